@@ -0,0 +1,994 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-bench.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+/*
+ * Throughput benchmark.  Test audio is generated with audiotestsrc,
+ * so every machine converts exactly the same input, and each file is
+ * converted with every installed audio profile.  Every conversion
+ * runs in a process of its own, so the CPU time and the peak RSS we
+ * report belong to that conversion alone.
+ *
+ * With --tiny-files it instead measures the fixed cost of a file, by
+ * running thousands of one second files through a single NscBatch.
+ *
+ * With --queue-files it measures the memory a batch needs per queued
+ * file, without converting anything.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <gconf/gconf-client.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-batch.h"
+#include "nsc-gstreamer.h"
+#include "nsc-queue.h"
+
+typedef struct {
+	const gchar *name;
+	const gchar *encoder;
+	const gchar *extension;
+	gint         rate;
+	gint         channels;
+	gint         seconds;
+} Source;
+
+/* The test audio every profile is benchmarked with */
+static const Source sources[] = {
+	{ "wav-44k-stereo-30s",  "wavenc",             "wav",  44100, 2, 30 },
+	{ "wav-48k-mono-30s",    "wavenc",             "wav",  48000, 1, 30 },
+	{ "wav-96k-stereo-30s",  "wavenc",             "wav",  96000, 2, 30 },
+	{ "flac-44k-stereo-120s", "flacenc",           "flac", 44100, 2, 120 },
+	{ "ogg-44k-stereo-120s", "vorbisenc ! oggmux", "ogg",  44100, 2, 120 },
+};
+
+/* Copied over and over for the per-file overhead benchmark */
+static const Source tiny_source =
+	{ "tiny-44k-stereo-1s",  "wavenc",             "wav",  44100, 2, 1 };
+
+/* Samples per buffer of the generated audio */
+#define SAMPLES_PER_BUFFER 1024
+
+/*
+ * The CPU time is only what the conversion itself took.  The peak
+ * RSS is a high-water mark, so it is that of the whole child, and
+ * the init RSS is where it stood once initialized.
+ */
+typedef struct {
+	gdouble realtime_factor;
+	gdouble cpu_time;
+	glong   peak_rss;
+	glong   init_rss;
+} Result;
+
+/* Options */
+static gchar    *workdir = NULL;
+static gchar    *baseline = NULL;
+static gchar   **profile_ids = NULL;
+static gint      threshold = 10;
+static gint      repeat = 3;
+static gboolean  save_baseline = FALSE;
+static gint      tiny_files = 0;
+static gint      queue_files = 0;
+static gint      queue_spill = 0;
+static gchar    *run_profile = NULL;
+static gchar    *run_source = NULL;
+
+static GOptionEntry entries[] = {
+	{ "workdir", 'd', 0, G_OPTION_ARG_FILENAME, &workdir,
+	  "Directory for the test audio and the converted files", "DIR" },
+	{ "baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline,
+	  "Compare against the results stored in FILE", "FILE" },
+	{ "save-baseline", 's', 0, G_OPTION_ARG_NONE, &save_baseline,
+	  "Store the results in the baseline instead of comparing", NULL },
+	{ "threshold", 't', 0, G_OPTION_ARG_INT, &threshold,
+	  "Percentage a result may be worse than the baseline", "PERCENT" },
+	{ "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+	  "Number of runs per file, of which the best one counts", "N" },
+	{ "profile", 'p', 0, G_OPTION_ARG_STRING_ARRAY, &profile_ids,
+	  "Only benchmark this audio profile", "ID" },
+	{ "tiny-files", 'n', 0, G_OPTION_ARG_INT, &tiny_files,
+	  "Measure the per-file overhead with N one second files", "N" },
+	{ "queue-files", 'q', 0, G_OPTION_ARG_INT, &queue_files,
+	  "Measure the memory used by a queue of N files", "N" },
+	{ "queue-spill", 0, 0, G_OPTION_ARG_INT, &queue_spill,
+	  "Keep no more than N queued files in memory", "N" },
+	/* Used to run a single conversion in a child process */
+	{ "run-profile", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING,
+	  &run_profile, NULL, NULL },
+	{ "run-source", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING,
+	  &run_source, NULL, NULL },
+	{ NULL }
+};
+
+static const Source *
+lookup_source (const gchar *name)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (sources); i++) {
+		if (strcmp (sources[i].name, name) == 0)
+			return &sources[i];
+	}
+
+	return NULL;
+}
+
+static gchar *
+source_path (const Source *source)
+{
+	gchar *basename, *path;
+
+	basename = g_strdup_printf ("%s.%s", source->name, source->extension);
+	path = g_build_filename (workdir, basename, NULL);
+	g_free (basename);
+
+	return path;
+}
+
+/**
+ * Run a pipeline until it is done.
+ */
+static gboolean
+run_pipeline (GstElement *pipeline, GError **error)
+{
+	GstMessage *msg;
+	GstBus     *bus;
+	gboolean    result = TRUE;
+
+	gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+	bus = gst_element_get_bus (pipeline);
+	msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+					  GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	gst_object_unref (bus);
+
+	if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+		gst_message_parse_error (msg, error, NULL);
+		result = FALSE;
+	}
+	gst_message_unref (msg);
+
+	gst_element_set_state (pipeline, GST_STATE_NULL);
+
+	return result;
+}
+
+/**
+ * Generate the test audio, unless it was already generated
+ * by an earlier run.
+ */
+static gboolean
+generate_source (const Source *source, GError **error)
+{
+	GstElement *pipeline;
+	gchar      *path, *tmp, *description;
+	gboolean    result;
+
+	path = source_path (source);
+	if (g_file_test (path, G_FILE_TEST_EXISTS)) {
+		g_free (path);
+		return TRUE;
+	}
+
+	/* A sine wave encodes the same way every time */
+	tmp = g_strconcat (path, ".part", NULL);
+	description = g_strdup_printf ("audiotestsrc wave=sine freq=440 "
+				       "samplesperbuffer=%d num-buffers=%d ! "
+				       "audio/x-raw-int,rate=%d,channels=%d,"
+				       "width=16,depth=16 ! "
+				       "audioconvert ! %s ! "
+				       "filesink location=\"%s\"",
+				       SAMPLES_PER_BUFFER,
+				       (source->seconds * source->rate
+					+ SAMPLES_PER_BUFFER - 1)
+				       / SAMPLES_PER_BUFFER,
+				       source->rate, source->channels,
+				       source->encoder, tmp);
+
+	pipeline = gst_parse_launch (description, error);
+	g_free (description);
+
+	result = pipeline != NULL && run_pipeline (pipeline, error);
+	if (pipeline != NULL)
+		gst_object_unref (pipeline);
+
+	if (result)
+		g_rename (tmp, path);
+	else
+		g_unlink (tmp);
+
+	g_free (tmp);
+	g_free (path);
+
+	return result;
+}
+
+/*
+ * Child process
+ */
+static void
+completion_cb (NscGStreamer *gstreamer, GMainLoop *loop)
+{
+	g_main_loop_quit (loop);
+}
+
+static void
+error_cb (NscGStreamer *gstreamer, GError *error, GMainLoop *loop)
+{
+	g_printerr ("%s\n", error->message);
+	exit (EXIT_FAILURE);
+}
+
+static gdouble
+cpu_seconds (const struct rusage *usage)
+{
+	return usage->ru_utime.tv_sec + usage->ru_stime.tv_sec
+		+ (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * Convert a single file and print the result as a key file.
+ * Loading GStreamer and the profiles is left out of the CPU time.
+ */
+static int
+run_conversion (void)
+{
+	GMAudioProfile     *profile;
+	const Source       *source;
+	const NscFileStats *stats;
+	NscGStreamer       *gstreamer;
+	GMainLoop          *loop;
+	GFile              *src, *sink;
+	GError             *error = NULL;
+	struct rusage       before, after;
+	gchar              *path, *basename;
+
+	profile = gm_audio_profile_lookup (run_profile);
+	source = lookup_source (run_source);
+	if (profile == NULL || source == NULL) {
+		g_printerr ("Unknown profile or source\n");
+		return EXIT_FAILURE;
+	}
+
+	path = source_path (source);
+	src = g_file_new_for_path (path);
+	g_free (path);
+
+	basename = g_strdup_printf ("out-%s-%s.%s", run_profile,
+				    source->name,
+				    gm_audio_profile_get_extension (profile));
+	path = g_build_filename (workdir, basename, NULL);
+	sink = g_file_new_for_path (path);
+	g_free (basename);
+	g_free (path);
+
+	loop = g_main_loop_new (NULL, FALSE);
+	gstreamer = nsc_gstreamer_new (profile);
+	g_signal_connect (gstreamer, "completion",
+			  G_CALLBACK (completion_cb), loop);
+	g_signal_connect (gstreamer, "error",
+			  G_CALLBACK (error_cb), loop);
+
+	getrusage (RUSAGE_SELF, &before);
+	nsc_gstreamer_convert_file (gstreamer, src, sink, &error);
+	if (error != NULL) {
+		g_printerr ("%s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	g_main_loop_run (loop);
+
+	getrusage (RUSAGE_SELF, &after);
+	stats = nsc_gstreamer_get_stats (gstreamer);
+
+	g_print ("[result]\n"
+		 "realtime_factor=%f\n"
+		 "cpu_time=%f\n"
+		 "peak_rss=%ld\n"
+		 "init_rss=%ld\n",
+		 stats->realtime_factor,
+		 cpu_seconds (&after) - cpu_seconds (&before),
+		 after.ru_maxrss, before.ru_maxrss);
+
+	g_file_delete (sink, NULL, NULL);
+	g_object_unref (gstreamer);
+	g_object_unref (sink);
+	g_object_unref (src);
+	g_main_loop_unref (loop);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Parent process
+ */
+static gboolean
+measure (const gchar  *self,
+	 const gchar  *profile_id,
+	 const Source *source,
+	 Result       *result,
+	 GError      **error)
+{
+	GKeyFile *key_file;
+	gchar    *output, *errors;
+	gint      status;
+	gchar    *argv[] = {
+		(gchar *) self,
+		"--workdir", workdir,
+		"--run-profile", (gchar *) profile_id,
+		"--run-source", (gchar *) source->name,
+		NULL
+	};
+
+	if (!g_spawn_sync (NULL, argv, NULL, 0, NULL, NULL,
+			   &output, &errors, &status, error))
+		return FALSE;
+
+	if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+		g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+			     "%s", g_strstrip (errors));
+		g_free (output);
+		g_free (errors);
+		return FALSE;
+	}
+
+	key_file = g_key_file_new ();
+	if (g_key_file_load_from_data (key_file, output, -1,
+				       G_KEY_FILE_NONE, error)) {
+		result->realtime_factor =
+			g_key_file_get_double (key_file, "result",
+					       "realtime_factor", NULL);
+		result->cpu_time =
+			g_key_file_get_double (key_file, "result",
+					       "cpu_time", NULL);
+		result->peak_rss =
+			g_key_file_get_integer (key_file, "result",
+						"peak_rss", NULL);
+		result->init_rss =
+			g_key_file_get_integer (key_file, "result",
+						"init_rss", NULL);
+	}
+	g_key_file_free (key_file);
+
+	g_free (output);
+	g_free (errors);
+
+	return TRUE;
+}
+
+/**
+ * Compare one number against the baseline, where @higher_is_better
+ * says which way a regression goes.  Returns FALSE on a regression.
+ */
+static gboolean
+compare (const gchar *name,
+	 gdouble      value,
+	 gdouble      base,
+	 gboolean     higher_is_better)
+{
+	gdouble change;
+
+	if (base <= 0)
+		return TRUE;
+
+	change = (value - base) / base * 100;
+	if (higher_is_better)
+		change = -change;
+
+	if (change <= threshold)
+		return TRUE;
+
+	g_print ("    %s regressed %.1f%% (%.3f, baseline %.3f)\n",
+		 name, change, value, base);
+
+	return FALSE;
+}
+
+/**
+ * Store the results, keeping those of the other benchmark
+ * that is already in the file.
+ */
+static void
+write_baseline (GKeyFile *results)
+{
+	GKeyFile  *key_file;
+	GError    *error = NULL;
+	gchar    **groups, **keys, *data;
+	gint       i, j;
+
+	key_file = g_key_file_new ();
+	g_key_file_load_from_file (key_file, baseline,
+				   G_KEY_FILE_KEEP_COMMENTS, NULL);
+
+	groups = g_key_file_get_groups (results, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		keys = g_key_file_get_keys (results, groups[i], NULL, NULL);
+		for (j = 0; keys[j] != NULL; j++) {
+			gchar *value;
+
+			value = g_key_file_get_value (results, groups[i],
+						      keys[j], NULL);
+			g_key_file_set_value (key_file, groups[i],
+					      keys[j], value);
+			g_free (value);
+		}
+		g_strfreev (keys);
+	}
+	g_strfreev (groups);
+
+	data = g_key_file_to_data (key_file, NULL, NULL);
+	if (!g_file_set_contents (baseline, data, -1, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+	} else {
+		g_print ("\nBaseline written to %s\n", baseline);
+	}
+
+	g_free (data);
+	g_key_file_free (key_file);
+}
+
+static GList *
+get_profiles (void)
+{
+	GList *profiles = NULL, *l;
+	gint   i;
+
+	if (profile_ids == NULL) {
+		for (l = gm_audio_profile_get_active_list (); l; l = l->next) {
+			if (nsc_gstreamer_supports_profile (l->data))
+				profiles = g_list_prepend (profiles, l->data);
+		}
+
+		return g_list_reverse (profiles);
+	}
+
+	for (i = 0; profile_ids[i] != NULL; i++) {
+		GMAudioProfile *profile;
+
+		profile = gm_audio_profile_lookup (profile_ids[i]);
+		if (profile == NULL)
+			g_printerr ("Unknown profile %s\n", profile_ids[i]);
+		else
+			profiles = g_list_append (profiles, profile);
+	}
+
+	return profiles;
+}
+
+static int
+run_benchmark (const gchar *self)
+{
+	GKeyFile *base;
+	GList    *profiles, *l;
+	GError   *error = NULL;
+	gboolean  have_base = FALSE, regressed = FALSE;
+	guint     i;
+
+	for (i = 0; i < G_N_ELEMENTS (sources); i++) {
+		if (!generate_source (&sources[i], &error)) {
+			g_printerr ("Could not generate %s: %s\n",
+				    sources[i].name, error->message);
+			return EXIT_FAILURE;
+		}
+	}
+
+	base = g_key_file_new ();
+	if (baseline != NULL && !save_baseline)
+		have_base = g_key_file_load_from_file (base, baseline,
+						       G_KEY_FILE_NONE, NULL);
+
+	g_print ("%-16s %-22s %10s %10s %10s %10s\n", "profile", "source",
+		 "realtime", "cpu (s)", "rss (KiB)", "init (KiB)");
+
+	profiles = get_profiles ();
+	for (l = profiles; l != NULL; l = l->next) {
+		const gchar *id = gm_audio_profile_get_id (l->data);
+
+		for (i = 0; i < G_N_ELEMENTS (sources); i++) {
+			Result  best = { 0, G_MAXDOUBLE, G_MAXLONG, G_MAXLONG };
+			gchar  *group;
+			gint    run;
+
+			/* The best of a few runs is the least noisy */
+			for (run = 0; run < MAX (1, repeat); run++) {
+				Result result;
+
+				if (!measure (self, id, &sources[i],
+					      &result, &error)) {
+					g_print ("%-16s %-22s failed: %s\n",
+						 id, sources[i].name,
+						 error->message);
+					g_clear_error (&error);
+					break;
+				}
+
+				best.realtime_factor = MAX (best.realtime_factor,
+							    result.realtime_factor);
+				best.cpu_time = MIN (best.cpu_time,
+						     result.cpu_time);
+				best.peak_rss = MIN (best.peak_rss,
+						     result.peak_rss);
+				best.init_rss = MIN (best.init_rss,
+						     result.init_rss);
+			}
+
+			if (run < MAX (1, repeat))
+				continue;
+
+			g_print ("%-16s %-22s %9.1fx %10.3f %10ld %10ld\n",
+				 id, sources[i].name, best.realtime_factor,
+				 best.cpu_time, best.peak_rss, best.init_rss);
+
+			group = g_strdup_printf ("%s/%s", id, sources[i].name);
+
+			if (save_baseline) {
+				g_key_file_set_double (base, group,
+						       "realtime_factor",
+						       best.realtime_factor);
+				g_key_file_set_double (base, group, "cpu_time",
+						       best.cpu_time);
+				g_key_file_set_integer (base, group, "peak_rss",
+							best.peak_rss);
+			} else if (have_base &&
+				   g_key_file_has_group (base, group)) {
+				gboolean ok = TRUE;
+
+				ok &= compare ("realtime factor",
+					       best.realtime_factor,
+					       g_key_file_get_double (base, group, "realtime_factor", NULL),
+					       TRUE);
+				ok &= compare ("cpu time", best.cpu_time,
+					       g_key_file_get_double (base, group, "cpu_time", NULL),
+					       FALSE);
+				ok &= compare ("peak rss", best.peak_rss,
+					       g_key_file_get_integer (base, group, "peak_rss", NULL),
+					       FALSE);
+				if (!ok)
+					regressed = TRUE;
+			}
+
+			g_free (group);
+		}
+	}
+	g_list_free (profiles);
+
+	if (save_baseline && baseline != NULL) {
+		write_baseline (base);
+	} else if (baseline != NULL && !have_base) {
+		g_print ("\nNo baseline in %s, run with --save-baseline "
+			 "to create one\n", baseline);
+	} else if (regressed) {
+		g_print ("\nSlower than the baseline by more than %d%%\n",
+			 threshold);
+	}
+
+	g_key_file_free (base);
+
+	return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * Per-file overhead
+ */
+typedef enum {
+	PHASE_BUILD,
+	PHASE_STARTUP,
+	PHASE_QUERY,
+	PHASE_STREAM,
+	PHASE_STOP,
+	PHASE_OTHER,
+	PHASE_TOTAL,
+	PHASE_LAST
+} Phase;
+
+static const gchar *phase_names[PHASE_LAST] = {
+	"build",
+	"startup",
+	"query",
+	"stream",
+	"stop",
+	"other",
+	"total",
+};
+
+typedef struct {
+	GMainLoop *loop;
+	GArray    *phases[PHASE_LAST];
+	gint64     started;
+	guint      n_failed;
+} TinyRun;
+
+/**
+ * Split the time since the file was started into phases.  What
+ * NscGStreamer does not account for is waiting for the main loop,
+ * and the batch moving on to the next file.
+ */
+static void
+add_phases (TinyRun *run, const NscFileStats *stats)
+{
+	gdouble times[PHASE_LAST];
+	gint    i;
+
+	times[PHASE_TOTAL] = g_get_monotonic_time () - run->started;
+	times[PHASE_BUILD] = stats->build_time;
+	times[PHASE_STARTUP] = MAX (0, stats->startup_time);
+	times[PHASE_QUERY] = MAX (0, stats->query_time);
+	times[PHASE_STOP] = MAX (0, stats->stop_time);
+	times[PHASE_STREAM] = stats->wall_time - times[PHASE_STARTUP]
+		- times[PHASE_QUERY] - times[PHASE_STOP];
+	times[PHASE_OTHER] = times[PHASE_TOTAL] - stats->build_time
+		- stats->wall_time;
+
+	for (i = 0; i < PHASE_LAST; i++) {
+		gdouble msecs = times[i] / 1000;
+
+		g_array_append_val (run->phases[i], msecs);
+	}
+}
+
+static void
+tiny_started_cb (NscBatch *batch, guint index, TinyRun *run)
+{
+	run->started = g_get_monotonic_time ();
+}
+
+static void
+tiny_completed_cb (NscBatch *batch, guint index, TinyRun *run)
+{
+	add_phases (run, nsc_batch_get_file_stats (batch));
+}
+
+static void
+tiny_failed_cb (NscBatch *batch, guint index, GError *error, TinyRun *run)
+{
+	if (run->n_failed++ == 0)
+		g_printerr ("%s\n", error->message);
+}
+
+static void
+tiny_finished_cb (NscBatch *batch, TinyRun *run)
+{
+	g_main_loop_quit (run->loop);
+}
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * Make @n_files copies of the one second test file.
+ */
+static GPtrArray *
+create_tiny_files (gint n_files, GError **error)
+{
+	GPtrArray *files;
+	GFile     *source;
+	gchar     *path, *dir;
+	gint       i;
+
+	if (!generate_source (&tiny_source, error))
+		return NULL;
+
+	path = source_path (&tiny_source);
+	source = g_file_new_for_path (path);
+	g_free (path);
+
+	dir = g_build_filename (workdir, "tiny", NULL);
+	g_mkdir_with_parents (dir, 0755);
+
+	files = g_ptr_array_new ();
+	for (i = 0; i < n_files; i++) {
+		GFile *file;
+		gchar *basename;
+
+		basename = g_strdup_printf ("tiny-%05d.wav", i);
+		path = g_build_filename (dir, basename, NULL);
+		file = g_file_new_for_path (path);
+		g_free (basename);
+		g_free (path);
+
+		if (!g_file_query_exists (file, NULL) &&
+		    !g_file_copy (source, file, G_FILE_COPY_NONE,
+				  NULL, NULL, NULL, error)) {
+			g_object_unref (file);
+			g_ptr_array_foreach (files, (GFunc) g_object_unref, NULL);
+			g_ptr_array_free (files, TRUE);
+			files = NULL;
+			break;
+		}
+
+		g_ptr_array_add (files, file);
+	}
+
+	g_object_unref (source);
+	g_free (dir);
+
+	return files;
+}
+
+static int
+run_tiny_benchmark (void)
+{
+	GMAudioProfile *profile;
+	GPtrArray      *files;
+	GKeyFile       *base;
+	GList          *profiles;
+	NscBatch       *batch;
+	TinyRun         run = { 0 };
+	GError         *error = NULL;
+	gchar          *path, *uri;
+	gboolean        have_base = FALSE, regressed = FALSE;
+	gint64          started;
+	guint           i;
+
+	profiles = get_profiles ();
+	if (profiles == NULL) {
+		g_printerr ("No usable audio profile\n");
+		return EXIT_FAILURE;
+	}
+	profile = profiles->data;
+	g_list_free (profiles);
+
+	files = create_tiny_files (tiny_files, &error);
+	if (files == NULL) {
+		g_printerr ("Could not create the test files: %s\n",
+			    error->message);
+		g_error_free (error);
+		return EXIT_FAILURE;
+	}
+
+	path = g_build_filename (workdir, "tiny-out", NULL);
+	g_mkdir_with_parents (path, 0755);
+	uri = g_filename_to_uri (path, NULL, NULL);
+	g_free (path);
+
+	/* The same object the Nautilus extension and the service use */
+	batch = nsc_batch_new (profile, uri);
+	g_free (uri);
+
+	for (i = 0; i < files->len; i++)
+		nsc_batch_add_file (batch, g_ptr_array_index (files, i));
+
+	run.loop = g_main_loop_new (NULL, FALSE);
+	for (i = 0; i < PHASE_LAST; i++)
+		run.phases[i] = g_array_sized_new (FALSE, FALSE,
+						   sizeof (gdouble),
+						   files->len);
+
+	g_signal_connect (batch, "file-started",
+			  G_CALLBACK (tiny_started_cb), &run);
+	g_signal_connect (batch, "file-completed",
+			  G_CALLBACK (tiny_completed_cb), &run);
+	g_signal_connect (batch, "file-failed",
+			  G_CALLBACK (tiny_failed_cb), &run);
+	g_signal_connect (batch, "finished",
+			  G_CALLBACK (tiny_finished_cb), &run);
+
+	started = g_get_monotonic_time ();
+	nsc_batch_start (batch);
+	g_main_loop_run (run.loop);
+
+	g_print ("%u files with %s in %.1f s, %u failed\n\n",
+		 files->len, gm_audio_profile_get_id (profile),
+		 (g_get_monotonic_time () - started) / 1e6, run.n_failed);
+
+	base = g_key_file_new ();
+	if (baseline != NULL && !save_baseline)
+		have_base = g_key_file_load_from_file (base, baseline,
+						       G_KEY_FILE_NONE, NULL);
+
+	g_print ("%-10s %10s %10s %10s\n", "phase", "mean (ms)",
+		 "p50 (ms)", "p95 (ms)");
+
+	for (i = 0; i < PHASE_LAST && run.phases[i]->len > 0; i++) {
+		GArray  *times = run.phases[i];
+		gdouble  mean = 0;
+		guint    j;
+
+		for (j = 0; j < times->len; j++)
+			mean += g_array_index (times, gdouble, j);
+		mean /= times->len;
+
+		g_array_sort (times, compare_doubles);
+
+		g_print ("%-10s %10.3f %10.3f %10.3f\n", phase_names[i], mean,
+			 g_array_index (times, gdouble, times->len / 2),
+			 g_array_index (times, gdouble, times->len * 95 / 100));
+
+		if (save_baseline)
+			g_key_file_set_double (base, "tiny", phase_names[i],
+					       mean);
+		else if (have_base &&
+			 g_key_file_has_key (base, "tiny", phase_names[i], NULL) &&
+			 !compare (phase_names[i], mean,
+				   g_key_file_get_double (base, "tiny",
+							  phase_names[i], NULL),
+				   FALSE))
+			regressed = TRUE;
+	}
+
+	if (save_baseline && baseline != NULL)
+		write_baseline (base);
+
+	for (i = 0; i < PHASE_LAST; i++)
+		g_array_free (run.phases[i], TRUE);
+	g_main_loop_unref (run.loop);
+	g_object_unref (batch);
+	g_ptr_array_foreach (files, (GFunc) g_object_unref, NULL);
+	g_ptr_array_free (files, TRUE);
+	g_key_file_free (base);
+
+	return regressed || run.n_failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* The resident set size right now, in bytes */
+static glong
+get_rss (void)
+{
+	gchar *contents;
+	glong  size = 0, resident = 0;
+
+	if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+		return 0;
+
+	sscanf (contents, "%ld %ld", &size, &resident);
+	g_free (contents);
+
+	return resident * sysconf (_SC_PAGESIZE);
+}
+
+/**
+ * Queue made up files, laid out like a music collection, and see
+ * what they cost per 100000 files.
+ */
+static int
+run_queue_benchmark (void)
+{
+	NscQueue *queue;
+	GKeyFile *base;
+	GError   *error = NULL;
+	gboolean  regressed = FALSE;
+	gdouble   rss_per, size_per;
+	gint64    started, added;
+	glong     rss;
+	gint      i;
+
+	rss = get_rss ();
+	started = g_get_monotonic_time ();
+
+	queue = nsc_queue_new ();
+	if (queue_spill > 0 &&
+	    !nsc_queue_set_spill (queue, queue_spill, &error)) {
+		g_printerr ("Could not spill the queue: %s\n", error->message);
+		g_error_free (error);
+		nsc_queue_free (queue);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < queue_files; i++) {
+		gchar *uri;
+
+		uri = g_strdup_printf ("file:///home/user/Music/Artist%%20%04d/"
+				       "Album%%20%02d/%02d%%20-%%20Track%%20"
+				       "number%%20%d.flac",
+				       i / 120, i / 12 % 10, i % 12 + 1, i);
+		nsc_queue_add (queue, uri, NULL);
+		g_free (uri);
+	}
+
+	added = g_get_monotonic_time ();
+	rss_per = (gdouble) (get_rss () - rss) * 100000 / queue_files;
+	size_per = (gdouble) nsc_queue_get_size (queue) * 100000 / queue_files;
+
+	/* The batch reads every file back once, and then drops it */
+	for (i = 0; i < queue_files; i++) {
+		g_free (nsc_queue_get_uri (queue, i));
+		nsc_queue_release (queue, i);
+	}
+
+	g_print ("%d files queued in %.1f ms and drained in %.1f ms\n",
+		 queue_files, (added - started) / 1000.0,
+		 (g_get_monotonic_time () - added) / 1000.0);
+	g_print ("per 100000 files: %.1f MB resident, %.1f MB in the queue\n",
+		 rss_per / (1024 * 1024), size_per / (1024 * 1024));
+
+	nsc_queue_free (queue);
+
+	base = g_key_file_new ();
+	if (save_baseline) {
+		g_key_file_set_double (base, "queue", "rss_per_100k", rss_per);
+		if (baseline != NULL)
+			write_baseline (base);
+	} else if (baseline != NULL &&
+		   g_key_file_load_from_file (base, baseline,
+					      G_KEY_FILE_NONE, NULL) &&
+		   g_key_file_has_key (base, "queue", "rss_per_100k", NULL)) {
+		regressed = !compare ("rss_per_100k", rss_per,
+				      g_key_file_get_double (base, "queue",
+							     "rss_per_100k",
+							     NULL),
+				      FALSE);
+	}
+	g_key_file_free (base);
+
+	return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GConfClient    *gconf;
+	GError         *error = NULL;
+	int             status;
+
+	g_type_init ();
+
+	context = g_option_context_new ("- benchmark audio conversion");
+	g_option_context_add_main_entries (context, entries, NULL);
+	g_option_context_add_group (context, gst_init_get_option_group ());
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (workdir == NULL)
+		workdir = g_strdup ("bench-data");
+	g_mkdir_with_parents (workdir, 0755);
+
+	gconf = gconf_client_get_default ();
+	gnome_media_profiles_init (gconf);
+
+	if (run_profile != NULL && run_source != NULL)
+		status = run_conversion ();
+	else if (queue_files > 0)
+		status = run_queue_benchmark ();
+	else if (tiny_files > 0)
+		status = run_tiny_benchmark ();
+	else
+		status = run_benchmark (argv[0]);
+
+	g_object_unref (gconf);
+
+	return status;
+}
@@ -0,0 +1,1630 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-batch.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-batch.h"
+#include "nsc-cue.h"
+#include "nsc-error.h"
+#include "nsc-gstreamer.h"
+#include "nsc-prefetch.h"
+#include "nsc-queue.h"
+#include "nsc-scheduler.h"
+#include "nsc-split.h"
+
+/* Properties */
+enum {
+	PROP_0,
+	PROP_PROFILE,
+	PROP_OUTPUT_URI,
+};
+
+/* Signals */
+enum {
+	FILE_STARTED,
+	DURATION,
+	PROGRESS,
+	FILE_COMPLETED,
+	FILE_FAILED,
+	RETRYING,
+	PAUSED,
+	FINISHED,
+	LAST_SIGNAL,
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* Decoder used when retrying failed files */
+#define ALTERNATE_DECODER "decodebin2"
+
+/* Files read ahead of the one being converted */
+#define PREFETCH_AHEAD    2
+
+#define NSEC_PER_SEC      ((gint64) 1000000000)
+
+/* Part of a file, in nanoseconds, with an end of -1 for its end */
+typedef struct {
+	gint64 start;
+	gint64 end;
+} Range;
+
+typedef struct _NscBatchPrivate NscBatchPrivate;
+
+struct _NscBatchPrivate {
+	/* The audio profile used for every file */
+	GMAudioProfile *profile;
+
+	/* Directory to save new files, or NULL for the source directory */
+	gchar          *output_uri;
+	GFile          *output;
+
+	/*
+	 * Every file added to the batch, in order, with the directory
+	 * each goes into, relative to the output directory.  Files are
+	 * dropped from it once converted.
+	 */
+	NscQueue       *files;
+
+	/* Indices of the files still to be converted */
+	GArray         *queue;
+	guint           position;
+
+	/* The Range of the files only partly converted, by index */
+	GHashTable     *ranges;
+
+	/*
+	 * The URIs of the files this batch writes, so they are not
+	 * converted again when written into a folder still being read.
+	 */
+	GHashTable     *written;
+
+	/* Files are still being added, so running out is not the end */
+	gboolean        open;
+	gboolean        waiting;
+
+	/* Files that failed and will be tried again */
+	gboolean        retry;
+	gboolean        retrying;
+	GArray         *failed;
+
+	/* GStreamer Object */
+	NscGStreamer   *gst;
+
+	/*
+	 * Splits images with a cue sheet into their tracks, and is
+	 * doing so for the current file.
+	 */
+	gboolean        split_cue;
+	NscSplitter    *splitter;
+	gboolean        splitting;
+
+	/* The cue sheets of each directory, and the lookup running */
+	NscCueCache    *cues;
+	GCancellable   *lookup;
+
+	/* Our place with the scheduler, and whether we go first */
+	NscSchedulerClient *client;
+	gboolean        interactive;
+
+	/*
+	 * Paused by the user or for the load.  A file that was due to
+	 * start while paused is held until the batch is resumed.
+	 */
+	gboolean        user_paused;
+	gboolean        load_paused;
+	gboolean        paused;
+	gboolean        held;
+
+	/* Idle source used to move on after an error */
+	guint           next_id;
+
+	/* Reads the next files while the current one converts */
+	NscPrefetch    *prefetch;
+
+	/* Where to write the timing report, or NULL for none */
+	gchar          *report_dir;
+	NscStats       *stats;
+
+	/* Where to write the verification manifest, or NULL for none */
+	gchar          *verify_dir;
+	NscManifest    *manifest;
+
+	/* Where to write the trace, or NULL for none */
+	gchar          *trace_dir;
+	NscTrace       *trace;
+	guint           lane;
+	gint64          file_start;
+};
+
+#define NSC_BATCH_GET_PRIVATE(o)           \
+	((NscBatchPrivate *)((NSC_BATCH(o))->priv))
+
+G_DEFINE_TYPE (NscBatch, nsc_batch, G_TYPE_OBJECT)
+
+static void run_next (NscBatch *batch);
+
+static void
+stop_gst (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	if (priv->next_id) {
+		g_source_remove (priv->next_id);
+		priv->next_id = 0;
+	}
+
+	nsc_scheduler_remove_client (priv->client);
+	priv->client = NULL;
+
+	nsc_prefetch_free (priv->prefetch);
+	priv->prefetch = NULL;
+
+	if (priv->lookup) {
+		g_cancellable_cancel (priv->lookup);
+		g_object_unref (priv->lookup);
+		priv->lookup = NULL;
+	}
+
+	if (priv->gst) {
+		g_signal_handlers_disconnect_matched (priv->gst,
+						      G_SIGNAL_MATCH_DATA,
+						      0, 0, NULL, NULL, batch);
+		g_object_unref (priv->gst);
+		priv->gst = NULL;
+	}
+
+	if (priv->splitter) {
+		g_signal_handlers_disconnect_matched (priv->splitter,
+						      G_SIGNAL_MATCH_DATA,
+						      0, 0, NULL, NULL, batch);
+		g_object_unref (priv->splitter);
+		priv->splitter = NULL;
+	}
+	priv->splitting = FALSE;
+}
+
+/**
+ * Write the trace once the batch is done with it.
+ */
+static void
+release_trace (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	GError          *error = NULL;
+
+	if (priv->trace == NULL)
+		return;
+
+	if (!nsc_trace_release (priv->trace, priv->trace_dir, &error)) {
+		g_warning ("Unable to write the trace; %s", error->message);
+		g_error_free (error);
+	}
+
+	priv->trace = NULL;
+}
+
+/**
+ * Put the current file on the timeline, up to now.
+ */
+static void
+trace_file (NscBatch *batch, guint index, const gchar *result)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	gchar           *uri;
+
+	if (priv->trace == NULL)
+		return;
+
+	uri = nsc_queue_get_uri (priv->files, index);
+	nsc_trace_span (priv->trace, priv->lane, "batch", result,
+			priv->file_start, g_get_monotonic_time (), uri);
+	g_free (uri);
+}
+
+static void
+nsc_batch_set_property (GObject      *object,
+			guint         property_id,
+			const GValue *value,
+			GParamSpec   *pspec)
+{
+	NscBatch        *self = NSC_BATCH (object);
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (self);
+
+	switch (property_id) {
+	case PROP_PROFILE:
+		if (priv->profile)
+			g_object_unref (priv->profile);
+
+		priv->profile = GM_AUDIO_PROFILE (g_value_dup_object (value));
+		break;
+	case PROP_OUTPUT_URI:
+		g_free (priv->output_uri);
+		priv->output_uri = g_value_dup_string (value);
+
+		if (priv->output)
+			g_object_unref (priv->output);
+		priv->output = priv->output_uri ?
+			g_file_new_for_uri (priv->output_uri) : NULL;
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+	}
+}
+
+static void
+nsc_batch_get_property (GObject    *object,
+			guint       property_id,
+			GValue     *value,
+			GParamSpec *pspec)
+{
+	NscBatch        *self = NSC_BATCH (object);
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (self);
+
+	switch (property_id) {
+	case PROP_PROFILE:
+		g_value_set_object (value, priv->profile);
+		break;
+	case PROP_OUTPUT_URI:
+		g_value_set_string (value, priv->output_uri);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+	}
+}
+
+static void
+nsc_batch_dispose (GObject *object)
+{
+	NscBatch        *self = (NscBatch *) object;
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		stop_gst (self);
+		release_trace (self);
+
+		if (priv->profile) {
+			g_object_unref (priv->profile);
+			priv->profile = NULL;
+		}
+
+		if (priv->output) {
+			g_object_unref (priv->output);
+			priv->output = NULL;
+		}
+	}
+
+	G_OBJECT_CLASS (nsc_batch_parent_class)->dispose (object);
+}
+
+static void
+nsc_batch_finalize (GObject *object)
+{
+	NscBatch        *self = (NscBatch *) object;
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		g_free (priv->output_uri);
+		g_free (priv->report_dir);
+		g_free (priv->trace_dir);
+		g_free (priv->verify_dir);
+		nsc_stats_free (priv->stats);
+		nsc_manifest_free (priv->manifest);
+		nsc_cue_cache_free (priv->cues);
+		nsc_queue_free (priv->files);
+		g_hash_table_destroy (priv->ranges);
+		g_hash_table_destroy (priv->written);
+		g_array_free (priv->queue, TRUE);
+		g_array_free (priv->failed, TRUE);
+
+		g_free (priv);
+
+		(NSC_BATCH (self))->priv = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_batch_parent_class)->finalize (object);
+}
+
+/*
+ * Private Methods
+ */
+
+/**
+ * A time in a file name, like 1h05m00s.
+ */
+static gchar *
+format_offset (gint64 nanos)
+{
+	gint64 secs = nanos / NSEC_PER_SEC;
+
+	if (secs >= 3600)
+		return g_strdup_printf ("%dh%02dm%02ds", (gint) (secs / 3600),
+					(gint) (secs / 60 % 60),
+					(gint) (secs % 60));
+
+	return g_strdup_printf ("%dm%02ds", (gint) (secs / 60),
+				(gint) (secs % 60));
+}
+
+/**
+ * Create the new GFile.  This will need to be unreferenced.  A file
+ * that is only partly converted is named after its @range, so many
+ * ranges can be taken from the same file.
+ */
+static GFile *
+create_new_file (NscBatch    *batch,
+		 GFile       *file,
+		 const gchar *subdir,
+		 const Range *range)
+{
+	NscBatchPrivate *priv;
+	GFile           *new_file, *parent;
+	gchar           *basename, *new_basename;
+	gchar           *extension, *start, *end;
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	/* Swap the extension of the basename for the audio profile's */
+	basename = g_file_get_basename (file);
+	extension = strrchr (basename, '.');
+	if (extension != NULL)
+		*extension = '\0';
+
+	if (range != NULL) {
+		start = format_offset (range->start);
+		end = range->end < 0 ? g_strdup ("end")
+				     : format_offset (range->end);
+		new_basename = g_strdup_printf ("%s %s-%s.%s", basename,
+						start, end,
+						gm_audio_profile_get_extension (priv->profile));
+		g_free (start);
+		g_free (end);
+	} else {
+		new_basename = g_strconcat (basename, ".",
+					    gm_audio_profile_get_extension (priv->profile),
+					    NULL);
+	}
+	g_free (basename);
+
+	/*
+	 * Either the chosen directory, or the one the file is in.  Files
+	 * from a folder keep their place in the tree under the chosen one.
+	 */
+	if (priv->output != NULL && subdir != NULL)
+		parent = g_file_resolve_relative_path (priv->output, subdir);
+	else if (priv->output != NULL)
+		parent = g_object_ref (priv->output);
+	else
+		parent = g_file_get_parent (file);
+
+	/* And now finally let's create the new GFile */
+	new_file = g_file_get_child (parent, new_basename);
+	g_object_unref (parent);
+	g_free (new_basename);
+
+	return new_file;
+}
+
+/**
+ * Files from a folder may go into a directory that does not
+ * exist yet.
+ */
+static gboolean
+make_parent (GFile *file, GError **error)
+{
+	GFile    *parent;
+	GError   *err = NULL;
+	gboolean  result;
+
+	parent = g_file_get_parent (file);
+	result = g_file_make_directory_with_parents (parent, NULL, &err);
+	g_object_unref (parent);
+
+	if (!result &&
+	    g_error_matches (err, G_IO_ERROR, G_IO_ERROR_EXISTS)) {
+		g_error_free (err);
+		return TRUE;
+	}
+
+	if (!result)
+		g_propagate_error (error, err);
+
+	return result;
+}
+
+static guint
+current_index (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	return g_array_index (priv->queue, guint, priv->position);
+}
+
+/**
+ * Start reading the files after the current one, so they are
+ * in memory by the time they are converted.
+ */
+static void
+prefetch_ahead (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	guint            i;
+
+	if (priv->prefetch == NULL)
+		return;
+
+	for (i = priv->position + 1;
+	     i < priv->queue->len && i <= priv->position + PREFETCH_AHEAD;
+	     i++) {
+		guint  index;
+		gchar *uri;
+
+		/* The start of a file is no use when only a range is read */
+		index = g_array_index (priv->queue, guint, i);
+		if (g_hash_table_lookup (priv->ranges, GUINT_TO_POINTER (index)))
+			continue;
+
+		uri = nsc_queue_get_uri (priv->files, index);
+		if (uri != NULL)
+			nsc_prefetch_file (priv->prefetch, uri);
+		g_free (uri);
+	}
+}
+
+/**
+ * Report the current file as failed, or keep it for the
+ * retry pass at the end of the batch.
+ */
+static void
+fail_current (NscBatch *batch, GError *error)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	guint            index;
+
+	index = current_index (batch);
+
+	/* Let the other batches have a go */
+	nsc_scheduler_release (priv->client);
+
+	if (priv->retry && !priv->retrying) {
+		g_array_append_val (priv->failed, index);
+		return;
+	}
+
+	g_signal_emit (batch, signals[FILE_FAILED], 0, index, error);
+	nsc_queue_release (priv->files, index);
+	g_hash_table_remove (priv->ranges, GUINT_TO_POINTER (index));
+}
+
+/**
+ * Keep what it took to convert the last file for the report.
+ */
+static void
+record_stats (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	/* A split image is not timed */
+	if (priv->stats == NULL || priv->splitting)
+		return;
+
+	nsc_stats_add (priv->stats,
+		       nsc_file_stats_copy (nsc_gstreamer_get_stats (priv->gst)));
+}
+
+static void
+export_stats (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	GError          *error = NULL;
+
+	if (priv->stats == NULL)
+		return;
+
+	if (!nsc_stats_export (priv->stats, priv->report_dir, &error)) {
+		g_warning ("Unable to write the batch report; %s",
+			   error->message);
+		g_error_free (error);
+	}
+
+	nsc_stats_free (priv->stats);
+	priv->stats = NULL;
+}
+
+/**
+ * Keep how the last file checked out for the manifest.
+ */
+static void
+record_verify (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	NscVerifyResult  result;
+	const gchar     *pcm_md5;
+
+	if (priv->manifest == NULL || priv->splitting)
+		return;
+
+	result = nsc_gstreamer_get_verify_result (priv->gst, &pcm_md5);
+	nsc_manifest_add (priv->manifest,
+			  nsc_gstreamer_get_stats (priv->gst)->uri,
+			  result, pcm_md5);
+}
+
+static void
+export_manifest (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	GError          *error = NULL;
+
+	if (priv->manifest == NULL)
+		return;
+
+	if (!nsc_manifest_export (priv->manifest, priv->verify_dir, &error)) {
+		g_warning ("Unable to write the verification manifest; %s",
+			   error->message);
+		g_error_free (error);
+	}
+
+	nsc_manifest_free (priv->manifest);
+	priv->manifest = NULL;
+}
+
+static gboolean
+next_idle_cb (gpointer data)
+{
+	NscBatch        *batch = NSC_BATCH (data);
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	priv->next_id = 0;
+	priv->position++;
+	run_next (batch);
+
+	return FALSE;
+}
+
+/**
+ * Move on to the next file once we are back in the main loop.
+ */
+static void
+schedule_next (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	if (priv->next_id == 0)
+		priv->next_id = g_idle_add (next_idle_cb, batch);
+}
+
+static void
+on_completion_cb (NscGStreamer *gstream, gpointer data)
+{
+	NscBatch        *batch = NSC_BATCH (data);
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	gint64           finalise;
+	guint            index;
+
+	record_stats (batch);
+	record_verify (batch);
+
+	/* Whatever the handlers do with the new file */
+	index = current_index (batch);
+	finalise = g_get_monotonic_time ();
+	g_signal_emit (batch, signals[FILE_COMPLETED], 0, index);
+	priv->splitting = FALSE;
+	if (priv->trace != NULL)
+		nsc_trace_span (priv->trace, priv->lane, "file", "finalise",
+				finalise, g_get_monotonic_time (), NULL);
+	trace_file (batch, index, "completed");
+	nsc_queue_release (priv->files, index);
+	g_hash_table_remove (priv->ranges, GUINT_TO_POINTER (index));
+	nsc_scheduler_release (priv->client);
+
+	priv->position++;
+	run_next (batch);
+}
+
+/**
+ * The error passed in does not need to be freed.
+ */
+static void
+on_error_cb (NscGStreamer *gstream, GError *error, gpointer data)
+{
+	NscBatch        *batch = NSC_BATCH (data);
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	record_stats (batch);
+	record_verify (batch);
+	trace_file (batch, current_index (batch), "failed");
+	fail_current (batch, error);
+	priv->splitting = FALSE;
+	schedule_next (batch);
+}
+
+static void
+on_duration_cb (NscGStreamer *gstream, const int seconds, gpointer data)
+{
+	g_signal_emit (data, signals[DURATION], 0, seconds);
+}
+
+static void
+on_progress_cb (NscGStreamer *gstream, const int seconds, gpointer data)
+{
+	g_signal_emit (data, signals[PROGRESS], 0, seconds);
+}
+
+/**
+ * Split @old_file into its tracks with @sheet instead of converting
+ * it.  The tracks go into the directory @new_file would have been
+ * written to.  The splitter takes ownership of @sheet.
+ */
+static void
+split_image (NscBatch     *batch,
+	     GFile        *old_file,
+	     GFile        *new_file,
+	     NscCueSheet  *sheet,
+	     GError      **error)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	GFile           *directory;
+	guint            i;
+
+	if (priv->splitter == NULL) {
+		priv->splitter = nsc_splitter_new (priv->profile);
+
+		g_signal_connect (G_OBJECT (priv->splitter), "completion",
+				  (GCallback) on_completion_cb,
+				  batch);
+		g_signal_connect (G_OBJECT (priv->splitter), "error",
+				  (GCallback) on_error_cb,
+				  batch);
+		g_signal_connect (G_OBJECT (priv->splitter), "progress",
+				  (GCallback) on_progress_cb,
+				  batch);
+		g_signal_connect (G_OBJECT (priv->splitter), "duration",
+				  (GCallback) on_duration_cb,
+				  batch);
+	}
+
+	priv->splitting = TRUE;
+	directory = g_file_get_parent (new_file);
+
+	for (i = 0; i < sheet->tracks->len; i++) {
+		GFile *track;
+
+		track = nsc_splitter_get_track_file (priv->profile, sheet,
+						     directory, i);
+		g_hash_table_insert (priv->written, g_file_get_uri (track),
+				     NULL);
+		g_object_unref (track);
+	}
+
+	nsc_splitter_split_file (priv->splitter, old_file, sheet,
+				 directory, error);
+	g_object_unref (directory);
+}
+
+/**
+ * Convert @old_file into @new_file, or split it with @sheet when
+ * it is an image that has one, in which case the splitter takes
+ * ownership of @sheet.  Returns FALSE if it could not even be
+ * started.
+ */
+static gboolean
+start_file (NscBatch     *batch,
+	    GFile        *old_file,
+	    GFile        *new_file,
+	    const Range  *range,
+	    NscCueSheet  *sheet)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	GError          *err = NULL;
+
+	if (range != NULL)
+		nsc_gstreamer_convert_range (priv->gst, old_file, new_file,
+					     range->start, range->end, &err);
+	else if (sheet != NULL)
+		split_image (batch, old_file, new_file, sheet, &err);
+	else
+		nsc_gstreamer_convert_file (priv->gst, old_file, new_file,
+					    &err);
+
+	/* The file could not even be started, so skip it */
+	if (err != NULL) {
+		record_stats (batch);
+		trace_file (batch, current_index (batch), "failed");
+		fail_current (batch, err);
+		priv->splitting = FALSE;
+		g_error_free (err);
+		schedule_next (batch);
+		return FALSE;
+	}
+
+	prefetch_ahead (batch);
+
+	return TRUE;
+}
+
+typedef struct {
+	NscBatch     *batch;
+	GFile        *old_file;
+	GFile        *new_file;
+	GCancellable *cancellable;
+} Lookup;
+
+static void
+lookup_free (Lookup *lookup)
+{
+	g_object_unref (lookup->batch);
+	g_object_unref (lookup->old_file);
+	g_object_unref (lookup->new_file);
+	g_object_unref (lookup->cancellable);
+	g_free (lookup);
+}
+
+static void
+sheet_found_cb (GObject      *source,
+		GAsyncResult *res,
+		gpointer      user_data)
+{
+	Lookup          *lookup = user_data;
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (lookup->batch);
+	NscCueSheet     *sheet;
+	gboolean         started;
+
+	sheet = nsc_cue_sheet_find_finish (res, NULL);
+
+	/* The batch was cancelled while the sheet was looked for */
+	if (g_cancellable_is_cancelled (lookup->cancellable)) {
+		nsc_cue_sheet_free (sheet);
+		lookup_free (lookup);
+		return;
+	}
+
+	g_object_unref (priv->lookup);
+	priv->lookup = NULL;
+
+	started = start_file (lookup->batch, lookup->old_file,
+			      lookup->new_file, NULL, sheet);
+
+	/* It was paused while nothing was running yet */
+	if (started && priv->paused) {
+		if (priv->splitting)
+			nsc_splitter_pause (priv->splitter);
+		else
+			nsc_gstreamer_pause_convert (priv->gst);
+	}
+
+	lookup_free (lookup);
+}
+
+/**
+ * Look for the cue sheet of @old_file in a thread, and start it
+ * once it is known whether it has one.
+ */
+static void
+find_sheet (NscBatch *batch,
+	    GFile    *old_file,
+	    GFile    *new_file)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	Lookup          *lookup;
+
+	priv->lookup = g_cancellable_new ();
+
+	lookup = g_new0 (Lookup, 1);
+	lookup->batch = g_object_ref (batch);
+	lookup->old_file = g_object_ref (old_file);
+	lookup->new_file = g_object_ref (new_file);
+	lookup->cancellable = g_object_ref (priv->lookup);
+
+	nsc_cue_sheet_find_async (old_file, priv->cues, priv->lookup,
+				  sheet_found_cb, lookup);
+}
+
+/**
+ * Convert the file at the current position, or finish up
+ * if there are none left.
+ */
+static void
+run_next (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	GFile           *old_file, *new_file;
+	GError          *err = NULL;
+	const gchar     *subdir;
+	const Range     *range;
+	gchar           *uri;
+	guint            index;
+
+	/* Wait for the next file to be added */
+	if (priv->position >= priv->queue->len && priv->open) {
+		priv->waiting = TRUE;
+		return;
+	}
+
+	/* Go over the failed files once more with the other decoder */
+	if (priv->position >= priv->queue->len && priv->failed->len > 0) {
+		GArray *queue;
+
+		queue = priv->queue;
+		priv->queue = priv->failed;
+		priv->failed = queue;
+		g_array_set_size (priv->failed, 0);
+
+		priv->position = 0;
+		priv->retrying = TRUE;
+
+		g_object_set (G_OBJECT (priv->gst),
+			      "decoder", ALTERNATE_DECODER,
+			      NULL);
+
+		g_signal_emit (batch, signals[RETRYING], 0, priv->queue->len);
+	}
+
+	if (priv->position >= priv->queue->len) {
+		/* No more files to convert time to do some cleanup */
+		stop_gst (batch);
+		export_stats (batch);
+		export_manifest (batch);
+		release_trace (batch);
+		g_signal_emit (batch, signals[FINISHED], 0);
+		return;
+	}
+
+	/* Let other batches have our turn until we are resumed */
+	if (priv->paused) {
+		priv->held = TRUE;
+		nsc_scheduler_release (priv->client);
+		return;
+	}
+
+	/* Wait for our turn, turn_cb comes back here */
+	if (!nsc_scheduler_request (priv->client))
+		return;
+
+	index = current_index (batch);
+	priv->file_start = g_get_monotonic_time ();
+	g_signal_emit (batch, signals[FILE_STARTED], 0, index);
+
+	uri = nsc_queue_get_uri (priv->files, index);
+	if (uri == NULL) {
+		/* It could not be read back from the spill file */
+		err = g_error_new (NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				   _("The file was lost from the queue"));
+		fail_current (batch, err);
+		g_error_free (err);
+		schedule_next (batch);
+		return;
+	}
+
+	subdir = nsc_queue_get_subdir (priv->files, index);
+	range = g_hash_table_lookup (priv->ranges, GUINT_TO_POINTER (index));
+	old_file = g_file_new_for_uri (uri);
+	new_file = create_new_file (batch, old_file, subdir, range);
+	g_free (uri);
+
+	/* Which happens when it already is in the profile's format */
+	if (g_file_equal (old_file, new_file)) {
+		gchar *name;
+
+		name = g_file_get_parse_name (old_file);
+		err = g_error_new (NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				   _("%s would be written over itself"),
+				   name);
+		g_free (name);
+	} else {
+		g_hash_table_insert (priv->written, g_file_get_uri (new_file),
+				     NULL);
+	}
+
+	/* Let's finally get to the fun stuff */
+	if (err == NULL && priv->output != NULL && subdir != NULL)
+		make_parent (new_file, &err);
+
+	if (err != NULL) {
+		record_stats (batch);
+		trace_file (batch, index, "failed");
+		fail_current (batch, err);
+		g_error_free (err);
+		schedule_next (batch);
+	} else if (range == NULL && priv->split_cue &&
+		   nsc_cue_is_image (old_file)) {
+		find_sheet (batch, old_file, new_file);
+	} else {
+		start_file (batch, old_file, new_file, range, NULL);
+	}
+
+	g_object_unref (old_file);
+	g_object_unref (new_file);
+}
+
+static void
+turn_cb (gpointer data)
+{
+	run_next (NSC_BATCH (data));
+}
+
+/**
+ * Pause or resume the file being converted, and whatever comes
+ * after it, once the user and the load agree.
+ */
+static void
+update_paused (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	gboolean         paused;
+
+	paused = priv->user_paused || priv->load_paused;
+	if (paused == priv->paused)
+		return;
+
+	priv->paused = paused;
+
+	if (priv->splitting) {
+		if (paused)
+			nsc_splitter_pause (priv->splitter);
+		else
+			nsc_splitter_resume (priv->splitter);
+	} else if (priv->gst != NULL) {
+		if (paused)
+			nsc_gstreamer_pause_convert (priv->gst);
+		else
+			nsc_gstreamer_resume_convert (priv->gst);
+	}
+
+	g_signal_emit (batch, signals[PAUSED], 0, paused);
+
+	if (!paused && priv->held) {
+		priv->held = FALSE;
+		run_next (batch);
+	}
+}
+
+static void
+load_pause_cb (gboolean paused,
+	       gpointer data)
+{
+	NscBatch        *batch = NSC_BATCH (data);
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	priv->load_paused = paused;
+	update_paused (batch);
+}
+
+static void
+nsc_batch_real_start (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+	gint64           prescan;
+	guint            i;
+
+	g_return_if_fail (priv->gst == NULL);
+
+	if (priv->trace_dir != NULL && priv->trace == NULL) {
+		gchar *name;
+
+		name = g_strdup_printf ("batch %s",
+					gm_audio_profile_get_id (priv->profile));
+		priv->trace = nsc_trace_acquire ();
+		priv->lane = nsc_trace_add_lane (priv->trace, name);
+		g_free (name);
+	}
+
+	/* Queue every file that was added */
+	prescan = g_get_monotonic_time ();
+	g_array_set_size (priv->queue, 0);
+	for (i = 0; i < nsc_queue_get_length (priv->files); i++)
+		g_array_append_val (priv->queue, i);
+	priv->position = 0;
+
+	if (priv->trace != NULL)
+		nsc_trace_span (priv->trace, priv->lane, "batch", "prescan",
+				prescan, g_get_monotonic_time (), NULL);
+
+	priv->client = nsc_scheduler_add_client (nsc_scheduler_get_default (),
+						 priv->interactive,
+						 turn_cb, batch);
+	nsc_scheduler_set_pause_func (priv->client, load_pause_cb);
+	priv->load_paused =
+		nsc_scheduler_is_overloaded (nsc_scheduler_get_default ());
+	priv->paused = priv->user_paused || priv->load_paused;
+	priv->held = FALSE;
+	if (priv->paused)
+		g_signal_emit (batch, signals[PAUSED], 0, TRUE);
+	priv->prefetch = nsc_prefetch_new ();
+
+	priv->gst = nsc_gstreamer_new (priv->profile);
+	if (priv->trace != NULL)
+		nsc_gstreamer_set_trace (priv->gst, priv->trace, priv->lane);
+
+	if (priv->report_dir != NULL) {
+		g_object_set (G_OBJECT (priv->gst), "instrument", TRUE, NULL);
+		nsc_stats_free (priv->stats);
+		priv->stats = nsc_stats_new ();
+	}
+
+	if (priv->verify_dir != NULL) {
+		g_object_set (G_OBJECT (priv->gst), "verify", TRUE, NULL);
+		nsc_manifest_free (priv->manifest);
+		priv->manifest = nsc_manifest_new ();
+	}
+
+	/* Connect to the gstreamer object signals */
+	g_signal_connect (G_OBJECT (priv->gst), "completion",
+			  (GCallback) on_completion_cb,
+			  batch);
+	g_signal_connect (G_OBJECT (priv->gst), "error",
+			  (GCallback) on_error_cb,
+			  batch);
+	g_signal_connect (G_OBJECT (priv->gst), "progress",
+			  (GCallback) on_progress_cb,
+			  batch);
+	g_signal_connect (G_OBJECT (priv->gst), "duration",
+			  (GCallback) on_duration_cb,
+			  batch);
+
+	run_next (batch);
+}
+
+static void
+nsc_batch_real_cancel (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	if (priv->gst == NULL)
+		return;
+
+	/* Nothing from the running file should reach us any more */
+	g_signal_handlers_disconnect_matched (priv->gst,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, batch);
+	nsc_gstreamer_cancel_convert (priv->gst);
+	if (priv->splitter != NULL) {
+		g_signal_handlers_disconnect_matched (priv->splitter,
+						      G_SIGNAL_MATCH_DATA,
+						      0, 0, NULL, NULL, batch);
+		nsc_splitter_cancel (priv->splitter);
+	}
+
+	stop_gst (batch);
+
+	/* A cancelled batch says nothing about throughput */
+	nsc_stats_free (priv->stats);
+	priv->stats = NULL;
+
+	/* What was checked so far still holds */
+	export_manifest (batch);
+
+	/* But its trace may still show why it was slow */
+	release_trace (batch);
+
+	g_array_set_size (priv->queue, 0);
+	g_array_set_size (priv->failed, 0);
+	g_hash_table_remove_all (priv->ranges);
+	priv->position = 0;
+	priv->open = FALSE;
+	priv->waiting = FALSE;
+	priv->paused = FALSE;
+	priv->held = FALSE;
+}
+
+static void
+nsc_batch_real_pause (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	priv->user_paused = TRUE;
+	if (priv->gst != NULL)
+		update_paused (batch);
+}
+
+static void
+nsc_batch_real_resume (NscBatch *batch)
+{
+	NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	priv->user_paused = FALSE;
+	if (priv->gst != NULL)
+		update_paused (batch);
+}
+
+static void
+nsc_batch_class_init (NscBatchClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->set_property = nsc_batch_set_property;
+	object_class->get_property = nsc_batch_get_property;
+	object_class->dispose      = nsc_batch_dispose;
+	object_class->finalize     = nsc_batch_finalize;
+
+	klass->start  = nsc_batch_real_start;
+	klass->cancel = nsc_batch_real_cancel;
+	klass->pause  = nsc_batch_real_pause;
+	klass->resume = nsc_batch_real_resume;
+
+	/* Properties */
+	g_object_class_install_property (object_class, PROP_PROFILE,
+					 g_param_spec_object ("profile",
+							      _("Audio Profile"),
+							      _("The GNOME Audio Profile used for encoding audio"),
+							      GM_AUDIO_TYPE_PROFILE,
+							      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+	g_object_class_install_property (object_class, PROP_OUTPUT_URI,
+					 g_param_spec_string ("output-uri",
+							      _("Output URI"),
+							      _("The directory new files are saved in"),
+							      NULL,
+							      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+	/* Signals */
+	signals[FILE_STARTED] =
+		g_signal_new ("file-started",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, file_started),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+	signals[DURATION] =
+		g_signal_new ("duration",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, duration),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__INT,
+			      G_TYPE_NONE, 1, G_TYPE_INT);
+	signals[PROGRESS] =
+		g_signal_new ("progress",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, progress),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__INT,
+			      G_TYPE_NONE, 1, G_TYPE_INT);
+	signals[FILE_COMPLETED] =
+		g_signal_new ("file-completed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, file_completed),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+	signals[FILE_FAILED] =
+		g_signal_new ("file-failed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, file_failed),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__UINT_POINTER,
+			      G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_POINTER);
+	signals[RETRYING] =
+		g_signal_new ("retrying",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, retrying),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+	signals[PAUSED] =
+		g_signal_new ("paused",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, paused),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__BOOLEAN,
+			      G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+	signals[FINISHED] =
+		g_signal_new ("finished",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscBatchClass, finished),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+static void
+nsc_batch_init (NscBatch *self)
+{
+	/* Allocate Private data structure */
+	(NSC_BATCH (self))->priv = \
+		(NscBatchPrivate *) g_malloc0 (sizeof (NscBatchPrivate));
+
+	/* If correctly allocated, initialize parameters */
+	if ((NSC_BATCH (self))->priv != NULL) {
+		NscBatchPrivate *priv = NSC_BATCH_GET_PRIVATE (self);
+
+		priv->files = nsc_queue_new ();
+		priv->queue = g_array_new (FALSE, FALSE, sizeof (guint));
+		priv->failed = g_array_new (FALSE, FALSE, sizeof (guint));
+		priv->ranges = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+		priv->written = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, NULL);
+		priv->cues = nsc_cue_cache_new ();
+	}
+}
+
+/*
+ * Public Methods
+ */
+NscBatch *
+nsc_batch_new (GMAudioProfile *profile,
+	       const gchar    *output_uri)
+{
+	return g_object_new (NSC_TYPE_BATCH,
+			     "profile", profile,
+			     "output-uri", output_uri,
+			     NULL);
+}
+
+void
+nsc_batch_add_file (NscBatch *batch,
+		    GFile    *file)
+{
+	nsc_batch_add_file_in (batch, file, NULL);
+}
+
+/**
+ * Add a file that is saved in @subdir, relative to the output
+ * directory.  @subdir is ignored when the new files are saved
+ * next to the old ones.  Files may be added while the batch is
+ * running, as long as it was opened with nsc_batch_open().
+ * Returns FALSE, and skips the file, if this batch wrote it.
+ */
+gboolean
+nsc_batch_add_file_in (NscBatch    *batch,
+		       GFile       *file,
+		       const gchar *subdir)
+{
+	NscBatchPrivate *priv;
+	gchar           *uri;
+	guint            index;
+
+	g_return_val_if_fail (NSC_IS_BATCH (batch), FALSE);
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	uri = g_file_get_uri (file);
+	if (g_hash_table_lookup_extended (priv->written, uri, NULL, NULL)) {
+		g_free (uri);
+		return FALSE;
+	}
+
+	index = nsc_queue_add (priv->files, uri, subdir);
+	g_free (uri);
+
+	/* Already running, so it goes straight into the queue */
+	if (priv->gst != NULL) {
+		g_array_append_val (priv->queue, index);
+
+		if (priv->waiting) {
+			priv->waiting = FALSE;
+			run_next (batch);
+		} else {
+			prefetch_ahead (batch);
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Add only the part of @file between @start and @end, in
+ * nanoseconds, with an @end of -1 for the end of the file.  The
+ * new file is named after the range, so the same file may be added
+ * with many ranges.  Only for batches converted in this process, as
+ * the conversion service takes whole files.
+ */
+void
+nsc_batch_add_range (NscBatch *batch,
+		     GFile    *file,
+		     gint64    start,
+		     gint64    end)
+{
+	NscBatchPrivate *priv;
+	Range           *range;
+
+	g_return_if_fail (NSC_IS_BATCH (batch));
+	g_return_if_fail (start >= 0);
+	g_return_if_fail (end < 0 || end > start);
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	range = g_new (Range, 1);
+	range->start = start;
+	range->end = end;
+
+	/* Known before the file can be started */
+	g_hash_table_insert (priv->ranges,
+			     GUINT_TO_POINTER (nsc_queue_get_length (priv->files)),
+			     range);
+	nsc_batch_add_file_in (batch, file, NULL);
+}
+
+/**
+ * More files are going to be added once the batch is started,
+ * so it should wait for them rather than finish when it runs
+ * out.  Call nsc_batch_close() once the last one is added.
+ */
+void
+nsc_batch_open (NscBatch *batch)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_PRIVATE (batch)->open = TRUE;
+}
+
+void
+nsc_batch_close (NscBatch *batch)
+{
+	NscBatchPrivate *priv;
+
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	priv->open = FALSE;
+
+	if (priv->waiting) {
+		priv->waiting = FALSE;
+		run_next (batch);
+	}
+}
+
+guint
+nsc_batch_get_n_files (NscBatch *batch)
+{
+	g_return_val_if_fail (NSC_IS_BATCH (batch), 0);
+
+	return nsc_queue_get_length (NSC_BATCH_GET_PRIVATE (batch)->files);
+}
+
+/**
+ * The returned file needs to be unreferenced.  Files are dropped
+ * once they have been converted, so this is NULL for any file
+ * past its file-completed or file-failed signal.
+ */
+GFile *
+nsc_batch_get_file (NscBatch *batch,
+		    guint     index)
+{
+	NscBatchPrivate *priv;
+	GFile           *file;
+	gchar           *uri;
+
+	g_return_val_if_fail (NSC_IS_BATCH (batch), NULL);
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+	g_return_val_if_fail (index < nsc_queue_get_length (priv->files),
+			      NULL);
+
+	uri = nsc_queue_get_uri (priv->files, index);
+	if (uri == NULL)
+		return NULL;
+
+	file = g_file_new_for_uri (uri);
+	g_free (uri);
+
+	return file;
+}
+
+/**
+ * Keep no more than @limit queued files in memory, and the rest in
+ * a file in the temporary directory.  For batches of many thousands
+ * of files; only the files added after this are spilled.
+ */
+void
+nsc_batch_set_spill (NscBatch *batch,
+		     guint     limit)
+{
+	NscBatchPrivate *priv;
+	GError          *error = NULL;
+
+	g_return_if_fail (NSC_IS_BATCH (batch));
+	g_return_if_fail (limit > 0);
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	if (!nsc_queue_set_spill (priv->files, limit, &error)) {
+		g_warning ("Unable to spill the queue; %s", error->message);
+		g_error_free (error);
+	}
+}
+
+/**
+ * An interactive batch, like a single file the user is waiting
+ * for, converts before the background batches that are waiting.
+ * Needs to be set before the batch is started.
+ */
+void
+nsc_batch_set_interactive (NscBatch *batch,
+			   gboolean  interactive)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_PRIVATE (batch)->interactive = interactive;
+}
+
+GMAudioProfile *
+nsc_batch_get_profile (NscBatch *batch)
+{
+	g_return_val_if_fail (NSC_IS_BATCH (batch), NULL);
+
+	return NSC_BATCH_GET_PRIVATE (batch)->profile;
+}
+
+const gchar *
+nsc_batch_get_output_uri (NscBatch *batch)
+{
+	g_return_val_if_fail (NSC_IS_BATCH (batch), NULL);
+
+	return NSC_BATCH_GET_PRIVATE (batch)->output_uri;
+}
+
+void
+nsc_batch_set_retry (NscBatch *batch,
+		     gboolean  retry)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_PRIVATE (batch)->retry = retry;
+}
+
+gboolean
+nsc_batch_get_retry (NscBatch *batch)
+{
+	g_return_val_if_fail (NSC_IS_BATCH (batch), FALSE);
+
+	return NSC_BATCH_GET_PRIVATE (batch)->retry;
+}
+
+/**
+ * Split images that have a cue sheet next to them into a file per
+ * track, rather than converting them into a single file.
+ */
+void
+nsc_batch_set_split_cue (NscBatch *batch,
+			 gboolean  split_cue)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_PRIVATE (batch)->split_cue = split_cue;
+}
+
+/**
+ * Time every file of the batch, and write a CSV and JSON report
+ * into @report_dir when it finishes.  NULL turns this off again.
+ */
+void
+nsc_batch_set_report_dir (NscBatch    *batch,
+			  const gchar *report_dir)
+{
+	NscBatchPrivate *priv;
+
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	g_free (priv->report_dir);
+	priv->report_dir = g_strdup (report_dir);
+}
+
+/**
+ * Checksum the decoded audio of every file on its way into the
+ * encoder, check FLAC output against it, and write a manifest of the
+ * results into @verify_dir when the batch finishes.  Files that do
+ * not match fail.  NULL turns this off again.
+ */
+void
+nsc_batch_set_verify_dir (NscBatch    *batch,
+			  const gchar *verify_dir)
+{
+	NscBatchPrivate *priv;
+
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	g_free (priv->verify_dir);
+	priv->verify_dir = g_strdup (verify_dir);
+}
+
+/**
+ * Write a timeline of the batch into @trace_dir when it finishes.
+ * Batches running at the same time share a single trace file.
+ */
+void
+nsc_batch_set_trace_dir (NscBatch    *batch,
+			 const gchar *trace_dir)
+{
+	NscBatchPrivate *priv;
+
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+
+	g_free (priv->trace_dir);
+	priv->trace_dir = g_strdup (trace_dir);
+}
+
+/**
+ * The statistics of the file that just completed or failed.  Only
+ * valid in handlers of the file-completed and file-failed signals,
+ * and NULL when the file was not converted by this process.
+ */
+const NscFileStats *
+nsc_batch_get_file_stats (NscBatch *batch)
+{
+	NscBatchPrivate *priv;
+
+	g_return_val_if_fail (NSC_IS_BATCH (batch), NULL);
+
+	priv = NSC_BATCH_GET_PRIVATE (batch);
+	if (priv->gst == NULL || priv->splitting)
+		return NULL;
+
+	return nsc_gstreamer_get_stats (priv->gst);
+}
+
+void
+nsc_batch_start (NscBatch *batch)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_CLASS (batch)->start (batch);
+}
+
+void
+nsc_batch_cancel (NscBatch *batch)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_CLASS (batch)->cancel (batch);
+}
+
+/**
+ * Hold the batch where it is, without losing the file being
+ * converted.  The batch may also pause on its own while the
+ * machine is overloaded, and says so with the "paused" signal.
+ */
+void
+nsc_batch_pause (NscBatch *batch)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_CLASS (batch)->pause (batch);
+}
+
+void
+nsc_batch_resume (NscBatch *batch)
+{
+	g_return_if_fail (NSC_IS_BATCH (batch));
+
+	NSC_BATCH_GET_CLASS (batch)->resume (batch);
+}
@@ -0,0 +1,121 @@
+/*
+ *  nsc-batch.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#ifndef NSC_BATCH_H
+#define NSC_BATCH_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <profiles/audio-profile.h>
+
+#include "nsc-stats.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A queue of files converted with a single audio profile.  The
+ * batch does not know anything about dialogs, so it is shared by
+ * the Nautilus extension and the conversion service.
+ */
+
+#define NSC_TYPE_BATCH            (nsc_batch_get_type ())
+#define NSC_BATCH(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NSC_TYPE_BATCH, NscBatch))
+#define NSC_BATCH_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NSC_TYPE_BATCH, NscBatchClass))
+#define NSC_IS_BATCH(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NSC_TYPE_BATCH))
+#define NSC_IS_BATCH_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NSC_TYPE_BATCH))
+#define NSC_BATCH_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NSC_TYPE_BATCH, NscBatchClass))
+
+typedef struct _NscBatch      NscBatch;
+typedef struct _NscBatchClass NscBatchClass;
+
+struct _NscBatch {
+	/* Parent object */
+	GObject  parent;
+	/* Private data pointer */
+	gpointer priv;
+};
+
+struct _NscBatchClass {
+	GObjectClass parent_class;
+
+	/* Virtual methods */
+	void (*start)          (NscBatch *batch);
+	void (*cancel)         (NscBatch *batch);
+	void (*pause)          (NscBatch *batch);
+	void (*resume)         (NscBatch *batch);
+
+	/* Signals */
+	void (*file_started)   (NscBatch *batch, guint index);
+	void (*duration)       (NscBatch *batch, const int seconds);
+	void (*progress)       (NscBatch *batch, const int seconds);
+	void (*file_completed) (NscBatch *batch, guint index);
+	void (*file_failed)    (NscBatch *batch, guint index, GError *error);
+	void (*retrying)       (NscBatch *batch, guint n_files);
+	void (*paused)         (NscBatch *batch, gboolean paused);
+	void (*finished)       (NscBatch *batch);
+};
+
+GType           nsc_batch_get_type        (void);
+NscBatch       *nsc_batch_new             (GMAudioProfile *profile,
+					   const gchar    *output_uri);
+void            nsc_batch_add_file        (NscBatch       *batch,
+					   GFile          *file);
+gboolean        nsc_batch_add_file_in     (NscBatch       *batch,
+					   GFile          *file,
+					   const gchar    *subdir);
+void            nsc_batch_add_range       (NscBatch       *batch,
+					   GFile          *file,
+					   gint64          start,
+					   gint64          end);
+void            nsc_batch_open            (NscBatch       *batch);
+void            nsc_batch_close           (NscBatch       *batch);
+guint           nsc_batch_get_n_files     (NscBatch       *batch);
+GFile          *nsc_batch_get_file        (NscBatch       *batch,
+					   guint           index);
+void            nsc_batch_set_spill       (NscBatch       *batch,
+					   guint           limit);
+void            nsc_batch_set_interactive (NscBatch       *batch,
+					   gboolean        interactive);
+GMAudioProfile *nsc_batch_get_profile     (NscBatch       *batch);
+const gchar    *nsc_batch_get_output_uri  (NscBatch       *batch);
+void            nsc_batch_set_retry       (NscBatch       *batch,
+					   gboolean        retry);
+gboolean        nsc_batch_get_retry       (NscBatch       *batch);
+void            nsc_batch_set_split_cue   (NscBatch       *batch,
+					   gboolean        split_cue);
+void            nsc_batch_set_report_dir  (NscBatch       *batch,
+					   const gchar    *report_dir);
+void            nsc_batch_set_verify_dir  (NscBatch       *batch,
+					   const gchar    *verify_dir);
+void            nsc_batch_set_trace_dir   (NscBatch       *batch,
+					   const gchar    *trace_dir);
+const NscFileStats *
+		nsc_batch_get_file_stats  (NscBatch       *batch);
+void            nsc_batch_start           (NscBatch       *batch);
+void            nsc_batch_cancel          (NscBatch       *batch);
+void            nsc_batch_pause           (NscBatch       *batch);
+void            nsc_batch_resume          (NscBatch       *batch);
+
+G_END_DECLS
+
+#endif /* NSC_BATCH_H */
@@ -0,0 +1,94 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-calibrate.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+/*
+ * Times every installed decoder on this machine and saves which
+ * ones are fastest, so conversions use those from then on:
+ *
+ *   nautilus-sound-converter-calibrate
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <glib/gi18n.h>
+#include <gst/gst.h>
+
+#include "nsc-decoders.h"
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GPtrArray      *timings;
+	GError         *error = NULL;
+	guint           i;
+
+	bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+	g_type_init ();
+
+	context = g_option_context_new (_("- Find the fastest audio decoders"));
+	g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+	g_option_context_add_group (context, gst_init_get_option_group ());
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	g_print (_("Timing the installed decoders, this takes a while...\n"));
+
+	timings = nsc_decoders_calibrate (&error);
+	if (timings == NULL) {
+		g_printerr (_("Could not calibrate: %s\n"), error->message);
+		g_error_free (error);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < timings->len; i++) {
+		NscDecoderTiming *timing = g_ptr_array_index (timings, i);
+
+		if (timing->correct)
+			g_print ("%-8s %-24s %8.1fx\n", timing->format,
+				 timing->decoder, timing->speed);
+		else
+			g_print ("%-8s %-24s %s\n", timing->format,
+				 timing->decoder, _("failed"));
+	}
+
+	if (timings->len == 0)
+		g_print (_("No decoders could be timed\n"));
+
+	g_ptr_array_free (timings, TRUE);
+
+	return EXIT_SUCCESS;
+}
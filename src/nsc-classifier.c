@@ -0,0 +1,363 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-classifier.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <libnautilus-extension/nautilus-file-info.h>
+
+#include "nsc-classifier.h"
+#include "nsc-engine.h"
+#include "nsc-init.h"
+
+/* Signals */
+enum {
+	FILE_FOUND,
+	FINISHED,
+	LAST_SIGNAL,
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* How long a slice may keep the main loop busy, in microseconds */
+#define SLICE_TIME 4000
+
+/* Files looked at between checks of the clock */
+#define SLICE_CHECK 32
+
+/* What the table knows about a MIME type */
+#define VERDICT_SOUND GINT_TO_POINTER (1)
+#define VERDICT_OTHER GINT_TO_POINTER (2)
+
+typedef struct _NscClassifierPrivate NscClassifierPrivate;
+
+struct _NscClassifierPrivate {
+	/* The NautilusFileInfo of the selection */
+	GPtrArray *files;
+	guint      position;
+
+	guint      idle_id;
+	gboolean   running;
+
+	/* Holding a reference until the formats are known */
+	gboolean   waiting;
+};
+
+#define NSC_CLASSIFIER_GET_PRIVATE(o)           \
+	((NscClassifierPrivate *)((NSC_CLASSIFIER(o))->priv))
+
+G_DEFINE_TYPE (NscClassifier, nsc_classifier, G_TYPE_OBJECT)
+
+/*
+ * Whether each MIME type seen so far can be converted.  Selections
+ * are made of a handful of types, so working it out once per type
+ * leaves a hash lookup per file.
+ */
+static GHashTable *verdicts = NULL;
+
+static void
+nsc_classifier_dispose (GObject *object)
+{
+	NscClassifier        *self = (NscClassifier *) object;
+	NscClassifierPrivate *priv = NSC_CLASSIFIER_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		if (priv->idle_id) {
+			g_source_remove (priv->idle_id);
+			priv->idle_id = 0;
+		}
+
+		if (priv->files) {
+			guint i;
+
+			/* The ones before the position are gone already */
+			for (i = priv->position; i < priv->files->len; i++)
+				g_object_unref (g_ptr_array_index (priv->files, i));
+			g_ptr_array_free (priv->files, TRUE);
+			priv->files = NULL;
+		}
+	}
+
+	G_OBJECT_CLASS (nsc_classifier_parent_class)->dispose (object);
+}
+
+static void
+nsc_classifier_finalize (GObject *object)
+{
+	NscClassifier *self = (NscClassifier *) object;
+
+	if (self->priv != NULL) {
+		g_free (self->priv);
+		self->priv = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_classifier_parent_class)->finalize (object);
+}
+
+/*
+ * Private Methods
+ */
+static gboolean
+type_is_sound (const gchar *mime_type)
+{
+	const gchar * const *optional;
+	gint                 i;
+
+	static const gchar *required[] = {
+		NSC_ENGINE_REQUIRED_TYPES,
+		NULL
+	};
+
+	for (i = 0; required[i] != NULL; i++)
+		if (g_content_type_is_a (mime_type, required[i]))
+			return TRUE;
+
+	/* Only audio files need the plugins checked */
+	if (!g_content_type_is_a (mime_type, "audio/*"))
+		return FALSE;
+
+	/* Only classifying once initialized, so this does not wait */
+	optional = nsc_init_get_mime_types ();
+	for (i = 0; optional[i] != NULL; i++)
+		if (g_content_type_is_a (mime_type, optional[i]))
+			return TRUE;
+
+	return FALSE;
+}
+
+static gboolean
+file_is_sound (NautilusFileInfo *file_info)
+{
+	gchar    *scheme, *mime_type;
+	gpointer  verdict;
+
+	/* Is this a file? */
+	scheme = nautilus_file_info_get_uri_scheme (file_info);
+	if (strcmp (scheme, "file") != 0) {
+		g_free (scheme);
+		return FALSE;
+	}
+	g_free (scheme);
+
+	if (verdicts == NULL)
+		verdicts = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  g_free, NULL);
+
+	mime_type = nautilus_file_info_get_mime_type (file_info);
+
+	verdict = g_hash_table_lookup (verdicts, mime_type);
+	if (verdict == NULL) {
+		verdict = type_is_sound (mime_type) ?
+			VERDICT_SOUND : VERDICT_OTHER;
+		g_hash_table_insert (verdicts, mime_type, verdict);
+	} else {
+		g_free (mime_type);
+	}
+
+	return verdict == VERDICT_SOUND;
+}
+
+/**
+ * Go through the selection for a little while, and come
+ * back to it the next time the main loop is idle.
+ */
+static gboolean
+classify_idle_cb (gpointer data)
+{
+	NscClassifier        *classifier = NSC_CLASSIFIER (data);
+	NscClassifierPrivate *priv = NSC_CLASSIFIER_GET_PRIVATE (classifier);
+	gint64                start;
+	guint                 n = 0;
+
+	start = g_get_monotonic_time ();
+
+	while (priv->running && priv->position < priv->files->len) {
+		NautilusFileInfo *file_info;
+
+		file_info = g_ptr_array_index (priv->files, priv->position);
+		g_ptr_array_index (priv->files, priv->position) = NULL;
+		priv->position++;
+
+		/* Only the GFile is kept, as it is much smaller */
+		if (file_is_sound (file_info)) {
+			GFile *file;
+
+			file = nautilus_file_info_get_location (file_info);
+			g_signal_emit (classifier, signals[FILE_FOUND], 0, file);
+			g_object_unref (file);
+		}
+
+		g_object_unref (file_info);
+
+		if (++n % SLICE_CHECK == 0 &&
+		    g_get_monotonic_time () - start >= SLICE_TIME)
+			return priv->running;
+	}
+
+	priv->idle_id = 0;
+
+	/* Unless a handler cancelled us; this may be the last reference */
+	if (priv->running) {
+		priv->running = FALSE;
+		g_signal_emit (classifier, signals[FINISHED], 0);
+	}
+
+	return FALSE;
+}
+
+static void
+start_idle (NscClassifier *classifier)
+{
+	NscClassifierPrivate *priv = NSC_CLASSIFIER_GET_PRIVATE (classifier);
+
+	priv->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+					 classify_idle_cb,
+					 classifier, NULL);
+}
+
+/**
+ * GStreamer is initialized, so the formats it can convert are
+ * known without blocking the main loop.
+ */
+static void
+init_ready_cb (gpointer data)
+{
+	NscClassifier        *classifier = NSC_CLASSIFIER (data);
+	NscClassifierPrivate *priv = NSC_CLASSIFIER_GET_PRIVATE (classifier);
+
+	priv->waiting = FALSE;
+
+	if (priv->running && priv->idle_id == 0)
+		start_idle (classifier);
+
+	g_object_unref (classifier);
+}
+
+static void
+nsc_classifier_class_init (NscClassifierClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose  = nsc_classifier_dispose;
+	object_class->finalize = nsc_classifier_finalize;
+
+	/* Signals */
+	signals[FILE_FOUND] =
+		g_signal_new ("file-found",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscClassifierClass, file_found),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, G_TYPE_FILE);
+	signals[FINISHED] =
+		g_signal_new ("finished",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscClassifierClass, finished),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+static void
+nsc_classifier_init (NscClassifier *self)
+{
+	/* Allocate Private data structure */
+	self->priv = g_malloc0 (sizeof (NscClassifierPrivate));
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * @files is a list of NautilusFileInfo, which is copied.
+ */
+NscClassifier *
+nsc_classifier_new (GList *files)
+{
+	NscClassifier        *classifier;
+	NscClassifierPrivate *priv;
+	GList                *l;
+
+	classifier = g_object_new (NSC_TYPE_CLASSIFIER, NULL);
+
+	priv = NSC_CLASSIFIER_GET_PRIVATE (classifier);
+	priv->files = g_ptr_array_sized_new (g_list_length (files));
+	for (l = files; l != NULL; l = l->next)
+		g_ptr_array_add (priv->files, g_object_ref (l->data));
+
+	return classifier;
+}
+
+gboolean
+nsc_classifier_is_running (NscClassifier *classifier)
+{
+	g_return_val_if_fail (NSC_IS_CLASSIFIER (classifier), FALSE);
+
+	return NSC_CLASSIFIER_GET_PRIVATE (classifier)->running;
+}
+
+/**
+ * Start going through the selection, once GStreamer is
+ * initialized.  Redrawing the dialogs comes first, so they stay
+ * responsive while this goes on.
+ */
+void
+nsc_classifier_start (NscClassifier *classifier)
+{
+	NscClassifierPrivate *priv;
+
+	g_return_if_fail (NSC_IS_CLASSIFIER (classifier));
+
+	priv = NSC_CLASSIFIER_GET_PRIVATE (classifier);
+	g_return_if_fail (!priv->running);
+
+	priv->running = TRUE;
+	priv->position = 0;
+
+	if (priv->waiting)
+		return;
+
+	priv->waiting = TRUE;
+	nsc_init_when_ready (init_ready_cb, g_object_ref (classifier));
+}
+
+/**
+ * Stop going through the selection.  Nothing is reported after
+ * this, not even "finished", and the idle goes away on its own.
+ */
+void
+nsc_classifier_cancel (NscClassifier *classifier)
+{
+	NscClassifierPrivate *priv;
+
+	g_return_if_fail (NSC_IS_CLASSIFIER (classifier));
+
+	priv = NSC_CLASSIFIER_GET_PRIVATE (classifier);
+
+	priv->running = FALSE;
+}
@@ -0,0 +1,73 @@
+/*
+ *  nsc-classifier.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_CLASSIFIER_H
+#define NSC_CLASSIFIER_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Picks the audio files out of a Nautilus selection.  The selection
+ * is gone through a slice at a time whenever the main loop is idle,
+ * so a huge one does not hold up the dialog, and every audio file is
+ * reported as soon as it is found.
+ */
+
+#define NSC_TYPE_CLASSIFIER            (nsc_classifier_get_type ())
+#define NSC_CLASSIFIER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NSC_TYPE_CLASSIFIER, NscClassifier))
+#define NSC_CLASSIFIER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NSC_TYPE_CLASSIFIER, NscClassifierClass))
+#define NSC_IS_CLASSIFIER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NSC_TYPE_CLASSIFIER))
+#define NSC_IS_CLASSIFIER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NSC_TYPE_CLASSIFIER))
+#define NSC_CLASSIFIER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NSC_TYPE_CLASSIFIER, NscClassifierClass))
+
+typedef struct _NscClassifier      NscClassifier;
+typedef struct _NscClassifierClass NscClassifierClass;
+
+struct _NscClassifier {
+	/* Parent object */
+	GObject  parent;
+	/* Private data pointer */
+	gpointer priv;
+};
+
+struct _NscClassifierClass {
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (*file_found) (NscClassifier *classifier, GFile *file);
+	void (*finished)   (NscClassifier *classifier);
+};
+
+GType          nsc_classifier_get_type    (void);
+NscClassifier *nsc_classifier_new         (GList         *files);
+gboolean       nsc_classifier_is_running  (NscClassifier *classifier);
+void           nsc_classifier_start       (NscClassifier *classifier);
+void           nsc_classifier_cancel      (NscClassifier *classifier);
+
+G_END_DECLS
+
+#endif /* NSC_CLASSIFIER_H */
@@ -26,7 +26,6 @@
 
 #include <config.h>
 
-#include <sys/time.h>
 #include <string.h>
 
 #include <gconf/gconf-client.h>
@@ -36,22 +35,35 @@
 #include <libnautilus-extension/nautilus-file-info.h>
 #include <profiles/gnome-media-profiles.h>
 
+#include "nsc-batch.h"
+#include "nsc-classifier.h"
 #include "nsc-converter.h"
+#include "nsc-engine.h"
+#include "nsc-estimator.h"
 #include "nsc-gstreamer.h"
+#include "nsc-history.h"
+#include "nsc-init.h"
+#include "nsc-remote-batch.h"
+#include "nsc-scheduler.h"
+#include "nsc-walker.h"
 #include "nsc-xml.h"
 
 typedef struct _NscConverterPrivate NscConverterPrivate;
 
 typedef struct {
-	int            seconds;
-	struct timeval time;
-	int            ripped;
-	int            taken;
+	/* Seconds of audio converted in the batch, and when */
+	gdouble        seconds;
+	gint64         time;
 } Progress;
 
+typedef struct {
+	gchar *name;
+	gchar *message;
+} ConvertError;
+
 struct _NscConverterPrivate {
-	/* GStreamer Object */
-	NscGStreamer	*gst;
+	/* The batch doing the conversion */
+	NscBatch	*batch;
 
 	/* The current audio profile */
 	GMAudioProfile *profile;
@@ -59,6 +71,8 @@ struct _NscConverterPrivate {
 	GtkWidget	*dialog;
 	GtkWidget	*path_chooser;
 	GtkWidget       *profile_chooser;
+	GtkWidget       *count_label;
+	GtkWidget       *estimate_label;
 	GtkWidget       *progress_dlg;
 	GtkWidget       *progressbar;
 	GtkWidget       *speedbar;
@@ -66,11 +80,27 @@ struct _NscConverterPrivate {
 	/* Status icon */
 	GtkStatusIcon   *status_icon;
 	
-	/* Files to be convertered */
+	/* The selection, and the folders to convert */
 	GList		*files;
+	GList           *folders;
+
+	/* Audio files found so far, and how many are done */
 	gint             files_converted;
 	gint		 total_files;
 
+	/* Picks the audio files out of the selection */
+	NscClassifier   *classifier;
+
+	/* The ones found before there was a batch to add them to */
+	GPtrArray       *found;
+
+	/* Sizes up the selection for each profile while the dialog is up */
+	NscEstimator    *estimator;
+
+	/* Folders still being searched for more files */
+	GList           *walkers;
+	gint             n_walking;
+
 	/* Use the source directory as the output directory? */
 	gboolean         src_dir;
 
@@ -80,21 +110,67 @@ struct _NscConverterPrivate {
 	/* Snapshots of the progress used to calculate the speed and the ETA */
 	Progress         before;
 
-        /* The duration of the file being converter. */
-	gint             current_duration;
+	/* Seconds of audio converted per second, or 0 when not known */
+	gdouble          speed;
+
+	/* Seconds of audio in the files done, and how many there were */
+	gdouble          done_duration;
+	gint             files_timed;
 
 	/* The total duration of the file being converter. */
 	gint             total_duration;
+
+	/*
+	 * Speeds and file lengths of earlier runs, and the format
+	 * they are looked up by for the file being converted.
+	 */
+	NscHistory      *history;
+	gchar           *format;
+	gdouble          expected_duration;
+
+	/* Files that could not be converted, reported when the batch ends */
+	GList           *errors;
+
+	/* Retry failed files with a different decoder? */
+	gboolean         retry;
+	gboolean         retrying;
+
+	/* Convert in the conversion service rather than in Nautilus? */
+	gboolean         use_service;
+
+	/* Directory for batch timing reports, or NULL */
+	gchar           *report_dir;
+
+	/* Directory for verification manifests, or NULL */
+	gchar           *verify_dir;
+
+	/* Directory for batch traces, or NULL */
+	gchar           *trace_dir;
+
+	/* Queued files kept in memory, or 0 for all of them */
+	gint             spill_limit;
+
+	/* Files converted at the same time in the process, 0 for one per CPU */
+	gint             max_jobs;
+
+	/* Hold back while the machine is busy */
+	gboolean         throttle;
+
+	/* Split images with a cue sheet into their tracks */
+	gboolean         split_cue;
+
+	/* Paused by the user, and paused at all */
+	gboolean         user_paused;
+	gboolean         paused;
+	GtkWidget       *pause_button;
 };
 
 /* Default profile name */
 #define DEFAULT_AUDIO_PROFILE_NAME "cdlossy"
 
-/*
- * gconf key for whether the user wants to use
- * the source directory for the output directory.
- */
-#define SOURCE_DIRECTORY "/apps/nautilus-sound-converter/source_dir"
+/* Seconds between speed samples, and the weight of the newest one */
+#define SPEED_INTERVAL 1.0
+#define SPEED_WEIGHT   0.3
 
 #define NSC_CONVERTER_GET_PRIVATE(o)           \
 	((NscConverterPrivate *)((NSC_CONVERTER(o))->priv))
@@ -103,8 +179,99 @@ G_DEFINE_TYPE (NscConverter, nsc_converter, G_TYPE_OBJECT)
 
 enum {
 	PROP_FILES = 1,
+	PROP_FOLDERS,
 };
 
+static void
+free_errors (GList *errors)
+{
+	GList *l;
+
+	for (l = errors; l != NULL; l = l->next) {
+		ConvertError *error = l->data;
+
+		g_free (error->name);
+		g_free (error->message);
+		g_free (error);
+	}
+
+	g_list_free (errors);
+}
+
+static void
+free_walkers (NscConverter *converter)
+{
+	NscConverterPrivate *priv = NSC_CONVERTER_GET_PRIVATE (converter);
+	GList               *l;
+
+	for (l = priv->walkers; l != NULL; l = l->next) {
+		g_signal_handlers_disconnect_matched (l->data,
+						      G_SIGNAL_MATCH_DATA,
+						      0, 0, NULL, NULL,
+						      converter);
+		nsc_walker_cancel (l->data);
+		g_object_unref (l->data);
+	}
+
+	g_list_free (priv->walkers);
+	priv->walkers = NULL;
+	priv->n_walking = 0;
+}
+
+static void
+free_classifier (NscConverter *converter)
+{
+	NscConverterPrivate *priv = NSC_CONVERTER_GET_PRIVATE (converter);
+
+	if (priv->classifier == NULL)
+		return;
+
+	g_signal_handlers_disconnect_matched (priv->classifier,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, converter);
+	nsc_classifier_cancel (priv->classifier);
+	g_object_unref (priv->classifier);
+	priv->classifier = NULL;
+}
+
+static void
+free_estimator (NscConverter *converter)
+{
+	NscConverterPrivate *priv = NSC_CONVERTER_GET_PRIVATE (converter);
+
+	if (priv->estimator == NULL)
+		return;
+
+	g_signal_handlers_disconnect_matched (priv->estimator,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, converter);
+	nsc_estimator_cancel (priv->estimator);
+	g_object_unref (priv->estimator);
+	priv->estimator = NULL;
+}
+
+/**
+ * Keep what this batch learnt for the next one.
+ */
+static void
+free_history (NscConverter *converter)
+{
+	NscConverterPrivate *priv = NSC_CONVERTER_GET_PRIVATE (converter);
+	GError              *error = NULL;
+
+	if (priv->history == NULL)
+		return;
+
+	if (!nsc_history_save (priv->history, &error)) {
+		g_warning ("Unable to save the conversion history; %s",
+			   error->message);
+		g_error_free (error);
+	}
+
+	nsc_history_free (priv->history);
+	priv->history = NULL;
+}
+
 static void
 nsc_converter_finalize (GObject *object)
 {
@@ -115,14 +282,34 @@ nsc_converter_finalize (GObject *object)
 		if (priv->save_path)
 			g_free (priv->save_path);
 
-		if (priv->gst)
-			g_object_unref (priv->gst);
+		g_free (priv->report_dir);
+		g_free (priv->trace_dir);
+		g_free (priv->verify_dir);
+
+		free_walkers (self);
+		free_classifier (self);
+		free_estimator (self);
+		free_history (self);
+		g_free (priv->format);
+
+		g_ptr_array_foreach (priv->found, (GFunc) g_object_unref, NULL);
+		g_ptr_array_free (priv->found, TRUE);
+
+		if (priv->batch) {
+			g_signal_handlers_disconnect_matched (priv->batch,
+							      G_SIGNAL_MATCH_DATA,
+							      0, 0, NULL, NULL,
+							      self);
+			g_object_unref (priv->batch);
+		}
 
 		if (priv->profile)
 			g_object_unref (priv->profile);
 
-		if (priv->files)
-			g_list_free (priv->files);
+		nautilus_file_info_list_free (priv->files);
+		nautilus_file_info_list_free (priv->folders);
+
+		free_errors (priv->errors);
 
 		g_free (priv);
 
@@ -144,7 +331,9 @@ nsc_converter_set_property (GObject      *object,
 	switch (property_id) {
 	case PROP_FILES:
 		priv->files = g_value_get_pointer (value);
-		priv->total_files = g_list_length (priv->files);
+		break;
+	case PROP_FOLDERS:
+		priv->folders = g_value_get_pointer (value);
 		break;
 	default:
 		/* We don't have any other property... */
@@ -166,6 +355,9 @@ nsc_converter_get_property (GObject    *object,
 	case PROP_FILES:
 		g_value_set_pointer (value, priv->files);
 		break;
+	case PROP_FOLDERS:
+		g_value_set_pointer (value, priv->folders);
+		break;
 	default:
 		/* We don't have any other property... */
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -180,6 +372,7 @@ nsc_converter_class_init (NscConverterClass *klass)
 
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	GParamSpec   *files_param_spec;
+	GParamSpec   *folders_param_spec;
 
 	object_class->finalize = nsc_converter_finalize;
 	object_class->set_property = nsc_converter_set_property;
@@ -194,13 +387,27 @@ nsc_converter_class_init (NscConverterClass *klass)
 	g_object_class_install_property (object_class,
 					 PROP_FILES,
 					 files_param_spec);
+
+	folders_param_spec =
+		g_param_spec_pointer ("folders",
+				      "Folders",
+				      "Set selected folders",
+				      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE);
+
+	g_object_class_install_property (object_class,
+					 PROP_FOLDERS,
+					 folders_param_spec);
 }
 
 /**
- * Cancel converting the files.
+ * Cancel converting the files.  The whole batch is dropped at once,
+ * and the pipeline is torn down in the background, so the dialog
+ * goes away without waiting for GStreamer.
  */
 static void
-progress_cancel_cb (GtkWidget *widget, gpointer user_data)
+progress_cancel_cb (GtkDialog *dialog,
+		    gint       response_id,
+		    gpointer   user_data)
 {
 	NscConverter        *conv;
 	NscConverterPrivate *priv;
@@ -208,14 +415,52 @@ progress_cancel_cb (GtkWidget *widget, gpointer user_data)
 	conv =  NSC_CONVERTER (user_data);
 	priv =  NSC_CONVERTER_GET_PRIVATE (conv);
 
-	nsc_gstreamer_cancel_convert (priv->gst);
+	if (priv->batch == NULL)
+		return;
+
+	free_walkers (conv);
+	free_classifier (conv);
+
+	/* Nothing from the running file should reach us any more */
+	g_signal_handlers_disconnect_matched (priv->batch,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, conv);
+	nsc_batch_cancel (priv->batch);
+	free_history (conv);
 
 	gtk_widget_destroy (priv->progress_dlg);
 	if (priv->status_icon)
 		g_object_unref (priv->status_icon);
 
-	g_object_unref (priv->gst);
-	priv->gst = NULL;
+	g_object_unref (priv->batch);
+	priv->batch = NULL;
+}
+
+/**
+ * Pause converting the files, or go on with them.  The file being
+ * converted is held where it is, so nothing is lost.
+ */
+static void
+progress_pause_cb (GtkButton *button,
+		   gpointer   user_data)
+{
+	NscConverter        *conv;
+	NscConverterPrivate *priv;
+
+	conv =  NSC_CONVERTER (user_data);
+	priv =  NSC_CONVERTER_GET_PRIVATE (conv);
+
+	if (priv->batch == NULL)
+		return;
+
+	priv->user_paused = !priv->user_paused;
+	if (priv->user_paused)
+		nsc_batch_pause (priv->batch);
+	else
+		nsc_batch_resume (priv->batch);
+
+	gtk_button_set_label (button, priv->user_paused ? _("_Resume")
+							: _("_Pause"));
 }
 
 /**
@@ -225,7 +470,6 @@ static void
 create_progress_dialog (NscConverter *converter)
 {
 	NscConverterPrivate *priv;
-	GtkWidget           *button;
 
 	priv = NSC_CONVERTER_GET_PRIVATE (converter);
 
@@ -234,11 +478,20 @@ create_progress_dialog (NscConverter *converter)
 			  "progress_dialog", &priv->progress_dlg,
 			  "file_progressbar", &priv->progressbar,
 			  "speed_progressbar", &priv->speedbar,
-			  "cancel_button", &button,
+			  "pause_button", &priv->pause_button,
 			  NULL);
 
-	/* Connect the signal for the cancel button */
-	g_signal_connect (G_OBJECT (button), "clicked",
+	priv->user_paused = FALSE;
+	priv->paused = FALSE;
+	g_signal_connect (G_OBJECT (priv->pause_button), "clicked",
+			  (GCallback) progress_pause_cb,
+			  converter);
+
+	/*
+	 * The cancel button is an action widget, so this also
+	 * covers the dialog being closed by the window manager.
+	 */
+	g_signal_connect (G_OBJECT (priv->progress_dlg), "response",
 			  (GCallback) progress_cancel_cb,
 			  converter);
 
@@ -246,232 +499,431 @@ create_progress_dialog (NscConverter *converter)
 }
 
 /**
- * Create the new GFile.  This will need to be unreferenced.
+ * Are there files still to be found?
  */
-static GFile *
-create_new_file (NscConverter *converter, GFile *file)
+static gboolean
+is_searching (NscConverter *convert)
+{
+	NscConverterPrivate *priv = NSC_CONVERTER_GET_PRIVATE (convert);
+
+	return priv->n_walking > 0 ||
+		(priv->classifier != NULL &&
+		 nsc_classifier_is_running (priv->classifier));
+}
+
+/**
+ * Update progressbar text
+ */
+static void
+update_progressbar_text (NscConverter *convert)
 {
 	NscConverterPrivate *priv;
-	GFile               *new_file;
-	gchar               *old_basename, *new_basename;
-	gchar               *extension, *new_uri;
-	const gchar         *new_extension;
+	gchar               *text;
 
-	g_return_val_if_fail (G_IS_FILE (file), NULL);
+	g_return_if_fail (NSC_IS_CONVERTER (convert));
 
-	priv = NSC_CONVERTER_GET_PRIVATE (converter);
+	priv = NSC_CONVERTER_GET_PRIVATE (convert);
 
-	/* Let's the get the basename from the original file */
-	old_basename = g_file_get_basename (file);
+	if (priv->paused && priv->user_paused) {
+		text = g_strdup_printf (_("Paused: %d of %d"),
+					priv->files_converted + 1,
+					priv->total_files);
+	} else if (priv->paused) {
+		text = g_strdup_printf (_("Paused while the computer is busy: %d of %d"),
+					priv->files_converted + 1,
+					priv->total_files);
+	} else if (priv->retrying) {
+		text = g_strdup_printf (_("Retrying: %d of %d"),
+					priv->files_converted + 1,
+					priv->total_files);
+	} else if (is_searching (convert) &&
+		   priv->files_converted >= priv->total_files) {
+		text = g_strdup (_("Looking for audio files..."));
+	} else if (is_searching (convert)) {
+		text = g_strdup_printf (_("Converting: %d of %d found so far"),
+					priv->files_converted + 1,
+					priv->total_files);
+	} else {
+		text = g_strdup_printf (_("Converting: %d of %d"),
+					priv->files_converted + 1,
+					priv->total_files);
+	}
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->progressbar),
+				   text);
+	if (priv->status_icon) {
+		gtk_status_icon_set_tooltip (priv->status_icon,
+					     text);
+	}
+	g_free (text);
+}
 
-	/* Now let's remove the extension from the basename. */
-	extension = g_strdup (strrchr (old_basename, '.'));
-	if (extension != NULL)
-		old_basename[strlen (old_basename) - strlen (extension)] = '\0';
-	g_free (extension);
+/**
+ * Show every file that failed in a single, non-modal report.
+ */
+static void
+show_error_report (NscConverter *converter)
+{
+	NscConverterPrivate *priv;
+	GtkWidget           *dialog, *area, *scrolled, *view;
+	GtkTextBuffer       *buffer;
+	GtkTextIter          iter;
+	GList               *l;
+	gint                 n_errors;
 
-	/* Get the new extension from the audio profie */
-	new_extension = gm_audio_profile_get_extension (priv->profile);
+	priv = NSC_CONVERTER_GET_PRIVATE (converter);
 
-	/* Create the new basename */
-	new_basename = g_strdup_printf ("%s.%s", old_basename, new_extension);
-	g_free (old_basename);
+	n_errors = g_list_length (priv->errors);
+	priv->errors = g_list_reverse (priv->errors);
 
-	/* Now let's create the new files uri */
-	new_uri = g_strconcat (priv->save_path, G_DIR_SEPARATOR_S,
-			       new_basename, NULL);
-	g_free (new_basename);
+	dialog = gtk_message_dialog_new (NULL, 0,
+					 GTK_MESSAGE_ERROR,
+					 GTK_BUTTONS_CLOSE,
+					 ngettext ("Nautilus Sound Converter could not convert %d file.",
+						   "Nautilus Sound Converter could not convert %d files.",
+						   n_errors),
+					 n_errors);
+	gtk_window_set_icon_name (GTK_WINDOW (dialog), "audio-x-generic");
+
+	buffer = gtk_text_buffer_new (NULL);
+	gtk_text_buffer_get_end_iter (buffer, &iter);
+
+	for (l = priv->errors; l != NULL; l = l->next) {
+		ConvertError *error = l->data;
+		gchar        *text;
+
+		text = g_strdup_printf (_("%s\nReason: %s\n"),
+					error->name, error->message);
+		gtk_text_buffer_insert (buffer, &iter, text, -1);
+		g_free (text);
+	}
 
-	/* And now finally let's create the new GFile */
-	new_file = g_file_new_for_uri (new_uri);
-	g_free (new_uri);
+	view = gtk_text_view_new_with_buffer (buffer);
+	gtk_text_view_set_editable (GTK_TEXT_VIEW (view), FALSE);
+	gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (view), GTK_WRAP_WORD_CHAR);
+	g_object_unref (buffer);
+
+	scrolled = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+					GTK_POLICY_AUTOMATIC,
+					GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled),
+					     GTK_SHADOW_IN);
+	gtk_widget_set_size_request (scrolled, 400, 150);
+	gtk_container_add (GTK_CONTAINER (scrolled), view);
+
+	area = gtk_message_dialog_get_message_area (GTK_MESSAGE_DIALOG (dialog));
+	gtk_box_pack_start (GTK_BOX (area), scrolled, TRUE, TRUE, 0);
+
+	g_signal_connect (G_OBJECT (dialog), "response",
+			  (GCallback) gtk_widget_destroy,
+			  NULL);
 
-	return new_file;
+	gtk_widget_show_all (dialog);
+
+	free_errors (priv->errors);
+	priv->errors = NULL;
 }
 
 /**
- * Function to get orginal & new files, and pass
- * them to the gstreamer object.
+ * Seconds left for the whole batch, from the speed and the length
+ * of the files done so far, or of earlier runs.  -1 when unknown.
  */
-static void
-convert_file (NscConverter *convert)
+static gint
+estimate_time_left (NscConverter *conv,
+		    gint          seconds)
 {
 	NscConverterPrivate *priv;
-	NautilusFileInfo    *file_info;
-	GFile               *old_file, *new_file;
-	GError              *err = NULL;
+	gdouble              length, left;
+	gint                 files_left;
 
-	priv = NSC_CONVERTER_GET_PRIVATE (convert);
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	if (priv->speed <= 0)
+		return -1;
 
-	g_return_if_fail (priv->files != NULL);
+	if (priv->files_timed > 0)
+		length = priv->done_duration / priv->files_timed;
+	else if (priv->expected_duration > 0)
+		length = priv->expected_duration;
+	else
+		length = priv->total_duration;
 
-	/* Get the files */
-	file_info = NAUTILUS_FILE_INFO (priv->files->data);
-	old_file = nautilus_file_info_get_location (file_info);
-	new_file = create_new_file (convert, old_file);
+	if (priv->total_duration > 0)
+		left = MAX (priv->total_duration - seconds, 0);
+	else
+		left = length;
 
-	/* Let's finally get to the fun stuff */
-	nsc_gstreamer_convert_file (priv->gst, old_file, new_file,
-				    &err);
+	files_left = MAX (priv->total_files - priv->files_converted - 1, 0);
 
-	/* Free the files since we do not need them anymore */
-	g_object_unref (old_file);
-	g_object_unref (new_file);
+	return (left + files_left * length) / priv->speed;
 }
 
 /**
- * Update progressbar text
+ * Update the ETA and Speed labels
  */
 static void
-update_progressbar_text (NscConverter *convert)
+update_speed_progress (NscConverter *conv,
+		       gint          seconds)
 {
 	NscConverterPrivate *priv;
-	gchar               *text;
+	gchar               *eta_str;
+	gint                 eta;
 
-	g_return_if_fail (NSC_IS_CONVERTER (convert));
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
 
-	priv = NSC_CONVERTER_GET_PRIVATE (convert);
+	eta = estimate_time_left (conv, seconds);
+	if (eta >= 0) {
+		eta_str =
+			g_strdup_printf (_("Estimated time left: %d:%02d (at %0.1f\303\227)"),
+					 eta / 60,
+					 eta % 60,
+					 priv->speed);
+	} else {
+		eta_str = g_strdup (_("Estimated time left: unknown"));
+	}
 
-	text = g_strdup_printf (_("Converting: %d of %d"),
-				priv->files_converted + 1, priv->total_files);
-	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->progressbar),
-				   text);
-	if (priv->status_icon) {
-		gtk_status_icon_set_tooltip (priv->status_icon,
-					     text);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->speedbar),
+				   eta_str);
+	g_free (eta_str);
+}
+
+/**
+ * Update the progress dialog once a file is out of the way.
+ */
+static void
+on_file_done (NscConverter *converter)
+{
+	NscConverterPrivate *priv;
+	gdouble              fraction;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (converter);
+
+	/* Increment converted total */
+	priv->files_converted++;
+
+	/* The speed carries on to the next file, the progress does not */
+	if (priv->total_duration > 0) {
+		priv->done_duration += priv->total_duration;
+		priv->files_timed++;
 	}
-	g_free (text);
+	priv->total_duration = 0;
+
+	update_speed_progress (converter, 0);
+
+	/* Update the progress dialog */
+	fraction = (double) priv->files_converted / priv->total_files;
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (priv->progressbar),
+				       fraction);
+
+	if (priv->files_converted < priv->total_files || is_searching (converter))
+		update_progressbar_text (converter);
 }
 
-/** 
+/**
  * Callback to report errors.  The error passed in does not
- * need to be freed.
+ * need to be freed.  The error is only recorded, since the
+ * batch keeps going.
  */
 static void
-on_error_cb (NscGStreamer *gstream, GError *error, gpointer data)
+on_file_failed_cb (NscBatch *batch,
+		   guint     index,
+		   GError   *error,
+		   gpointer  data)
 {
-	NscConverter	    *converter;
 	NscConverterPrivate *priv;
-	GtkWidget           *dialog;
-	gchar               *text;
+	ConvertError        *convert_error;
+	GFile               *file;
 
-	converter = NSC_CONVERTER (data);
-	priv = NSC_CONVERTER_GET_PRIVATE (converter);
+	priv = NSC_CONVERTER_GET_PRIVATE (data);
 
-	text = g_strdup_printf (_("Nautilus Sound Converter could "
-				  "not convert this file.\nReason: %s"),
-				error->message);
+	file = nsc_batch_get_file (batch, index);
+	convert_error = g_new0 (ConvertError, 1);
+	if (file != NULL) {
+		convert_error->name = g_file_get_parse_name (file);
+		g_object_unref (file);
+	} else {
+		convert_error->name = g_strdup (_("Unknown file"));
+	}
+	convert_error->message = g_strdup (error->message);
 
-	dialog = gtk_message_dialog_new (GTK_WINDOW (priv->dialog), 0,
-					 GTK_MESSAGE_ERROR,
-					 GTK_BUTTONS_CLOSE,
-					 text);
-	g_free (text);
+	priv->errors = g_list_prepend (priv->errors, convert_error);
 
-	gtk_dialog_run (GTK_DIALOG (dialog));
-	gtk_widget_destroy (dialog);
+	on_file_done (NSC_CONVERTER (data));
 }
 
 /**
- * Callback to report completion.
+ * Callback for when the batch goes over the failed files again.
  */
 static void
-on_completion_cb (NscGStreamer *gstream, gpointer data)
+on_retrying_cb (NscBatch *batch,
+		guint     n_files,
+		gpointer  data)
 {
-	NscConverter	    *converter;
+	NscConverter        *converter;
 	NscConverterPrivate *priv;
-	gdouble              fraction;
 
 	converter = NSC_CONVERTER (data);
 	priv = NSC_CONVERTER_GET_PRIVATE (converter);
-	
-	/* Increment converted total & point to next file */
-	priv->files_converted++;
-	priv->files = priv->files->next;
 
-	/* Reset the progress variables */
-	priv->current_duration =  0;
-	priv->total_duration   =  0;
-	priv->before.seconds   = -1;
-
-	/* Clear the speed label */
-	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->speedbar),
-				   (_("Speed: Unknown")));
+	priv->retrying = TRUE;
+	priv->files_converted = 0;
+	priv->total_files = n_files;
 
-	/* Update the progress dialog */
-	fraction = (double) priv->files_converted / priv->total_files;
 	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (priv->progressbar),
-				       fraction);
+				       0.0);
 	update_progressbar_text (converter);
+}
 
-	/* If there are more files let's go ahead and convert them */
-	if (priv->files != NULL) {
-		convert_file (converter);
-	} else {
-		/* No more files to convert time to do some cleanup */
-		gtk_widget_destroy (priv->progress_dlg);
-		if (priv->status_icon)
-			g_object_unref (priv->status_icon);
-		g_object_unref (priv->gst);
-		priv->gst = NULL;
-	}
+/**
+ * Callback for when the batch pauses, for the user or the load,
+ * and when it goes on.
+ */
+static void
+on_paused_cb (NscBatch *batch,
+	      gboolean  paused,
+	      gpointer  data)
+{
+	NscConverter        *converter;
+	NscConverterPrivate *priv;
+
+	converter = NSC_CONVERTER (data);
+	priv = NSC_CONVERTER_GET_PRIVATE (converter);
+
+	priv->paused = paused;
+	update_progressbar_text (converter);
+
+	/* The time spent paused is not part of the speed */
+	priv->before.time = 0;
 }
 
 /**
- * Callback to set file total duration.
+ * Callback to report completion.
+ */
+static void
+on_file_completed_cb (NscBatch *batch,
+		      guint     index,
+		      gpointer  data)
+{
+	NscConverterPrivate *priv;
+	const NscFileStats  *stats;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (data);
+
+	/* Files converted in the service are not timed here */
+	stats = nsc_batch_get_file_stats (batch);
+	if (stats != NULL && priv->history != NULL)
+		nsc_history_add (priv->history, stats, priv->format);
+
+	on_file_done (NSC_CONVERTER (data));
+}
+
+/**
+ * Callback for when a file is started.  Until the batch has a
+ * speed of its own, it goes by how fast files like this one were
+ * converted before.
  */
 static void
-on_duration_cb (NscGStreamer *gstream,
-		const int     seconds,
-		gpointer      data)
+on_file_started_cb (NscBatch *batch,
+		    guint     index,
+		    gpointer  data)
 {
 	NscConverter        *conv;
 	NscConverterPrivate *priv;
+	GFile               *file;
+	gchar               *name;
+	gdouble              factor, duration;
 
 	conv = NSC_CONVERTER (data);
 	priv = NSC_CONVERTER_GET_PRIVATE (conv);
 
-	priv->total_duration = seconds;
+	g_free (priv->format);
+	priv->format = NULL;
+
+	file = nsc_batch_get_file (batch, index);
+	if (file != NULL) {
+		name = g_file_get_basename (file);
+		priv->format = g_content_type_guess (name, NULL, 0, NULL);
+		g_free (name);
+		g_object_unref (file);
+	}
+
+	if (priv->history != NULL &&
+	    nsc_history_lookup (priv->history,
+				gm_audio_profile_get_id (priv->profile),
+				priv->format, &factor, &duration)) {
+		if (priv->speed <= 0)
+			priv->speed = factor;
+		priv->expected_duration = duration;
+	}
+
+	update_speed_progress (conv, 0);
 }
 
 /**
- * Update the ETA and Speed labels
+ * Callback for when every file has been handled.
  */
 static void
-update_speed_progress (NscConverter *conv,
-		       float         speed,
-		       int           eta)
+on_finished_cb (NscBatch *batch,
+		gpointer  data)
 {
+	NscConverter        *converter;
+	NscConverterPrivate *priv;
+
+	converter = NSC_CONVERTER (data);
+	priv = NSC_CONVERTER_GET_PRIVATE (converter);
+
+	/* No more files to convert time to do some cleanup */
+	gtk_widget_destroy (priv->progress_dlg);
+	if (priv->status_icon)
+		g_object_unref (priv->status_icon);
+
+	g_signal_handlers_disconnect_matched (priv->batch,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, converter);
+	g_object_unref (priv->batch);
+	priv->batch = NULL;
+
+	free_walkers (converter);
+	free_classifier (converter);
+	free_history (converter);
+
+	if (priv->errors != NULL)
+		show_error_report (converter);
+}
+
+/**
+ * Callback to set file total duration.
+ */
+static void
+on_duration_cb (NscBatch  *batch,
+		const int  seconds,
+		gpointer   data)
+{
+	NscConverter        *conv;
 	NscConverterPrivate *priv;
-	gchar               *eta_str;
 
+	conv = NSC_CONVERTER (data);
 	priv = NSC_CONVERTER_GET_PRIVATE (conv);
 
-	if (eta >= 0) {
-		eta_str =
-			g_strdup_printf (_("Estimated time left: %d:%02d (at %0.1f\303\227)"),
-					 eta / 60,
-					 eta % 60,
-					 speed);
-	} else {
-		eta_str = g_strdup (_("Estimated time left: unknown"));
-	}
+	priv->total_duration = seconds;
 
-	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->speedbar),
-				   eta_str);
-	g_free (eta_str);
+	update_speed_progress (conv, 0);
 }
 
 /**
- * Callback to report on file conversion progress.
+ * Callback to report on file conversion progress.  The speed is
+ * taken over the whole batch, so the time spent between files
+ * counts as well.
  */
 static void
-on_progress_cb (NscGStreamer *gstream,
-		const int     seconds,
-		gpointer      data)
+on_progress_cb (NscBatch  *batch,
+		const int  seconds,
+		gpointer   data)
 {
 	NscConverter        *conv;
 	NscConverterPrivate *priv;
+	gdouble              position, taken, speed;
+	gint64               now;
 
 	conv = NSC_CONVERTER (data);
 	priv = NSC_CONVERTER_GET_PRIVATE (conv);
@@ -479,35 +931,35 @@ on_progress_cb (NscGStreamer *gstream,
 	if (priv->total_duration != 0) {
 		float percent;
 
-		percent =
-			CLAMP ((float) (priv->current_duration + seconds)
-			       / (float) priv->total_duration, 0, 1);
+		percent = CLAMP ((float) seconds / (float) priv->total_duration,
+				 0, 1);
 		gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (priv->speedbar), percent);
+	}
 
-		if (priv->before.seconds == -1) {
-			priv->before.seconds = priv->current_duration + seconds;
-			gettimeofday (&priv->before.time, NULL);
-		} else {
-			struct timeval time;
-			gint           taken;
-			float          speed;
-
-			gettimeofday (&time, NULL);
-			taken = time.tv_sec + (time.tv_usec / 1000000.0)
-				- (priv->before.time.tv_sec + (priv->before.time.tv_usec / 1000000.0));
-
-			if (taken >= 2) {
-				priv->before.taken += taken;
-				priv->before.ripped += priv->current_duration + seconds - priv->before.seconds;
-				speed = (float) priv->before.ripped / (float) priv->before.taken;
-				update_speed_progress (conv, speed,
-						       (int) ((priv->total_duration - priv->current_duration - seconds)
-							      / speed));
-				priv->before.seconds = priv->current_duration + seconds;
-				gettimeofday (&priv->before.time, NULL);
-			}
-		}
+	position = priv->done_duration + seconds;
+	now = g_get_monotonic_time ();
+
+	if (priv->before.time == 0) {
+		priv->before.seconds = position;
+		priv->before.time = now;
+		return;
 	}
+
+	taken = (gdouble) (now - priv->before.time) / G_USEC_PER_SEC;
+	if (taken < SPEED_INTERVAL)
+		return;
+
+	/* Follow the live speed, starting from the one of earlier runs */
+	speed = (position - priv->before.seconds) / taken;
+	if (priv->speed > 0)
+		priv->speed += SPEED_WEIGHT * (speed - priv->speed);
+	else
+		priv->speed = speed;
+
+	priv->before.seconds = position;
+	priv->before.time = now;
+
+	update_speed_progress (conv, seconds);
 }
 
 static void
@@ -530,26 +982,402 @@ converter_status_icon_activate_cb (GtkStatusIcon *status_icon,
 	}
 }
 
+/**
+ * A file was found in one of the folders, so queue it
+ * right away, keeping its place in the tree.
+ */
 static void
-create_gst (NscConverter *conv)
+on_file_found_cb (NscWalker   *walker,
+		  GFile       *file,
+		  const gchar *path,
+		  gpointer     data)
 {
+	NscConverter        *conv;
 	NscConverterPrivate *priv;
 
+	conv = NSC_CONVERTER (data);
 	priv = NSC_CONVERTER_GET_PRIVATE (conv);
 
-	priv->gst = nsc_gstreamer_new (priv->profile);
-	
-	/* Connect to the gstreamer object signals */
-	g_signal_connect (G_OBJECT (priv->gst), "completion",
-			  (GCallback) on_completion_cb,
+	/*
+	 * Counted first, as the batch may start on it right away, but
+	 * not the files it is writing into the tree being read.
+	 */
+	priv->total_files++;
+	if (!nsc_batch_add_file_in (priv->batch, file, path)) {
+		priv->total_files--;
+		return;
+	}
+
+	/* Unless the batch already moved on to it */
+	if (priv->files_converted < priv->total_files)
+		update_progressbar_text (conv);
+}
+
+/**
+ * Once every file has been found the batch can finish.
+ */
+static void
+close_batch (NscConverter *conv)
+{
+	NscConverterPrivate *priv;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	if (priv->batch == NULL || is_searching (conv))
+		return;
+
+	if (priv->files_converted < priv->total_files)
+		update_progressbar_text (conv);
+
+	nsc_batch_close (priv->batch);
+}
+
+static void
+on_walker_finished_cb (NscWalker *walker,
+		       gpointer   data)
+{
+	NscConverterPrivate *priv;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (data);
+
+	priv->n_walking--;
+	close_batch (NSC_CONVERTER (data));
+}
+
+/**
+ * Show how many of the selected files will be converted.
+ */
+static void
+update_count_label (NscConverter *conv)
+{
+	NscConverterPrivate *priv;
+	gchar               *text;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	if (priv->count_label == NULL)
+		return;
+
+	if (nsc_classifier_is_running (priv->classifier)) {
+		text = g_strdup_printf (ngettext ("%d audio file found so far",
+						  "%d audio files found so far",
+						  priv->total_files),
+					priv->total_files);
+	} else {
+		text = g_strdup_printf (ngettext ("%d audio file selected",
+						  "%d audio files selected",
+						  priv->total_files),
+					priv->total_files);
+
+		/* Nothing to convert after all */
+		if (priv->total_files == 0 && priv->folders == NULL)
+			gtk_dialog_set_response_sensitive (GTK_DIALOG (priv->dialog),
+							   GTK_RESPONSE_OK,
+							   FALSE);
+	}
+
+	gtk_label_set_text (GTK_LABEL (priv->count_label), text);
+	g_free (text);
+}
+
+/**
+ * An audio file was picked out of the selection.  It is converted
+ * right away if the batch is running, and kept for it otherwise.
+ */
+static void
+on_file_classified_cb (NscClassifier *classifier,
+		       GFile         *file,
+		       gpointer       data)
+{
+	NscConverter        *conv;
+	NscConverterPrivate *priv;
+
+	conv = NSC_CONVERTER (data);
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	priv->total_files++;
+
+	if (priv->batch != NULL) {
+		nsc_batch_add_file (priv->batch, file);
+
+		if (priv->files_converted < priv->total_files)
+			update_progressbar_text (conv);
+	} else {
+		g_ptr_array_add (priv->found, g_object_ref (file));
+		update_count_label (conv);
+
+		if (priv->estimator != NULL)
+			nsc_estimator_add_file (priv->estimator, file);
+	}
+}
+
+/**
+ * Show what converting the selection with the chosen profile
+ * should come to.
+ */
+static void
+update_estimate_label (NscConverter *conv)
+{
+	NscConverterPrivate *priv;
+	GMAudioProfile      *profile;
+	NscEstimateResult    result = NSC_ESTIMATE_PENDING;
+	guint64              bytes;
+	gdouble              seconds;
+	guint                jobs;
+	gint                 secs;
+	gchar               *size, *text;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	if (priv->estimate_label == NULL || priv->estimator == NULL)
+		return;
+
+	profile = gm_audio_profile_choose_get_active (priv->profile_chooser);
+	jobs = priv->max_jobs > 0 ? (guint) priv->max_jobs :
+		nsc_scheduler_get_limit (nsc_scheduler_get_default ());
+
+	if (profile != NULL)
+		result = nsc_estimator_get_estimate (priv->estimator, profile,
+						     jobs, &bytes, &seconds);
+
+	if (result == NSC_ESTIMATE_PENDING) {
+		gtk_label_set_text (GTK_LABEL (priv->estimate_label),
+				    _("Estimating size\342\200\246"));
+		return;
+	} else if (result == NSC_ESTIMATE_UNKNOWN) {
+		gtk_label_set_text (GTK_LABEL (priv->estimate_label),
+				    _("Size unknown"));
+		return;
+	}
+
+	size = g_format_size (bytes);
+	secs = (gint) seconds;
+	if (secs >= 3600)
+		text = g_strdup_printf (_("About %s in %d:%02d:%02d"), size,
+					secs / 3600, secs / 60 % 60,
+					secs % 60);
+	else
+		text = g_strdup_printf (_("About %s in %d:%02d"), size,
+					secs / 60, secs % 60);
+	gtk_label_set_text (GTK_LABEL (priv->estimate_label), text);
+	g_free (text);
+	g_free (size);
+}
+
+static void
+on_estimate_changed_cb (NscEstimator *estimator,
+			gpointer      data)
+{
+	update_estimate_label (NSC_CONVERTER (data));
+}
+
+static void
+on_profile_changed_cb (GtkWidget *chooser,
+		       gpointer   data)
+{
+	update_estimate_label (NSC_CONVERTER (data));
+}
+
+/**
+ * Once the selection is known, sample it with the chosen profile
+ * first, then with every other one that can be used.
+ */
+static void
+start_estimator (NscConverter *conv)
+{
+	NscConverterPrivate *priv;
+	GMAudioProfile      *active;
+	GList               *profiles = NULL, *all, *l;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	if (priv->estimator == NULL || priv->profile_chooser == NULL)
+		return;
+
+	active = gm_audio_profile_choose_get_active (priv->profile_chooser);
+
+	all = gm_audio_profile_get_active_list ();
+	for (l = all; l != NULL; l = l->next) {
+		if (l->data == active ||
+		    !nsc_gstreamer_supports_profile (l->data))
+			continue;
+		profiles = g_list_prepend (profiles, l->data);
+	}
+	g_list_free (all);
+
+	profiles = g_list_reverse (profiles);
+	if (active != NULL && nsc_gstreamer_supports_profile (active))
+		profiles = g_list_prepend (profiles, active);
+
+	nsc_estimator_start (priv->estimator, profiles);
+	g_list_free (profiles);
+
+	update_estimate_label (conv);
+}
+
+static void
+on_classifier_finished_cb (NscClassifier *classifier,
+			   gpointer       data)
+{
+	update_count_label (NSC_CONVERTER (data));
+	close_batch (NSC_CONVERTER (data));
+
+	/* Still choosing a profile */
+	if (NSC_CONVERTER_GET_PRIVATE (data)->batch == NULL)
+		start_estimator (NSC_CONVERTER (data));
+}
+
+static void
+start_classifier (NscConverter *conv)
+{
+	NscConverterPrivate *priv;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	priv->classifier = nsc_classifier_new (priv->files);
+
+	/* Only the classifier needs the selection, until it is done */
+	nautilus_file_info_list_free (priv->files);
+	priv->files = NULL;
+
+	g_signal_connect (G_OBJECT (priv->classifier), "file-found",
+			  (GCallback) on_file_classified_cb,
+			  conv);
+	g_signal_connect (G_OBJECT (priv->classifier), "finished",
+			  (GCallback) on_classifier_finished_cb,
+			  conv);
+
+	nsc_classifier_start (priv->classifier);
+	update_count_label (conv);
+}
+
+/**
+ * Start searching the folders, every file found is
+ * added to the running batch.
+ */
+static void
+start_walkers (NscConverter *conv)
+{
+	NscConverterPrivate *priv;
+	const gchar * const *optional;
+	GPtrArray           *mime_types;
+	GList               *l;
+	gint                 i;
+
+	static const gchar *required[] = {
+		NSC_ENGINE_REQUIRED_TYPES,
+		NULL
+	};
+
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	mime_types = g_ptr_array_new ();
+	for (i = 0; required[i] != NULL; i++)
+		g_ptr_array_add (mime_types, (gpointer) required[i]);
+	optional = nsc_init_get_mime_types ();
+	for (i = 0; optional[i] != NULL; i++)
+		g_ptr_array_add (mime_types, (gpointer) optional[i]);
+	g_ptr_array_add (mime_types, NULL);
+
+	for (l = priv->folders; l != NULL; l = l->next) {
+		NscWalker *walker;
+		GFile     *root;
+
+		root = nautilus_file_info_get_location (NAUTILUS_FILE_INFO (l->data));
+		walker = nsc_walker_new (root,
+					 (const gchar * const *) mime_types->pdata);
+		g_object_unref (root);
+
+		g_signal_connect (G_OBJECT (walker), "file-found",
+				  (GCallback) on_file_found_cb,
+				  conv);
+		g_signal_connect (G_OBJECT (walker), "finished",
+				  (GCallback) on_walker_finished_cb,
+				  conv);
+
+		priv->walkers = g_list_prepend (priv->walkers, walker);
+		priv->n_walking++;
+	}
+
+	g_ptr_array_free (mime_types, TRUE);
+
+	for (l = priv->walkers; l != NULL; l = l->next)
+		nsc_walker_start (l->data);
+}
+
+/**
+ * Set up @remote, or a batch converting in process when it is NULL.
+ */
+static void
+create_batch (NscConverter *conv,
+	      NscBatch     *remote)
+{
+	NscConverterPrivate *priv;
+	guint                i;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (conv);
+
+	priv->batch = remote;
+
+	if (priv->batch == NULL) {
+		priv->batch = nsc_batch_new (priv->profile, priv->save_path);
+		nsc_batch_set_report_dir (priv->batch, priv->report_dir);
+		nsc_batch_set_verify_dir (priv->batch, priv->verify_dir);
+		nsc_batch_set_trace_dir (priv->batch, priv->trace_dir);
+
+		if (priv->spill_limit > 0)
+			nsc_batch_set_spill (priv->batch, priv->spill_limit);
+
+		/* Shared with every other batch in Nautilus */
+		nsc_scheduler_set_limit (nsc_scheduler_get_default (),
+					 MAX (priv->max_jobs, 0));
+		nsc_scheduler_set_throttle (nsc_scheduler_get_default (),
+					    priv->throttle);
+	}
+
+	/* Times the batch before it has timed anything itself */
+	priv->history = nsc_history_load ();
+
+	nsc_batch_set_retry (priv->batch, priv->retry);
+	nsc_batch_set_split_cue (priv->batch, priv->split_cue);
+
+	/* Someone converting a single file is waiting for it */
+	nsc_batch_set_interactive (priv->batch,
+				   !is_searching (conv) &&
+				   priv->folders == NULL &&
+				   priv->found->len == 1);
+
+	for (i = 0; i < priv->found->len; i++) {
+		GFile *file = g_ptr_array_index (priv->found, i);
+
+		nsc_batch_add_file (priv->batch, file);
+		g_object_unref (file);
+	}
+	g_ptr_array_set_size (priv->found, 0);
+
+	/* Connect to the batch signals */
+	g_signal_connect (G_OBJECT (priv->batch), "file-started",
+			  (GCallback) on_file_started_cb,
 			  conv);
-	g_signal_connect (G_OBJECT (priv->gst), "error",
-			  (GCallback) on_error_cb,
+	g_signal_connect (G_OBJECT (priv->batch), "file-completed",
+			  (GCallback) on_file_completed_cb,
 			  conv);
-	g_signal_connect (G_OBJECT (priv->gst), "progress",
+	g_signal_connect (G_OBJECT (priv->batch), "file-failed",
+			  (GCallback) on_file_failed_cb,
+			  conv);
+	g_signal_connect (G_OBJECT (priv->batch), "retrying",
+			  (GCallback) on_retrying_cb,
+			  conv);
+	g_signal_connect (G_OBJECT (priv->batch), "paused",
+			  (GCallback) on_paused_cb,
+			  conv);
+	g_signal_connect (G_OBJECT (priv->batch), "finished",
+			  (GCallback) on_finished_cb,
+			  conv);
+	g_signal_connect (G_OBJECT (priv->batch), "progress",
 			  (GCallback) on_progress_cb,
 			  conv);
-	g_signal_connect (G_OBJECT (priv->gst), "duration",
+	g_signal_connect (G_OBJECT (priv->batch), "duration",
 			  (GCallback) on_duration_cb,
 			  conv);
 }
@@ -569,6 +1397,63 @@ create_status_icon (NscConverter *conv)
 	gtk_status_icon_set_visible (priv->status_icon, TRUE);
 }
 	
+/**
+ * Show the progress and start converting.
+ */
+static void
+start_batch (NscConverter *converter)
+{
+	NscConverterPrivate *priv;
+
+	priv = NSC_CONVERTER_GET_PRIVATE (converter);
+
+	/* Create the progress window & status icon */
+	create_progress_dialog (converter);
+	create_status_icon (converter);
+
+	/* Let's put some text in the progressbar */
+	update_progressbar_text (converter);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->speedbar),
+				   (_("Speed: Unknown")));
+
+	/*
+	 * Alright we're finally ready to start converting, even
+	 * if the rest of the files are still to be found.
+	 */
+	if (is_searching (converter) || priv->folders != NULL) {
+		nsc_batch_open (priv->batch);
+		nsc_batch_start (priv->batch);
+		start_walkers (converter);
+	} else {
+		nsc_batch_start (priv->batch);
+	}
+}
+
+/**
+ * The service answered, or could not be reached and the files
+ * are converted in process.
+ */
+static void
+remote_batch_cb (GObject      *source,
+		 GAsyncResult *res,
+		 gpointer      data)
+{
+	NscConverter *converter = NSC_CONVERTER (data);
+	NscBatch     *batch;
+	GError       *error = NULL;
+
+	batch = nsc_remote_batch_new_finish (res, &error);
+	if (batch == NULL) {
+		g_message ("Converting in process; %s", error->message);
+		g_error_free (error);
+	}
+
+	create_batch (converter, batch);
+	start_batch (converter);
+
+	g_object_unref (converter);
+}
+
 /**
  * The OK or Cancel button was pressed on the main dialog.
  */
@@ -601,21 +1486,30 @@ converter_response_cb (GtkWidget *dialog,
 			return;
 		}
 
-		/* Create the gstreamer converter object */
-		create_gst (converter);
-
-		/* Create the progress window & status icon */
-		create_progress_dialog (converter);
-		create_status_icon (converter);
-
-		/* Let's put some text in the progressbar */
-		update_progressbar_text (converter);
-		gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->speedbar),
-					   (_("Speed: Unknown")));
-
-		/* Alright we're finally ready to start converting */
-		convert_file (converter);
+		/*
+		 * Prefer the service, but convert in process if it can't
+		 * be reached.  The service takes a job in one go, so files
+		 * that are still being found are converted in process as
+		 * they come.  Starting it can take a while, so the dialog
+		 * does not wait for it.
+		 */
+		if (priv->use_service && !is_searching (converter) &&
+		    priv->folders == NULL) {
+			nsc_remote_batch_new_async (priv->profile,
+						    priv->save_path,
+						    remote_batch_cb,
+						    g_object_ref (converter));
+		} else {
+			create_batch (converter, NULL);
+			start_batch (converter);
+		}
+	} else {
+		free_classifier (NSC_CONVERTER (user_data));
 	}
+
+	free_estimator (NSC_CONVERTER (user_data));
+	NSC_CONVERTER_GET_PRIVATE (user_data)->count_label = NULL;
+	NSC_CONVERTER_GET_PRIVATE (user_data)->estimate_label = NULL;
 	gtk_widget_destroy (dialog);
 }
 
@@ -658,6 +1552,7 @@ create_main_dialog (NscConverter *converter)
 				   "main_dialog", &priv->dialog,
 				   "path_chooser", &priv->path_chooser,
 				   "format_hbox", &hbox,
+				   "count_label", &priv->count_label,
 				   NULL);
 
 	if (!result) {
@@ -672,11 +1567,20 @@ create_main_dialog (NscConverter *converter)
 		NautilusFileInfo *file_info;
 		gchar            *uri;
 
-		file_info = NAUTILUS_FILE_INFO (priv->files->data);
-		uri = nautilus_file_info_get_uri (file_info);
+		file_info = NAUTILUS_FILE_INFO (priv->files ?
+						priv->files->data :
+						priv->folders->data);
 
-		gtk_file_chooser_set_uri (GTK_FILE_CHOOSER (priv->path_chooser),
-					  uri);
+		/* A folder is rebuilt next to itself, so over the same tree */
+		if (nautilus_file_info_is_directory (file_info)) {
+			uri = nautilus_file_info_get_parent_uri (file_info);
+			gtk_file_chooser_set_current_folder_uri (GTK_FILE_CHOOSER (priv->path_chooser),
+								 uri);
+		} else {
+			uri = nautilus_file_info_get_uri (file_info);
+			gtk_file_chooser_set_uri (GTK_FILE_CHOOSER (priv->path_chooser),
+						  uri);
+		}
 		g_free (uri);
 	}
 
@@ -701,6 +1605,11 @@ create_main_dialog (NscConverter *converter)
 			    FALSE, FALSE, 0);
 	gtk_box_pack_start (GTK_BOX (hbox), edit, FALSE, FALSE, 0);
 
+	/* Filled in once the selection has been sampled */
+	priv->estimate_label = gtk_label_new (NULL);
+	gtk_box_pack_start (GTK_BOX (hbox), priv->estimate_label,
+			    FALSE, FALSE, 0);
+
 	/* Connect signals */
 	g_signal_connect (G_OBJECT (priv->dialog), "response",
 			  (GCallback) converter_response_cb,
@@ -708,6 +1617,9 @@ create_main_dialog (NscConverter *converter)
 	g_signal_connect (G_OBJECT (edit), "clicked",
 			  (GCallback) converter_edit_profile,
 			  converter);
+	g_signal_connect (G_OBJECT (priv->profile_chooser), "changed",
+			  (GCallback) on_profile_changed_cb,
+			  converter);
 
 	gtk_widget_show_all (priv->dialog);
 }
@@ -722,37 +1634,26 @@ nsc_converter_init (NscConverter *self)
 	/* If correctly allocated, initialize parameters */
 	if ((NSC_CONVERTER (self))->priv != NULL) {
 		NscConverterPrivate *priv = NSC_CONVERTER_GET_PRIVATE (self);
-		GConfClient         *gconf;
-		GError              *error = NULL;
+		const NscSettings   *settings;
 
 		/* Set init values */
-		priv->gst = NULL;
+		priv->batch = NULL;
 		priv->files_converted = 0;
-		priv->current_duration = 0;
 		priv->total_duration = 0;
-		priv->before.seconds = -1;
-
-		/* Get gconf client */
-		gconf = gconf_client_get_default ();
-		if (gconf == NULL) {
-			/* Should probably do more than just give a warning */
-			g_warning (_("Could not create GConf client.\n"));
-		}
-
-		priv->src_dir = gconf_client_get_bool (gconf,
-						       SOURCE_DIRECTORY,
-						       &error);
-
-		if (error) {
-			priv->src_dir = FALSE;
-			g_error_free (error);
-		}
-
-		/* Init gnome-media-profiles */
-		gnome_media_profiles_init (gconf);
-
-		/* Unreference the gconf client */
-		g_object_unref (gconf);
+		priv->found = g_ptr_array_new ();
+
+		/* The settings are read once, and kept up to date */
+		settings = nsc_init_get_settings ();
+		priv->src_dir = settings->src_dir;
+		priv->retry = settings->retry;
+		priv->use_service = settings->use_service;
+		priv->report_dir = g_strdup (settings->report_dir);
+		priv->verify_dir = g_strdup (settings->verify_dir);
+		priv->trace_dir = g_strdup (settings->trace_dir);
+		priv->spill_limit = settings->spill_limit;
+		priv->max_jobs = settings->max_jobs;
+		priv->throttle = settings->throttle;
+		priv->split_cue = settings->split_cue;
 
 		/* Set the profile to the default. */
 		priv->profile = gm_audio_profile_lookup (DEFAULT_AUDIO_PROFILE_NAME);
@@ -762,16 +1663,44 @@ nsc_converter_init (NscConverter *self)
 /*
  * Public Methods
  */
+/**
+ * @files is the selection, and @folders are converted with every
+ * audio file in them.  Both lists of NautilusFileInfo are taken over.
+ */
 NscConverter *
-nsc_converter_new (GList *files)
+nsc_converter_new (GList *files,
+		   GList *folders)
 {
-	return g_object_new (NSC_TYPE_CONVERTER, "files", files, NULL);
+	return g_object_new (NSC_TYPE_CONVERTER,
+			     "files", files,
+			     "folders", folders,
+			     NULL);
 }
 
 void
 nsc_converter_show_dialog (NscConverter *converter)
 {
+	NscConverterPrivate *priv;
+	gint64               start;
+
 	g_return_if_fail (NSC_IS_CONVERTER (converter));
 
+	priv = NSC_CONVERTER_GET_PRIVATE (converter);
+
+	start = g_get_monotonic_time ();
 	create_main_dialog (converter);
+	g_debug ("Main dialog opened in %.2f ms",
+		 (g_get_monotonic_time () - start) / 1000.0);
+
+	/* The count and the estimate fill in while the dialog is up */
+	if (priv->files != NULL) {
+		priv->estimator = nsc_estimator_new ();
+		g_signal_connect (G_OBJECT (priv->estimator), "changed",
+				  (GCallback) on_estimate_changed_cb,
+				  converter);
+		start_classifier (converter);
+	}
+
+	/* Most likely the next dialog we need */
+	nsc_xml_prefetch ("progress.ui");
 }
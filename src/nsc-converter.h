@@ -50,7 +50,8 @@ struct _NscConverterClass {
 };
 
 GType		 nsc_converter_get_type    (void);
-NscConverter	*nsc_converter_new 	   (GList *files);
+NscConverter	*nsc_converter_new 	   (GList *files,
+					    GList *folders);
 void		 nsc_converter_show_dialog (NscConverter *dialog);
 
 G_END_DECLS
@@ -0,0 +1,553 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-cue.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#include "nsc-cue.h"
+#include "nsc-error.h"
+
+/* Most sheets that are not UTF-8 come from Windows rippers */
+#define FALLBACK_CHARSET "WINDOWS-1252"
+
+struct _NscCueCache {
+	/* The names of the sheets in each directory, by its URI */
+	GHashTable *directories;
+};
+
+/*
+ * Private Methods
+ */
+static void
+track_free (NscCueTrack *track)
+{
+	g_free (track->title);
+	g_free (track->performer);
+	g_free (track);
+}
+
+/**
+ * The next word of @line, or the next string if it is quoted,
+ * moving @line past it.
+ */
+static gchar *
+next_token (const gchar **line)
+{
+	const gchar *p = *line, *end;
+	gchar       *token;
+
+	while (g_ascii_isspace (*p))
+		p++;
+
+	if (*p == '\0') {
+		*line = p;
+		return NULL;
+	}
+
+	if (*p == '"') {
+		p++;
+		end = strchr (p, '"');
+		if (end == NULL)
+			end = p + strlen (p);
+		token = g_strndup (p, end - p);
+		*line = *end == '"' ? end + 1 : end;
+	} else {
+		end = p;
+		while (*end != '\0' && !g_ascii_isspace (*end))
+			end++;
+		token = g_strndup (p, end - p);
+		*line = end;
+	}
+
+	return token;
+}
+
+/**
+ * Parse a time like 03:25:60 into CD frames.
+ */
+static gboolean
+parse_time (const gchar *time,
+	    guint64     *frames)
+{
+	guint minutes, seconds, remainder;
+
+	if (time == NULL ||
+	    sscanf (time, "%u:%u:%u", &minutes, &seconds, &remainder) != 3 ||
+	    seconds >= 60 || remainder >= NSC_CUE_FRAMES_PER_SECOND)
+		return FALSE;
+
+	*frames = ((guint64) minutes * 60 + seconds)
+		* NSC_CUE_FRAMES_PER_SECOND + remainder;
+
+	return TRUE;
+}
+
+static gchar *
+strip_extension (const gchar *name)
+{
+	gchar *basename, *dot;
+
+	basename = g_path_get_basename (name);
+	dot = strrchr (basename, '.');
+	if (dot != NULL && dot != basename)
+		*dot = '\0';
+
+	return basename;
+}
+
+/**
+ * The names of the cue sheets in @directory.  A directory that can
+ * not be listed has none.
+ */
+static GHashTable *
+list_sheets (GFile        *directory,
+	     GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo       *info;
+	GHashTable      *names;
+
+	names = g_hash_table_new_full (g_str_hash, g_str_equal,
+				       g_free, NULL);
+
+	enumerator = g_file_enumerate_children (directory,
+						G_FILE_ATTRIBUTE_STANDARD_NAME,
+						G_FILE_QUERY_INFO_NONE,
+						cancellable, NULL);
+	if (enumerator == NULL)
+		return names;
+
+	while ((info = g_file_enumerator_next_file (enumerator, cancellable,
+						    NULL)) != NULL) {
+		const gchar *name = g_file_info_get_name (info);
+
+		if (g_str_has_suffix (name, ".cue"))
+			g_hash_table_add (names, g_strdup (name));
+		g_object_unref (info);
+	}
+
+	g_object_unref (enumerator);
+
+	return names;
+}
+
+typedef struct {
+	NscCueCache *cache;
+	GFile       *directory;
+	gchar       *stem;
+	gchar       *candidates[3];
+
+	/* The sheets in the directory, or NULL until it was listed */
+	GHashTable  *names;
+	gboolean     listed;
+
+	NscCueSheet *sheet;
+} FindData;
+
+static void
+find_data_free (FindData *data)
+{
+	g_object_unref (data->directory);
+	g_free (data->stem);
+	g_free (data->candidates[0]);
+	g_free (data->candidates[1]);
+	if (data->names != NULL)
+		g_hash_table_unref (data->names);
+	nsc_cue_sheet_free (data->sheet);
+	g_free (data);
+}
+
+/**
+ * Whether the directory holds a sheet that could be for the image.
+ */
+static gboolean
+has_candidate (FindData *data)
+{
+	gint i;
+
+	for (i = 0; data->candidates[i] != NULL; i++)
+		if (g_hash_table_contains (data->names, data->candidates[i]))
+			return TRUE;
+
+	return FALSE;
+}
+
+static void
+find_thread (GSimpleAsyncResult *simple,
+	     GObject            *object,
+	     GCancellable       *cancellable)
+{
+	FindData *data = g_simple_async_result_get_op_res_gpointer (simple);
+	gint      i;
+
+	if (data->names == NULL) {
+		data->names = list_sheets (data->directory, cancellable);
+		data->listed = TRUE;
+	}
+
+	for (i = 0; data->sheet == NULL && data->candidates[i] != NULL; i++) {
+		NscCueSheet *sheet;
+		GFile       *file;
+		gchar       *file_stem;
+
+		if (!g_hash_table_contains (data->names, data->candidates[i]))
+			continue;
+
+		file = g_file_get_child (data->directory, data->candidates[i]);
+		sheet = nsc_cue_sheet_load (file, NULL);
+		g_object_unref (file);
+
+		if (sheet == NULL)
+			continue;
+
+		file_stem = strip_extension (sheet->file);
+		if (sheet->tracks->len > 1 &&
+		    g_ascii_strcasecmp (file_stem, data->stem) == 0)
+			data->sheet = sheet;
+		else
+			nsc_cue_sheet_free (sheet);
+		g_free (file_stem);
+	}
+}
+
+/*
+ * Public Methods
+ */
+NscCueSheet *
+nsc_cue_sheet_parse (const gchar  *data,
+		     GError      **error)
+{
+	NscCueSheet  *sheet;
+	NscCueTrack  *track = NULL;
+	gchar       **lines;
+	gboolean      audio = FALSE, has_index = TRUE;
+	guint         n_files = 0;
+	gint          i;
+
+	g_return_val_if_fail (data != NULL, NULL);
+
+	/* Skip the byte order mark some editors put in */
+	if (g_str_has_prefix (data, "\xef\xbb\xbf"))
+		data += 3;
+
+	sheet = g_new0 (NscCueSheet, 1);
+	sheet->tracks = g_ptr_array_new_with_free_func ((GDestroyNotify) track_free);
+
+	lines = g_strsplit (data, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		const gchar *line = lines[i];
+		gchar       *command, *arg;
+
+		command = next_token (&line);
+		if (command == NULL)
+			continue;
+		arg = next_token (&line);
+
+		if (strcmp (command, "FILE") == 0) {
+			n_files++;
+			g_free (sheet->file);
+			sheet->file = g_strdup (arg);
+		} else if (strcmp (command, "TRACK") == 0) {
+			gchar *type = next_token (&line);
+
+			if (track != NULL && audio && !has_index)
+				break;
+
+			/* Data tracks of enhanced CDs are not in the image */
+			audio = g_strcmp0 (type, "AUDIO") == 0;
+			has_index = FALSE;
+			track = NULL;
+			if (audio) {
+				track = g_new0 (NscCueTrack, 1);
+				track->number = arg ? atoi (arg) : 0;
+				g_ptr_array_add (sheet->tracks, track);
+			}
+			g_free (type);
+		} else if (track == NULL && sheet->tracks->len > 0) {
+			/* Whatever describes a data track */
+		} else if (strcmp (command, "TITLE") == 0) {
+			gchar **title = track ? &track->title : &sheet->title;
+
+			g_free (*title);
+			*title = g_strdup (arg);
+		} else if (strcmp (command, "PERFORMER") == 0) {
+			gchar **performer = track ? &track->performer
+						  : &sheet->performer;
+
+			g_free (*performer);
+			*performer = g_strdup (arg);
+		} else if (strcmp (command, "INDEX") == 0 && track != NULL) {
+			gchar *time = next_token (&line);
+
+			/* The pregap of INDEX 00 stays with the track before */
+			if (g_strcmp0 (arg, "01") == 0 &&
+			    parse_time (time, &track->start))
+				has_index = TRUE;
+			g_free (time);
+		}
+
+		g_free (arg);
+		g_free (command);
+	}
+	g_strfreev (lines);
+
+	if (track != NULL && !has_index) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("Track %u of the cue sheet has no start"),
+			     track->number);
+		nsc_cue_sheet_free (sheet);
+		return NULL;
+	}
+
+	if (n_files != 1 || sheet->tracks->len == 0) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("The cue sheet is not for a single image"));
+		nsc_cue_sheet_free (sheet);
+		return NULL;
+	}
+
+	for (i = 1; i < (gint) sheet->tracks->len; i++) {
+		NscCueTrack *prev = g_ptr_array_index (sheet->tracks, i - 1);
+		NscCueTrack *next = g_ptr_array_index (sheet->tracks, i);
+
+		if (next->start <= prev->start) {
+			g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("The tracks of the cue sheet are out of order"));
+			nsc_cue_sheet_free (sheet);
+			return NULL;
+		}
+	}
+
+	return sheet;
+}
+
+NscCueSheet *
+nsc_cue_sheet_load (GFile   *file,
+		    GError **error)
+{
+	NscCueSheet *sheet;
+	gchar       *contents, *converted;
+	gsize        length;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+	if (!g_file_load_contents (file, NULL, &contents, &length, NULL,
+				   error))
+		return NULL;
+
+	if (!g_utf8_validate (contents, length, NULL)) {
+		converted = g_convert (contents, length, "UTF-8",
+				       FALLBACK_CHARSET, NULL, NULL, NULL);
+		if (converted != NULL) {
+			g_free (contents);
+			contents = converted;
+		}
+	}
+
+	/* Sheets from Windows end their lines with \r\n */
+	g_strdelimit (contents, "\r", ' ');
+
+	sheet = nsc_cue_sheet_parse (contents, error);
+	g_free (contents);
+
+	return sheet;
+}
+
+/**
+ * Whether @image is of a kind rippers write a whole album into.
+ * Only those are worth looking for a cue sheet for.
+ */
+gboolean
+nsc_cue_is_image (GFile *image)
+{
+	static const gchar *extensions[] = {
+		".flac", ".wav", ".ape", ".wv", NULL
+	};
+	gchar              *basename, *lower;
+	gboolean            found = FALSE;
+	gint                i;
+
+	g_return_val_if_fail (G_IS_FILE (image), FALSE);
+
+	basename = g_file_get_basename (image);
+	if (basename == NULL)
+		return FALSE;
+
+	lower = g_ascii_strdown (basename, -1);
+	for (i = 0; !found && extensions[i] != NULL; i++)
+		found = g_str_has_suffix (lower, extensions[i]);
+
+	g_free (lower);
+	g_free (basename);
+
+	return found;
+}
+
+/**
+ * Remembers which cue sheets each directory holds, so the images
+ * of a directory only list it once.
+ */
+NscCueCache *
+nsc_cue_cache_new (void)
+{
+	NscCueCache *cache;
+
+	cache = g_new0 (NscCueCache, 1);
+	cache->directories = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free,
+						    (GDestroyNotify) g_hash_table_unref);
+
+	return cache;
+}
+
+void
+nsc_cue_cache_free (NscCueCache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	g_hash_table_destroy (cache->directories);
+	g_free (cache);
+}
+
+/**
+ * Look for the cue sheet next to @image that splits it into more
+ * than one track, named either album.cue or album.flac.cue for
+ * album.flac.  The sheet may name the image with another extension,
+ * as rippers write it for the WAV file that was compressed later.
+ *
+ * The directory is listed and the sheet read in a thread.  @cache
+ * has to be kept until @callback got the sheet with
+ * nsc_cue_sheet_find_finish().
+ */
+void
+nsc_cue_sheet_find_async (GFile               *image,
+			  NscCueCache         *cache,
+			  GCancellable        *cancellable,
+			  GAsyncReadyCallback  callback,
+			  gpointer             user_data)
+{
+	GSimpleAsyncResult *simple;
+	FindData           *data;
+	GFile              *directory;
+	gchar              *basename, *uri;
+
+	g_return_if_fail (G_IS_FILE (image));
+	g_return_if_fail (cache != NULL);
+
+	simple = g_simple_async_result_new (NULL, callback, user_data,
+					    nsc_cue_sheet_find_async);
+	g_simple_async_result_set_check_cancellable (simple, cancellable);
+
+	directory = g_file_get_parent (image);
+	if (directory == NULL) {
+		g_simple_async_result_complete_in_idle (simple);
+		g_object_unref (simple);
+		return;
+	}
+
+	basename = g_file_get_basename (image);
+
+	data = g_new0 (FindData, 1);
+	data->cache = cache;
+	data->directory = directory;
+	data->stem = strip_extension (basename);
+	data->candidates[0] = g_strconcat (data->stem, ".cue", NULL);
+	data->candidates[1] = g_strconcat (basename, ".cue", NULL);
+	g_free (basename);
+
+	uri = g_file_get_uri (directory);
+	data->names = g_hash_table_lookup (cache->directories, uri);
+	g_free (uri);
+	if (data->names != NULL)
+		g_hash_table_ref (data->names);
+
+	g_simple_async_result_set_op_res_gpointer (simple, data,
+						   (GDestroyNotify) find_data_free);
+
+	/* Most images of a directory that was listed have no sheet */
+	if (data->names != NULL && !has_candidate (data))
+		g_simple_async_result_complete_in_idle (simple);
+	else
+		g_simple_async_result_run_in_thread (simple, find_thread,
+						     G_PRIORITY_DEFAULT,
+						     cancellable);
+	g_object_unref (simple);
+}
+
+/**
+ * Returns the sheet found, to be freed with nsc_cue_sheet_free(),
+ * or NULL if there is none.  @error is only set when the lookup
+ * was cancelled.
+ */
+NscCueSheet *
+nsc_cue_sheet_find_finish (GAsyncResult  *result,
+			   GError       **error)
+{
+	GSimpleAsyncResult *simple;
+	FindData           *data;
+	NscCueSheet        *sheet;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+							      nsc_cue_sheet_find_async),
+			      NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	data = g_simple_async_result_get_op_res_gpointer (simple);
+	if (data == NULL)
+		return NULL;
+
+	if (data->listed)
+		g_hash_table_replace (data->cache->directories,
+				      g_file_get_uri (data->directory),
+				      g_hash_table_ref (data->names));
+	data->listed = FALSE;
+
+	sheet = data->sheet;
+	data->sheet = NULL;
+
+	return sheet;
+}
+
+void
+nsc_cue_sheet_free (NscCueSheet *sheet)
+{
+	if (sheet == NULL)
+		return;
+
+	g_free (sheet->title);
+	g_free (sheet->performer);
+	g_free (sheet->file);
+	g_ptr_array_free (sheet->tracks, TRUE);
+	g_free (sheet);
+}
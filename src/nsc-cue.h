@@ -0,0 +1,84 @@
+/*
+ *  nsc-cue.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_CUE_H
+#define NSC_CUE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A cue sheet describing the tracks of a whole-album image, as CD
+ * rippers write them next to a single FLAC or WAV file.  Only sheets
+ * for a single file are supported.
+ */
+
+/* CD frames per second, which is what cue sheet times count */
+#define NSC_CUE_FRAMES_PER_SECOND 75
+
+typedef struct {
+	guint    number;
+	gchar   *title;
+	gchar   *performer;
+
+	/* Where INDEX 01 is, in CD frames */
+	guint64  start;
+} NscCueTrack;
+
+typedef struct {
+	gchar     *title;
+	gchar     *performer;
+
+	/* The image, as the sheet names it */
+	gchar     *file;
+
+	/* The audio tracks, in order */
+	GPtrArray *tracks;
+} NscCueSheet;
+
+typedef struct _NscCueCache NscCueCache;
+
+NscCueSheet *nsc_cue_sheet_parse (const gchar  *data,
+				  GError      **error);
+NscCueSheet *nsc_cue_sheet_load  (GFile        *file,
+				  GError      **error);
+void         nsc_cue_sheet_free  (NscCueSheet  *sheet);
+
+gboolean     nsc_cue_is_image    (GFile        *image);
+
+NscCueCache *nsc_cue_cache_new   (void);
+void         nsc_cue_cache_free  (NscCueCache  *cache);
+
+void         nsc_cue_sheet_find_async  (GFile               *image,
+					NscCueCache         *cache,
+					GCancellable        *cancellable,
+					GAsyncReadyCallback  callback,
+					gpointer             user_data);
+NscCueSheet *nsc_cue_sheet_find_finish (GAsyncResult        *result,
+					GError             **error);
+
+G_END_DECLS
+
+#endif /* NSC_CUE_H */
@@ -0,0 +1,91 @@
+/*
+ *  nsc-dbus.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#ifndef NSC_DBUS_H
+#define NSC_DBUS_H
+
+/*
+ * The session bus interface of the conversion service.  Every job
+ * is identified by the number returned from Submit, and all of the
+ * signals carry it so clients can pick out their own jobs.
+ */
+
+#define NSC_DBUS_NAME      "org.gnome.NautilusSoundConverter"
+#define NSC_DBUS_PATH      "/org/gnome/NautilusSoundConverter"
+#define NSC_DBUS_INTERFACE "org.gnome.NautilusSoundConverter"
+
+#define NSC_DBUS_INTROSPECTION						\
+	"<node>"							\
+	"  <interface name='" NSC_DBUS_INTERFACE "'>"			\
+	"    <method name='Submit'>"					\
+	"      <arg type='as' name='uris' direction='in'/>"		\
+	"      <arg type='s' name='profile' direction='in'/>"		\
+	"      <arg type='s' name='output_uri' direction='in'/>"	\
+	"      <arg type='b' name='retry' direction='in'/>"		\
+	"      <arg type='u' name='job' direction='out'/>"		\
+	"    </method>"							\
+	"    <method name='Cancel'>"					\
+	"      <arg type='u' name='job' direction='in'/>"		\
+	"    </method>"							\
+	"    <method name='Pause'>"					\
+	"      <arg type='u' name='job' direction='in'/>"		\
+	"    </method>"							\
+	"    <method name='Resume'>"					\
+	"      <arg type='u' name='job' direction='in'/>"		\
+	"    </method>"							\
+	"    <signal name='FileStarted'>"				\
+	"      <arg type='u' name='job'/>"				\
+	"      <arg type='u' name='index'/>"				\
+	"    </signal>"							\
+	"    <signal name='Duration'>"					\
+	"      <arg type='u' name='job'/>"				\
+	"      <arg type='i' name='seconds'/>"				\
+	"    </signal>"							\
+	"    <signal name='Progress'>"					\
+	"      <arg type='u' name='job'/>"				\
+	"      <arg type='i' name='seconds'/>"				\
+	"    </signal>"							\
+	"    <signal name='FileCompleted'>"				\
+	"      <arg type='u' name='job'/>"				\
+	"      <arg type='u' name='index'/>"				\
+	"    </signal>"							\
+	"    <signal name='FileFailed'>"				\
+	"      <arg type='u' name='job'/>"				\
+	"      <arg type='u' name='index'/>"				\
+	"      <arg type='s' name='message'/>"				\
+	"    </signal>"							\
+	"    <signal name='Retrying'>"					\
+	"      <arg type='u' name='job'/>"				\
+	"      <arg type='u' name='files'/>"				\
+	"    </signal>"							\
+	"    <signal name='Paused'>"					\
+	"      <arg type='u' name='job'/>"				\
+	"      <arg type='b' name='paused'/>"				\
+	"    </signal>"							\
+	"    <signal name='Finished'>"					\
+	"      <arg type='u' name='job'/>"				\
+	"    </signal>"							\
+	"  </interface>"						\
+	"</node>"
+
+#endif /* NSC_DBUS_H */
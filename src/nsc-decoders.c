@@ -0,0 +1,685 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-decoders.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include "nsc-decoders.h"
+#include "nsc-error.h"
+
+/* What gets calibrated, with the encoders that can make test audio */
+typedef struct {
+	const gchar *name;
+	const gchar *caps;
+	const gchar *encoders[3];
+} Format;
+
+static const Format formats[] = {
+	{ "mp3", "audio/mpeg, mpegversion=(int)1, layer=(int)3",
+	  { "lamemp3enc", "lame", NULL } },
+	{ "aac", "audio/mpeg, mpegversion=(int)4",
+	  { "faac", NULL } },
+	{ "vorbis", "audio/x-vorbis",
+	  { "vorbisenc ! oggmux", NULL } },
+	{ "flac", "audio/x-flac",
+	  { "flacenc", NULL } },
+	{ "wavpack", "audio/x-wavpack",
+	  { "wavpackenc", NULL } },
+	{ "wma", "audio/x-wma",
+	  { "ffenc_wmav2 ! asfmux", NULL } },
+};
+
+#define CONFIG_NAME     "decoders.conf"
+#define OVERRIDES_GROUP "Overrides"
+
+/* Ten seconds of CD audio */
+#define TEST_RATE       44100
+#define TEST_BUFFERS    100
+#define TEST_SAMPLES    (TEST_RATE / 10)
+#define TEST_SECONDS    ((gdouble) TEST_BUFFERS * TEST_SAMPLES / TEST_RATE)
+
+/* Lossy codecs pad the audio a little */
+#define FRAME_TOLERANCE 0.05
+
+/* Every decoder is timed this many times, and the best one counts */
+#define N_RUNS          3
+
+/* A decoder that takes longer than this is as good as stuck */
+#define RUN_TIMEOUT     (60 * GST_SECOND)
+
+/* Ranks above anything a plugin gives itself */
+#define PIN_RANK        (GST_RANK_PRIMARY + 512)
+#define CALIBRATE_RANK  (GST_RANK_PRIMARY + 1024)
+
+/* Audio frames that came out of a test decode */
+typedef struct {
+	guint64 bytes;
+	gint    frame_size;
+} Count;
+
+/*
+ * Private Methods
+ */
+static gchar *
+get_config_file (void)
+{
+	return g_build_filename (g_get_user_config_dir (),
+				 "nautilus-sound-converter", CONFIG_NAME,
+				 NULL);
+}
+
+/**
+ * The names of the installed decoders that take @caps.
+ */
+static GPtrArray *
+list_decoders (const gchar *caps)
+{
+	GPtrArray *names;
+	GstCaps   *sink_caps;
+	GList     *features, *l;
+
+	names = g_ptr_array_new_with_free_func (g_free);
+	sink_caps = gst_caps_from_string (caps);
+
+	features = gst_registry_get_feature_list (gst_registry_get_default (),
+						  GST_TYPE_ELEMENT_FACTORY);
+	for (l = features; l != NULL; l = l->next) {
+		GstElementFactory *factory = l->data;
+		const gchar       *klass;
+
+		klass = gst_element_factory_get_klass (factory);
+		if (strstr (klass, "Decoder") == NULL ||
+		    strstr (klass, "Audio") == NULL)
+			continue;
+
+		if (gst_element_factory_can_sink_caps (factory, sink_caps))
+			g_ptr_array_add (names,
+					 g_strdup (GST_PLUGIN_FEATURE_NAME (factory)));
+	}
+	gst_plugin_feature_list_free (features);
+	gst_caps_unref (sink_caps);
+
+	return names;
+}
+
+static GstPluginFeature *
+find_feature (const gchar *name)
+{
+	return gst_registry_find_feature (gst_registry_get_default (), name,
+					  GST_TYPE_ELEMENT_FACTORY);
+}
+
+static void
+set_rank (const gchar *name,
+	  guint        rank)
+{
+	GstPluginFeature *feature;
+
+	feature = find_feature (name);
+	if (feature == NULL)
+		return;
+
+	gst_plugin_feature_set_rank (feature, rank);
+	gst_object_unref (feature);
+}
+
+static guint
+get_rank (const gchar *name)
+{
+	GstPluginFeature *feature;
+	guint             rank;
+
+	feature = find_feature (name);
+	if (feature == NULL)
+		return GST_RANK_NONE;
+
+	rank = gst_plugin_feature_get_rank (feature);
+	gst_object_unref (feature);
+
+	return rank;
+}
+
+/**
+ * Run @pipeline until it is done, which is fine outside the main
+ * loop since nothing else is going on while calibrating.
+ */
+static gboolean
+run_pipeline (GstElement  *pipeline,
+	      GError     **error)
+{
+	GstMessage *message;
+	GstBus     *bus;
+	gboolean    result = FALSE;
+
+	gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+	bus = gst_element_get_bus (pipeline);
+	message = gst_bus_timed_pop_filtered (bus, RUN_TIMEOUT,
+					      GST_MESSAGE_EOS |
+					      GST_MESSAGE_ERROR);
+	gst_object_unref (bus);
+
+	if (message == NULL) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("The test pipeline did not finish"));
+	} else if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ERROR) {
+		gst_message_parse_error (message, error, NULL);
+	} else {
+		result = TRUE;
+	}
+
+	if (message != NULL)
+		gst_message_unref (message);
+
+	gst_element_set_state (pipeline, GST_STATE_NULL);
+
+	return result;
+}
+
+static GstElement *
+parse_pipeline (const gchar  *description,
+		GError      **error)
+{
+	GstElement *pipeline;
+	GError     *err = NULL;
+
+	pipeline = gst_parse_launch (description, &err);
+
+	/* A missing element still gives a pipeline, just not one we want */
+	if (err != NULL) {
+		if (pipeline != NULL)
+			gst_object_unref (pipeline);
+		g_propagate_error (error, err);
+		return NULL;
+	}
+
+	return pipeline;
+}
+
+/**
+ * Encode test audio in @format to @path with the first of its
+ * encoders that is installed.
+ */
+static gboolean
+generate (const Format  *format,
+	  const gchar   *path,
+	  GError       **error)
+{
+	GstElement *pipeline = NULL;
+	gchar      *description;
+	gboolean    result;
+	gint        i;
+
+	for (i = 0; pipeline == NULL && format->encoders[i] != NULL; i++) {
+		g_clear_error (error);
+
+		description = g_strdup_printf ("audiotestsrc wave=white-noise "
+					       "volume=0.5 num-buffers=%d "
+					       "samplesperbuffer=%d ! "
+					       "audio/x-raw-int, rate=(int)%d, "
+					       "channels=(int)2 ! audioconvert ! "
+					       "%s ! filesink location=\"%s\"",
+					       TEST_BUFFERS, TEST_SAMPLES,
+					       TEST_RATE, format->encoders[i],
+					       path);
+		pipeline = parse_pipeline (description, error);
+		g_free (description);
+	}
+
+	if (pipeline == NULL)
+		return FALSE;
+
+	result = run_pipeline (pipeline, error);
+	gst_object_unref (pipeline);
+
+	return result;
+}
+
+static gboolean
+count_probe_cb (GstPad    *pad,
+		GstBuffer *buffer,
+		gpointer   data)
+{
+	Count        *count = data;
+	GstStructure *structure;
+	gint          channels, width;
+
+	if (count->frame_size == 0 && GST_BUFFER_CAPS (buffer) != NULL) {
+		structure = gst_caps_get_structure (GST_BUFFER_CAPS (buffer), 0);
+		if (gst_structure_get_int (structure, "channels", &channels) &&
+		    gst_structure_get_int (structure, "width", &width))
+			count->frame_size = channels * width / 8;
+	}
+
+	count->bytes += GST_BUFFER_SIZE (buffer);
+
+	return TRUE;
+}
+
+/**
+ * Whether an element made by @decoder ended up in @bin.
+ */
+static gboolean
+was_used (GstElement  *bin,
+	  const gchar *decoder)
+{
+	GstIterator *iter;
+	gpointer     item;
+	gboolean     used = FALSE, done = FALSE;
+
+	iter = gst_bin_iterate_recurse (GST_BIN (bin));
+	while (!done) {
+		switch (gst_iterator_next (iter, &item)) {
+		case GST_ITERATOR_OK: {
+			GstElementFactory *factory;
+
+			factory = gst_element_get_factory (item);
+			if (factory != NULL &&
+			    strcmp (GST_PLUGIN_FEATURE_NAME (factory),
+				    decoder) == 0)
+				used = TRUE;
+			gst_object_unref (item);
+			break;
+		}
+		case GST_ITERATOR_RESYNC:
+			used = FALSE;
+			gst_iterator_resync (iter);
+			break;
+		default:
+			done = TRUE;
+		}
+	}
+	gst_iterator_free (iter);
+
+	return used;
+}
+
+/**
+ * Decode @path, which only @decoder is allowed to do, and return
+ * how long it took in microseconds, or -1 if it went wrong.
+ */
+static gint64
+time_decoder (const gchar *path,
+	      const gchar *decoder,
+	      guint64     *frames)
+{
+	GstElement *pipeline, *sink;
+	GstPad     *pad;
+	Count       count = { 0, 0 };
+	gchar      *description;
+	gint64      start, elapsed = -1;
+	gboolean    result;
+
+	description = g_strdup_printf ("filesrc location=\"%s\" ! decodebin2 ! "
+				       "fakesink name=sink sync=false",
+				       path);
+	pipeline = parse_pipeline (description, NULL);
+	g_free (description);
+
+	if (pipeline == NULL)
+		return -1;
+
+	sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+	pad = gst_element_get_static_pad (sink, "sink");
+	gst_pad_add_buffer_probe (pad, G_CALLBACK (count_probe_cb), &count);
+	gst_object_unref (pad);
+	gst_object_unref (sink);
+
+	start = g_get_monotonic_time ();
+	result = run_pipeline (pipeline, NULL);
+	if (result && was_used (pipeline, decoder))
+		elapsed = g_get_monotonic_time () - start;
+	gst_object_unref (pipeline);
+
+	*frames = count.frame_size > 0 ? count.bytes / count.frame_size : 0;
+
+	return elapsed;
+}
+
+/**
+ * Time every decoder of @format on @path, leaving the others out
+ * while each of them is timed.
+ */
+static void
+calibrate_format (const Format *format,
+		  const gchar  *path,
+		  GPtrArray    *decoders,
+		  GPtrArray    *results)
+{
+	guint   *ranks;
+	guint    i, j, run;
+
+	ranks = g_new (guint, decoders->len);
+	for (i = 0; i < decoders->len; i++)
+		ranks[i] = get_rank (g_ptr_array_index (decoders, i));
+
+	for (i = 0; i < decoders->len; i++) {
+		const gchar      *decoder = g_ptr_array_index (decoders, i);
+		NscDecoderTiming *timing;
+		gint64            best = -1;
+		guint64           frames = 0, expected;
+
+		for (j = 0; j < decoders->len; j++)
+			set_rank (g_ptr_array_index (decoders, j),
+				  i == j ? CALIBRATE_RANK : GST_RANK_NONE);
+
+		for (run = 0; run < N_RUNS; run++) {
+			gint64 elapsed;
+
+			elapsed = time_decoder (path, decoder, &frames);
+			if (elapsed < 0) {
+				best = -1;
+				break;
+			}
+			if (best < 0 || elapsed < best)
+				best = elapsed;
+		}
+
+		expected = (guint64) TEST_BUFFERS * TEST_SAMPLES;
+
+		timing = g_new0 (NscDecoderTiming, 1);
+		timing->format = g_strdup (format->name);
+		timing->decoder = g_strdup (decoder);
+		timing->correct = best > 0 &&
+			ABS ((gdouble) frames - expected) <= expected * FRAME_TOLERANCE;
+		timing->speed = best > 0
+			? TEST_SECONDS / ((gdouble) best / G_USEC_PER_SEC) : 0;
+		g_ptr_array_add (results, timing);
+	}
+
+	for (i = 0; i < decoders->len; i++)
+		set_rank (g_ptr_array_index (decoders, i), ranks[i]);
+	g_free (ranks);
+}
+
+static gint
+compare_speed (gconstpointer a,
+	       gconstpointer b)
+{
+	const NscDecoderTiming *ta = *(NscDecoderTiming **) a;
+	const NscDecoderTiming *tb = *(NscDecoderTiming **) b;
+
+	if (ta->speed == tb->speed)
+		return 0;
+
+	return ta->speed > tb->speed ? -1 : 1;
+}
+
+/**
+ * Put the results of @format into its group of @config, fastest
+ * decoder first, leaving out the ones that did not decode correctly.
+ */
+static void
+save_format (GKeyFile     *config,
+	     const Format *format,
+	     GPtrArray    *results)
+{
+	GPtrArray *sorted;
+	GPtrArray *ranking, *failed;
+	guint      i;
+
+	sorted = g_ptr_array_new ();
+	for (i = 0; i < results->len; i++) {
+		NscDecoderTiming *timing = g_ptr_array_index (results, i);
+
+		if (strcmp (timing->format, format->name) == 0)
+			g_ptr_array_add (sorted, timing);
+	}
+	g_ptr_array_sort (sorted, compare_speed);
+
+	ranking = g_ptr_array_new ();
+	failed = g_ptr_array_new ();
+	for (i = 0; i < sorted->len; i++) {
+		NscDecoderTiming *timing = g_ptr_array_index (sorted, i);
+
+		g_ptr_array_add (timing->correct ? ranking : failed,
+				 timing->decoder);
+	}
+
+	g_key_file_set_string (config, format->name, "caps", format->caps);
+	g_key_file_set_string_list (config, format->name, "ranking",
+				    (const gchar * const *) ranking->pdata,
+				    ranking->len);
+	g_key_file_set_string_list (config, format->name, "failed",
+				    (const gchar * const *) failed->pdata,
+				    failed->len);
+
+	g_ptr_array_free (ranking, TRUE);
+	g_ptr_array_free (failed, TRUE);
+	g_ptr_array_free (sorted, TRUE);
+}
+
+/**
+ * The saved configuration without the old results, keeping what
+ * the user put into the overrides.
+ */
+static GKeyFile *
+load_overrides (const gchar *filename)
+{
+	GKeyFile  *config;
+	gchar    **groups;
+	gint       i;
+
+	config = g_key_file_new ();
+	g_key_file_load_from_file (config, filename,
+				   G_KEY_FILE_KEEP_COMMENTS, NULL);
+
+	groups = g_key_file_get_groups (config, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		if (strcmp (groups[i], OVERRIDES_GROUP) != 0)
+			g_key_file_remove_group (config, groups[i], NULL);
+	}
+	g_strfreev (groups);
+
+	if (!g_key_file_has_group (config, OVERRIDES_GROUP)) {
+		g_key_file_set_string (config, OVERRIDES_GROUP, "pin", "");
+		g_key_file_set_string (config, OVERRIDES_GROUP, "exclude", "");
+		g_key_file_set_comment (config, OVERRIDES_GROUP, NULL,
+					" Decoders in pin are always tried first, "
+					"and the ones in exclude never.\n"
+					" Both are lists separated by ';'.",
+					NULL);
+	}
+
+	return config;
+}
+
+static gboolean
+save_config (GKeyFile     *config,
+	     const gchar  *filename,
+	     GError      **error)
+{
+	gchar    *data, *dirname;
+	gsize     length;
+	gboolean  result;
+
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0755);
+	g_free (dirname);
+
+	data = g_key_file_to_data (config, &length, NULL);
+	result = g_file_set_contents (filename, data, length, error);
+	g_free (data);
+
+	return result;
+}
+
+/*
+ * Public Methods
+ */
+void
+nsc_decoder_timing_free (NscDecoderTiming *timing)
+{
+	if (timing == NULL)
+		return;
+
+	g_free (timing->format);
+	g_free (timing->decoder);
+	g_free (timing);
+}
+
+/**
+ * Whether any installed decoder takes @caps.
+ */
+gboolean
+nsc_decoders_has_decoder (const gchar *caps)
+{
+	GPtrArray *decoders;
+	gboolean   result;
+
+	g_return_val_if_fail (caps != NULL, FALSE);
+
+	decoders = list_decoders (caps);
+	result = decoders->len > 0;
+	g_ptr_array_free (decoders, TRUE);
+
+	return result;
+}
+
+/**
+ * Time every installed decoder of every format there is an encoder
+ * for, and save which are fastest.  Takes a few seconds per decoder,
+ * and blocks until it is done.  Returns how each decoder did.
+ */
+GPtrArray *
+nsc_decoders_calibrate (GError **error)
+{
+	GPtrArray *results;
+	GKeyFile  *config;
+	gchar     *dir, *filename;
+	guint      i;
+
+	dir = g_dir_make_tmp ("nsc-calibrate-XXXXXX", error);
+	if (dir == NULL)
+		return NULL;
+
+	filename = get_config_file ();
+	config = load_overrides (filename);
+	results = g_ptr_array_new_with_free_func ((GDestroyNotify) nsc_decoder_timing_free);
+
+	for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+		GPtrArray *decoders;
+		GError    *err = NULL;
+		gchar     *path;
+
+		decoders = list_decoders (formats[i].caps);
+		path = g_build_filename (dir, formats[i].name, NULL);
+
+		if (decoders->len == 0) {
+			g_debug ("No decoders for %s", formats[i].name);
+		} else if (!generate (&formats[i], path, &err)) {
+			g_debug ("No test audio for %s; %s", formats[i].name,
+				 err ? err->message : "no encoder");
+			g_clear_error (&err);
+		} else {
+			calibrate_format (&formats[i], path, decoders, results);
+			save_format (config, &formats[i], results);
+		}
+
+		g_unlink (path);
+		g_free (path);
+		g_ptr_array_free (decoders, TRUE);
+	}
+
+	g_rmdir (dir);
+	g_free (dir);
+
+	if (!save_config (config, filename, error)) {
+		g_ptr_array_free (results, TRUE);
+		results = NULL;
+	}
+
+	g_key_file_free (config);
+	g_free (filename);
+
+	return results;
+}
+
+/**
+ * Rank the decoders the way calibrating and the overrides say.
+ * Only the first call does anything, and it costs no more than
+ * reading a small file when there is nothing to apply.
+ */
+void
+nsc_decoders_apply (void)
+{
+	static gboolean   applied = FALSE;
+	GKeyFile         *config;
+	gchar            *filename;
+	gchar           **groups, **names;
+	gsize             n_names;
+	gint              i, j;
+
+	if (applied)
+		return;
+	applied = TRUE;
+
+	filename = get_config_file ();
+	config = g_key_file_new ();
+	if (!g_key_file_load_from_file (config, filename, G_KEY_FILE_NONE,
+					NULL)) {
+		g_key_file_free (config);
+		g_free (filename);
+		return;
+	}
+	g_free (filename);
+
+	groups = g_key_file_get_groups (config, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		if (strcmp (groups[i], OVERRIDES_GROUP) == 0)
+			continue;
+
+		/* Faster decoders get higher ranks, all above the usual */
+		names = g_key_file_get_string_list (config, groups[i],
+						    "ranking", &n_names, NULL);
+		for (j = 0; names != NULL && names[j] != NULL; j++)
+			set_rank (names[j], GST_RANK_PRIMARY + n_names - j);
+		g_strfreev (names);
+	}
+	g_strfreev (groups);
+
+	names = g_key_file_get_string_list (config, OVERRIDES_GROUP, "pin",
+					    &n_names, NULL);
+	for (j = 0; names != NULL && names[j] != NULL; j++) {
+		if (*names[j] != '\0')
+			set_rank (names[j], PIN_RANK + n_names - j);
+	}
+	g_strfreev (names);
+
+	names = g_key_file_get_string_list (config, OVERRIDES_GROUP,
+					    "exclude", NULL, NULL);
+	for (j = 0; names != NULL && names[j] != NULL; j++) {
+		if (*names[j] != '\0')
+			set_rank (names[j], GST_RANK_NONE);
+	}
+	g_strfreev (names);
+
+	g_key_file_free (config);
+}
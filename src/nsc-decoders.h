@@ -0,0 +1,66 @@
+/*
+ *  nsc-decoders.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_DECODERS_H
+#define NSC_DECODERS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The decoders GStreamer plugs in are picked by their static rank,
+ * which says nothing about how fast they are here.  Calibrating
+ * times every installed decoder of each format on generated audio
+ * and saves the results.  Applying them raises the rank of the
+ * fastest decoders, so both decodebins try them first.
+ *
+ * The results are kept in decoders.conf in the user's configuration
+ * directory, where the [Overrides] group can pin decoders to the
+ * top or exclude them altogether:
+ *
+ *   [Overrides]
+ *   pin=flump3dec
+ *   exclude=ffdec_mp3;ffdec_aac
+ */
+
+/* How one decoder did on one format */
+typedef struct {
+	gchar    *format;
+	gchar    *decoder;
+	gboolean  correct;
+
+	/* Seconds of audio decoded per second */
+	gdouble   speed;
+} NscDecoderTiming;
+
+void       nsc_decoder_timing_free  (NscDecoderTiming  *timing);
+
+gboolean   nsc_decoders_has_decoder (const gchar       *caps);
+GPtrArray *nsc_decoders_calibrate   (GError           **error);
+void       nsc_decoders_apply       (void);
+
+G_END_DECLS
+
+#endif /* NSC_DECODERS_H */
@@ -0,0 +1,66 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-engine.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <gmodule.h>
+
+#include "nsc-converter.h"
+#include "nsc-engine.h"
+#include "nsc-init.h"
+
+static void
+engine_convert (GList *files,
+		GList *folders)
+{
+	NscConverter *converter;
+
+	/* In case the background initialization is not done yet */
+	nsc_init_ensure ();
+
+	converter = nsc_converter_new (files, folders);
+
+	nsc_converter_show_dialog (converter);
+}
+
+static const NscEngine engine = {
+	nsc_init_prefetch,
+	nsc_init_get_mime_types,
+	engine_convert,
+};
+
+G_MODULE_EXPORT const NscEngine *
+nsc_engine_get (void)
+{
+	return &engine;
+}
+
+/* The types we register can not be unloaded again */
+G_MODULE_EXPORT const gchar *
+g_module_check_init (GModule *module)
+{
+	g_module_make_resident (module);
+
+	return NULL;
+}
@@ -0,0 +1,74 @@
+/*
+ *  nsc-engine.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_ENGINE_H
+#define NSC_ENGINE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The menu provider is all Nautilus loads at startup.  The dialogs,
+ * GStreamer and the profiles are in a module of their own, which is
+ * only loaded once there is something to convert.  This is what the
+ * module offers the menu provider.
+ */
+typedef struct {
+	/* Start initializing in the background */
+	void                  (*prefetch)       (void);
+
+	/* The formats beyond the built-in ones that can be converted */
+	const gchar * const * (*get_mime_types) (void);
+
+	/*
+	 * Show the dialog for lists of NautilusFileInfo.  The audio
+	 * files are picked out of @files, and @folders are converted
+	 * with every audio file in them.  The lists are taken over.
+	 */
+	void                  (*convert)        (GList *files,
+						 GList *folders);
+} NscEngine;
+
+/*
+ * These are the formats we require, so no check of plugin
+ * support is needed.  Shared by the menu and the engine.
+ */
+#define NSC_ENGINE_REQUIRED_TYPES				\
+	"audio/x-flac",						\
+	"audio/x-vorbis+ogg",					\
+	"audio/ogg",						\
+	"audio/x-wav"
+
+/* The module is installed here, and exports this function */
+#define NSC_ENGINE_MODULE "libnsc-converter"
+#define NSC_ENGINE_SYMBOL "nsc_engine_get"
+
+typedef const NscEngine *(*NscEngineGetFunc) (void);
+
+const NscEngine *nsc_engine_get (void);
+
+G_END_DECLS
+
+#endif /* NSC_ENGINE_H */
@@ -0,0 +1,708 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-estimator.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include "nsc-estimator.h"
+#include "nsc-gstreamer.h"
+#include "nsc-scheduler.h"
+
+/* Signals */
+enum {
+	CHANGED,
+	LAST_SIGNAL,
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* Files a piece is converted of */
+#define SAMPLE_FILES 3
+
+/* The piece converted, past any silence at the start */
+#define SAMPLE_START (30 * GST_SECOND)
+#define SAMPLE_END   (40 * GST_SECOND)
+
+/* Files that can not be cut are converted whole up to this size */
+#define WHOLE_LIMIT (16 * 1024 * 1024)
+
+typedef struct _NscEstimatorPrivate NscEstimatorPrivate;
+
+struct _NscEstimatorPrivate {
+	/* Files added, and the ones we know the size of */
+	guint         n_files;
+	guint         n_sized;
+	guint64       total_bytes;
+
+	/* Files waiting for their size to be read */
+	GQueue       *unsized;
+	gboolean      querying;
+
+	/* A random pick of the sized files */
+	GPtrArray    *samples;
+
+	/* One for each profile, in the order given */
+	GPtrArray    *workers;
+	guint         next_worker;
+
+	/* Profiles with an estimate */
+	guint         n_ready;
+
+	gboolean      started;
+	gboolean      cancelled;
+	GCancellable *cancellable;
+};
+
+typedef struct {
+	GFile   *file;
+	guint64  size;
+} Sample;
+
+/* Converts the samples with one of the profiles */
+typedef struct {
+	NscEstimator   *estimator;
+	GMAudioProfile *profile;
+	NscGStreamer   *gst;
+
+	/* Samples take turns with the batches, behind them */
+	NscSchedulerClient *client;
+
+	/* The sample being converted, and whether all of it is */
+	guint           next;
+	gboolean        whole;
+	gchar          *tmp_name;
+
+	gboolean        running;
+	gboolean        done;
+
+	/* What the samples converted came to */
+	guint           n_done;
+	guint64         src_bytes;
+	guint64         out_bytes;
+	gdouble         src_secs;
+	gdouble         secs;
+	gint64          streaming;
+
+	/*
+	 * Starting a whole file is what every file of the batch costs.
+	 * Samples cut out of a file start when the cut was seeked to,
+	 * and only count when there is no whole one.
+	 */
+	guint           n_whole;
+	gint64          startup;
+	gint64          cut_startup;
+} Worker;
+
+#define NSC_ESTIMATOR_GET_PRIVATE(o)           \
+	((NscEstimatorPrivate *)((NSC_ESTIMATOR(o))->priv))
+
+G_DEFINE_TYPE (NscEstimator, nsc_estimator, G_TYPE_OBJECT)
+
+static void encode_next (Worker *worker);
+static void run_workers (NscEstimator *estimator);
+
+static void
+sample_free (Sample *sample)
+{
+	g_object_unref (sample->file);
+	g_free (sample);
+}
+
+static void
+remove_tmp (Worker *worker)
+{
+	if (worker->tmp_name == NULL)
+		return;
+
+	g_unlink (worker->tmp_name);
+	g_free (worker->tmp_name);
+	worker->tmp_name = NULL;
+}
+
+/**
+ * Stop the worker where it is.  Nothing is reported after this.
+ */
+static void
+worker_stop (Worker *worker)
+{
+	nsc_scheduler_remove_client (worker->client);
+	worker->client = NULL;
+
+	if (worker->gst == NULL)
+		return;
+
+	g_signal_handlers_disconnect_matched (worker->gst,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, worker);
+
+	if (worker->running)
+		nsc_gstreamer_cancel_convert (worker->gst);
+	worker->running = FALSE;
+
+	remove_tmp (worker);
+}
+
+static void
+worker_free (Worker *worker)
+{
+	worker_stop (worker);
+
+	if (worker->gst != NULL)
+		g_object_unref (worker->gst);
+	g_object_unref (worker->profile);
+	g_free (worker);
+}
+
+static void
+nsc_estimator_dispose (GObject *object)
+{
+	NscEstimator        *self = (NscEstimator *) object;
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		if (priv->cancellable) {
+			g_object_unref (priv->cancellable);
+			priv->cancellable = NULL;
+		}
+	}
+
+	G_OBJECT_CLASS (nsc_estimator_parent_class)->dispose (object);
+}
+
+static void
+nsc_estimator_finalize (GObject *object)
+{
+	NscEstimator        *self = (NscEstimator *) object;
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		g_queue_foreach (priv->unsized, (GFunc) g_object_unref, NULL);
+		g_queue_free (priv->unsized);
+
+		g_ptr_array_foreach (priv->samples, (GFunc) sample_free, NULL);
+		g_ptr_array_free (priv->samples, TRUE);
+
+		g_ptr_array_foreach (priv->workers, (GFunc) worker_free, NULL);
+		g_ptr_array_free (priv->workers, TRUE);
+
+		g_free (priv);
+
+		(NSC_ESTIMATOR (self))->priv = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_estimator_parent_class)->finalize (object);
+}
+
+/*
+ * Private Methods
+ */
+
+/**
+ * Keep @file as a sample with the same chance as any other
+ * file sized so far.
+ */
+static void
+pick_sample (NscEstimator *estimator,
+	     GFile        *file,
+	     guint64       size)
+{
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+	Sample              *sample;
+	guint                i;
+
+	if (priv->samples->len < SAMPLE_FILES) {
+		i = priv->samples->len;
+		g_ptr_array_add (priv->samples, NULL);
+	} else {
+		i = g_random_int_range (0, priv->n_sized);
+		if (i >= SAMPLE_FILES)
+			return;
+		sample_free (g_ptr_array_index (priv->samples, i));
+	}
+
+	sample = g_new0 (Sample, 1);
+	sample->file = g_object_ref (file);
+	sample->size = size;
+	g_ptr_array_index (priv->samples, i) = sample;
+}
+
+static void query_next (NscEstimator *estimator);
+
+static void
+query_info_cb (GObject      *source,
+	       GAsyncResult *res,
+	       gpointer      data)
+{
+	NscEstimator        *estimator = data;
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+	GFileInfo           *info;
+	GError              *error = NULL;
+	gboolean             sized = FALSE;
+
+	info = g_file_query_info_finish (G_FILE (source), res, &error);
+
+	if (info == NULL) {
+		/* A file we can not read is left out of the estimate */
+		g_error_free (error);
+	} else {
+		priv->n_sized++;
+		priv->total_bytes += g_file_info_get_size (info);
+		sized = TRUE;
+
+		/* The samples stay put once they are being converted */
+		if (priv->next_worker == 0)
+			pick_sample (estimator, G_FILE (source),
+				     g_file_info_get_size (info));
+		g_object_unref (info);
+	}
+
+	g_object_unref (source);
+
+	if (priv->cancelled) {
+		priv->querying = FALSE;
+		g_object_unref (estimator);
+		return;
+	}
+
+	/* The ready estimates grow with the batch */
+	if (sized && priv->n_ready > 0)
+		g_signal_emit (estimator, signals[CHANGED], 0);
+
+	query_next (estimator);
+	g_object_unref (estimator);
+}
+
+/**
+ * Read the size of the next file, one at a time as only the
+ * conversions are in a hurry.
+ */
+static void
+query_next (NscEstimator *estimator)
+{
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+	GFile               *file;
+
+	file = g_queue_pop_head (priv->unsized);
+	if (file == NULL) {
+		priv->querying = FALSE;
+		if (priv->started)
+			run_workers (estimator);
+		return;
+	}
+
+	priv->querying = TRUE;
+	g_object_ref (estimator);
+
+	g_file_query_info_async (file,
+				 G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_LOW,
+				 priv->cancellable,
+				 query_info_cb,
+				 estimator);
+}
+
+/**
+ * The worker converted all of the samples it could.
+ */
+static void
+worker_done (Worker *worker)
+{
+	NscEstimator        *estimator = worker->estimator;
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+
+	worker->done = TRUE;
+	nsc_scheduler_remove_client (worker->client);
+	worker->client = NULL;
+
+	if (worker->n_done > 0)
+		priv->n_ready++;
+
+	/* Even with no estimate, so that is not waited for */
+	g_signal_emit (estimator, signals[CHANGED], 0);
+}
+
+static void
+sample_failed (Worker *worker)
+{
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (worker->estimator);
+	Sample              *sample;
+
+	remove_tmp (worker);
+	worker->running = FALSE;
+	nsc_scheduler_release (worker->client);
+
+	/* Not every file can be cut, but a short one can be done whole */
+	sample = g_ptr_array_index (priv->samples, worker->next);
+	if (!worker->whole && sample->size <= WHOLE_LIMIT) {
+		worker->whole = TRUE;
+	} else {
+		worker->whole = FALSE;
+		worker->next++;
+	}
+
+	encode_next (worker);
+}
+
+static void
+completion_cb (NscGStreamer *gst,
+	       gpointer      data)
+{
+	Worker              *worker = data;
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (worker->estimator);
+	const NscFileStats  *stats;
+	Sample              *sample;
+
+	stats = nsc_gstreamer_get_stats (gst);
+	sample = g_ptr_array_index (priv->samples, worker->next);
+
+	/* Without a duration there is nothing to scale by */
+	if (stats->duration > 0 && stats->source_duration > 0 &&
+	    stats->startup_time >= 0) {
+		worker->n_done++;
+		worker->src_bytes += sample->size;
+		worker->src_secs += stats->source_duration;
+		worker->out_bytes += stats->bytes_written;
+		worker->secs += stats->duration;
+		if (worker->whole) {
+			worker->n_whole++;
+			worker->startup += stats->startup_time;
+		} else {
+			worker->cut_startup += stats->startup_time;
+		}
+		worker->streaming += MAX (stats->wall_time
+					  - stats->startup_time, 0);
+	}
+
+	remove_tmp (worker);
+	worker->running = FALSE;
+	nsc_scheduler_release (worker->client);
+	worker->whole = FALSE;
+	worker->next++;
+
+	encode_next (worker);
+}
+
+static void
+error_cb (NscGStreamer *gst,
+	  GError       *error,
+	  gpointer      data)
+{
+	sample_failed (data);
+}
+
+/**
+ * Convert the next sample, or finish if that was the last.
+ */
+static void
+encode_next (Worker *worker)
+{
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (worker->estimator);
+	Sample              *sample;
+	GFile               *sink;
+	GError              *error = NULL;
+	gint                 fd;
+
+	if (worker->next >= priv->samples->len) {
+		worker_done (worker);
+		return;
+	}
+
+	/* Wait for a turn, turn_cb comes back here */
+	if (!nsc_scheduler_request (worker->client))
+		return;
+
+	sample = g_ptr_array_index (priv->samples, worker->next);
+
+	fd = g_file_open_tmp ("nsc-estimate-XXXXXX", &worker->tmp_name,
+			      &error);
+	if (fd < 0) {
+		g_warning ("Unable to estimate %s; %s",
+			   gm_audio_profile_get_name (worker->profile),
+			   error->message);
+		g_error_free (error);
+		worker_done (worker);
+		return;
+	}
+	close (fd);
+
+	sink = g_file_new_for_path (worker->tmp_name);
+	worker->running = TRUE;
+
+	if (worker->whole)
+		nsc_gstreamer_convert_file (worker->gst, sample->file, sink,
+					    &error);
+	else
+		nsc_gstreamer_convert_range (worker->gst, sample->file, sink,
+					     SAMPLE_START, SAMPLE_END, &error);
+	g_object_unref (sink);
+
+	if (error != NULL) {
+		g_error_free (error);
+		sample_failed (worker);
+	}
+}
+
+static void
+turn_cb (gpointer data)
+{
+	encode_next (data);
+}
+
+/**
+ * Start every profile.  The samples only convert as the scheduler
+ * hands out turns, so they are held back by the load and the
+ * batches like any other file, and go in the order given.
+ */
+static void
+run_workers (NscEstimator *estimator)
+{
+	NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+	Worker              *worker;
+
+	while (priv->next_worker < priv->workers->len) {
+		worker = g_ptr_array_index (priv->workers, priv->next_worker);
+		priv->next_worker++;
+
+		worker->client = nsc_scheduler_add_client (nsc_scheduler_get_default (),
+							   FALSE, turn_cb,
+							   worker);
+		worker->gst = nsc_gstreamer_new (worker->profile);
+
+		/* The bytes written are only counted when instrumenting */
+		g_object_set (G_OBJECT (worker->gst), "instrument", TRUE, NULL);
+		g_signal_connect (G_OBJECT (worker->gst), "completion",
+				  (GCallback) completion_cb, worker);
+		g_signal_connect (G_OBJECT (worker->gst), "error",
+				  (GCallback) error_cb, worker);
+
+		encode_next (worker);
+	}
+}
+
+static void
+nsc_estimator_class_init (NscEstimatorClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose  = nsc_estimator_dispose;
+	object_class->finalize = nsc_estimator_finalize;
+
+	/* Signals */
+	signals[CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscEstimatorClass, changed),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+static void
+nsc_estimator_init (NscEstimator *self)
+{
+	/* Allocate Private data structure */
+	(NSC_ESTIMATOR (self))->priv = \
+		(NscEstimatorPrivate *) g_malloc0 (sizeof (NscEstimatorPrivate));
+
+	/* If correctly allocated, initialize parameters */
+	if ((NSC_ESTIMATOR (self))->priv != NULL) {
+		NscEstimatorPrivate *priv = NSC_ESTIMATOR_GET_PRIVATE (self);
+
+		priv->unsized = g_queue_new ();
+		priv->samples = g_ptr_array_new ();
+		priv->workers = g_ptr_array_new ();
+		priv->cancellable = g_cancellable_new ();
+	}
+}
+
+/*
+ * Public Methods
+ */
+NscEstimator *
+nsc_estimator_new (void)
+{
+	return g_object_new (NSC_TYPE_ESTIMATOR, NULL);
+}
+
+/**
+ * Count @file in the batch.  The files may keep coming after
+ * the estimator was started, but the samples are only picked
+ * among the ones sized before it converts any.
+ */
+void
+nsc_estimator_add_file (NscEstimator *estimator,
+			GFile        *file)
+{
+	NscEstimatorPrivate *priv;
+
+	g_return_if_fail (NSC_IS_ESTIMATOR (estimator));
+	g_return_if_fail (G_IS_FILE (file));
+
+	priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+	if (priv->cancelled)
+		return;
+
+	priv->n_files++;
+	g_queue_push_tail (priv->unsized, g_object_ref (file));
+
+	if (!priv->querying)
+		query_next (estimator);
+}
+
+/**
+ * Convert the samples with each of @profiles, in that order, as
+ * the default scheduler hands out background turns.  "changed" is
+ * emitted as the estimate of each profile becomes ready, or turns
+ * out there is none.
+ */
+void
+nsc_estimator_start (NscEstimator *estimator,
+		     GList        *profiles)
+{
+	NscEstimatorPrivate *priv;
+	Worker              *worker;
+	GList               *l;
+
+	g_return_if_fail (NSC_IS_ESTIMATOR (estimator));
+
+	priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+	g_return_if_fail (!priv->started);
+
+	priv->started = TRUE;
+
+	for (l = profiles; l != NULL; l = l->next) {
+		worker = g_new0 (Worker, 1);
+		worker->estimator = estimator;
+		worker->profile = g_object_ref (l->data);
+		g_ptr_array_add (priv->workers, worker);
+	}
+
+	/* The samples are picked once every file added has a size */
+	if (!priv->querying)
+		run_workers (estimator);
+}
+
+/**
+ * Stop converting the samples and reading the sizes.  The
+ * estimates that are ready are kept.
+ */
+void
+nsc_estimator_cancel (NscEstimator *estimator)
+{
+	NscEstimatorPrivate *priv;
+
+	g_return_if_fail (NSC_IS_ESTIMATOR (estimator));
+
+	priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+	if (priv->cancelled)
+		return;
+
+	priv->cancelled = TRUE;
+	g_cancellable_cancel (priv->cancellable);
+	g_ptr_array_foreach (priv->workers, (GFunc) worker_stop, NULL);
+}
+
+/**
+ * The output size and the time it will take to convert the batch
+ * with @profile, @jobs files at a time.  Returns
+ * NSC_ESTIMATE_PENDING until the samples were converted with it,
+ * and NSC_ESTIMATE_UNKNOWN if the profile was not sampled, or none
+ * of the samples could be converted.
+ */
+NscEstimateResult
+nsc_estimator_get_estimate (NscEstimator   *estimator,
+			    GMAudioProfile *profile,
+			    guint           jobs,
+			    guint64        *bytes,
+			    gdouble        *seconds)
+{
+	NscEstimatorPrivate *priv;
+	Worker              *worker = NULL;
+	gdouble              total_bytes, total_secs, startup, streaming;
+	guint                i;
+
+	g_return_val_if_fail (NSC_IS_ESTIMATOR (estimator),
+			      NSC_ESTIMATE_UNKNOWN);
+	g_return_val_if_fail (profile != NULL, NSC_ESTIMATE_UNKNOWN);
+
+	priv = NSC_ESTIMATOR_GET_PRIVATE (estimator);
+
+	for (i = 0; i < priv->workers->len; i++) {
+		Worker *w = g_ptr_array_index (priv->workers, i);
+
+		if (g_strcmp0 (gm_audio_profile_get_id (w->profile),
+			       gm_audio_profile_get_id (profile)) == 0) {
+			worker = w;
+			break;
+		}
+	}
+
+	/* Only the profiles that can be used are sampled */
+	if (worker == NULL)
+		return priv->started ? NSC_ESTIMATE_UNKNOWN
+				     : NSC_ESTIMATE_PENDING;
+
+	if (!worker->done)
+		return NSC_ESTIMATE_PENDING;
+
+	if (worker->n_done == 0 || worker->src_bytes == 0 ||
+	    worker->secs <= 0 || priv->n_sized == 0)
+		return NSC_ESTIMATE_UNKNOWN;
+
+	/* Files we could not size are taken to be like the rest */
+	total_bytes = (gdouble) priv->total_bytes * priv->n_files
+		/ priv->n_sized;
+	total_secs = total_bytes * worker->src_secs / worker->src_bytes;
+
+	/*
+	 * Every file costs a start up, and the rest goes with the
+	 * length of the audio.  The samples shared the processors
+	 * with the other profiles, so this errs on the long side.
+	 */
+	if (worker->n_whole > 0)
+		startup = (gdouble) worker->startup / G_USEC_PER_SEC
+			/ worker->n_whole;
+	else
+		startup = (gdouble) worker->cut_startup / G_USEC_PER_SEC
+			/ worker->n_done;
+	streaming = (gdouble) worker->streaming / G_USEC_PER_SEC
+		/ worker->secs;
+	jobs = CLAMP (jobs, 1, MAX (priv->n_files, 1));
+
+	if (bytes != NULL)
+		*bytes = total_secs * worker->out_bytes / worker->secs;
+	if (seconds != NULL)
+		*seconds = (priv->n_files * startup + total_secs * streaming)
+			/ jobs;
+
+	return NSC_ESTIMATE_READY;
+}
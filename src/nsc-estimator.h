@@ -0,0 +1,88 @@
+/*
+ *  nsc-estimator.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_ESTIMATOR_H
+#define NSC_ESTIMATOR_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <profiles/audio-profile.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Guesses how large the output of a batch will be, and how long
+ * it will take, for each of a few profiles.  A short piece of a
+ * few of the files is converted with every profile, and the rest
+ * is worked out from the size of the files.
+ */
+
+#define NSC_TYPE_ESTIMATOR            (nsc_estimator_get_type ())
+#define NSC_ESTIMATOR(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NSC_TYPE_ESTIMATOR, NscEstimator))
+#define NSC_ESTIMATOR_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NSC_TYPE_ESTIMATOR, NscEstimatorClass))
+#define NSC_IS_ESTIMATOR(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NSC_TYPE_ESTIMATOR))
+#define NSC_IS_ESTIMATOR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NSC_TYPE_ESTIMATOR))
+#define NSC_ESTIMATOR_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NSC_TYPE_ESTIMATOR, NscEstimatorClass))
+
+typedef enum {
+	/* The samples are still being converted */
+	NSC_ESTIMATE_PENDING,
+	NSC_ESTIMATE_READY,
+	/* The profile could not be sampled, so there will not be one */
+	NSC_ESTIMATE_UNKNOWN
+} NscEstimateResult;
+
+typedef struct _NscEstimator      NscEstimator;
+typedef struct _NscEstimatorClass NscEstimatorClass;
+
+struct _NscEstimator {
+	/* Parent object */
+	GObject  parent;
+	/* Private data pointer */
+	gpointer priv;
+};
+
+struct _NscEstimatorClass {
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (*changed) (NscEstimator *estimator);
+};
+
+GType             nsc_estimator_get_type     (void);
+NscEstimator     *nsc_estimator_new          (void);
+void              nsc_estimator_add_file     (NscEstimator   *estimator,
+					      GFile          *file);
+void              nsc_estimator_start        (NscEstimator   *estimator,
+					      GList          *profiles);
+void              nsc_estimator_cancel       (NscEstimator   *estimator);
+NscEstimateResult nsc_estimator_get_estimate (NscEstimator   *estimator,
+					      GMAudioProfile *profile,
+					      guint           jobs,
+					      guint64        *bytes,
+					      gdouble        *seconds);
+
+G_END_DECLS
+
+#endif /* NSC_ESTIMATOR_H */
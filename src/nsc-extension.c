@@ -24,15 +24,13 @@
 
 #include <config.h> /* for GETTEXT_PACKAGE */
 
-#include "nsc-converter.h"
 #include "nsc-extension.h"
-#include "nsc-gstreamer.h"
+#include "nsc-loader.h"
 
 #include <libnautilus-extension/nautilus-menu-provider.h>
 
 #include <glib/gi18n-lib.h>
 #include <gtk/gtk.h>
-#include <gst/gst.h>
 
 #include <string.h> /* For strcmp */
 
@@ -49,19 +47,17 @@ static GType sound_converter_type = 0;
  * no check of plugin support is needed
  */
 static gchar *mime_types[] = {
-	"audio/x-flac",
-	"audio/x-vorbis+ogg",
-	"audio/ogg",
-	"audio/x-wav",
+	NSC_ENGINE_REQUIRED_TYPES,
 	NULL
 };
 
 static gboolean
 file_is_sound (NautilusFileInfo *file_info)
 {
-	gchar          *scheme;
-	gint            i;
-	GError         *error = NULL;
+	const NscEngine     *engine;
+	const gchar * const *optional;
+	gchar               *scheme;
+	gint                 i;
 
 	/* Is this a file? */
 	scheme = nautilus_file_info_get_uri_scheme (file_info);
@@ -73,71 +69,107 @@ file_is_sound (NautilusFileInfo *file_info)
 	g_free (scheme);
 
 	for (i = 0; mime_types[i] != NULL; i++)
-		if (nautilus_file_info_is_mime_type (file_info, mime_types[i]))
+		if (nautilus_file_info_is_mime_type (file_info, mime_types[i])) {
+			/* Chances are it will be converted */
+			nsc_loader_prefetch ();
 			return TRUE;
+		}
 
-	/* Check for mp3 support */
-	if (nsc_gstreamer_supports_mp3 (&error)) {
-		if (nautilus_file_info_is_mime_type (file_info, "audio/mpeg"))
-			return TRUE;
-	} else {
-		g_error_free (error);
-		error = NULL;
-	}
-
-	/* Check for aac suppport */
-	if (nsc_gstreamer_supports_aac (&error)) {
-		if (nautilus_file_info_is_mime_type (file_info, "audio/mp4"))
-			return TRUE;
-	} else {
-		g_error_free (error);
-		error = NULL;
-	}
+	/*
+	 * Only audio files need the plugins checked, so nothing
+	 * else waits for the engine and GStreamer to be loaded.
+	 */
+	if (!nautilus_file_info_is_mime_type (file_info, "audio/*"))
+		return FALSE;
 
-	/* Check for Musepack support */
-	if (nsc_gstreamer_supports_musepack (&error)) {
-		if (nautilus_file_info_is_mime_type (file_info, "audio/x-musepack"))
-			return TRUE;
-	} else {
-		g_error_free (error);
-		error = NULL;
-	}
+	engine = nsc_loader_get_engine ();
+	if (engine == NULL)
+		return FALSE;
 
-	/* Check for wma support */
-	if (nsc_gstreamer_supports_wma (&error)) {
-		if (nautilus_file_info_is_mime_type (file_info, "audio/x-ms-wma"))
+	/* Formats we can convert when the plugins are installed */
+	optional = engine->get_mime_types ();
+	for (i = 0; optional[i] != NULL; i++)
+		if (nautilus_file_info_is_mime_type (file_info, optional[i]))
 			return TRUE;
-	} else {
-		g_error_free (error);
-		error = NULL;
-	}
 
 	return FALSE;
 }
 
-static GList *
-converter_filter_files (GList *files)
+/**
+ * Folders are only offered when local, like the files.
+ */
+static gboolean
+file_is_folder (NautilusFileInfo *file_info)
 {
-	GList *sounds = NULL;
-	GList *file = NULL;
+	gchar    *scheme;
+	gboolean  result;
 
-	for (file = files; file != NULL; file = file->next) {
-		if (file_is_sound (file->data))
-			sounds = g_list_prepend (sounds, file->data);
-	}
+	if (!nautilus_file_info_is_directory (file_info))
+		return FALSE;
+
+	scheme = nautilus_file_info_get_uri_scheme (file_info);
+	result = strcmp (scheme, "file") == 0;
+	g_free (scheme);
 
-	return sounds;
+	return result;
 }
 
 static void
 sound_convert_callback (NautilusMenuItem *item,
 		        GList            *files)
 {
-	NscConverter *converter;
+	const NscEngine *engine;
+
+	engine = nsc_loader_get_engine ();
+	if (engine == NULL)
+		return;
+
+	/*
+	 * The engine picks out the audio files while its dialog is
+	 * up, as going through a large selection here would hang
+	 * Nautilus before anything is shown.
+	 */
+	engine->convert (nautilus_file_info_list_copy (files), NULL);
+}
+
+static void
+folder_convert_callback (NautilusMenuItem *item,
+			 GList            *files)
+{
+	const NscEngine *engine;
+	GList           *folders = NULL;
+	GList           *file;
+
+	engine = nsc_loader_get_engine ();
+	if (engine == NULL)
+		return;
+
+	for (file = files; file != NULL; file = file->next) {
+		if (file_is_folder (file->data))
+			folders = g_list_prepend (folders,
+						  g_object_ref (file->data));
+	}
+
+	engine->convert (NULL, g_list_reverse (folders));
+}
+
+static NautilusMenuItem *
+create_folder_item (GList *folders)
+{
+	NautilusMenuItem *item;
 
-	converter = nsc_converter_new (converter_filter_files (files));
+	item = nautilus_menu_item_new ("NautilusSoundConverter::convert_folder",
+				       _("Convert _Folder..."),
+				       _("Convert every audio file in the folder and its subfolders"),
+				       "audio-x-generic");
 
-	nsc_converter_show_dialog (converter);
+	g_signal_connect_data (item, "activate",
+			       G_CALLBACK (folder_convert_callback),
+			       folders,
+			       (GClosureNotify) nautilus_file_info_list_free,
+			       0);
+
+	return item;
 }
 
 static GList *
@@ -145,7 +177,14 @@ nsc_extension_get_background_items (NautilusMenuProvider  *provider,
 				    GtkWidget             *window,
 				    NautilusFileInfo      *file_info)
 {
-	return NULL;
+	GList *folders;
+
+	if (!file_is_folder (file_info))
+		return NULL;
+
+	folders = g_list_prepend (NULL, g_object_ref (file_info));
+
+	return g_list_prepend (NULL, create_folder_item (folders));
 }
 
 static GList *
@@ -167,18 +206,27 @@ nsc_extension_get_file_items (NautilusMenuProvider *provider,
                                                        _("Convert each selected audio file"),
                                                        "audio-x-generic");
 
-			g_signal_connect (item, "activate",
-					  G_CALLBACK (sound_convert_callback),
-					  nautilus_file_info_list_copy (files));
+			g_signal_connect_data (item, "activate",
+					       G_CALLBACK (sound_convert_callback),
+					       nautilus_file_info_list_copy (files),
+					       (GClosureNotify) nautilus_file_info_list_free,
+					       0);
 
 			items = g_list_prepend (items, item);
-			items = g_list_reverse (items);
+			break;
+		}
+	}
 
-			return items;
+	/* Folders are only walked once the item is picked */
+	for (scan = files; scan; scan = scan->next) {
+		if (file_is_folder (scan->data)) {
+			item = create_folder_item (nautilus_file_info_list_copy (files));
+			items = g_list_prepend (items, item);
+			break;
 		}
 	}
 
-	return NULL;
+	return g_list_reverse (items);
 }
 
 static void
@@ -192,10 +240,10 @@ static void
 nsc_extension_instance_init (NscExtension *sound)
 {
 	/*
-	 * Initialize gstreamer, otherwise the
-	 * profile chooser won't show any values.
+	 * Nothing is loaded while Nautilus starts up, only a little
+	 * while after, or as soon as an audio file is selected.
 	 */
-	gst_init (NULL, NULL);
+	nsc_loader_prefetch_later ();
 }
 
 static void
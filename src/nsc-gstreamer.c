@@ -26,21 +26,34 @@
 
 #include <config.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <glib/gerror.h>
 #include <glib/gtypes.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <glib-object.h>
 #include <gst/gst.h>
 #include <profiles/gnome-media-profiles.h>
 
+#include "nsc-decoders.h"
 #include "nsc-error.h"
 #include "nsc-gstreamer.h"
+#include "nsc-stats.h"
+#include "nsc-trace.h"
+#include "nsc-verify.h"
 
 /* Properties */
 enum {
 	PROP_0,
 	PROP_PROFILE,
+	PROP_DECODER,
+	PROP_INSTRUMENT,
+	PROP_VERIFY,
 };
 
 /* Signals */
@@ -57,11 +70,67 @@ static guint signals[LAST_SIGNAL] = { 0 };
 /* Element names */
 #define FILE_SOURCE "giosrc"
 #define FILE_SINK   "giosink"
+#define FD_SOURCE   "fdsrc"
+#define FD_SINK     "fdsink"
+#define DECODER     "decodebin"
+
+/* Where the seek for a range is */
+enum {
+	SEEK_NONE,
+	SEEK_WAITING,
+	SEEK_PENDING,
+};
+
+/* Encoded audio waiting to be written, so the encoder never waits */
+#define WRITE_QUEUE_BYTES (4 * 1024 * 1024)
+
+/*
+ * Outputs are preallocated for the bitrate of the profile, or for
+ * CD audio when it has none, plus some room for headers.
+ */
+#define CD_BITRATE        1411200
+#define PREALLOC_SLACK    (64 * 1024)
+#define MAX_PREALLOC      ((gint64) 2 * 1024 * 1024 * 1024)
+
+/*
+ * What the buffer probes of a pipeline share with the object.  The
+ * probes run on the streaming threads, which go on until the
+ * teardown pool stopped the pipeline, so each of them holds a
+ * reference and nothing in here points back at the object.  The
+ * object detaches from it under the lock when it lets the pipeline
+ * go.
+ */
+typedef struct {
+	volatile gint   ref_count;
+	GMutex          lock;
+
+	guint64         bytes_read;
+	guint64         bytes_written;
+	gint64          stage_first[NSC_STAGE_LAST];
+	gint64          stage_last[NSC_STAGE_LAST];
+
+	/* The decoded audio, hashed on its way into the encoder */
+	NscPcmChecksum *checksum;
+
+	/*
+	 * Where the queue levels go while tracing, NULL once detached,
+	 * and the queues they are read from, which are held here since
+	 * the object forgets about them when it lets the pipeline go.
+	 */
+	NscTrace       *trace;
+	gchar          *queues_name;
+	GstElement     *decode_queue;
+	GstElement     *write_queue;
+	gint64          last_sample;
+} Probes;
 
 struct NscGStreamerPrivate {
 	/* The current audio profile */
 	GMAudioProfile *profile;
 
+	/* The element used to decode the input */
+	gchar          *decoder;
+
 	/* If the pipeline needs to be re-created */
 	gboolean        rebuild_pipeline;
 
@@ -72,12 +141,161 @@ struct NscGStreamerPrivate {
 	GstElement     *encode;
 	GstElement     *filesink;
 
+	/* Where decodebin's source pad gets linked to */
+	GstElement     *decode_target;
+
+	/*
+	 * When instrumenting, every stage runs in its own streaming
+	 * thread, so the CPU time of each thread is the time spent in
+	 * that stage.  The probes keep track of it as buffers go by.
+	 */
+	gboolean        instrument;
+	Probes         *probes;
+	GstPad         *probe_pads[NSC_STAGE_LAST];
+	gulong          probe_ids[NSC_STAGE_LAST];
+
+	/* Statistics for the current file */
+	NscFileStats    stats;
+	gint64          start_time;
+	gint64          build_time;
+
+	/* Timeline of the conversion, when tracing */
+	NscTrace       *trace;
+	guint           lane;
+	gchar          *queues_name;
+	GstElement     *write_queue;
+	gint64          playing_time;
+
+	/*
+	 * When verifying, the decoded audio is hashed on its way into
+	 * the encoder, and compared with the MD5 a FLAC encoder stores.
+	 */
+	gboolean        verify;
+	gboolean        flac_output;
+	GstPad         *verify_pad;
+	gulong          verify_id;
+	NscVerifyResult verify_result;
+	gchar          *pcm_md5;
+
+	/* Reading and writing file descriptors rather than files */
+	gboolean        streaming;
+
+	/*
+	 * Converting only part of the input, in nanoseconds, with an
+	 * end of -1 for the end of the input.  The decoded audio is held
+	 * before the range filter until the input has been seeked.
+	 */
+	gboolean        ranged;
+	gint64          range_start;
+	gint64          range_end;
+	GstElement     *range_filter;
+	volatile gint   seek_state;
+
+	/*
+	 * Local outputs are opened here and written through fdsink,
+	 * so they can be preallocated and trimmed once written.  They
+	 * are written next to the file they replace, which may be the
+	 * input, and renamed over it once done.  Opening them is done
+	 * by the output pool, and the serial tells a file that is still
+	 * wanted from one opened for a conversion since cancelled.
+	 */
+	gboolean        fd_output;
+	gint            output_fd;
+	gchar          *output_tmp;
+	gboolean        opening;
+	gboolean        hold;
+	guint           open_serial;
+
+	/* Reached its end, and waiting for the teardown pool to finish */
+	gboolean        finishing;
+	guint           finish_serial;
+
+	/* The file currently being written, and whether it is in progress */
+	GFile          *sink_file;
+	gboolean        converting;
+
+	/* Held in PAUSED, and for how long, which is not converting time */
+	gboolean        paused;
+	gint64          pause_start;
+	gint64          paused_time;
+
 	/* Misc */
 	int             seconds;
 	GError         *construct_error;
 	guint           tick_id;
 };
 
+/*
+ * Pipelines that are being torn down.  Shutting down a pipeline
+ * may block for as long as the slowest element takes to stop, so
+ * this is never done from the main loop.
+ */
+typedef struct {
+	GstElement     *pipeline;
+	GFile          *remove_file;
+	gchar          *remove_path;
+	gint            output_fd;
+
+	/*
+	 * Set for a conversion that reached its end.  Its output is only
+	 * closed and put in place once the sink stopped, and the object
+	 * then hears about it in the main loop.
+	 */
+	NscGStreamer   *gstreamer;
+	guint           serial;
+	gchar          *output_tmp;
+	gchar          *output_path;
+	gint64          stop;
+	gint64          stop_time;
+	GError         *error;
+
+	/*
+	 * The checksum a FLAC output is checked against before it is
+	 * put in place, and the output when it is not a local one.
+	 */
+	gchar          *pcm_md5;
+	GFile          *verify_file;
+	NscVerifyResult verify_result;
+} Teardown;
+
+#define TEARDOWN_THREADS 2
+
+static GThreadPool *teardown_pool = NULL;
+
+/*
+ * Creating a local output, or reserving room for it, which may
+ * block on a slow or remote filesystem, so neither is done from
+ * the main loop either.  An output is created when @path is set,
+ * and preallocated otherwise.
+ */
+typedef struct {
+	NscGStreamer *gstreamer;
+	guint         serial;
+	gchar        *path;
+	gchar        *uri;
+	gchar        *tmp_path;
+	gint          fd;
+	gint          error_no;
+	gint64        size;
+} OutputJob;
+
+#define OUTPUT_THREADS 2
+
+static GThreadPool *output_pool = NULL;
+
+static void eos_cb   (GstBus     *bus,
+		     GstMessage *message,
+		     gpointer    user_data);
+static void error_cb (GstBus     *bus,
+		      GstMessage *message,
+		      gpointer    user_data);
+static void state_changed_cb (GstBus     *bus,
+			      GstMessage *message,
+			      gpointer    user_data);
+static void message_cb (GstBus     *bus,
+			GstMessage *message,
+			gpointer    user_data);
+
 /*
  * GObject methods
  */
@@ -105,6 +323,26 @@ nsc_gstreamer_set_property (GObject      *object,
 
 		g_object_notify (object, "profile");
 		break;
+	case PROP_DECODER:
+		g_free (priv->decoder);
+
+		priv->decoder = g_value_dup_string (value);
+		priv->rebuild_pipeline = TRUE;
+
+		g_object_notify (object, "decoder");
+		break;
+	case PROP_INSTRUMENT:
+		priv->instrument = g_value_get_boolean (value);
+		priv->rebuild_pipeline = TRUE;
+
+		g_object_notify (object, "instrument");
+		break;
+	case PROP_VERIFY:
+		priv->verify = g_value_get_boolean (value);
+		priv->rebuild_pipeline = TRUE;
+
+		g_object_notify (object, "verify");
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 	}
@@ -123,11 +361,456 @@ nsc_gstreamer_get_property (GObject    *object,
 	case PROP_PROFILE:
 		g_value_set_object (value, priv->profile);
 		break;
+	case PROP_DECODER:
+		g_value_set_string (value, priv->decoder);
+		break;
+	case PROP_INSTRUMENT:
+		g_value_set_boolean (value, priv->instrument);
+		break;
+	case PROP_VERIFY:
+		g_value_set_boolean (value, priv->verify);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 	}
 }
 
+/**
+ * Create a new file next to @path to write it, so whatever is
+ * there now stays readable until the new one is complete.
+ */
+static gint
+open_output (const gchar  *path,
+	     gchar       **tmp_path)
+{
+	gchar *dirname, *basename, *name;
+	gint   fd;
+
+	dirname = g_path_get_dirname (path);
+	basename = g_path_get_basename (path);
+	name = g_strdup_printf (".%s.XXXXXX", basename);
+	*tmp_path = g_build_filename (dirname, name, NULL);
+	g_free (name);
+	g_free (basename);
+	g_free (dirname);
+
+	fd = g_mkstemp_full (*tmp_path, O_WRONLY | O_CLOEXEC, 0666);
+	if (fd < 0) {
+		gint saved_errno = errno;
+
+		g_free (*tmp_path);
+		*tmp_path = NULL;
+		errno = saved_errno;
+	}
+
+	return fd;
+}
+
+/**
+ * Give back the space preallocated past the end of the file,
+ * and close it.
+ */
+static void
+close_output (gint fd)
+{
+	struct stat st;
+
+	if (fd < 0)
+		return;
+
+	if (fstat (fd, &st) == 0 && ftruncate (fd, st.st_size) != 0)
+		g_warning ("Unable to trim the output; %s", g_strerror (errno));
+
+	close (fd);
+}
+
+static gboolean output_opened_cb (gpointer data);
+
+static void
+output_func (gpointer data,
+	     gpointer user_data)
+{
+	OutputJob *job = data;
+
+	if (job->path != NULL) {
+		job->fd = open_output (job->path, &job->tmp_path);
+		job->error_no = errno;
+		g_idle_add (output_opened_cb, job);
+		return;
+	}
+
+#ifdef HAVE_FALLOCATE
+	/* Just a hint, so a filesystem that can not do it is fine */
+	fallocate (job->fd, FALLOC_FL_KEEP_SIZE, 0, job->size);
+#endif
+	close (job->fd);
+	g_free (job);
+}
+
+#ifdef HAVE_FALLOCATE
+/**
+ * The bitrate of the profile in bits per second, as far as it can
+ * be told from its pipeline.  Encoders take it in either kbit/s or
+ * bit/s, and no one encodes audio at less than 10 kbit/s.
+ */
+static guint64
+estimate_bitrate (GMAudioProfile *profile)
+{
+	const gchar *pipeline, *p;
+	guint64      bitrate;
+
+	pipeline = gm_audio_profile_get_pipeline (profile);
+	p = pipeline ? strstr (pipeline, "bitrate=") : NULL;
+	if (p == NULL)
+		return CD_BITRATE;
+
+	bitrate = g_ascii_strtoull (p + strlen ("bitrate="), NULL, 10);
+	if (bitrate == 0)
+		return CD_BITRATE;
+
+	return bitrate < 10000 ? bitrate * 1000 : bitrate;
+}
+#endif
+
+static void
+push_output_job (OutputJob *job)
+{
+	if (output_pool == NULL)
+		output_pool = g_thread_pool_new (output_func, NULL,
+						 OUTPUT_THREADS,
+						 FALSE, NULL);
+
+	g_thread_pool_push (output_pool, job, NULL);
+}
+
+/**
+ * Reserve room for all of the output at once, so it is not spread
+ * all over a busy disk as it grows.  The size of the file does not
+ * change, and whatever is not used is given back when it is closed.
+ */
+static void
+preallocate_output (NscGStreamer *gstreamer,
+		    gdouble       duration)
+{
+#ifdef HAVE_FALLOCATE
+	NscGStreamerPrivate *priv;
+	OutputJob           *job;
+	gint64               size;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	if (priv->output_fd < 0 || duration <= 0)
+		return;
+
+	size = duration * estimate_bitrate (priv->profile) / 8;
+
+	/* The output may be closed before the pool gets to it */
+	job = g_new0 (OutputJob, 1);
+	job->fd = dup (priv->output_fd);
+	job->size = MIN (size + PREALLOC_SLACK, MAX_PREALLOC);
+	if (job->fd < 0) {
+		g_free (job);
+		return;
+	}
+
+	push_output_job (job);
+#endif
+}
+
+static gboolean finished_cb (gpointer data);
+
+/**
+ * Check a FLAC output against the decoded audio, before it takes
+ * the place of anything.  Only the FLAC header is read back, so this
+ * takes no longer than opening the file.  An output that does not
+ * match is removed.
+ */
+static void
+check_output (Teardown *teardown)
+{
+	GFile  *file;
+	gchar  *flac_md5;
+	GError *error = NULL;
+
+	if (teardown->pcm_md5 == NULL)
+		return;
+
+	if (teardown->output_tmp != NULL)
+		file = g_file_new_for_path (teardown->output_tmp);
+	else
+		file = g_object_ref (teardown->verify_file);
+
+	flac_md5 = nsc_verify_read_flac_md5 (file, &error);
+	if (flac_md5 == NULL) {
+		if (error != NULL) {
+			g_warning ("Unable to verify the output; %s",
+				   error->message);
+			g_error_free (error);
+		}
+		g_object_unref (file);
+		return;
+	}
+
+	if (strcmp (flac_md5, teardown->pcm_md5) == 0) {
+		teardown->verify_result = NSC_VERIFY_MATCH;
+	} else {
+		teardown->verify_result = NSC_VERIFY_MISMATCH;
+		teardown->error = g_error_new (NSC_ERROR,
+					       NSC_ERROR_INTERNAL_ERROR,
+					       _("The converted file does not match the original"));
+		g_file_delete (file, NULL, NULL);
+	}
+
+	g_free (flac_md5);
+	g_object_unref (file);
+}
+
+/**
+ * Put the new file of a conversion that reached its end in the
+ * place of the one it replaces, once it checked out.
+ */
+static void
+finish_output (Teardown *teardown)
+{
+	if (teardown->output_tmp == NULL || teardown->error != NULL)
+		return;
+
+	if (g_rename (teardown->output_tmp, teardown->output_path) != 0) {
+		teardown->error = g_error_new (NSC_ERROR,
+					       NSC_ERROR_INTERNAL_ERROR,
+					       _("Unable to write %s; %s"),
+					       teardown->output_path,
+					       g_strerror (errno));
+		g_unlink (teardown->output_tmp);
+	}
+}
+
+static void
+teardown_func (gpointer data,
+	       gpointer user_data)
+{
+	Teardown *teardown = data;
+	GError   *error = NULL;
+
+	if (teardown->pipeline != NULL) {
+		gst_element_set_state (teardown->pipeline, GST_STATE_NULL);
+		gst_object_unref (GST_OBJECT (teardown->pipeline));
+	}
+
+	close_output (teardown->output_fd);
+
+	if (teardown->gstreamer != NULL) {
+		teardown->stop_time = g_get_monotonic_time () - teardown->stop;
+		check_output (teardown);
+		finish_output (teardown);
+		g_idle_add (finished_cb, teardown);
+		return;
+	}
+
+	/* Remove the new file that was never finished */
+	if (teardown->remove_path != NULL) {
+		g_unlink (teardown->remove_path);
+		g_free (teardown->remove_path);
+	}
+
+	/* Remove the partially written file */
+	if (teardown->remove_file != NULL) {
+		if (!g_file_delete (teardown->remove_file, NULL, &error)) {
+			if (!g_error_matches (error, G_IO_ERROR,
+					      G_IO_ERROR_NOT_FOUND))
+				g_warning ("Unable to delete file; %s",
+					   error->message);
+			g_error_free (error);
+		}
+		g_object_unref (teardown->remove_file);
+	}
+
+	g_free (teardown);
+}
+
+static void
+push_teardown (Teardown *teardown)
+{
+	if (teardown_pool == NULL)
+		teardown_pool = g_thread_pool_new (teardown_func, NULL,
+						   TEARDOWN_THREADS,
+						   FALSE, NULL);
+
+	g_thread_pool_push (teardown_pool, teardown, NULL);
+}
+
+/**
+ * Close the output being written without keeping it, in the
+ * teardown pool.
+ */
+static void
+discard_output (NscGStreamer *gstreamer)
+{
+	NscGStreamerPrivate *priv;
+	Teardown            *teardown;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	if (priv->output_fd < 0 && priv->output_tmp == NULL)
+		return;
+
+	teardown = g_new0 (Teardown, 1);
+	teardown->output_fd = priv->output_fd;
+	teardown->remove_path = priv->output_tmp;
+	priv->output_fd = -1;
+	priv->output_tmp = NULL;
+
+	push_teardown (teardown);
+}
+
+static Probes *
+probes_new (void)
+{
+	Probes *probes;
+
+	probes = g_new0 (Probes, 1);
+	probes->ref_count = 1;
+	g_mutex_init (&probes->lock);
+
+	return probes;
+}
+
+static Probes *
+probes_ref (Probes *probes)
+{
+	g_atomic_int_inc (&probes->ref_count);
+
+	return probes;
+}
+
+static void
+probes_unref (Probes *probes)
+{
+	if (!g_atomic_int_dec_and_test (&probes->ref_count))
+		return;
+
+	nsc_pcm_checksum_free (probes->checksum);
+	g_free (probes->queues_name);
+	if (probes->decode_queue != NULL)
+		gst_object_unref (probes->decode_queue);
+	if (probes->write_queue != NULL)
+		gst_object_unref (probes->write_queue);
+	g_mutex_clear (&probes->lock);
+	g_free (probes);
+}
+
+/*
+ * Detach the current pipeline from the object, into a teardown
+ * that also closes the output.  This only does constant-time work,
+ * so it is safe to call from the main loop.
+ */
+static Teardown *
+detach_pipeline (NscGStreamer *gstreamer)
+{
+	NscGStreamerPrivate *priv;
+	Teardown            *teardown;
+	GstBus              *bus;
+	gint                 i;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	if (priv->tick_id) {
+		g_source_remove (priv->tick_id);
+		priv->tick_id = 0;
+	}
+
+	if (priv->pipeline == NULL)
+		return NULL;
+
+	/* Make sure no more messages reach us from this pipeline */
+	bus = gst_element_get_bus (priv->pipeline);
+	g_signal_handlers_disconnect_by_func (bus, error_cb, gstreamer);
+	g_signal_handlers_disconnect_by_func (bus, eos_cb, gstreamer);
+	g_signal_handlers_disconnect_by_func (bus, state_changed_cb, gstreamer);
+	g_signal_handlers_disconnect_by_func (bus, message_cb, gstreamer);
+	gst_bus_remove_signal_watch (bus);
+	gst_object_unref (bus);
+
+	/* A probe still running keeps its own reference to them */
+	for (i = 0; i < NSC_STAGE_LAST; i++) {
+		if (priv->probe_pads[i] == NULL)
+			continue;
+
+		gst_pad_remove_buffer_probe (priv->probe_pads[i],
+					     priv->probe_ids[i]);
+		gst_object_unref (priv->probe_pads[i]);
+		priv->probe_pads[i] = NULL;
+		priv->probe_ids[i] = 0;
+	}
+
+	if (priv->verify_pad != NULL) {
+		gst_pad_remove_buffer_probe (priv->verify_pad,
+					     priv->verify_id);
+		gst_object_unref (priv->verify_pad);
+		priv->verify_pad = NULL;
+		priv->verify_id = 0;
+	}
+
+	if (priv->probes != NULL) {
+		g_mutex_lock (&priv->probes->lock);
+		priv->probes->trace = NULL;
+		g_mutex_unlock (&priv->probes->lock);
+		probes_unref (priv->probes);
+		priv->probes = NULL;
+	}
+
+	teardown = g_new0 (Teardown, 1);
+	teardown->pipeline = priv->pipeline;
+
+	/* The sink may still be writing to it until it is stopped */
+	teardown->output_fd = priv->output_fd;
+	priv->output_fd = -1;
+
+	priv->pipeline = NULL;
+	priv->filesrc  = NULL;
+	priv->decode   = NULL;
+	priv->encode   = NULL;
+	priv->filesink = NULL;
+	priv->decode_target = NULL;
+	priv->range_filter = NULL;
+	priv->write_queue = NULL;
+	g_atomic_int_set (&priv->seek_state, SEEK_NONE);
+	priv->converting = FALSE;
+	priv->rebuild_pipeline = TRUE;
+
+	return teardown;
+}
+
+/*
+ * Hand the current pipeline over to the teardown pool, along with
+ * the output when @remove_output.
+ */
+static void
+release_pipeline (NscGStreamer *gstreamer,
+		  gboolean      remove_output)
+{
+	NscGStreamerPrivate *priv;
+	Teardown            *teardown;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	teardown = detach_pipeline (gstreamer);
+	if (teardown == NULL)
+		return;
+
+	/*
+	 * A local output was never renamed over the file it replaces,
+	 * which is left alone, and is always removed.
+	 */
+	if (remove_output && priv->sink_file != NULL &&
+	    priv->output_tmp == NULL)
+		teardown->remove_file = g_object_ref (priv->sink_file);
+	teardown->remove_path = priv->output_tmp;
+	priv->output_tmp = NULL;
+
+	push_teardown (teardown);
+}
+
 static void
 nsc_gstreamer_dispose (GObject *object)
 {
@@ -141,10 +824,11 @@ nsc_gstreamer_dispose (GObject *object)
 			priv->profile = NULL;
 		}
 
-		if (priv->pipeline) {
-			gst_element_set_state (priv->pipeline, GST_STATE_NULL);
-			g_object_unref (priv->pipeline);
-			priv->pipeline = NULL;
+		release_pipeline (self, FALSE);
+
+		if (priv->sink_file) {
+			g_object_unref (priv->sink_file);
+			priv->sink_file = NULL;
 		}
 	}
 
@@ -164,6 +848,10 @@ nsc_gstreamer_finalize (GObject *object)
 		if (priv->construct_error)
 			g_error_free (priv->construct_error);
 
+		g_free (priv->decoder);
+		g_free (priv->queues_name);
+		nsc_file_stats_reset (&priv->stats);
+		g_free (priv->pcm_md5);
 
 		g_free (priv);
 
@@ -181,6 +869,9 @@ nsc_gstreamer_class_init (NscGStreamerClass *klass)
 
 	g_type_class_add_private (klass, sizeof (NscGStreamerPrivate));
 
+	/* Prefer the decoders that calibrating found fastest */
+	nsc_decoders_apply ();
+
 	/* GObject */
 	object_class->set_property = nsc_gstreamer_set_property;
 	object_class->get_property = nsc_gstreamer_get_property;
@@ -194,6 +885,24 @@ nsc_gstreamer_class_init (NscGStreamerClass *klass)
 							      _("The GNOME Audio Profile used for encoding audio"),
 							      GM_AUDIO_TYPE_PROFILE,
 							      G_PARAM_READWRITE));
+	g_object_class_install_property (object_class, PROP_DECODER,
+					 g_param_spec_string ("decoder",
+							      _("Decoder"),
+							      _("The GStreamer element used for decoding audio"),
+							      DECODER,
+							      G_PARAM_READWRITE));
+	g_object_class_install_property (object_class, PROP_INSTRUMENT,
+					 g_param_spec_boolean ("instrument",
+							       _("Instrument"),
+							       _("Whether to measure the CPU time of each stage"),
+							       FALSE,
+							       G_PARAM_READWRITE));
+	g_object_class_install_property (object_class, PROP_VERIFY,
+					 g_param_spec_boolean ("verify",
+							       _("Verify"),
+							       _("Whether to checksum the decoded audio and check it against the output"),
+							       FALSE,
+							       G_PARAM_READWRITE));
 
 	/* Signals */
 	signals[PROGRESS] = 
@@ -242,43 +951,492 @@ nsc_gstreamer_init (NscGStreamer *self)
 		NscGStreamerPrivate *priv = NSC_GSTREAMER_GET_PRIVATE (self);
 		/* Initialize private data */
 		priv->rebuild_pipeline = TRUE;
+		priv->decoder = g_strdup (DECODER);
+		priv->output_fd = -1;
+		nsc_file_stats_reset (&priv->stats);
 	}
 }
 
 /* 
  * Private Methods
  */
-static void
-eos_cb (GstBus     *bus,
-	GstMessage *message,
-	gpointer    user_data)
+static gint64
+thread_cpu_time (void)
 {
-	NscGStreamer        *gstreamer;
-	NscGStreamerPrivate *priv;
-
-	gstreamer = NSC_GSTREAMER (user_data);
-	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+	struct timespec ts;
 
-	gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+	if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return -1;
 
-	if (priv->tick_id) {
-		g_source_remove (priv->tick_id);
-		priv->tick_id = 0;
-	}
+	return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
 
-	priv->rebuild_pipeline = TRUE;
+/**
+ * Called with the lock of @probes held.
+ */
+static void
+mark_stage (Probes   *probes,
+	    NscStage  stage)
+{
+	gint64 now;
 
-	g_signal_emit (gstreamer, signals[COMPLETION], 0);
+	now = thread_cpu_time ();
+	if (probes->stage_first[stage] < 0)
+		probes->stage_first[stage] = now;
+	probes->stage_last[stage] = now;
 }
 
-static GstElement*
-build_encoder (NscGStreamer *gstreamer)
+/* Microseconds between two samples of the queue levels */
+#define SAMPLE_INTERVAL 10000
+
+/**
+ * Called from the streaming thread that writes the output, with
+ * the lock of @probes held.
+ */
+static void
+sample_queues (Probes *probes)
 {
-	NscGStreamerPrivate *priv;
-	GstElement          *element = NULL;
-	gchar               *pipeline;
+	guint  decode_level, write_level;
+	gint64 now;
 
-	g_return_val_if_fail (NSC_IS_GSTREAMER (gstreamer), NULL);
+	now = g_get_monotonic_time ();
+	if (now - probes->last_sample < SAMPLE_INTERVAL)
+		return;
+	probes->last_sample = now;
+
+	g_object_get (G_OBJECT (probes->decode_queue),
+		      "current-level-buffers", &decode_level,
+		      NULL);
+	g_object_get (G_OBJECT (probes->write_queue),
+		      "current-level-buffers", &write_level,
+		      NULL);
+
+	nsc_trace_counter (probes->trace, probes->queues_name,
+			   "decoded", decode_level,
+			   "encoded", write_level);
+}
+
+static gboolean
+decode_probe_cb (GstPad    *pad,
+		 GstBuffer *buffer,
+		 gpointer   data)
+{
+	Probes *probes = data;
+
+	g_mutex_lock (&probes->lock);
+	probes->bytes_read += GST_BUFFER_SIZE (buffer);
+	mark_stage (probes, NSC_STAGE_DECODE);
+	g_mutex_unlock (&probes->lock);
+
+	return TRUE;
+}
+
+static gboolean
+encode_probe_cb (GstPad    *pad,
+		 GstBuffer *buffer,
+		 gpointer   data)
+{
+	Probes *probes = data;
+
+	g_mutex_lock (&probes->lock);
+	mark_stage (probes, NSC_STAGE_ENCODE);
+	g_mutex_unlock (&probes->lock);
+
+	return TRUE;
+}
+
+static gboolean
+write_probe_cb (GstPad    *pad,
+		GstBuffer *buffer,
+		gpointer   data)
+{
+	Probes *probes = data;
+
+	g_mutex_lock (&probes->lock);
+	probes->bytes_written += GST_BUFFER_SIZE (buffer);
+	mark_stage (probes, NSC_STAGE_WRITE);
+
+	if (probes->trace != NULL && probes->write_queue != NULL)
+		sample_queues (probes);
+	g_mutex_unlock (&probes->lock);
+
+	return TRUE;
+}
+
+static gboolean
+verify_probe_cb (GstPad    *pad,
+		 GstBuffer *buffer,
+		 gpointer   data)
+{
+	Probes *probes = data;
+
+	g_mutex_lock (&probes->lock);
+	nsc_pcm_checksum_update (probes->checksum, buffer);
+	g_mutex_unlock (&probes->lock);
+
+	return TRUE;
+}
+
+static gboolean
+is_encoder (GstElement *element)
+{
+	GstElementFactory *factory;
+
+	factory = gst_element_get_factory (element);
+	if (factory == NULL)
+		return FALSE;
+
+	return strstr (gst_element_factory_get_klass (factory),
+		       "Encoder") != NULL;
+}
+
+/**
+ * The encoder of the profile pipeline in @bin, or NULL for
+ * profiles that only mux, like WAV.
+ */
+static GstElement *
+find_encoder (GstElement *bin)
+{
+	GstIterator *iter;
+	GstElement  *encoder = NULL;
+	gpointer     item;
+	gboolean     done = FALSE;
+
+	iter = gst_bin_iterate_elements (GST_BIN (bin));
+	while (!done) {
+		switch (gst_iterator_next (iter, &item)) {
+		case GST_ITERATOR_OK:
+			if (encoder == NULL && is_encoder (item))
+				encoder = item;
+			else
+				gst_object_unref (item);
+			break;
+		case GST_ITERATOR_RESYNC:
+			if (encoder != NULL)
+				gst_object_unref (encoder);
+			encoder = NULL;
+			gst_iterator_resync (iter);
+			break;
+		default:
+			done = TRUE;
+		}
+	}
+	gst_iterator_free (iter);
+
+	return encoder;
+}
+
+/**
+ * Hash the audio exactly as the encoder gets it, after it was
+ * converted and resampled, since that is what FLAC hashes too.
+ */
+static void
+add_verify_probe (NscGStreamerPrivate *priv)
+{
+	GstElementFactory *factory;
+	GstElement        *encoder;
+
+	encoder = find_encoder (priv->encode);
+	if (encoder != NULL) {
+		factory = gst_element_get_factory (encoder);
+		priv->flac_output = strcmp (GST_PLUGIN_FEATURE_NAME (factory),
+					    "flacenc") == 0;
+		priv->verify_pad = gst_element_get_static_pad (encoder, "sink");
+		gst_object_unref (encoder);
+	} else {
+		priv->flac_output = FALSE;
+		priv->verify_pad = gst_element_get_static_pad (priv->encode,
+							       "sink");
+	}
+
+	if (priv->verify_pad == NULL)
+		return;
+
+	priv->probes->checksum = nsc_pcm_checksum_new ();
+	priv->verify_id = gst_pad_add_buffer_probe_full (priv->verify_pad,
+							 G_CALLBACK (verify_probe_cb),
+							 probes_ref (priv->probes),
+							 (GDestroyNotify) probes_unref);
+}
+
+/**
+ * Keep the checksum of the decoded audio, once all of it went
+ * through the encoder.
+ */
+static void
+take_checksum (NscGStreamerPrivate *priv)
+{
+	if (priv->verify_pad == NULL)
+		return;
+
+	g_mutex_lock (&priv->probes->lock);
+	g_free (priv->pcm_md5);
+	priv->pcm_md5 = g_strdup (nsc_pcm_checksum_get_string (priv->probes->checksum));
+	g_mutex_unlock (&priv->probes->lock);
+	priv->verify_result = NSC_VERIFY_UNCHECKED;
+}
+
+static void
+add_probe (NscGStreamerPrivate *priv,
+	   NscStage             stage,
+	   GstElement          *element,
+	   const gchar         *pad_name,
+	   GCallback            callback)
+{
+	GstPad *pad;
+
+	pad = gst_element_get_static_pad (element, pad_name);
+	if (pad == NULL)
+		return;
+
+	priv->probe_pads[stage] = pad;
+	priv->probe_ids[stage] = gst_pad_add_buffer_probe_full (pad, callback,
+								probes_ref (priv->probes),
+								(GDestroyNotify) probes_unref);
+}
+
+/**
+ * Start collecting statistics for a new file.
+ */
+static void
+start_stats (NscGStreamer *gstreamer,
+	     const gchar  *uri)
+{
+	NscGStreamerPrivate *priv;
+	gint                 i;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	nsc_file_stats_reset (&priv->stats);
+	priv->stats.uri = g_strdup (uri);
+	priv->stats.profile = g_strdup (gm_audio_profile_get_id (priv->profile));
+	priv->stats.build_time = priv->build_time;
+	priv->stats.preroll_time = -1;
+	priv->stats.startup_time = -1;
+	priv->stats.query_time = -1;
+	priv->stats.stop_time = -1;
+
+	if (priv->probes != NULL) {
+		Probes *probes = priv->probes;
+
+		g_mutex_lock (&probes->lock);
+		probes->bytes_read = 0;
+		probes->bytes_written = 0;
+		for (i = 0; i < NSC_STAGE_LAST; i++) {
+			probes->stage_first[i] = -1;
+			probes->stage_last[i] = -1;
+		}
+		if (probes->checksum != NULL)
+			nsc_pcm_checksum_reset (probes->checksum);
+		g_mutex_unlock (&probes->lock);
+	}
+
+	priv->start_time = g_get_monotonic_time ();
+	priv->playing_time = 0;
+	priv->paused = FALSE;
+	priv->paused_time = 0;
+}
+
+/**
+ * Copy what the probes counted into the statistics, before the
+ * pipeline is let go.
+ */
+static void
+collect_probes (NscGStreamerPrivate *priv)
+{
+	Probes *probes = priv->probes;
+	gint    i;
+
+	if (probes == NULL)
+		return;
+
+	g_mutex_lock (&probes->lock);
+	priv->stats.bytes_read = probes->bytes_read;
+	priv->stats.bytes_written = probes->bytes_written;
+	for (i = 0; i < NSC_STAGE_LAST; i++) {
+		if (probes->stage_first[i] >= 0)
+			priv->stats.stage_cpu[i] = probes->stage_last[i]
+				- probes->stage_first[i];
+	}
+	g_mutex_unlock (&probes->lock);
+}
+
+static void
+finish_stats (NscGStreamer *gstreamer,
+	      gboolean      success)
+{
+	NscGStreamerPrivate *priv;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	priv->stats.success = success;
+	priv->stats.wall_time = g_get_monotonic_time () - priv->start_time
+		- priv->paused_time;
+
+	collect_probes (priv);
+
+	if (priv->stats.wall_time > 0)
+		priv->stats.realtime_factor = priv->stats.duration
+			/ ((gdouble) priv->stats.wall_time / G_USEC_PER_SEC);
+}
+
+static void
+state_changed_cb (GstBus     *bus,
+		  GstMessage *message,
+		  gpointer    user_data)
+{
+	NscGStreamerPrivate *priv;
+	GstState             new_state;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (user_data);
+
+	if (GST_MESSAGE_SRC (message) != GST_OBJECT (priv->pipeline))
+		return;
+
+	gst_message_parse_state_changed (message, NULL, &new_state, NULL);
+
+	if (new_state == GST_STATE_PLAYING && priv->stats.preroll_time < 0) {
+		priv->playing_time = g_get_monotonic_time ();
+		priv->stats.preroll_time = priv->playing_time
+			- priv->start_time;
+
+		if (priv->trace != NULL)
+			nsc_trace_span (priv->trace, priv->lane, "file",
+					"preroll", priv->start_time,
+					priv->playing_time, NULL);
+	}
+}
+
+/**
+ * Put every bus message on the timeline.
+ */
+static void
+message_cb (GstBus     *bus,
+	    GstMessage *message,
+	    gpointer    user_data)
+{
+	NscGStreamerPrivate *priv;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (user_data);
+
+	nsc_trace_instant (priv->trace, priv->lane, "bus",
+			   GST_MESSAGE_TYPE_NAME (message),
+			   GST_MESSAGE_SRC_NAME (message));
+}
+
+/**
+ * Stopping the pipeline joins its streaming threads, so on EOS it
+ * goes to the teardown pool too, which also closes the output and
+ * puts it in place.  The conversion is only complete once that is
+ * done, in finished_cb().
+ */
+static void
+eos_cb (GstBus     *bus,
+	GstMessage *message,
+	gpointer    user_data)
+{
+	NscGStreamer        *gstreamer;
+	NscGStreamerPrivate *priv;
+	Teardown            *teardown;
+
+	gstreamer = NSC_GSTREAMER (user_data);
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	/* Everything went through the probes by now */
+	collect_probes (priv);
+	take_checksum (priv);
+
+	teardown = detach_pipeline (gstreamer);
+	if (teardown == NULL)
+		return;
+
+	teardown->stop = g_get_monotonic_time ();
+	teardown->gstreamer = g_object_ref (gstreamer);
+	teardown->serial = ++priv->finish_serial;
+
+	if (priv->output_tmp != NULL) {
+		teardown->output_tmp = priv->output_tmp;
+		teardown->output_path = g_file_get_path (priv->sink_file);
+		priv->output_tmp = NULL;
+	}
+
+	/* What went into a pipe can not be read back */
+	teardown->verify_result = priv->verify_result;
+	if (priv->verify_result == NSC_VERIFY_UNCHECKED &&
+	    priv->flac_output && priv->pcm_md5 != NULL &&
+	    priv->sink_file != NULL) {
+		teardown->pcm_md5 = g_strdup (priv->pcm_md5);
+		teardown->verify_file = g_object_ref (priv->sink_file);
+	}
+
+	priv->finishing = TRUE;
+	push_teardown (teardown);
+}
+
+/**
+ * The teardown pool stopped the pipeline of a conversion that
+ * reached its end, and put its output in place.
+ */
+static gboolean
+finished_cb (gpointer data)
+{
+	Teardown            *teardown = data;
+	NscGStreamer        *gstreamer = teardown->gstreamer;
+	NscGStreamerPrivate *priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+	GError              *error = teardown->error;
+
+	/* Cancelled, or followed by another conversion, in the meantime */
+	if (!priv->finishing || teardown->serial != priv->finish_serial) {
+		if (error != NULL)
+			g_error_free (error);
+		goto out;
+	}
+
+	priv->finishing = FALSE;
+	priv->stats.stop_time = teardown->stop_time;
+	priv->verify_result = teardown->verify_result;
+	finish_stats (gstreamer, error == NULL);
+
+	if (priv->trace != NULL) {
+		nsc_trace_span (priv->trace, priv->lane, "file", "streaming",
+				priv->playing_time ? priv->playing_time
+						   : priv->start_time,
+				teardown->stop, NULL);
+		nsc_trace_span (priv->trace, priv->lane, "file", "eos",
+				teardown->stop,
+				teardown->stop + teardown->stop_time, NULL);
+	}
+
+	if (error != NULL) {
+		if (priv->trace != NULL)
+			nsc_trace_instant (priv->trace, priv->lane, "file",
+					   "error", error->message);
+		g_signal_emit (gstreamer, signals[ERROR], 0, error);
+		g_error_free (error);
+	} else {
+		g_signal_emit (gstreamer, signals[COMPLETION], 0);
+	}
+
+out:
+	g_free (teardown->output_tmp);
+	g_free (teardown->output_path);
+	g_free (teardown->pcm_md5);
+	if (teardown->verify_file != NULL)
+		g_object_unref (teardown->verify_file);
+	g_object_unref (gstreamer);
+	g_free (teardown);
+
+	return FALSE;
+}
+
+static GstElement*
+build_encoder (NscGStreamer *gstreamer)
+{
+	NscGStreamerPrivate *priv;
+	GstElement          *element = NULL;
+	gchar               *pipeline;
+
+	g_return_val_if_fail (NSC_IS_GSTREAMER (gstreamer), NULL);
 
 	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
 	g_return_val_if_fail (priv->profile != NULL, NULL);
@@ -305,7 +1463,10 @@ error_cb (GstBus     *bus,
 
 	/* Make sure the pipeline is not running any more */
 	gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+	discard_output (gstreamer);
+	priv->converting = FALSE;
 	priv->rebuild_pipeline = TRUE;
+	finish_stats (gstreamer, FALSE);
 
 	if (priv->tick_id) {
 		g_source_remove (priv->tick_id);
@@ -313,6 +1474,9 @@ error_cb (GstBus     *bus,
 	}
 
 	gst_message_parse_error (message, &error, NULL);
+	if (priv->trace != NULL)
+		nsc_trace_instant (priv->trace, priv->lane, "file", "error",
+				   error->message);
 	g_signal_emit (gstreamer, signals[ERROR], 0, error);
 	g_error_free (error);
 }
@@ -352,14 +1516,15 @@ build_pipeline (NscGStreamer *gstreamer)
 {
 	NscGStreamerPrivate *priv;
 	GstBus              *bus;
+	gint64               start;
 
 	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
 
 	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
 
-	if (priv->pipeline != NULL) {
-		gst_object_unref (GST_OBJECT (priv->pipeline));
-	}
+	release_pipeline (gstreamer, FALSE);
+
+	start = g_get_monotonic_time ();
 
 	priv->pipeline = gst_pipeline_new ("pipeline");
 	bus = gst_element_get_bus (priv->pipeline);
@@ -372,9 +1537,19 @@ build_pipeline (NscGStreamer *gstreamer)
 	g_signal_connect (G_OBJECT (bus), "message::eos",
 			  G_CALLBACK (eos_cb),
 			  gstreamer);
-
-	/* Read from disk */
-	priv->filesrc = gst_element_factory_make (FILE_SOURCE, "file_src");
+	g_signal_connect (G_OBJECT (bus), "message::state-changed",
+			  G_CALLBACK (state_changed_cb),
+			  gstreamer);
+	if (priv->trace != NULL)
+		g_signal_connect (G_OBJECT (bus), "message",
+				  G_CALLBACK (message_cb),
+				  gstreamer);
+	gst_object_unref (bus);
+
+	/* Read from disk, or from whatever is on the other end */
+	priv->filesrc = gst_element_factory_make (priv->streaming ? FD_SOURCE
+								  : FILE_SOURCE,
+						  "file_src");
 	if (priv->filesrc == NULL) {
 		g_set_error (&priv->construct_error,
 			     NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
@@ -383,7 +1558,7 @@ build_pipeline (NscGStreamer *gstreamer)
 	}
 
 	/* Decode */
-	priv->decode = gst_element_factory_make ("decodebin", "decode");
+	priv->decode = gst_element_factory_make (priv->decoder, "decode");
 	if (priv->decode == NULL) {
 		g_set_error (&priv->construct_error,
 			     NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
@@ -402,12 +1577,40 @@ build_pipeline (NscGStreamer *gstreamer)
 	}
 
 	/* Decodebin uses dynamic pads, so lets set up a callback. */
+	priv->decode_target = priv->encode;
+	if (priv->instrument)
+		priv->decode_target = gst_element_factory_make ("queue",
+								"decode_queue");
+
+	/*
+	 * A range goes through a filter that restamps it to start at
+	 * zero, so the encoder sees a file of its own.
+	 */
+	if (priv->ranged) {
+		priv->range_filter = gst_element_factory_make ("identity",
+							       "range_filter");
+		if (priv->range_filter == NULL) {
+			g_set_error (&priv->construct_error,
+				     NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("Could not create GStreamer range filter"));
+			return;
+		}
+
+		g_object_set (G_OBJECT (priv->range_filter),
+			      "single-segment", TRUE,
+			      NULL);
+	}
+
 	g_signal_connect (G_OBJECT (priv->decode), "new-decoded-pad",
 			  G_CALLBACK (connect_decodebin_cb),
-			  priv->encode);
+			  priv->ranged ? priv->range_filter
+				       : priv->decode_target);
 
 	/* Write to disk */
-	priv->filesink = gst_element_factory_make (FILE_SINK, "file_sink");
+	priv->filesink = gst_element_factory_make (priv->streaming ||
+						   priv->fd_output ? FD_SINK
+								   : FILE_SINK,
+						   "file_sink");
 	if (priv->filesink == NULL) {
 		g_set_error (&priv->construct_error,
 			     NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
@@ -415,13 +1618,18 @@ build_pipeline (NscGStreamer *gstreamer)
 		return;
 	}
 
-	/*
-	 * TODO: Eventually, we should ask the user if they want to 
-	 *       overwrite any existing file.
-	 */
-	g_signal_connect (G_OBJECT (priv->filesink), "allow-overwrite",
-			  G_CALLBACK (just_say_yes),
-			  gstreamer);
+	if (priv->streaming || priv->fd_output) {
+		/* Write as fast as the reader takes it, like giosink does */
+		g_object_set (G_OBJECT (priv->filesink), "sync", FALSE, NULL);
+	} else {
+		/*
+		 * TODO: Eventually, we should ask the user if they want to
+		 *       overwrite any existing file.
+		 */
+		g_signal_connect (G_OBJECT (priv->filesink), "allow-overwrite",
+				  G_CALLBACK (just_say_yes),
+				  gstreamer);
+	}
 
 	/* Add the elements to the pipeline */
 	gst_bin_add_many (GST_BIN (priv->pipeline),
@@ -437,15 +1645,77 @@ build_pipeline (NscGStreamer *gstreamer)
 		return;
 	}
 
+	/*
+	 * Writing always gets a thread of its own, so a slow disk
+	 * never holds up the encoder, only the queue in between.
+	 */
+	priv->write_queue = gst_element_factory_make ("queue", "write_queue");
+	g_object_set (G_OBJECT (priv->write_queue),
+		      "max-size-buffers", 0,
+		      "max-size-time", (guint64) 0,
+		      "max-size-bytes", WRITE_QUEUE_BYTES,
+		      NULL);
+	gst_bin_add (GST_BIN (priv->pipeline), priv->write_queue);
+
 	/* Link the rest */
-	if (!gst_element_link (priv->encode, priv->filesink)) {
+	if (priv->instrument) {
+		/* And decoding and encoding get one each too */
+		gst_bin_add (GST_BIN (priv->pipeline), priv->decode_target);
+
+		if (!gst_element_link (priv->decode_target, priv->encode)) {
+			g_set_error (&priv->construct_error,
+				     NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("Could not link pipeline"));
+			return;
+		}
+	}
+
+	if (priv->ranged) {
+		gst_bin_add (GST_BIN (priv->pipeline), priv->range_filter);
+
+		if (!gst_element_link (priv->range_filter,
+				       priv->decode_target)) {
+			g_set_error (&priv->construct_error,
+				     NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("Could not link pipeline"));
+			return;
+		}
+	}
+
+	if (!gst_element_link_many (priv->encode, priv->write_queue,
+				    priv->filesink, NULL)) {
 		g_set_error (&priv->construct_error,
 			     NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
 			     _("Could not link pipeline"));
 		return;
 	}
 
+	priv->probes = probes_new ();
+	if (priv->trace != NULL && priv->instrument) {
+		priv->probes->trace = priv->trace;
+		priv->probes->queues_name = g_strdup (priv->queues_name);
+		priv->probes->decode_queue = gst_object_ref (priv->decode_target);
+		priv->probes->write_queue = gst_object_ref (priv->write_queue);
+	}
+
+	/* Watch the data going through each stage */
+	if (priv->instrument) {
+		add_probe (priv, NSC_STAGE_DECODE, priv->filesrc, "src",
+			   G_CALLBACK (decode_probe_cb));
+		add_probe (priv, NSC_STAGE_ENCODE, priv->encode, "sink",
+			   G_CALLBACK (encode_probe_cb));
+		add_probe (priv, NSC_STAGE_WRITE, priv->filesink, "sink",
+			   G_CALLBACK (write_probe_cb));
+	}
+	if (priv->verify)
+		add_verify_probe (priv);
+
+	priv->build_time = g_get_monotonic_time () - start;
 	priv->rebuild_pipeline = FALSE;
+
+	if (priv->trace != NULL)
+		nsc_trace_span (priv->trace, priv->lane, "file", "build",
+				start, start + priv->build_time, NULL);
 }
 
 static gboolean
@@ -473,6 +1743,10 @@ tick_timeout_cb (NscGStreamer *gstreamer)
 		return FALSE;
 	}
 
+	/* There is no position before the range was seeked to */
+	if (g_atomic_int_get (&priv->seek_state) != SEEK_NONE)
+		return TRUE;
+
 	if (!gst_element_query_position (priv->pipeline,
 					 &format,
 					 &nanos)) {
@@ -497,52 +1771,220 @@ nsc_gstreamer_new (GMAudioProfile *profile)
 	return g_object_new (NSC_TYPE_GSTREAMER, "profile", profile, NULL);
 }
 
-void
-nsc_gstreamer_convert_file (NscGStreamer *gstreamer,
-			    GFile        *src,
-			    GFile        *sink,
-			    GError      **error)
+/**
+ * Make sure there is a pipeline for reading and writing files, or
+ * file descriptors when @streaming.  With @fd_output, files are
+ * read but written to a file descriptor.  With @ranged, only part
+ * of the input is converted.
+ */
+static gboolean
+prepare_pipeline (NscGStreamer  *gstreamer,
+		  gboolean       streaming,
+		  gboolean       fd_output,
+		  gboolean       ranged,
+		  GError       **error)
 {
-	GstStateChangeReturn  state_ret;
-	NscGStreamerPrivate  *priv;
-	gint64                nanos;
-	static GstFormat      format = GST_FORMAT_TIME;
-
-	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
+	NscGStreamerPrivate *priv;
 
-	g_return_if_fail (src != NULL);
-	g_return_if_fail (sink != NULL);
-       
 	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
-	
+
+	/* The last file is no longer reported once another one starts */
+	priv->finishing = FALSE;
+
+	if (priv->streaming != streaming || priv->fd_output != fd_output ||
+	    priv->ranged != ranged) {
+		priv->streaming = streaming;
+		priv->fd_output = fd_output;
+		priv->ranged = ranged;
+		priv->rebuild_pipeline = TRUE;
+	}
+
 	/* See if we need to rebuild the pipeline */
+	priv->build_time = 0;
 	if (priv->rebuild_pipeline != FALSE) {
 		build_pipeline (gstreamer);
 
 		if (priv->construct_error != NULL) {
 			g_propagate_error (error, priv->construct_error);
 			priv->construct_error = NULL;
-			return;
+			return FALSE;
 		}
 	}
 
-	/* Set the input file */
 	gst_element_set_state (priv->filesrc, GST_STATE_NULL);
-	g_object_set (G_OBJECT (priv->filesrc),
-		      "file", src,
-		      NULL);
-
-	/* Set the output filename */
 	gst_element_set_state (priv->filesink, GST_STATE_NULL);
-	g_object_set (G_OBJECT (priv->filesink),
-		      "file", sink,
-		      NULL);
+
+	return TRUE;
+}
+
+/**
+ * Find out how long the input, or the range of it, is once the
+ * input was opened.  Returns FALSE if the range is past its end.
+ */
+static gboolean
+query_duration (NscGStreamer  *gstreamer,
+		GError       **error)
+{
+	NscGStreamerPrivate *priv;
+	gint64               nanos, query;
+	gboolean             queried;
+	static GstFormat     format = GST_FORMAT_TIME;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	priv->stats.startup_time = g_get_monotonic_time () - priv->start_time;
+
+	query = g_get_monotonic_time ();
+	queried = gst_element_query_duration (priv->pipeline, &format, &nanos);
+	priv->stats.query_time = g_get_monotonic_time () - query;
+
+	if (!queried) {
+		/* A pipe does not know how long it is */
+		if (!priv->streaming)
+			g_warning (_("Could not get current file duration"));
+	} else {
+		gint secs;
+
+		priv->stats.source_duration = (gdouble) nanos / GST_SECOND;
+
+		/* Only the range counts, for progress and statistics */
+		if (priv->ranged) {
+			if (priv->range_end >= 0 && priv->range_end < nanos)
+				nanos = priv->range_end;
+			nanos -= priv->range_start;
+		}
+
+		if (nanos <= 0) {
+			g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("The range is past the end of the file"));
+			return FALSE;
+		}
+
+		secs = nanos / GST_SECOND;
+		priv->stats.duration = (gdouble) nanos / GST_SECOND;
+		preallocate_output (gstreamer, priv->stats.duration);
+		g_signal_emit (gstreamer, signals[DURATION], 0, secs);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Seek to the range once the input is open, and let the audio
+ * through.  Nothing reached the encoder before, so the output
+ * holds only the range.  The pipeline prerolls only after this,
+ * so it is started without waiting for it.
+ */
+static gboolean
+range_seek_idle_cb (gpointer data)
+{
+	NscGStreamerPrivate *priv;
+	GstEvent            *seek;
+	GstPad              *pad;
+	GError              *error = NULL;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (data);
+
+	/* The pipeline was released in the meantime */
+	if (priv->range_filter == NULL ||
+	    !g_atomic_int_compare_and_exchange (&priv->seek_state,
+						SEEK_PENDING, SEEK_NONE))
+		return FALSE;
+
+	if (!query_duration (data, &error)) {
+		/* Goes the way of any other error in the pipeline */
+		gst_element_post_message (priv->pipeline,
+					  gst_message_new_error (GST_OBJECT (priv->range_filter),
+								 error, NULL));
+		g_error_free (error);
+		return FALSE;
+	}
+
+	seek = gst_event_new_seek (1.0, GST_FORMAT_TIME,
+				   GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+				   GST_SEEK_TYPE_SET, priv->range_start,
+				   priv->range_end < 0 ? GST_SEEK_TYPE_NONE
+						       : GST_SEEK_TYPE_SET,
+				   priv->range_end < 0 ? GST_CLOCK_TIME_NONE
+						       : priv->range_end);
+
+	if (!gst_element_send_event (priv->range_filter, seek)) {
+		/* Goes the way of any other error in the pipeline */
+		error = g_error_new (NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("Could not seek to the start of the range"));
+		gst_element_post_message (priv->pipeline,
+					  gst_message_new_error (GST_OBJECT (priv->range_filter),
+								 error, NULL));
+		g_error_free (error);
+		return FALSE;
+	}
+
+	pad = gst_element_get_static_pad (priv->range_filter, "src");
+	gst_pad_set_blocked (pad, FALSE);
+	gst_object_unref (pad);
+
+	return FALSE;
+}
+
+/*
+ * Called from the streaming thread every time the audio is held,
+ * which is once before the seek, and may be once after it.
+ */
+static void
+range_blocked_cb (GstPad   *pad,
+		  gboolean  blocked,
+		  gpointer  data)
+{
+	NscGStreamerPrivate *priv;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (data);
+
+	if (blocked &&
+	    g_atomic_int_compare_and_exchange (&priv->seek_state,
+					       SEEK_WAITING, SEEK_PENDING))
+		g_idle_add_full (G_PRIORITY_DEFAULT, range_seek_idle_cb,
+				 g_object_ref (data), g_object_unref);
+}
+
+/**
+ * Start converting what the source and sink were set to.  @uri
+ * names the input in the statistics.
+ */
+static void
+start_pipeline (NscGStreamer  *gstreamer,
+		const gchar   *uri,
+		GError       **error)
+{
+	GstStateChangeReturn  state_ret;
+	NscGStreamerPrivate  *priv;
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	start_stats (gstreamer, uri);
+
+	priv->verify_result = NSC_VERIFY_NONE;
+
+	/* Hold the audio until the input is seeked to the range */
+	if (priv->range_filter != NULL) {
+		GstPad *pad;
+
+		g_atomic_int_set (&priv->seek_state, SEEK_WAITING);
+		pad = gst_element_get_static_pad (priv->range_filter, "src");
+		gst_pad_set_blocked_async_full (pad, TRUE, range_blocked_cb,
+						g_object_ref (gstreamer),
+						g_object_unref);
+		gst_object_unref (pad);
+	}
 
 	/* Let's get ready to rumble! */
 	state_ret = gst_element_set_state (priv->pipeline,
 					   GST_STATE_PLAYING);
 
-	if (state_ret == GST_STATE_CHANGE_ASYNC) {
+	/*
+	 * A ranged pipeline can not preroll before it was seeked, which
+	 * range_seek_idle_cb does once the input is open.
+	 */
+	if (state_ret == GST_STATE_CHANGE_ASYNC && !priv->ranged) {
 		/* 
 		 * Wait for the state change to either complete or fail,
 		 * but not for too long just to catch immediate errors.
@@ -556,10 +1998,14 @@ nsc_gstreamer_convert_file (NscGStreamer *gstreamer,
 
 	if (state_ret == GST_STATE_CHANGE_FAILURE) {
 		GstMessage *msg;
+		GstBus     *bus;
 
-		msg = gst_bus_poll (GST_ELEMENT_BUS (priv->pipeline),
-				    GST_MESSAGE_ERROR,
-				    0);
+		/*
+		 * Polling would run a main loop of its own, and the signal
+		 * watch would report the error as well as the caller.
+		 */
+		bus = GST_ELEMENT_BUS (priv->pipeline);
+		msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
 
 		if (msg) {
 			gst_message_parse_error (msg, error, NULL);
@@ -569,88 +2015,383 @@ nsc_gstreamer_convert_file (NscGStreamer *gstreamer,
 					      "Error starting converting pipeline");
 		}
 
+		/* Nor should any error still on the bus */
+		gst_bus_set_flushing (bus, TRUE);
 		gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+		gst_bus_set_flushing (bus, FALSE);
+		discard_output (gstreamer);
 		priv->rebuild_pipeline = TRUE;
+		finish_stats (gstreamer, FALSE);
 
 		return;
 	}
 
-	/* Get file duration */
-	if (!gst_element_query_duration (priv->pipeline, &format, &nanos)) {
-		g_warning (_("Could not get current file duration"));
-	} else {
-		gint secs;
-
-		secs = nanos / GST_SECOND;
-		g_signal_emit (gstreamer, signals[DURATION], 0, secs);
+	/* A ranged input is only known once it was opened and held */
+	if (!priv->ranged && !query_duration (gstreamer, error)) {
+		gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+		discard_output (gstreamer);
+		priv->rebuild_pipeline = TRUE;
+		finish_stats (gstreamer, FALSE);
+		return;
 	}
 
+	priv->converting = TRUE;
 	priv->tick_id = g_timeout_add (250, (GSourceFunc)tick_timeout_cb,
 				       gstreamer);
 }
 
+/**
+ * The output pool created the local output of a conversion, so
+ * it can start, unless it was cancelled in the meantime.
+ */
+static gboolean
+output_opened_cb (gpointer data)
+{
+	OutputJob           *job = data;
+	NscGStreamer        *gstreamer = job->gstreamer;
+	NscGStreamerPrivate *priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+	GError              *error = NULL;
+
+	if (!priv->opening || job->serial != priv->open_serial) {
+		if (job->fd >= 0) {
+			Teardown *teardown;
+
+			teardown = g_new0 (Teardown, 1);
+			teardown->output_fd = job->fd;
+			teardown->remove_path = job->tmp_path;
+			job->tmp_path = NULL;
+			push_teardown (teardown);
+		}
+	} else if (job->fd < 0) {
+		priv->opening = FALSE;
+
+		start_stats (gstreamer, job->uri);
+		finish_stats (gstreamer, FALSE);
+		error = g_error_new (NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("Unable to write %s; %s"), job->path,
+				     g_strerror (job->error_no));
+	} else {
+		priv->opening = FALSE;
+
+		g_object_set (G_OBJECT (priv->filesink), "fd", job->fd, NULL);
+		priv->output_fd = job->fd;
+		priv->output_tmp = job->tmp_path;
+		job->tmp_path = NULL;
+
+		start_pipeline (gstreamer, job->uri, &error);
+
+		/* Paused before it could start */
+		if (error == NULL && priv->hold)
+			nsc_gstreamer_pause_convert (gstreamer);
+		priv->hold = FALSE;
+	}
+
+	if (error != NULL) {
+		if (priv->trace != NULL)
+			nsc_trace_instant (priv->trace, priv->lane, "file",
+					   "error", error->message);
+		g_signal_emit (gstreamer, signals[ERROR], 0, error);
+		g_error_free (error);
+	}
+
+	g_free (job->path);
+	g_free (job->uri);
+	g_free (job->tmp_path);
+	g_object_unref (job->gstreamer);
+	g_free (job);
+
+	return FALSE;
+}
+
+void
+nsc_gstreamer_convert_file (NscGStreamer *gstreamer,
+			    GFile        *src,
+			    GFile        *sink,
+			    GError      **error)
+{
+	nsc_gstreamer_convert_range (gstreamer, src, sink, 0, -1, error);
+}
+
+/**
+ * Convert only what is between @start and @end of @src, in
+ * nanoseconds, with an @end of -1 for the end of the file.  The
+ * input is seeked to @start, so nothing before it is read or
+ * decoded, and the output starts at zero.  Like any other
+ * conversion, each range gets a pipeline of its own.
+ */
+void
+nsc_gstreamer_convert_range (NscGStreamer *gstreamer,
+			     GFile        *src,
+			     GFile        *sink,
+			     gint64        start,
+			     gint64        end,
+			     GError      **error)
+{
+	NscGStreamerPrivate *priv;
+	OutputJob           *job;
+	gchar               *uri, *path;
+	gboolean             ranged;
+
+	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
+
+	g_return_if_fail (src != NULL);
+	g_return_if_fail (sink != NULL);
+	g_return_if_fail (start >= 0);
+	g_return_if_fail (end < 0 || end > start);
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	/* Anything that is not local goes through GIO */
+	path = g_file_get_path (sink);
+
+	ranged = start > 0 || end >= 0;
+	if (!prepare_pipeline (gstreamer, FALSE, path != NULL, ranged, error)) {
+		g_free (path);
+		return;
+	}
+
+	priv->range_start = start;
+	priv->range_end = end;
+
+	/* Set the input file */
+	g_object_set (G_OBJECT (priv->filesrc),
+		      "file", src,
+		      NULL);
+
+	if (priv->sink_file)
+		g_object_unref (priv->sink_file);
+	priv->sink_file = g_object_ref (sink);
+
+	uri = g_file_get_uri (src);
+
+	/* The pipeline is started once the output pool created the file */
+	if (path != NULL) {
+		job = g_new0 (OutputJob, 1);
+		job->gstreamer = g_object_ref (gstreamer);
+		job->serial = ++priv->open_serial;
+		job->path = path;
+		job->uri = uri;
+		job->fd = -1;
+
+		priv->opening = TRUE;
+		priv->hold = FALSE;
+		push_output_job (job);
+		return;
+	}
+
+	g_object_set (G_OBJECT (priv->filesink), "file", sink, NULL);
+
+	start_pipeline (gstreamer, uri, error);
+	g_free (uri);
+}
+
+/**
+ * Convert whatever can be read from @in_fd, and write the result
+ * to @out_fd.  Either may be a pipe or a socket, so conversions can
+ * sit in a shell pipeline.  The format of the input is detected
+ * from the data.  Both stay open, and the caller closes them once
+ * "completion" or "error" was emitted.
+ */
+void
+nsc_gstreamer_convert_fd (NscGStreamer *gstreamer,
+			  gint          in_fd,
+			  gint          out_fd,
+			  GError      **error)
+{
+	NscGStreamerPrivate *priv;
+	gchar               *uri;
+
+	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
+
+	g_return_if_fail (in_fd >= 0);
+	g_return_if_fail (out_fd >= 0);
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	if (!prepare_pipeline (gstreamer, TRUE, FALSE, FALSE, error))
+		return;
+
+	g_object_set (G_OBJECT (priv->filesrc), "fd", in_fd, NULL);
+	g_object_set (G_OBJECT (priv->filesink), "fd", out_fd, NULL);
+
+	/* There is nothing to remove when cancelled */
+	if (priv->sink_file) {
+		g_object_unref (priv->sink_file);
+		priv->sink_file = NULL;
+	}
+
+	uri = g_strdup_printf ("fd://%d", in_fd);
+	start_pipeline (gstreamer, uri, error);
+	g_free (uri);
+}
+
 void
 nsc_gstreamer_cancel_convert (NscGStreamer *gstreamer)
 {
 	NscGStreamerPrivate *priv;
-	GstState             state;
-	GFile               *sink_file;
-	gchar               *sink_uri;
-	GError              *error = NULL;
 
 	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
 
 	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
 
-	gst_element_get_state (priv->pipeline,
-			       &state,
-			       NULL,
-			       GST_CLOCK_TIME_NONE);
+	/* Whatever the output pool opens is thrown away */
+	if (priv->opening) {
+		priv->opening = FALSE;
+		priv->hold = FALSE;
+		return;
+	}
 
-	if (state != GST_STATE_PLAYING) {
+	/* A file that reached its end is kept, but no longer reported */
+	if (priv->finishing) {
+		priv->finishing = FALSE;
 		return;
 	}
 
-	gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+	if (!priv->converting) {
+		return;
+	}
 
 	/*
-	 * Remove the file that was being converted
-	 * when the cancel button was pressed.
+	 * Stopping the pipeline and removing the file that was being
+	 * converted when the cancel button was pressed are both done
+	 * by the teardown pool, so this returns without blocking.
 	 */
-	g_object_get (G_OBJECT (priv->filesink),
-		      "location", &sink_uri,
-		      NULL);
+	release_pipeline (gstreamer, TRUE);
+}
 
-	sink_file = g_file_new_for_uri (sink_uri);
-	g_file_delete (sink_file, NULL, &error);
+/**
+ * Hold the file being converted where it is, without losing any
+ * of it, until nsc_gstreamer_resume_convert() is called.
+ */
+void
+nsc_gstreamer_pause_convert (NscGStreamer *gstreamer)
+{
+	NscGStreamerPrivate *priv;
 
-	if (error) {
-		g_warning ("Unable to delete file; %s", error->message);
-		g_error_free (error);
+	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	if (priv->opening) {
+		priv->hold = TRUE;
+		return;
+	}
+
+	if (!priv->converting || priv->paused)
+		return;
+
+	gst_element_set_state (priv->pipeline, GST_STATE_PAUSED);
+	priv->paused = TRUE;
+	priv->pause_start = g_get_monotonic_time ();
+
+	if (priv->tick_id) {
+		g_source_remove (priv->tick_id);
+		priv->tick_id = 0;
+	}
+}
+
+void
+nsc_gstreamer_resume_convert (NscGStreamer *gstreamer)
+{
+	NscGStreamerPrivate *priv;
+	gint64               now;
+
+	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	if (priv->opening) {
+		priv->hold = FALSE;
+		return;
 	}
 
-	if (sink_file)
-		g_object_unref (sink_file);
+	if (!priv->converting || !priv->paused)
+		return;
+
+	now = g_get_monotonic_time ();
+	priv->paused = FALSE;
+	priv->paused_time += now - priv->pause_start;
+
+	if (priv->trace != NULL)
+		nsc_trace_span (priv->trace, priv->lane, "file", "paused",
+				priv->pause_start, now, NULL);
 
-	g_free (sink_uri);
+	gst_element_set_state (priv->pipeline, GST_STATE_PLAYING);
+	priv->tick_id = g_timeout_add (250, (GSourceFunc)tick_timeout_cb,
+				       gstreamer);
+}
 
+/**
+ * Put what the pipeline does on @lane of @trace, which needs to
+ * stay around for as long as @gstreamer does.  Tracing also turns on
+ * instrumenting, so the levels of its queues can be followed.
+ */
+void
+nsc_gstreamer_set_trace (NscGStreamer *gstreamer,
+			 NscTrace     *trace,
+			 guint         lane)
+{
+	NscGStreamerPrivate *priv;
+
+	g_return_if_fail (NSC_IS_GSTREAMER (gstreamer));
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	priv->trace = trace;
+	priv->lane = lane;
+
+	g_free (priv->queues_name);
+	priv->queues_name = g_strdup_printf ("queues %u", lane);
+
+	if (trace != NULL)
+		g_object_set (G_OBJECT (gstreamer), "instrument", TRUE, NULL);
 	priv->rebuild_pipeline = TRUE;
 }
 
+/**
+ * The statistics of the last file, valid once it completed or failed.
+ */
+const NscFileStats *
+nsc_gstreamer_get_stats (NscGStreamer *gstreamer)
+{
+	g_return_val_if_fail (NSC_IS_GSTREAMER (gstreamer), NULL);
+
+	return &NSC_GSTREAMER_GET_PRIVATE (gstreamer)->stats;
+}
+
+/**
+ * How the last file checked out against its decoded audio, and the
+ * MD5 of that audio if @pcm_md5 is not NULL.  Valid once it completed
+ * or failed, and NSC_VERIFY_NONE unless verifying.
+ */
+NscVerifyResult
+nsc_gstreamer_get_verify_result (NscGStreamer  *gstreamer,
+				 const gchar  **pcm_md5)
+{
+	NscGStreamerPrivate *priv;
+
+	g_return_val_if_fail (NSC_IS_GSTREAMER (gstreamer), NSC_VERIFY_NONE);
+
+	priv = NSC_GSTREAMER_GET_PRIVATE (gstreamer);
+
+	if (pcm_md5 != NULL)
+		*pcm_md5 = priv->verify_result != NSC_VERIFY_NONE
+			? priv->pcm_md5 : NULL;
+
+	return priv->verify_result;
+}
+
 gboolean
 nsc_gstreamer_supports_mp3 (GError **error)
 {
-	GstElement *element = NULL;
-
-	element = gst_element_factory_make ("mad", "test");
-	if (element == NULL) {
+	/* Any decoder will do, not just mad */
+	if (!nsc_decoders_has_decoder ("audio/mpeg, mpegversion=(int)1, "
+				       "layer=(int)3")) {
 		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
 			     _("The plugin necessary for mp3 file access was not found"));
 		return FALSE;
 	}
 
-	g_object_unref (element);
-
 	return TRUE;
 }
 
@@ -709,17 +2450,12 @@ nsc_gstreamer_supports_musepack (GError **error)
 gboolean
 nsc_gstreamer_supports_wma (GError **error)
 {
-	GstElement *element = NULL;
-
-	element = gst_element_factory_make ("ffdec_wmav2", "test");
-	if (element == NULL) {
+	if (!nsc_decoders_has_decoder ("audio/x-wma")) {
 		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
 			     _("The plugin necessary for wma file access was not found"));
 		return FALSE;
 	}
 
-	g_object_unref (element);
-
 	return TRUE;
 }
 
@@ -31,6 +31,10 @@
 #include <glib-object.h>
 #include <profiles/audio-profile.h>
 
+#include "nsc-stats.h"
+#include "nsc-trace.h"
+#include "nsc-verify.h"
+
 G_BEGIN_DECLS
 
 #define NSC_TYPE_GSTREAMER            (nsc_gstreamer_get_type ())
@@ -63,7 +67,27 @@ void          nsc_gstreamer_convert_file      (NscGStreamer    *gstreamer,
 					       GFile           *src,
 					       GFile           *sink,
 					       GError         **error);
+void          nsc_gstreamer_convert_range     (NscGStreamer    *gstreamer,
+					       GFile           *src,
+					       GFile           *sink,
+					       gint64           start,
+					       gint64           end,
+					       GError         **error);
+void          nsc_gstreamer_convert_fd        (NscGStreamer    *gstreamer,
+					       gint             in_fd,
+					       gint             out_fd,
+					       GError         **error);
 void          nsc_gstreamer_cancel_convert    (NscGStreamer    *gstreamer);
+void          nsc_gstreamer_pause_convert     (NscGStreamer    *gstreamer);
+void          nsc_gstreamer_resume_convert    (NscGStreamer    *gstreamer);
+void          nsc_gstreamer_set_trace         (NscGStreamer    *gstreamer,
+					       NscTrace        *trace,
+					       guint            lane);
+const NscFileStats *
+	      nsc_gstreamer_get_stats         (NscGStreamer    *gstreamer);
+NscVerifyResult
+	      nsc_gstreamer_get_verify_result (NscGStreamer    *gstreamer,
+					       const gchar    **pcm_md5);
 gboolean      nsc_gstreamer_supports_profile  (GMAudioProfile  *profile);
 gboolean      nsc_gstreamer_supports_mp3      (GError         **error);
 gboolean      nsc_gstreamer_supports_wav      (GError         **error);
@@ -0,0 +1,247 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-history.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "nsc-history.h"
+
+#define HISTORY_NAME "history.conf"
+
+/* Weight of the newest file, so the history follows the machine */
+#define HISTORY_WEIGHT 0.25
+
+struct _NscHistory {
+	GKeyFile *config;
+	gchar    *filename;
+};
+
+/*
+ * Private Methods
+ */
+static gchar *
+get_group (const gchar *profile,
+	   const gchar *format)
+{
+	return g_strdup_printf ("%s %s", profile, format);
+}
+
+/**
+ * The average of every format converted with @profile, by the
+ * number of files of each.
+ */
+static gboolean
+lookup_profile (NscHistory  *history,
+		const gchar *profile,
+		gdouble     *realtime_factor,
+		gdouble     *duration)
+{
+	gchar   **groups;
+	gchar    *prefix;
+	gdouble   factor = 0, length = 0;
+	gint      files, total = 0;
+	gint      i;
+
+	prefix = g_strconcat (profile, " ", NULL);
+	groups = g_key_file_get_groups (history->config, NULL);
+
+	for (i = 0; groups[i] != NULL; i++) {
+		if (!g_str_has_prefix (groups[i], prefix))
+			continue;
+
+		files = g_key_file_get_integer (history->config, groups[i],
+						"files", NULL);
+		if (files <= 0)
+			continue;
+
+		factor += files * g_key_file_get_double (history->config,
+							 groups[i],
+							 "realtime_factor",
+							 NULL);
+		length += files * g_key_file_get_double (history->config,
+							 groups[i],
+							 "duration", NULL);
+		total += files;
+	}
+
+	g_strfreev (groups);
+	g_free (prefix);
+
+	if (total == 0 || factor <= 0)
+		return FALSE;
+
+	*realtime_factor = factor / total;
+	*duration = length / total;
+
+	return TRUE;
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * Read the history of earlier runs, which is empty the first time.
+ */
+NscHistory *
+nsc_history_load (void)
+{
+	NscHistory *history;
+
+	history = g_new0 (NscHistory, 1);
+	history->config = g_key_file_new ();
+	history->filename = g_build_filename (g_get_user_config_dir (),
+					      "nautilus-sound-converter",
+					      HISTORY_NAME, NULL);
+
+	g_key_file_load_from_file (history->config, history->filename,
+				   G_KEY_FILE_NONE, NULL);
+
+	return history;
+}
+
+void
+nsc_history_free (NscHistory *history)
+{
+	if (history == NULL)
+		return;
+
+	g_key_file_free (history->config);
+	g_free (history->filename);
+	g_free (history);
+}
+
+/**
+ * How many seconds of audio @profile converted per second for files
+ * of @format, and how long those files were.  Other formats stand in
+ * for one never converted with @profile.  Returns FALSE when there
+ * is no history of @profile at all.
+ */
+gboolean
+nsc_history_lookup (NscHistory  *history,
+		    const gchar *profile,
+		    const gchar *format,
+		    gdouble     *realtime_factor,
+		    gdouble     *duration)
+{
+	gchar   *group;
+	gdouble  factor, length;
+
+	g_return_val_if_fail (history != NULL, FALSE);
+	g_return_val_if_fail (profile != NULL, FALSE);
+	g_return_val_if_fail (realtime_factor != NULL, FALSE);
+	g_return_val_if_fail (duration != NULL, FALSE);
+
+	if (format == NULL)
+		return lookup_profile (history, profile, realtime_factor,
+				       duration);
+
+	group = get_group (profile, format);
+	factor = g_key_file_get_double (history->config, group,
+					"realtime_factor", NULL);
+	length = g_key_file_get_double (history->config, group,
+					"duration", NULL);
+	g_free (group);
+
+	if (factor <= 0)
+		return lookup_profile (history, profile, realtime_factor,
+				       duration);
+
+	*realtime_factor = factor;
+	*duration = length;
+
+	return TRUE;
+}
+
+/**
+ * Fold the file converted in @file_stats into the history of its
+ * profile and @format.  The time it took includes starting and
+ * stopping, which is most of it for short files.
+ */
+void
+nsc_history_add (NscHistory         *history,
+		 const NscFileStats *file_stats,
+		 const gchar        *format)
+{
+	gchar   *group;
+	gdouble  factor, length;
+	gint     files;
+
+	g_return_if_fail (history != NULL);
+	g_return_if_fail (file_stats != NULL);
+
+	if (!file_stats->success || file_stats->profile == NULL ||
+	    format == NULL || file_stats->duration <= 0 ||
+	    file_stats->realtime_factor <= 0)
+		return;
+
+	group = get_group (file_stats->profile, format);
+	files = g_key_file_get_integer (history->config, group,
+					"files", NULL);
+
+	if (files <= 0) {
+		factor = file_stats->realtime_factor;
+		length = file_stats->duration;
+	} else {
+		factor = g_key_file_get_double (history->config, group,
+						"realtime_factor", NULL);
+		length = g_key_file_get_double (history->config, group,
+						"duration", NULL);
+
+		factor += HISTORY_WEIGHT * (file_stats->realtime_factor - factor);
+		length += HISTORY_WEIGHT * (file_stats->duration - length);
+	}
+
+	g_key_file_set_double (history->config, group, "realtime_factor",
+			       factor);
+	g_key_file_set_double (history->config, group, "duration", length);
+	g_key_file_set_integer (history->config, group, "files",
+				MAX (files, 0) + 1);
+	g_free (group);
+}
+
+gboolean
+nsc_history_save (NscHistory  *history,
+		  GError     **error)
+{
+	gchar    *data, *dirname;
+	gsize     length;
+	gboolean  result;
+
+	g_return_val_if_fail (history != NULL, FALSE);
+
+	dirname = g_path_get_dirname (history->filename);
+	g_mkdir_with_parents (dirname, 0755);
+	g_free (dirname);
+
+	data = g_key_file_to_data (history->config, &length, NULL);
+	result = g_file_set_contents (history->filename, data, length,
+				      error);
+	g_free (data);
+
+	return result;
+}
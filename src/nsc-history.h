@@ -0,0 +1,55 @@
+/*
+ *  nsc-history.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_HISTORY_H
+#define NSC_HISTORY_H
+
+#include <glib.h>
+
+#include "nsc-stats.h"
+
+G_BEGIN_DECLS
+
+/*
+ * How fast each profile converted each input format before, kept
+ * across runs so a batch can be timed before it has done anything.
+ */
+typedef struct _NscHistory NscHistory;
+
+NscHistory *nsc_history_load   (void);
+void        nsc_history_free   (NscHistory         *history);
+gboolean    nsc_history_lookup (NscHistory         *history,
+				const gchar        *profile,
+				const gchar        *format,
+				gdouble            *realtime_factor,
+				gdouble            *duration);
+void        nsc_history_add    (NscHistory         *history,
+				const NscFileStats *file_stats,
+				const gchar        *format);
+gboolean    nsc_history_save   (NscHistory         *history,
+				GError            **error);
+
+G_END_DECLS
+
+#endif /* NSC_HISTORY_H */
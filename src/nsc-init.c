@@ -0,0 +1,365 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-init.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <gconf/gconf-client.h>
+#include <gst/gst.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-gstreamer.h"
+#include "nsc-init.h"
+
+/* gconf directory with all our keys */
+#define GCONF_DIR "/apps/nautilus-sound-converter"
+
+/* Seconds after the extension is loaded to start initializing */
+#define PREFETCH_DELAY 2
+
+/*
+ * The formats we can only convert when the right plugin is
+ * installed.  Which ones are is worked out once the registry
+ * has been loaded.
+ */
+static const struct {
+	const gchar *mime_type;
+	gboolean   (*supported) (GError **error);
+} optional_types[] = {
+	{ "audio/mpeg",       nsc_gstreamer_supports_mp3 },
+	{ "audio/mp4",        nsc_gstreamer_supports_aac },
+	{ "audio/x-musepack", nsc_gstreamer_supports_musepack },
+	{ "audio/x-ms-wma",   nsc_gstreamer_supports_wma },
+};
+
+static const gchar *mime_types[G_N_ELEMENTS (optional_types) + 1];
+
+static GThread     *gst_thread = NULL;
+static gboolean     gst_ready = FALSE;
+static gboolean     profiles_ready = FALSE;
+static guint        prefetch_id = 0;
+
+static GConfClient *gconf = NULL;
+static NscSettings  settings;
+
+/* Called once GStreamer is initialized */
+typedef struct {
+	NscInitFunc func;
+	gpointer    data;
+} Waiter;
+
+static GSList      *waiters = NULL;
+
+static gboolean gst_done_cb (gpointer data);
+
+/*
+ * Private Methods
+ */
+
+/**
+ * Runs in a thread of its own, as loading the registry
+ * may have to wait for the plugin scanner.
+ */
+static gpointer
+gst_thread_func (gpointer data)
+{
+	gint64 start;
+	guint  i, n = 0;
+
+	start = g_get_monotonic_time ();
+	gst_init (NULL, NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (optional_types); i++) {
+		if (optional_types[i].supported (NULL))
+			mime_types[n++] = optional_types[i].mime_type;
+	}
+	mime_types[n] = NULL;
+
+	g_debug ("GStreamer initialized in %.1f ms",
+		 (g_get_monotonic_time () - start) / 1000.0);
+
+	if (data != NULL)
+		g_idle_add (gst_done_cb, NULL);
+
+	return NULL;
+}
+
+static void
+start_gst_thread (void)
+{
+	GError *error = NULL;
+
+	if (gst_thread != NULL || gst_ready)
+		return;
+
+	gst_thread = g_thread_try_new ("nsc-init", gst_thread_func,
+				       GINT_TO_POINTER (TRUE), &error);
+	if (gst_thread == NULL) {
+		g_warning ("Unable to start a thread; %s", error->message);
+		g_error_free (error);
+
+		gst_thread_func (NULL);
+		gst_ready = TRUE;
+	}
+}
+
+static void
+wait_gst_thread (void)
+{
+	if (gst_thread == NULL)
+		return;
+
+	g_thread_join (gst_thread);
+	gst_thread = NULL;
+	gst_ready = TRUE;
+}
+
+static gchar *
+get_dir (const gchar *key)
+{
+	gchar *dir;
+
+	dir = gconf_client_get_string (gconf, key, NULL);
+	if (dir != NULL && *dir == '\0') {
+		g_free (dir);
+		dir = NULL;
+	}
+
+	return dir;
+}
+
+/**
+ * source_dir:   use the source directory as the output directory
+ * retry_errors: try failed files again with the alternate decoder
+ * use_service:  convert in the conversion service on the session bus
+ * report_dir:   where batch timing reports go, empty for none
+ * verify_dir:   where verification manifests go, empty for none
+ * trace_dir:    where batch timelines go, empty for none
+ * spill_limit:  queued files kept in memory, 0 for no limit
+ * max_jobs:     files converted at the same time, 0 for one per CPU
+ * throttle:     convert less, or pause, while the machine is busy
+ * split_cue:    split images with a cue sheet into their tracks
+ */
+static void
+read_settings (void)
+{
+	settings.src_dir = gconf_client_get_bool (gconf,
+						  GCONF_DIR "/source_dir",
+						  NULL);
+	settings.retry = gconf_client_get_bool (gconf,
+						GCONF_DIR "/retry_errors",
+						NULL);
+	settings.use_service = gconf_client_get_bool (gconf,
+						      GCONF_DIR "/use_service",
+						      NULL);
+
+	g_free (settings.report_dir);
+	settings.report_dir = get_dir (GCONF_DIR "/report_dir");
+	g_free (settings.verify_dir);
+	settings.verify_dir = get_dir (GCONF_DIR "/verify_dir");
+	g_free (settings.trace_dir);
+	settings.trace_dir = get_dir (GCONF_DIR "/trace_dir");
+	settings.spill_limit = gconf_client_get_int (gconf,
+						     GCONF_DIR "/spill_limit",
+						     NULL);
+	settings.max_jobs = gconf_client_get_int (gconf,
+						  GCONF_DIR "/max_jobs",
+						  NULL);
+	settings.throttle = gconf_client_get_bool (gconf,
+						   GCONF_DIR "/throttle",
+						   NULL);
+	settings.split_cue = gconf_client_get_bool (gconf,
+						    GCONF_DIR "/split_cue",
+						    NULL);
+}
+
+static void
+settings_changed_cb (GConfClient *client,
+		     guint        id,
+		     GConfEntry  *entry,
+		     gpointer     data)
+{
+	read_settings ();
+}
+
+/**
+ * Everything that has to be done in the main loop.  The GConf
+ * client is preloaded, so reading the settings later is free.
+ */
+static void
+init_profiles (void)
+{
+	gint64 start;
+
+	if (profiles_ready)
+		return;
+
+	start = g_get_monotonic_time ();
+
+	gconf = gconf_client_get_default ();
+	gconf_client_add_dir (gconf, GCONF_DIR,
+			      GCONF_CLIENT_PRELOAD_ONELEVEL, NULL);
+	gconf_client_notify_add (gconf, GCONF_DIR, settings_changed_cb,
+				 NULL, NULL, NULL);
+	read_settings ();
+
+	/* The profile chooser is empty until GStreamer is initialized */
+	wait_gst_thread ();
+	gnome_media_profiles_init (gconf);
+
+	profiles_ready = TRUE;
+
+	g_debug ("Profiles and settings loaded in %.1f ms",
+		 (g_get_monotonic_time () - start) / 1000.0);
+}
+
+/**
+ * The background thread is done, so the rest can be
+ * initialized without blocking.
+ */
+static gboolean
+gst_done_cb (gpointer data)
+{
+	GSList *list, *l;
+
+	init_profiles ();
+
+	/* A waiter may add another one */
+	list = g_slist_reverse (waiters);
+	waiters = NULL;
+
+	for (l = list; l != NULL; l = l->next) {
+		Waiter *waiter = l->data;
+
+		waiter->func (waiter->data);
+		g_free (waiter);
+	}
+	g_slist_free (list);
+
+	return FALSE;
+}
+
+static gboolean
+prefetch_cb (gpointer data)
+{
+	prefetch_id = 0;
+
+	start_gst_thread ();
+
+	return FALSE;
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * Start initializing in the background a little while after
+ * Nautilus is done starting up.
+ */
+void
+nsc_init_prefetch (void)
+{
+	if (profiles_ready || gst_thread != NULL || prefetch_id != 0)
+		return;
+
+	prefetch_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+						  PREFETCH_DELAY,
+						  prefetch_cb,
+						  NULL, NULL);
+}
+
+/**
+ * Make sure everything is initialized, waiting for the
+ * background initialization if it is still running.
+ */
+void
+nsc_init_ensure (void)
+{
+	if (prefetch_id != 0) {
+		g_source_remove (prefetch_id);
+		prefetch_id = 0;
+	}
+
+	start_gst_thread ();
+	init_profiles ();
+}
+
+gboolean
+nsc_init_is_ready (void)
+{
+	return profiles_ready;
+}
+
+/**
+ * Call @func once the optional formats are known, without waiting
+ * for GStreamer to be initialized.  It is called right away if it
+ * already is, and otherwise from the main loop once the background
+ * initialization is done, starting it if need be.
+ */
+void
+nsc_init_when_ready (NscInitFunc func,
+		     gpointer    data)
+{
+	Waiter *waiter;
+
+	g_return_if_fail (func != NULL);
+
+	if (prefetch_id != 0) {
+		g_source_remove (prefetch_id);
+		prefetch_id = 0;
+	}
+
+	start_gst_thread ();
+
+	if (gst_ready) {
+		func (data);
+		return;
+	}
+
+	waiter = g_new0 (Waiter, 1);
+	waiter->func = func;
+	waiter->data = data;
+	waiters = g_slist_prepend (waiters, waiter);
+}
+
+/**
+ * The optional formats that can be converted.  Waits
+ * for GStreamer to be initialized.
+ */
+const gchar * const *
+nsc_init_get_mime_types (void)
+{
+	start_gst_thread ();
+	wait_gst_thread ();
+
+	return mime_types;
+}
+
+const NscSettings *
+nsc_init_get_settings (void)
+{
+	nsc_init_ensure ();
+
+	return &settings;
+}
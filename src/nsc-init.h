@@ -0,0 +1,65 @@
+/*
+ *  nsc-init.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_INIT_H
+#define NSC_INIT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Loading the GStreamer registry and the audio profiles is too slow
+ * to do while Nautilus starts, so it is done in the background once
+ * Nautilus is idle, or at the latest when the menu needs it.
+ */
+
+/* What the user chose in GConf, kept up to date */
+typedef struct {
+	gboolean  src_dir;
+	gboolean  retry;
+	gboolean  use_service;
+	gchar    *report_dir;
+	gchar    *verify_dir;
+	gchar    *trace_dir;
+	gint      spill_limit;
+	gint      max_jobs;
+	gboolean  throttle;
+	gboolean  split_cue;
+} NscSettings;
+
+/* Called from the main loop once GStreamer is initialized */
+typedef void (*NscInitFunc) (gpointer data);
+
+void                 nsc_init_prefetch       (void);
+void                 nsc_init_ensure         (void);
+gboolean             nsc_init_is_ready       (void);
+void                 nsc_init_when_ready     (NscInitFunc  func,
+					      gpointer     data);
+const gchar * const *nsc_init_get_mime_types (void);
+const NscSettings   *nsc_init_get_settings   (void);
+
+G_END_DECLS
+
+#endif /* NSC_INIT_H */
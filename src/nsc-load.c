@@ -0,0 +1,164 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-load.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "nsc-load.h"
+
+#define PRESSURE_DIR     "/proc/pressure"
+#define POWER_SUPPLY_DIR "/sys/class/power_supply"
+
+/*
+ * Pressures, in percent, past which other work is clearly waiting
+ * on us.  Busy converts one file at a time, overloaded none at all.
+ */
+#define CPU_BUSY         40.0
+#define CPU_OVERLOADED   80.0
+#define IO_BUSY          20.0
+#define IO_OVERLOADED    50.0
+
+/*
+ * Private Methods
+ */
+static gchar *
+read_line (const gchar *filename)
+{
+	gchar *contents, *newline;
+
+	if (!g_file_get_contents (filename, &contents, NULL, NULL))
+		return NULL;
+
+	newline = strchr (contents, '\n');
+	if (newline != NULL)
+		*newline = '\0';
+
+	return contents;
+}
+
+/**
+ * The avg10 of the "some" line of a pressure file, which starts
+ * out like "some avg10=1.23 avg60=...".
+ */
+static gdouble
+read_pressure (const gchar *resource)
+{
+	gchar   *filename, *line, *avg;
+	gdouble  pressure = -1;
+
+	filename = g_build_filename (PRESSURE_DIR, resource, NULL);
+	line = read_line (filename);
+	g_free (filename);
+
+	if (line == NULL)
+		return -1;
+
+	avg = strstr (line, "avg10=");
+	if (g_str_has_prefix (line, "some ") && avg != NULL)
+		pressure = g_ascii_strtod (avg + strlen ("avg10="), NULL);
+	g_free (line);
+
+	return pressure;
+}
+
+/**
+ * Running on battery means no mains supply is online, while there
+ * is at least one.  Machines without any never run on battery.
+ */
+static gboolean
+read_on_battery (void)
+{
+	GDir        *dir;
+	const gchar *name;
+	gboolean     has_mains = FALSE, online = FALSE;
+
+	dir = g_dir_open (POWER_SUPPLY_DIR, 0, NULL);
+	if (dir == NULL)
+		return FALSE;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *filename, *type, *value;
+
+		filename = g_build_filename (POWER_SUPPLY_DIR, name, "type",
+					     NULL);
+		type = read_line (filename);
+		g_free (filename);
+
+		if (g_strcmp0 (type, "Mains") == 0) {
+			has_mains = TRUE;
+
+			filename = g_build_filename (POWER_SUPPLY_DIR, name,
+						     "online", NULL);
+			value = read_line (filename);
+			g_free (filename);
+
+			if (g_strcmp0 (value, "1") == 0)
+				online = TRUE;
+			g_free (value);
+		}
+		g_free (type);
+	}
+	g_dir_close (dir);
+
+	return has_mains && !online;
+}
+
+/*
+ * Public Methods
+ */
+void
+nsc_load_sample (NscLoad *load)
+{
+	g_return_if_fail (load != NULL);
+
+	load->cpu_pressure = read_pressure ("cpu");
+	load->io_pressure = read_pressure ("io");
+	load->on_battery = read_on_battery ();
+}
+
+/**
+ * How much converting the machine can take right now.  Running on
+ * battery counts as busy, so a laptop is not drained by a batch
+ * converting flat out, but still gets it done.
+ */
+NscLoadLevel
+nsc_load_get_level (const NscLoad *load)
+{
+	g_return_val_if_fail (load != NULL, NSC_LOAD_NORMAL);
+
+	if (load->cpu_pressure >= CPU_OVERLOADED ||
+	    load->io_pressure >= IO_OVERLOADED)
+		return NSC_LOAD_OVERLOADED;
+
+	if (load->on_battery ||
+	    load->cpu_pressure >= CPU_BUSY ||
+	    load->io_pressure >= IO_BUSY)
+		return NSC_LOAD_BUSY;
+
+	return NSC_LOAD_NORMAL;
+}
@@ -0,0 +1,55 @@
+/*
+ *  nsc-load.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_LOAD_H
+#define NSC_LOAD_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * How hard pressed the machine is.  The pressures are the share of
+ * the last ten seconds some task spent waiting for the CPU or for
+ * I/O, in percent, as Linux reports them in /proc/pressure, or -1
+ * where the kernel does not.
+ */
+typedef struct {
+	gdouble  cpu_pressure;
+	gdouble  io_pressure;
+	gboolean on_battery;
+} NscLoad;
+
+typedef enum {
+	NSC_LOAD_NORMAL,
+	NSC_LOAD_BUSY,
+	NSC_LOAD_OVERLOADED
+} NscLoadLevel;
+
+void         nsc_load_sample    (NscLoad       *load);
+NscLoadLevel nsc_load_get_level (const NscLoad *load);
+
+G_END_DECLS
+
+#endif /* NSC_LOAD_H */
@@ -0,0 +1,131 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-loader.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <gmodule.h>
+
+#include "nsc-loader.h"
+
+/* Seconds after startup before the engine is loaded anyway */
+#define STARTUP_DELAY 2
+
+static const NscEngine *engine = NULL;
+static gboolean         load_failed = FALSE;
+static guint            prefetch_id = 0;
+static gboolean         prefetch_soon = FALSE;
+
+static gboolean
+prefetch_idle_cb (gpointer data)
+{
+	const NscEngine *loaded;
+
+	prefetch_id = 0;
+
+	loaded = nsc_loader_get_engine ();
+	if (loaded != NULL)
+		loaded->prefetch ();
+
+	return FALSE;
+}
+
+/**
+ * Load the conversion engine, if it was not loaded already.
+ * Returns NULL if it can not be loaded.
+ */
+const NscEngine *
+nsc_loader_get_engine (void)
+{
+	NscEngineGetFunc  get_engine;
+	GModule          *module;
+	gchar            *path;
+	gint64            start;
+
+	if (engine != NULL || load_failed)
+		return engine;
+
+	start = g_get_monotonic_time ();
+
+	path = g_module_build_path (PKGLIBDIR, NSC_ENGINE_MODULE);
+	module = g_module_open (path, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
+	g_free (path);
+
+	if (module == NULL) {
+		g_warning ("Unable to load the conversion engine; %s",
+			   g_module_error ());
+		load_failed = TRUE;
+		return NULL;
+	}
+
+	if (!g_module_symbol (module, NSC_ENGINE_SYMBOL,
+			      (gpointer *) &get_engine)) {
+		g_warning ("Unable to load the conversion engine; %s",
+			   g_module_error ());
+		g_module_close (module);
+		load_failed = TRUE;
+		return NULL;
+	}
+
+	engine = get_engine ();
+
+	g_debug ("Conversion engine loaded in %.1f ms",
+		 (g_get_monotonic_time () - start) / 1000.0);
+
+	return engine;
+}
+
+/**
+ * Load the engine and start initializing it once the main loop
+ * is idle, because it looks like it is going to be needed.
+ */
+void
+nsc_loader_prefetch (void)
+{
+	if (engine != NULL || load_failed || prefetch_soon)
+		return;
+
+	/* Rather than a little while after startup */
+	if (prefetch_id != 0)
+		g_source_remove (prefetch_id);
+
+	prefetch_soon = TRUE;
+	prefetch_id = g_idle_add_full (G_PRIORITY_LOW, prefetch_idle_cb,
+				       NULL, NULL);
+}
+
+/**
+ * Load the engine a little while after Nautilus is done starting
+ * up, so the first conversion does not wait for it.
+ */
+void
+nsc_loader_prefetch_later (void)
+{
+	if (engine != NULL || load_failed || prefetch_id != 0)
+		return;
+
+	prefetch_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+						  STARTUP_DELAY,
+						  prefetch_idle_cb,
+						  NULL, NULL);
+}
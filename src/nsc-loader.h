@@ -0,0 +1,38 @@
+/*
+ *  nsc-loader.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_LOADER_H
+#define NSC_LOADER_H
+
+#include "nsc-engine.h"
+
+G_BEGIN_DECLS
+
+const NscEngine *nsc_loader_get_engine     (void);
+void             nsc_loader_prefetch       (void);
+void             nsc_loader_prefetch_later (void);
+
+G_END_DECLS
+
+#endif /* NSC_LOADER_H */
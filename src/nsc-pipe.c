@@ -0,0 +1,143 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-pipe.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+/*
+ * Pipe mode.  Converts what comes in on standard input and writes
+ * it to standard output, so conversions can sit in a shell pipeline
+ * without any temporary files:
+ *
+ *   recorder | nautilus-sound-converter-pipe -p cdlossless > take.flac
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gconf/gconf-client.h>
+#include <glib/gi18n.h>
+#include <gst/gst.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-gstreamer.h"
+
+/* Default profile name */
+#define DEFAULT_AUDIO_PROFILE_NAME "cdlossy"
+
+static GMainLoop *loop = NULL;
+static gboolean   failed = FALSE;
+
+/* Options */
+static gchar     *profile_id = NULL;
+
+static GOptionEntry entries[] = {
+	{ "profile", 'p', 0, G_OPTION_ARG_STRING, &profile_id,
+	  N_("Audio profile to convert with"), N_("ID") },
+	{ NULL }
+};
+
+static void
+completion_cb (NscGStreamer *gstreamer, gpointer data)
+{
+	g_main_loop_quit (loop);
+}
+
+static void
+error_cb (NscGStreamer *gstreamer, GError *error, gpointer data)
+{
+	g_printerr (_("Could not convert: %s\n"), error->message);
+	failed = TRUE;
+	g_main_loop_quit (loop);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GConfClient    *gconf;
+	GMAudioProfile *profile;
+	NscGStreamer   *gstreamer;
+	GError         *error = NULL;
+
+	bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+	g_type_init ();
+
+	context = g_option_context_new (_("- Convert audio from standard input to standard output"));
+	g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+	g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+	g_option_context_add_group (context, gst_init_get_option_group ());
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (isatty (STDOUT_FILENO)) {
+		g_printerr (_("Not writing audio to a terminal, redirect the output to a file or a pipe\n"));
+		return EXIT_FAILURE;
+	}
+
+	gconf = gconf_client_get_default ();
+	gnome_media_profiles_init (gconf);
+
+	profile = gm_audio_profile_lookup (profile_id ? profile_id
+					   : DEFAULT_AUDIO_PROFILE_NAME);
+	if (profile == NULL || !nsc_gstreamer_supports_profile (profile)) {
+		g_printerr (_("The audio profile '%s' is not available\n"),
+			    profile_id ? profile_id
+				       : DEFAULT_AUDIO_PROFILE_NAME);
+		return EXIT_FAILURE;
+	}
+
+	loop = g_main_loop_new (NULL, FALSE);
+
+	gstreamer = nsc_gstreamer_new (profile);
+	g_signal_connect (gstreamer, "completion",
+			  G_CALLBACK (completion_cb), NULL);
+	g_signal_connect (gstreamer, "error",
+			  G_CALLBACK (error_cb), NULL);
+
+	nsc_gstreamer_convert_fd (gstreamer, STDIN_FILENO, STDOUT_FILENO,
+				  &error);
+	if (error != NULL) {
+		g_printerr (_("Could not convert: %s\n"), error->message);
+		g_error_free (error);
+		failed = TRUE;
+	} else {
+		g_main_loop_run (loop);
+	}
+
+	g_object_unref (gstreamer);
+	g_main_loop_unref (loop);
+	g_object_unref (gconf);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
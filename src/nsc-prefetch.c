@@ -0,0 +1,179 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-prefetch.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+
+#include "nsc-prefetch.h"
+
+/* Files read ahead at the same time, over every batch */
+#define PREFETCH_THREADS 2
+
+/* How much of each file is read ahead */
+#define PREFETCH_BYTES   (16 * 1024 * 1024)
+#define CHUNK_SIZE       (256 * 1024)
+
+/* The files asked for lately, so none is read ahead twice */
+#define N_RECENT         4
+
+struct _NscPrefetch {
+	GCancellable *cancellable;
+	gchar        *recent[N_RECENT];
+	guint         next_recent;
+};
+
+typedef struct {
+	gchar        *path;
+	GCancellable *cancellable;
+} Job;
+
+static GThreadPool *prefetch_pool = NULL;
+
+/*
+ * Private Methods
+ */
+static void
+prefetch_func (gpointer data,
+	       gpointer user_data)
+{
+	Job     *job = data;
+	gchar   *buffer;
+	gssize   n_read;
+	gsize    total = 0;
+	gint     fd;
+
+	if (g_cancellable_is_cancelled (job->cancellable))
+		goto out;
+
+	fd = open (job->path, O_RDONLY);
+	if (fd < 0)
+		goto out;
+
+#ifdef POSIX_FADV_WILLNEED
+	/* Enough for local disks and NFS, which read ahead on their own */
+	posix_fadvise (fd, 0, PREFETCH_BYTES, POSIX_FADV_WILLNEED);
+#endif
+
+	/* FUSE and some network filesystems ignore that, so read it too */
+	buffer = g_malloc (CHUNK_SIZE);
+	while (total < PREFETCH_BYTES &&
+	       !g_cancellable_is_cancelled (job->cancellable)) {
+		n_read = read (fd, buffer, CHUNK_SIZE);
+		if (n_read <= 0)
+			break;
+		total += n_read;
+	}
+	g_free (buffer);
+
+	close (fd);
+
+out:
+	g_object_unref (job->cancellable);
+	g_free (job->path);
+	g_free (job);
+}
+
+/*
+ * Public Methods
+ */
+NscPrefetch *
+nsc_prefetch_new (void)
+{
+	NscPrefetch *prefetch;
+
+	prefetch = g_new0 (NscPrefetch, 1);
+	prefetch->cancellable = g_cancellable_new ();
+
+	return prefetch;
+}
+
+/**
+ * Stop reading ahead what is still queued for @prefetch.
+ */
+void
+nsc_prefetch_free (NscPrefetch *prefetch)
+{
+	gint i;
+
+	if (prefetch == NULL)
+		return;
+
+	g_cancellable_cancel (prefetch->cancellable);
+	g_object_unref (prefetch->cancellable);
+
+	for (i = 0; i < N_RECENT; i++)
+		g_free (prefetch->recent[i]);
+
+	g_free (prefetch);
+}
+
+/**
+ * Start reading @uri in the background, unless it was asked for
+ * lately or has no local path.
+ */
+void
+nsc_prefetch_file (NscPrefetch *prefetch,
+		   const gchar *uri)
+{
+	Job   *job;
+	GFile *file;
+	gchar *path;
+	gint   i;
+
+	g_return_if_fail (prefetch != NULL);
+	g_return_if_fail (uri != NULL);
+
+	for (i = 0; i < N_RECENT; i++) {
+		if (g_strcmp0 (prefetch->recent[i], uri) == 0)
+			return;
+	}
+
+	g_free (prefetch->recent[prefetch->next_recent]);
+	prefetch->recent[prefetch->next_recent] = g_strdup (uri);
+	prefetch->next_recent = (prefetch->next_recent + 1) % N_RECENT;
+
+	file = g_file_new_for_uri (uri);
+	path = g_file_get_path (file);
+	g_object_unref (file);
+
+	if (path == NULL)
+		return;
+
+	job = g_new0 (Job, 1);
+	job->path = path;
+	job->cancellable = g_object_ref (prefetch->cancellable);
+
+	if (prefetch_pool == NULL)
+		prefetch_pool = g_thread_pool_new (prefetch_func, NULL,
+						   PREFETCH_THREADS,
+						   FALSE, NULL);
+
+	g_thread_pool_push (prefetch_pool, job, NULL);
+}
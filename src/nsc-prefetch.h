@@ -0,0 +1,48 @@
+/*
+ *  nsc-prefetch.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_PREFETCH_H
+#define NSC_PREFETCH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Reads the start of the files a batch converts next into the page
+ * cache, in the background, so the next file does not begin with a
+ * cold read from a slow disk or network mount while the encoder
+ * waits.  Only files with a local path, FUSE mounts included, are
+ * read ahead, and only up to a limit per file.
+ */
+typedef struct _NscPrefetch NscPrefetch;
+
+NscPrefetch *nsc_prefetch_new  (void);
+void         nsc_prefetch_free (NscPrefetch *prefetch);
+void         nsc_prefetch_file (NscPrefetch *prefetch,
+				const gchar *uri);
+
+G_END_DECLS
+
+#endif /* NSC_PREFETCH_H */
@@ -0,0 +1,415 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-queue.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "nsc-queue.h"
+
+/* Files read back from the spill file at a time */
+#define SPILL_CHUNK 256
+
+/*
+ * A file, split after the last '/' of its URI.  The name is
+ * stored inline, so this is the only allocation it needs.
+ */
+typedef struct {
+	const gchar *dir;
+	const gchar *subdir;
+	gchar        name[1];
+} Entry;
+
+struct _NscQueue {
+	/* An Entry per file, or NULL once released or while spilled */
+	GPtrArray  *entries;
+	guint       n_live;
+
+	/* The directories, each kept once */
+	GHashTable *strings;
+
+	/* Bytes allocated for the entries and strings */
+	gsize       size;
+
+	/* Files kept in memory before spilling, or 0 for no limit */
+	guint       limit;
+
+	/* The files from spill_first on are in the spill file */
+	FILE       *spill;
+	gchar      *spill_path;
+	guint       spill_first;
+	guint       n_spilled;
+	long        read_offset;
+};
+
+/*
+ * Private Methods
+ */
+static const gchar *
+intern (NscQueue    *queue,
+	const gchar *string,
+	gssize       len)
+{
+	gchar *key, *found;
+
+	if (string == NULL)
+		return NULL;
+
+	key = len < 0 ? g_strdup (string) : g_strndup (string, len);
+
+	found = g_hash_table_lookup (queue->strings, key);
+	if (found != NULL) {
+		g_free (key);
+		return found;
+	}
+
+	g_hash_table_insert (queue->strings, key, key);
+	queue->size += strlen (key) + 1;
+
+	return key;
+}
+
+static void
+store (NscQueue    *queue,
+       guint        index,
+       const gchar *uri,
+       const gchar *subdir)
+{
+	Entry       *entry;
+	const gchar *name;
+	gsize        len;
+
+	/* The URI is escaped, so the last '/' ends the directory */
+	name = strrchr (uri, '/');
+	name = name != NULL ? name + 1 : uri;
+	len = strlen (name);
+
+	entry = g_malloc (offsetof (Entry, name) + len + 1);
+	entry->dir = intern (queue, uri, name - uri);
+	entry->subdir = intern (queue, subdir, -1);
+	memcpy (entry->name, name, len + 1);
+
+	g_ptr_array_index (queue->entries, index) = entry;
+	queue->n_live++;
+	queue->size += offsetof (Entry, name) + len + 1;
+}
+
+/**
+ * Subdirectories may hold any character, so they are escaped to
+ * keep a file to a line.  An empty one stands for none.
+ */
+static gboolean
+spill_entry (NscQueue    *queue,
+	     const gchar *uri,
+	     const gchar *subdir)
+{
+	gchar *escaped;
+	gint   result;
+
+	escaped = g_strescape (subdir != NULL ? subdir : "", NULL);
+
+	fseek (queue->spill, 0, SEEK_END);
+	result = fprintf (queue->spill, "%s\t%s\n", escaped, uri);
+	g_free (escaped);
+
+	return result >= 0;
+}
+
+/**
+ * Read back spilled files, at least up to @index, and as many
+ * more as fit.
+ */
+static void
+unspill (NscQueue *queue,
+	 guint     index)
+{
+	gchar   *line = NULL;
+	size_t   line_len = 0;
+	guint    n = 0;
+
+	if (queue->n_spilled == 0 || index < queue->spill_first)
+		return;
+
+	fseek (queue->spill, queue->read_offset, SEEK_SET);
+
+	while (queue->n_spilled > 0 &&
+	       (queue->spill_first <= index ||
+		(n < SPILL_CHUNK && queue->n_live < queue->limit))) {
+		gchar *tab, *subdir;
+		gssize read;
+
+		read = getline (&line, &line_len, queue->spill);
+		if (read <= 0 || (tab = strchr (line, '\t')) == NULL) {
+			g_warning ("Unable to read the spilled queue; %s",
+				   g_strerror (errno));
+			break;
+		}
+
+		*tab = '\0';
+		if (line[read - 1] == '\n')
+			line[read - 1] = '\0';
+
+		subdir = g_strcompress (line);
+		store (queue, queue->spill_first, tab + 1,
+		       *subdir != '\0' ? subdir : NULL);
+		g_free (subdir);
+
+		queue->spill_first++;
+		queue->n_spilled--;
+		n++;
+	}
+
+	queue->read_offset = ftell (queue->spill);
+	free (line);
+
+	/* Start the file over once it has all been read */
+	if (queue->n_spilled == 0) {
+		if (ftruncate (fileno (queue->spill), 0) != 0)
+			g_warning ("Unable to empty the spilled queue; %s",
+				   g_strerror (errno));
+		queue->read_offset = 0;
+	}
+}
+
+static void
+stop_spill (NscQueue *queue)
+{
+	if (queue->spill == NULL)
+		return;
+
+	fclose (queue->spill);
+	g_unlink (queue->spill_path);
+	g_free (queue->spill_path);
+
+	queue->spill = NULL;
+	queue->spill_path = NULL;
+}
+
+static Entry *
+get_entry (NscQueue *queue,
+	   guint     index)
+{
+	unspill (queue, index);
+
+	return g_ptr_array_index (queue->entries, index);
+}
+
+/*
+ * Public Methods
+ */
+NscQueue *
+nsc_queue_new (void)
+{
+	NscQueue *queue;
+
+	queue = g_new0 (NscQueue, 1);
+	queue->entries = g_ptr_array_new ();
+	queue->strings = g_hash_table_new_full (g_str_hash, g_str_equal,
+						g_free, NULL);
+
+	return queue;
+}
+
+void
+nsc_queue_free (NscQueue *queue)
+{
+	if (queue == NULL)
+		return;
+
+	g_ptr_array_foreach (queue->entries, (GFunc) g_free, NULL);
+	g_ptr_array_free (queue->entries, TRUE);
+	g_hash_table_destroy (queue->strings);
+	stop_spill (queue);
+
+	g_free (queue);
+}
+
+/**
+ * Keep no more than @limit files in memory, writing the rest
+ * to a file in the temporary directory.  Only files added after
+ * this are spilled.
+ */
+gboolean
+nsc_queue_set_spill (NscQueue  *queue,
+		     guint      limit,
+		     GError   **error)
+{
+	gint fd;
+
+	g_return_val_if_fail (queue != NULL, FALSE);
+	g_return_val_if_fail (limit > 0, FALSE);
+
+	queue->limit = limit;
+
+	if (queue->spill != NULL)
+		return TRUE;
+
+	fd = g_file_open_tmp ("nsc-queue-XXXXXX", &queue->spill_path, error);
+	if (fd < 0)
+		return FALSE;
+
+	queue->spill = fdopen (fd, "w+");
+	if (queue->spill == NULL) {
+		g_set_error (error, G_FILE_ERROR,
+			     g_file_error_from_errno (errno),
+			     _("Unable to open the queue file; %s"),
+			     g_strerror (errno));
+		close (fd);
+		g_unlink (queue->spill_path);
+		g_free (queue->spill_path);
+		queue->spill_path = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Returns the index of the new file.
+ */
+guint
+nsc_queue_add (NscQueue    *queue,
+	       const gchar *uri,
+	       const gchar *subdir)
+{
+	guint index;
+
+	g_return_val_if_fail (queue != NULL, 0);
+	g_return_val_if_fail (uri != NULL, 0);
+
+	index = queue->entries->len;
+	g_ptr_array_add (queue->entries, NULL);
+
+	/* Once a file is spilled, the ones after it are too */
+	if (queue->spill != NULL &&
+	    (queue->n_spilled > 0 || queue->n_live >= queue->limit)) {
+		if (spill_entry (queue, uri, subdir)) {
+			if (queue->n_spilled == 0)
+				queue->spill_first = index;
+			queue->n_spilled++;
+			return index;
+		}
+
+		/* Keep everything in memory rather than lose files */
+		g_warning ("Unable to spill the queue; %s",
+			   g_strerror (errno));
+		unspill (queue, G_MAXUINT);
+		stop_spill (queue);
+	}
+
+	store (queue, index, uri, subdir);
+
+	return index;
+}
+
+guint
+nsc_queue_get_length (NscQueue *queue)
+{
+	g_return_val_if_fail (queue != NULL, 0);
+
+	return queue->entries->len;
+}
+
+/**
+ * Returns a newly allocated URI, or NULL if the file was released.
+ */
+gchar *
+nsc_queue_get_uri (NscQueue *queue,
+		   guint     index)
+{
+	Entry *entry;
+
+	g_return_val_if_fail (queue != NULL, NULL);
+	g_return_val_if_fail (index < queue->entries->len, NULL);
+
+	entry = get_entry (queue, index);
+	if (entry == NULL)
+		return NULL;
+
+	return g_strconcat (entry->dir, entry->name, NULL);
+}
+
+/**
+ * The directory the file is to be saved in, relative to the
+ * output directory, or NULL.
+ */
+const gchar *
+nsc_queue_get_subdir (NscQueue *queue,
+		      guint     index)
+{
+	Entry *entry;
+
+	g_return_val_if_fail (queue != NULL, NULL);
+	g_return_val_if_fail (index < queue->entries->len, NULL);
+
+	entry = get_entry (queue, index);
+	if (entry == NULL)
+		return NULL;
+
+	return entry->subdir;
+}
+
+/**
+ * The batch is done with the file, so free it.  Its index
+ * stays valid, but says nothing any more.
+ */
+void
+nsc_queue_release (NscQueue *queue,
+		   guint     index)
+{
+	Entry *entry;
+
+	g_return_if_fail (queue != NULL);
+	g_return_if_fail (index < queue->entries->len);
+
+	entry = get_entry (queue, index);
+	if (entry == NULL)
+		return;
+
+	queue->size -= offsetof (Entry, name) + strlen (entry->name) + 1;
+	queue->n_live--;
+	g_free (entry);
+	g_ptr_array_index (queue->entries, index) = NULL;
+}
+
+/**
+ * Roughly the memory held by the queue, in bytes.
+ */
+gsize
+nsc_queue_get_size (NscQueue *queue)
+{
+	g_return_val_if_fail (queue != NULL, 0);
+
+	return sizeof (NscQueue) + queue->size +
+		queue->entries->len * sizeof (gpointer);
+}
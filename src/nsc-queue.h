@@ -0,0 +1,60 @@
+/*
+ *  nsc-queue.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_QUEUE_H
+#define NSC_QUEUE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The files of a batch, kept as small as we can: a single allocation
+ * per file holding its name, with the directories shared between the
+ * files in them.  A file is freed as soon as the batch is done with
+ * it.  Past a limit, new files go to a spill file on disk and are
+ * read back as the ones in memory are released.
+ */
+typedef struct _NscQueue NscQueue;
+
+NscQueue    *nsc_queue_new        (void);
+void         nsc_queue_free       (NscQueue     *queue);
+gboolean     nsc_queue_set_spill  (NscQueue     *queue,
+				   guint         limit,
+				   GError      **error);
+guint        nsc_queue_add        (NscQueue     *queue,
+				   const gchar  *uri,
+				   const gchar  *subdir);
+guint        nsc_queue_get_length (NscQueue     *queue);
+gchar       *nsc_queue_get_uri    (NscQueue     *queue,
+				   guint         index);
+const gchar *nsc_queue_get_subdir (NscQueue     *queue,
+				   guint         index);
+void         nsc_queue_release    (NscQueue     *queue,
+				   guint         index);
+gsize        nsc_queue_get_size   (NscQueue     *queue);
+
+G_END_DECLS
+
+#endif /* NSC_QUEUE_H */
@@ -0,0 +1,492 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-remote-batch.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-dbus.h"
+#include "nsc-error.h"
+#include "nsc-remote-batch.h"
+
+typedef struct _NscRemoteBatchPrivate NscRemoteBatchPrivate;
+
+struct _NscRemoteBatchPrivate {
+	/* Proxy for the conversion service */
+	GDBusProxy *proxy;
+
+	/* The job number the service gave us */
+	guint       job;
+	gboolean    submitted;
+
+	gboolean    running;
+	gboolean    cancelled;
+
+	/* Paused by the user, which is sent once the job is known */
+	gboolean    paused;
+
+	/* The file the service is working on */
+	guint       current;
+	gboolean    started;
+};
+
+#define NSC_REMOTE_BATCH_GET_PRIVATE(o)           \
+	((NscRemoteBatchPrivate *)((NSC_REMOTE_BATCH(o))->priv))
+
+G_DEFINE_TYPE (NscRemoteBatch, nsc_remote_batch, NSC_TYPE_BATCH)
+
+static void
+nsc_remote_batch_dispose (GObject *object)
+{
+	NscRemoteBatch        *self = (NscRemoteBatch *) object;
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (self);
+
+	if (priv != NULL && priv->proxy) {
+		g_signal_handlers_disconnect_matched (priv->proxy,
+						      G_SIGNAL_MATCH_DATA,
+						      0, 0, NULL, NULL, self);
+		g_object_unref (priv->proxy);
+		priv->proxy = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_remote_batch_parent_class)->dispose (object);
+}
+
+static void
+nsc_remote_batch_finalize (GObject *object)
+{
+	NscRemoteBatch *self = (NscRemoteBatch *) object;
+
+	if (self->priv != NULL) {
+		g_free (self->priv);
+		self->priv = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_remote_batch_parent_class)->finalize (object);
+}
+
+/*
+ * Private Methods
+ */
+
+/**
+ * The service went away in the middle of the batch, so fail
+ * the file it was working on and finish up.
+ */
+static void
+service_lost (NscRemoteBatch *batch)
+{
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+	GError                *error;
+
+	if (!priv->running)
+		return;
+
+	priv->running = FALSE;
+
+	if (priv->started) {
+		error = g_error_new (NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("The conversion service quit unexpectedly"));
+		g_signal_emit_by_name (batch, "file-failed",
+				       priv->current, error);
+		g_error_free (error);
+	}
+
+	g_signal_emit_by_name (batch, "finished");
+}
+
+static void
+name_owner_cb (GObject    *object,
+	       GParamSpec *pspec,
+	       gpointer    data)
+{
+	gchar *owner;
+
+	owner = g_dbus_proxy_get_name_owner (G_DBUS_PROXY (object));
+	if (owner == NULL)
+		service_lost (NSC_REMOTE_BATCH (data));
+	g_free (owner);
+}
+
+static void
+service_signal_cb (GDBusProxy  *proxy,
+		   const gchar *sender_name,
+		   const gchar *signal_name,
+		   GVariant    *parameters,
+		   gpointer     data)
+{
+	NscRemoteBatch        *batch = NSC_REMOTE_BATCH (data);
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+	guint                  job;
+
+	if (!priv->running || !priv->submitted)
+		return;
+
+	/* Every signal starts with the job it belongs to */
+	g_variant_get_child (parameters, 0, "u", &job);
+	if (job != priv->job)
+		return;
+
+	if (strcmp (signal_name, "FileStarted") == 0) {
+		g_variant_get (parameters, "(uu)", NULL, &priv->current);
+		priv->started = TRUE;
+		g_signal_emit_by_name (batch, "file-started", priv->current);
+	} else if (strcmp (signal_name, "Duration") == 0) {
+		gint seconds;
+
+		g_variant_get (parameters, "(ui)", NULL, &seconds);
+		g_signal_emit_by_name (batch, "duration", seconds);
+	} else if (strcmp (signal_name, "Progress") == 0) {
+		gint seconds;
+
+		g_variant_get (parameters, "(ui)", NULL, &seconds);
+		g_signal_emit_by_name (batch, "progress", seconds);
+	} else if (strcmp (signal_name, "FileCompleted") == 0) {
+		guint index;
+
+		g_variant_get (parameters, "(uu)", NULL, &index);
+		priv->started = FALSE;
+		g_signal_emit_by_name (batch, "file-completed", index);
+	} else if (strcmp (signal_name, "FileFailed") == 0) {
+		const gchar *message;
+		GError      *error;
+		guint        index;
+
+		g_variant_get (parameters, "(u&s)", NULL, &index, &message);
+		priv->started = FALSE;
+
+		error = g_error_new_literal (NSC_ERROR,
+					     NSC_ERROR_INTERNAL_ERROR,
+					     message);
+		g_signal_emit_by_name (batch, "file-failed", index, error);
+		g_error_free (error);
+	} else if (strcmp (signal_name, "Retrying") == 0) {
+		guint n_files;
+
+		g_variant_get (parameters, "(uu)", NULL, &n_files);
+		g_signal_emit_by_name (batch, "retrying", n_files);
+	} else if (strcmp (signal_name, "Paused") == 0) {
+		gboolean paused;
+
+		g_variant_get (parameters, "(ub)", NULL, &paused);
+		g_signal_emit_by_name (batch, "paused", paused);
+	} else if (strcmp (signal_name, "Finished") == 0) {
+		priv->running = FALSE;
+		g_signal_emit_by_name (batch, "finished");
+	}
+}
+
+static void
+cancel_job (NscRemoteBatch *batch)
+{
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+
+	g_dbus_proxy_call (priv->proxy, "Cancel",
+			   g_variant_new ("(u)", priv->job),
+			   G_DBUS_CALL_FLAGS_NONE, -1,
+			   NULL, NULL, NULL);
+}
+
+static void
+pause_job (NscRemoteBatch *batch)
+{
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+
+	g_dbus_proxy_call (priv->proxy, priv->paused ? "Pause" : "Resume",
+			   g_variant_new ("(u)", priv->job),
+			   G_DBUS_CALL_FLAGS_NONE, -1,
+			   NULL, NULL, NULL);
+}
+
+static void
+submit_cb (GObject      *source,
+	   GAsyncResult *res,
+	   gpointer      data)
+{
+	NscRemoteBatch        *batch = NSC_REMOTE_BATCH (data);
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+	GVariant              *result;
+	GError                *error = NULL;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+
+	if (result == NULL) {
+		/* The service would not take the job, so nothing was converted */
+		if (priv->running) {
+			guint i, n_files;
+
+			priv->running = FALSE;
+			n_files = nsc_batch_get_n_files (NSC_BATCH (batch));
+			for (i = 0; i < n_files; i++)
+				g_signal_emit_by_name (batch, "file-failed",
+						       i, error);
+			g_signal_emit_by_name (batch, "finished");
+		}
+
+		g_error_free (error);
+		g_object_unref (batch);
+		return;
+	}
+
+	g_variant_get (result, "(u)", &priv->job);
+	g_variant_unref (result);
+	priv->submitted = TRUE;
+
+	if (priv->cancelled)
+		cancel_job (batch);
+	else if (priv->paused)
+		pause_job (batch);
+
+	g_object_unref (batch);
+}
+
+static void
+nsc_remote_batch_start (NscBatch *batch)
+{
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+	const gchar           *output_uri;
+	gchar                **uris;
+	guint                  i, n_files;
+
+	g_return_if_fail (!priv->running);
+
+	n_files = nsc_batch_get_n_files (batch);
+	uris = g_new0 (gchar *, n_files + 1);
+	for (i = 0; i < n_files; i++) {
+		GFile *file;
+
+		file = nsc_batch_get_file (batch, i);
+		uris[i] = g_file_get_uri (file);
+		g_object_unref (file);
+	}
+
+	output_uri = nsc_batch_get_output_uri (batch);
+
+	priv->running = TRUE;
+	priv->submitted = FALSE;
+	priv->cancelled = FALSE;
+
+	g_dbus_proxy_call (priv->proxy, "Submit",
+			   g_variant_new ("(^assb)",
+					  uris,
+					  gm_audio_profile_get_id (nsc_batch_get_profile (batch)),
+					  output_uri ? output_uri : "",
+					  nsc_batch_get_retry (batch)),
+			   G_DBUS_CALL_FLAGS_NONE, -1,
+			   NULL, submit_cb, g_object_ref (batch));
+
+	g_strfreev (uris);
+}
+
+static void
+nsc_remote_batch_cancel (NscBatch *batch)
+{
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+
+	if (!priv->running)
+		return;
+
+	priv->running = FALSE;
+	priv->cancelled = TRUE;
+
+	/* Otherwise this is done as soon as we know the job number */
+	if (priv->submitted)
+		cancel_job (NSC_REMOTE_BATCH (batch));
+}
+
+static void
+nsc_remote_batch_pause (NscBatch *batch)
+{
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+
+	priv->paused = TRUE;
+	if (priv->running && priv->submitted)
+		pause_job (NSC_REMOTE_BATCH (batch));
+}
+
+static void
+nsc_remote_batch_resume (NscBatch *batch)
+{
+	NscRemoteBatchPrivate *priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+
+	priv->paused = FALSE;
+	if (priv->running && priv->submitted)
+		pause_job (NSC_REMOTE_BATCH (batch));
+}
+
+static void
+nsc_remote_batch_class_init (NscRemoteBatchClass *klass)
+{
+	GObjectClass  *object_class = G_OBJECT_CLASS (klass);
+	NscBatchClass *batch_class = NSC_BATCH_CLASS (klass);
+
+	object_class->dispose  = nsc_remote_batch_dispose;
+	object_class->finalize = nsc_remote_batch_finalize;
+
+	batch_class->start  = nsc_remote_batch_start;
+	batch_class->cancel = nsc_remote_batch_cancel;
+	batch_class->pause  = nsc_remote_batch_pause;
+	batch_class->resume = nsc_remote_batch_resume;
+}
+
+static void
+nsc_remote_batch_init (NscRemoteBatch *self)
+{
+	/* Allocate Private data structure */
+	self->priv = g_malloc0 (sizeof (NscRemoteBatchPrivate));
+}
+
+/* What the batch is made with once the service answers */
+typedef struct {
+	GMAudioProfile *profile;
+	gchar          *output_uri;
+} NewData;
+
+static void
+new_data_free (NewData *data)
+{
+	g_object_unref (data->profile);
+	g_free (data->output_uri);
+	g_free (data);
+}
+
+static void
+proxy_new_cb (GObject      *source,
+	      GAsyncResult *res,
+	      gpointer      user_data)
+{
+	GSimpleAsyncResult    *simple = user_data;
+	NewData               *data;
+	NscBatch              *batch;
+	NscRemoteBatchPrivate *priv;
+	GDBusProxy            *proxy;
+	GError                *error = NULL;
+	gchar                 *owner;
+
+	data = g_simple_async_result_get_op_res_gpointer (simple);
+
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		g_simple_async_result_take_error (simple, error);
+		g_simple_async_result_complete (simple);
+		g_object_unref (simple);
+		return;
+	}
+
+	owner = g_dbus_proxy_get_name_owner (proxy);
+	if (owner == NULL) {
+		g_simple_async_result_set_error (simple, NSC_ERROR,
+						 NSC_ERROR_INTERNAL_ERROR,
+						 _("The conversion service is not available"));
+		g_simple_async_result_complete (simple);
+		g_object_unref (simple);
+		g_object_unref (proxy);
+		return;
+	}
+	g_free (owner);
+
+	batch = g_object_new (NSC_TYPE_REMOTE_BATCH,
+			      "profile", data->profile,
+			      "output-uri", data->output_uri,
+			      NULL);
+
+	priv = NSC_REMOTE_BATCH_GET_PRIVATE (batch);
+	priv->proxy = proxy;
+
+	g_signal_connect (G_OBJECT (proxy), "g-signal",
+			  (GCallback) service_signal_cb,
+			  batch);
+	g_signal_connect (G_OBJECT (proxy), "notify::g-name-owner",
+			  (GCallback) name_owner_cb,
+			  batch);
+
+	/* The batch takes the place of what it was made with */
+	g_simple_async_result_set_op_res_gpointer (simple, batch,
+						   g_object_unref);
+	g_simple_async_result_complete (simple);
+	g_object_unref (simple);
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * Reach the conversion service, asking the bus to start it if it
+ * is not running, which may take a while.  @callback is called in
+ * the main loop once it answered or could not be reached, and gets
+ * the batch with nsc_remote_batch_new_finish().
+ */
+void
+nsc_remote_batch_new_async (GMAudioProfile      *profile,
+			    const gchar         *output_uri,
+			    GAsyncReadyCallback  callback,
+			    gpointer             user_data)
+{
+	GSimpleAsyncResult *simple;
+	NewData            *data;
+
+	simple = g_simple_async_result_new (NULL, callback, user_data,
+					    nsc_remote_batch_new_async);
+
+	data = g_new0 (NewData, 1);
+	data->profile = g_object_ref (profile);
+	data->output_uri = g_strdup (output_uri);
+	g_simple_async_result_set_op_res_gpointer (simple, data,
+						   (GDestroyNotify) new_data_free);
+
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SESSION,
+				  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+				  NULL,
+				  NSC_DBUS_NAME,
+				  NSC_DBUS_PATH,
+				  NSC_DBUS_INTERFACE,
+				  NULL,
+				  proxy_new_cb,
+				  simple);
+}
+
+/**
+ * Returns NULL if the conversion service can not be reached, in
+ * which case the files should be converted in process instead.
+ */
+NscBatch *
+nsc_remote_batch_new_finish (GAsyncResult  *result,
+			     GError       **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+							      nsc_remote_batch_new_async),
+			      NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	return g_object_ref (g_simple_async_result_get_op_res_gpointer (simple));
+}
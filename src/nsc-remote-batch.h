@@ -0,0 +1,64 @@
+/*
+ *  nsc-remote-batch.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#ifndef NSC_REMOTE_BATCH_H
+#define NSC_REMOTE_BATCH_H
+
+#include "nsc-batch.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A batch that is converted by the conversion service on the
+ * session bus.  It emits the same signals as a local NscBatch.
+ */
+
+#define NSC_TYPE_REMOTE_BATCH         (nsc_remote_batch_get_type ())
+#define NSC_REMOTE_BATCH(obj)         (G_TYPE_CHECK_INSTANCE_CAST ((obj), NSC_TYPE_REMOTE_BATCH, NscRemoteBatch))
+#define NSC_IS_REMOTE_BATCH(obj)      (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NSC_TYPE_REMOTE_BATCH))
+
+typedef struct _NscRemoteBatch      NscRemoteBatch;
+typedef struct _NscRemoteBatchClass NscRemoteBatchClass;
+
+struct _NscRemoteBatch {
+	/* Parent object */
+	NscBatch parent;
+	/* Private data pointer */
+	gpointer priv;
+};
+
+struct _NscRemoteBatchClass {
+	NscBatchClass parent_class;
+};
+
+GType     nsc_remote_batch_get_type   (void);
+void      nsc_remote_batch_new_async  (GMAudioProfile       *profile,
+				       const gchar          *output_uri,
+				       GAsyncReadyCallback   callback,
+				       gpointer              user_data);
+NscBatch *nsc_remote_batch_new_finish (GAsyncResult         *result,
+				       GError              **error);
+
+G_END_DECLS
+
+#endif /* NSC_REMOTE_BATCH_H */
@@ -0,0 +1,487 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-scheduler.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <unistd.h>
+
+#include "nsc-load.h"
+#include "nsc-scheduler.h"
+
+/* Seconds between looks at the load */
+#define LOAD_INTERVAL 2
+
+/*
+ * Looks at a lower load it takes to go back up, so it does not flap.
+ * Every time the files converted again are enough to push the load
+ * right back up, it takes twice as long the next time.
+ */
+#define CALM_SAMPLES     3
+#define MAX_CALM_SAMPLES 96
+
+struct _NscScheduler {
+	/* Files converted at the same time, and how many are */
+	guint         limit;
+	guint         n_running;
+
+	/* Clients waiting for a turn, interactive ones first */
+	GQueue       *interactive;
+	GQueue       *background;
+
+	/* Every client, to tell them when converting has to pause */
+	GList        *clients;
+
+	/* Converting fewer files, or none, while the machine is busy */
+	gboolean      throttle;
+	NscLoadLevel  level;
+	guint         calm_samples;
+	guint         calm_needed;
+	guint         steady_samples;
+	guint         load_id;
+};
+
+struct _NscSchedulerClient {
+	NscScheduler          *scheduler;
+	gboolean               interactive;
+
+	NscSchedulerFunc       func;
+	NscSchedulerPauseFunc  pause_func;
+	gpointer               data;
+
+	/* Converting, or in one of the queues */
+	gboolean               running;
+	gboolean               waiting;
+
+	/* Idle source that tells the client its turn came */
+	guint                  grant_id;
+};
+
+static NscScheduler *default_scheduler = NULL;
+
+/*
+ * Private Methods
+ */
+static guint
+default_limit (void)
+{
+	return MAX (1, sysconf (_SC_NPROCESSORS_ONLN));
+}
+
+/**
+ * How many files may be converted right now.
+ */
+static guint
+current_limit (NscScheduler *scheduler)
+{
+	switch (scheduler->level) {
+	case NSC_LOAD_OVERLOADED:
+		return 0;
+	case NSC_LOAD_BUSY:
+		return MIN (scheduler->limit, 1);
+	default:
+		return scheduler->limit;
+	}
+}
+
+static gboolean
+grant_idle_cb (gpointer data)
+{
+	NscSchedulerClient *client = data;
+
+	client->grant_id = 0;
+	client->func (client->data);
+
+	return FALSE;
+}
+
+/**
+ * Hand out the free turns.  The clients are told from the main
+ * loop, so a batch that just finished a file never starts another
+ * one from inside its own handlers.
+ */
+static void
+grant_waiting (NscScheduler *scheduler)
+{
+	NscSchedulerClient *client;
+
+	while (scheduler->n_running < current_limit (scheduler)) {
+		client = g_queue_pop_head (scheduler->interactive);
+		if (client == NULL)
+			client = g_queue_pop_head (scheduler->background);
+		if (client == NULL)
+			break;
+
+		client->waiting = FALSE;
+		client->running = TRUE;
+		scheduler->n_running++;
+
+		client->grant_id = g_idle_add (grant_idle_cb, client);
+	}
+}
+
+static void
+set_level (NscScheduler *scheduler,
+	   NscLoadLevel  level)
+{
+	gboolean  was_paused, paused;
+	GList    *l, *clients;
+
+	was_paused = scheduler->level == NSC_LOAD_OVERLOADED;
+	paused = level == NSC_LOAD_OVERLOADED;
+
+	if (level != scheduler->level)
+		g_debug ("Load went from level %d to %d",
+			 scheduler->level, level);
+
+	scheduler->level = level;
+	grant_waiting (scheduler);
+
+	if (paused == was_paused)
+		return;
+
+	/* A client may remove itself when told */
+	clients = g_list_copy (scheduler->clients);
+	for (l = clients; l != NULL; l = l->next) {
+		NscSchedulerClient *client = l->data;
+
+		if (g_list_find (scheduler->clients, client) &&
+		    client->pause_func != NULL)
+			client->pause_func (paused, client->data);
+	}
+	g_list_free (clients);
+}
+
+/**
+ * Look at the load, cutting back right away when it went up, but
+ * only going back up once it stayed down for a while.
+ *
+ * The pressure includes what our own files cause, so converting
+ * only stops when the load stays that high with a single file
+ * left, and not when the files of the batch themselves are what
+ * pushed it up.
+ */
+static void
+sample_load (NscScheduler *scheduler)
+{
+	NscLoad       load;
+	NscLoadLevel  level;
+
+	nsc_load_sample (&load);
+	level = nsc_load_get_level (&load);
+
+	if (level == NSC_LOAD_OVERLOADED && scheduler->n_running > 1)
+		level = NSC_LOAD_BUSY;
+
+	scheduler->steady_samples++;
+
+	if (level > scheduler->level) {
+		/* Pushed right back up, so wait longer before going up */
+		if (scheduler->steady_samples < scheduler->calm_needed)
+			scheduler->calm_needed = MIN (scheduler->calm_needed * 2,
+						      MAX_CALM_SAMPLES);
+		else
+			scheduler->calm_needed = CALM_SAMPLES;
+
+		scheduler->calm_samples = 0;
+		scheduler->steady_samples = 0;
+		set_level (scheduler, level);
+	} else if (level == scheduler->level) {
+		scheduler->calm_samples = 0;
+	} else if (++scheduler->calm_samples >= scheduler->calm_needed) {
+		scheduler->calm_samples = 0;
+		scheduler->steady_samples = 0;
+		set_level (scheduler, level);
+	}
+}
+
+/*
+ * The load only matters while files are converting or waiting, or
+ * while clients that were held back still have to be told it came
+ * down.
+ */
+static gboolean
+load_watch_needed (NscScheduler *scheduler)
+{
+	return scheduler->throttle &&
+		(scheduler->n_running > 0 ||
+		 !g_queue_is_empty (scheduler->interactive) ||
+		 !g_queue_is_empty (scheduler->background) ||
+		 (scheduler->level != NSC_LOAD_NORMAL &&
+		  scheduler->clients != NULL));
+}
+
+static void
+stop_load_watch (NscScheduler *scheduler)
+{
+	if (scheduler->load_id == 0)
+		return;
+
+	g_source_remove (scheduler->load_id);
+	scheduler->load_id = 0;
+	scheduler->calm_samples = 0;
+	set_level (scheduler, NSC_LOAD_NORMAL);
+}
+
+static gboolean
+load_timeout_cb (gpointer data)
+{
+	NscScheduler *scheduler = data;
+
+	sample_load (scheduler);
+
+	/* Nothing left to hold back, so stop waking up for it */
+	if (!load_watch_needed (scheduler))
+		stop_load_watch (scheduler);
+
+	return scheduler->load_id != 0;
+}
+
+/**
+ * Start looking at the load, which was not looked at while there
+ * was nothing to convert, so take a sample right away.
+ */
+static void
+start_load_watch (NscScheduler *scheduler)
+{
+	if (scheduler->load_id != 0)
+		return;
+
+	scheduler->steady_samples = 0;
+	scheduler->load_id = g_timeout_add_seconds (LOAD_INTERVAL,
+						    load_timeout_cb,
+						    scheduler);
+	sample_load (scheduler);
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * The scheduler shared by every batch of the process.
+ */
+NscScheduler *
+nsc_scheduler_get_default (void)
+{
+	if (default_scheduler == NULL) {
+		default_scheduler = g_new0 (NscScheduler, 1);
+		default_scheduler->limit = default_limit ();
+		default_scheduler->interactive = g_queue_new ();
+		default_scheduler->background = g_queue_new ();
+		default_scheduler->calm_needed = CALM_SAMPLES;
+	}
+
+	return default_scheduler;
+}
+
+/**
+ * Convert no more than @limit files at a time, or one per
+ * processor when @limit is 0.  Files already being converted
+ * go on when the limit is lowered.
+ */
+void
+nsc_scheduler_set_limit (NscScheduler *scheduler,
+			 guint         limit)
+{
+	g_return_if_fail (scheduler != NULL);
+
+	scheduler->limit = limit > 0 ? limit : default_limit ();
+	grant_waiting (scheduler);
+}
+
+guint
+nsc_scheduler_get_limit (NscScheduler *scheduler)
+{
+	g_return_val_if_fail (scheduler != NULL, 0);
+
+	return scheduler->limit;
+}
+
+/**
+ * Keep an eye on the load of the machine.  While it is busy or on
+ * battery, files are converted one at a time, and while it stays
+ * overloaded with one file converting, not at all, and the clients
+ * are told to pause the files they are converting.  It all goes
+ * back once the load comes down.  The load is only looked at while
+ * there are files to convert.
+ */
+void
+nsc_scheduler_set_throttle (NscScheduler *scheduler,
+			    gboolean      throttle)
+{
+	g_return_if_fail (scheduler != NULL);
+
+	if (scheduler->throttle == throttle)
+		return;
+
+	scheduler->throttle = throttle;
+
+	if (load_watch_needed (scheduler))
+		start_load_watch (scheduler);
+	else
+		stop_load_watch (scheduler);
+}
+
+/**
+ * Whether files may not be converted because of the load.
+ */
+gboolean
+nsc_scheduler_is_overloaded (NscScheduler *scheduler)
+{
+	g_return_val_if_fail (scheduler != NULL, FALSE);
+
+	return scheduler->level == NSC_LOAD_OVERLOADED;
+}
+
+/**
+ * Add a batch that will ask for turns.  @func is called with
+ * @data whenever a turn that could not be given right away comes.
+ */
+NscSchedulerClient *
+nsc_scheduler_add_client (NscScheduler     *scheduler,
+			  gboolean          interactive,
+			  NscSchedulerFunc  func,
+			  gpointer          data)
+{
+	NscSchedulerClient *client;
+
+	g_return_val_if_fail (scheduler != NULL, NULL);
+	g_return_val_if_fail (func != NULL, NULL);
+
+	client = g_new0 (NscSchedulerClient, 1);
+	client->scheduler = scheduler;
+	client->interactive = interactive;
+	client->func = func;
+	client->data = data;
+
+	scheduler->clients = g_list_prepend (scheduler->clients, client);
+
+	return client;
+}
+
+/**
+ * Give up the client's turn or its place in the queue, and free it.
+ */
+void
+nsc_scheduler_remove_client (NscSchedulerClient *client)
+{
+	NscScheduler *scheduler;
+
+	if (client == NULL)
+		return;
+
+	scheduler = client->scheduler;
+
+	if (client->waiting)
+		g_queue_remove (client->interactive ? scheduler->interactive
+						    : scheduler->background,
+				client);
+
+	if (client->grant_id)
+		g_source_remove (client->grant_id);
+
+	scheduler->clients = g_list_remove (scheduler->clients, client);
+
+	nsc_scheduler_release (client);
+	g_free (client);
+
+	if (!load_watch_needed (scheduler))
+		stop_load_watch (scheduler);
+}
+
+/**
+ * Have @func called with the client's data whenever the files being
+ * converted have to be paused because of the load, and once they
+ * may go on.
+ */
+void
+nsc_scheduler_set_pause_func (NscSchedulerClient    *client,
+			      NscSchedulerPauseFunc  func)
+{
+	g_return_if_fail (client != NULL);
+
+	client->pause_func = func;
+}
+
+/**
+ * Ask for a turn to convert a file.  Returns TRUE if the client may
+ * go ahead right away, otherwise it is queued behind the others.
+ */
+gboolean
+nsc_scheduler_request (NscSchedulerClient *client)
+{
+	NscScheduler *scheduler;
+
+	g_return_val_if_fail (client != NULL, FALSE);
+
+	scheduler = client->scheduler;
+
+	if (client->running && client->grant_id == 0)
+		return TRUE;
+
+	if (client->running || client->waiting)
+		return FALSE;
+
+	if (scheduler->throttle)
+		start_load_watch (scheduler);
+
+	if (scheduler->n_running < current_limit (scheduler)) {
+		client->running = TRUE;
+		scheduler->n_running++;
+		return TRUE;
+	}
+
+	client->waiting = TRUE;
+	g_queue_push_tail (client->interactive ? scheduler->interactive
+					       : scheduler->background,
+			   client);
+
+	return FALSE;
+}
+
+/**
+ * The client is done with its file.  Its next request goes to the
+ * back of the queue, so every waiting batch gets a turn first.
+ */
+void
+nsc_scheduler_release (NscSchedulerClient *client)
+{
+	NscScheduler *scheduler;
+
+	g_return_if_fail (client != NULL);
+
+	if (!client->running)
+		return;
+
+	scheduler = client->scheduler;
+
+	client->running = FALSE;
+	scheduler->n_running--;
+
+	grant_waiting (scheduler);
+
+	if (!load_watch_needed (scheduler))
+		stop_load_watch (scheduler);
+}
@@ -0,0 +1,70 @@
+/*
+ *  nsc-scheduler.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_SCHEDULER_H
+#define NSC_SCHEDULER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Decides which batch converts next, so batches started at the same
+ * time do not all convert at once.  No more than a set number of
+ * files are converted in the process at a time.  A batch asks for a
+ * turn for each file, and the turns go around the waiting batches.
+ * Interactive batches go before background ones.  When throttling,
+ * fewer files are converted while the machine is busy.  Only used
+ * from the main loop.
+ */
+typedef struct _NscScheduler       NscScheduler;
+typedef struct _NscSchedulerClient NscSchedulerClient;
+
+/* Called from the main loop once the client's turn comes */
+typedef void (*NscSchedulerFunc) (gpointer data);
+
+/* Called when converting has to pause for the load, or may go on */
+typedef void (*NscSchedulerPauseFunc) (gboolean paused, gpointer data);
+
+NscScheduler       *nsc_scheduler_get_default   (void);
+void                nsc_scheduler_set_limit     (NscScheduler       *scheduler,
+						 guint               limit);
+guint               nsc_scheduler_get_limit     (NscScheduler       *scheduler);
+void                nsc_scheduler_set_throttle  (NscScheduler       *scheduler,
+						 gboolean            throttle);
+gboolean            nsc_scheduler_is_overloaded (NscScheduler       *scheduler);
+
+NscSchedulerClient *nsc_scheduler_add_client    (NscScheduler       *scheduler,
+						 gboolean            interactive,
+						 NscSchedulerFunc    func,
+						 gpointer            data);
+void                nsc_scheduler_remove_client (NscSchedulerClient *client);
+void                nsc_scheduler_set_pause_func (NscSchedulerClient    *client,
+						  NscSchedulerPauseFunc  func);
+gboolean            nsc_scheduler_request       (NscSchedulerClient *client);
+void                nsc_scheduler_release       (NscSchedulerClient *client);
+
+G_END_DECLS
+
+#endif /* NSC_SCHEDULER_H */
@@ -0,0 +1,491 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-service.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+/*
+ * The conversion service.  It owns the GStreamer pipelines and the
+ * job queue, so encoding does not run inside Nautilus and keeps
+ * going when the window that started it is closed.  Jobs from every
+ * client share the same pool of workers, and take turns file by file.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <gconf/gconf-client.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+#include <gst/gst.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-batch.h"
+#include "nsc-dbus.h"
+#include "nsc-gstreamer.h"
+#include "nsc-scheduler.h"
+
+/* Seconds without any jobs before the service exits */
+#define IDLE_TIMEOUT 60
+
+/* gconf key for the directory batch timing reports are written to */
+#define REPORT_DIR "/apps/nautilus-sound-converter/report_dir"
+
+/* gconf key for the directory verification manifests are written to */
+#define VERIFY_DIR "/apps/nautilus-sound-converter/verify_dir"
+
+/* gconf key for the directory traces are written to */
+#define TRACE_DIR "/apps/nautilus-sound-converter/trace_dir"
+
+/* gconf key for the number of queued files kept in memory */
+#define SPILL_LIMIT "/apps/nautilus-sound-converter/spill_limit"
+
+/* gconf key for the number of files converted at the same time */
+#define MAX_JOBS "/apps/nautilus-sound-converter/max_jobs"
+
+/* gconf key for holding back while the machine is busy */
+#define THROTTLE "/apps/nautilus-sound-converter/throttle"
+
+/* gconf key for splitting images with a cue sheet into their tracks */
+#define SPLIT_CUE "/apps/nautilus-sound-converter/split_cue"
+
+typedef struct {
+	guint     id;
+	NscBatch *batch;
+	guint     start_id;
+} Job;
+
+static GMainLoop       *loop = NULL;
+static GDBusConnection *connection = NULL;
+static GDBusNodeInfo   *introspection = NULL;
+static GConfClient     *gconf = NULL;
+
+/* Every job by number */
+static GHashTable      *jobs = NULL;
+static guint            next_job_id = 1;
+static guint            idle_id = 0;
+
+/* Options */
+static gint             max_workers = 0;
+static gboolean         persist = FALSE;
+
+static GOptionEntry entries[] = {
+	{ "workers", 'w', 0, G_OPTION_ARG_INT, &max_workers,
+	  N_("Number of files converted at the same time"), N_("N") },
+	{ "persist", 'p', 0, G_OPTION_ARG_NONE, &persist,
+	  N_("Do not exit when there is nothing to convert"), NULL },
+	{ NULL }
+};
+
+static void
+emit_signal (const gchar *name,
+	     GVariant    *parameters)
+{
+	GError *error = NULL;
+
+	if (connection == NULL) {
+		g_variant_unref (g_variant_ref_sink (parameters));
+		return;
+	}
+
+	if (!g_dbus_connection_emit_signal (connection, NULL,
+					    NSC_DBUS_PATH,
+					    NSC_DBUS_INTERFACE,
+					    name, parameters, &error)) {
+		g_warning ("Unable to emit %s; %s", name, error->message);
+		g_error_free (error);
+	}
+}
+
+static gboolean
+idle_timeout_cb (gpointer data)
+{
+	idle_id = 0;
+	g_main_loop_quit (loop);
+
+	return FALSE;
+}
+
+static void
+update_idle_timeout (void)
+{
+	if (idle_id) {
+		g_source_remove (idle_id);
+		idle_id = 0;
+	}
+
+	if (!persist && g_hash_table_size (jobs) == 0)
+		idle_id = g_timeout_add_seconds (IDLE_TIMEOUT,
+						 idle_timeout_cb, NULL);
+}
+
+/*
+ * Batch callbacks, forwarded to the bus
+ */
+static void
+file_started_cb (NscBatch *batch, guint index, Job *job)
+{
+	emit_signal ("FileStarted", g_variant_new ("(uu)", job->id, index));
+}
+
+static void
+duration_cb (NscBatch *batch, const int seconds, Job *job)
+{
+	emit_signal ("Duration", g_variant_new ("(ui)", job->id, seconds));
+}
+
+static void
+progress_cb (NscBatch *batch, const int seconds, Job *job)
+{
+	emit_signal ("Progress", g_variant_new ("(ui)", job->id, seconds));
+}
+
+static void
+file_completed_cb (NscBatch *batch, guint index, Job *job)
+{
+	emit_signal ("FileCompleted", g_variant_new ("(uu)", job->id, index));
+}
+
+static void
+file_failed_cb (NscBatch *batch, guint index, GError *error, Job *job)
+{
+	emit_signal ("FileFailed", g_variant_new ("(uus)", job->id, index,
+						   error->message));
+}
+
+static void
+retrying_cb (NscBatch *batch, guint n_files, Job *job)
+{
+	emit_signal ("Retrying", g_variant_new ("(uu)", job->id, n_files));
+}
+
+static void
+paused_cb (NscBatch *batch, gboolean paused, Job *job)
+{
+	emit_signal ("Paused", g_variant_new ("(ub)", job->id, paused));
+}
+
+static void
+finish_job (Job *job)
+{
+	emit_signal ("Finished", g_variant_new ("(u)", job->id));
+
+	/* Frees the job */
+	g_hash_table_remove (jobs, GUINT_TO_POINTER (job->id));
+
+	update_idle_timeout ();
+}
+
+static void
+finished_cb (NscBatch *batch, Job *job)
+{
+	finish_job (job);
+}
+
+static void
+free_job (Job *job)
+{
+	if (job->start_id)
+		g_source_remove (job->start_id);
+
+	g_signal_handlers_disconnect_matched (job->batch,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, job);
+	g_object_unref (job->batch);
+	g_free (job);
+}
+
+/**
+ * Every job starts right away, and the scheduler decides which
+ * of them gets to convert its next file.
+ */
+static gboolean
+start_idle_cb (gpointer data)
+{
+	Job *job = data;
+
+	job->start_id = 0;
+	nsc_batch_start (job->batch);
+
+	return FALSE;
+}
+
+/*
+ * D-Bus methods
+ */
+static void
+handle_submit (GVariant              *parameters,
+	       GDBusMethodInvocation *invocation)
+{
+	GMAudioProfile *profile;
+	const gchar    *profile_id, *output_uri;
+	gchar         **uris;
+	gchar          *report_dir, *verify_dir, *trace_dir;
+	gint            spill_limit;
+	gboolean        retry;
+	Job            *job;
+	guint           i, n_uris;
+
+	g_variant_get (parameters, "(^a&s&s&sb)",
+		       &uris, &profile_id, &output_uri, &retry);
+
+	profile = gm_audio_profile_lookup (profile_id);
+	if (profile == NULL || !nsc_gstreamer_supports_profile (profile)) {
+		g_dbus_method_invocation_return_error (invocation,
+						       G_DBUS_ERROR,
+						       G_DBUS_ERROR_INVALID_ARGS,
+						       _("The audio profile '%s' is not available"),
+						       profile_id);
+		g_free (uris);
+		return;
+	}
+
+	job = g_new0 (Job, 1);
+	job->id = next_job_id++;
+	job->batch = nsc_batch_new (profile,
+				    *output_uri != '\0' ? output_uri : NULL);
+	nsc_batch_set_retry (job->batch, retry);
+	nsc_batch_set_split_cue (job->batch,
+				 gconf_client_get_bool (gconf, SPLIT_CUE, NULL));
+
+	/* Read for every job, so turning reports on needs no restart */
+	report_dir = gconf_client_get_string (gconf, REPORT_DIR, NULL);
+	if (report_dir != NULL && *report_dir != '\0')
+		nsc_batch_set_report_dir (job->batch, report_dir);
+	g_free (report_dir);
+
+	verify_dir = gconf_client_get_string (gconf, VERIFY_DIR, NULL);
+	if (verify_dir != NULL && *verify_dir != '\0')
+		nsc_batch_set_verify_dir (job->batch, verify_dir);
+	g_free (verify_dir);
+
+	/* Jobs running at the same time end up in the same trace */
+	trace_dir = gconf_client_get_string (gconf, TRACE_DIR, NULL);
+	if (trace_dir != NULL && *trace_dir != '\0')
+		nsc_batch_set_trace_dir (job->batch, trace_dir);
+	g_free (trace_dir);
+
+	spill_limit = gconf_client_get_int (gconf, SPILL_LIMIT, NULL);
+	if (spill_limit > 0)
+		nsc_batch_set_spill (job->batch, spill_limit);
+
+	for (n_uris = 0; uris[n_uris] != NULL; n_uris++) {
+		GFile *file;
+
+		file = g_file_new_for_uri (uris[n_uris]);
+		nsc_batch_add_file (job->batch, file);
+		g_object_unref (file);
+	}
+	g_free (uris);
+
+	/* Someone converting a single file is waiting for it */
+	nsc_batch_set_interactive (job->batch, n_uris == 1);
+
+	g_signal_connect (job->batch, "file-started",
+			  G_CALLBACK (file_started_cb), job);
+	g_signal_connect (job->batch, "duration",
+			  G_CALLBACK (duration_cb), job);
+	g_signal_connect (job->batch, "progress",
+			  G_CALLBACK (progress_cb), job);
+	g_signal_connect (job->batch, "file-completed",
+			  G_CALLBACK (file_completed_cb), job);
+	g_signal_connect (job->batch, "file-failed",
+			  G_CALLBACK (file_failed_cb), job);
+	g_signal_connect (job->batch, "retrying",
+			  G_CALLBACK (retrying_cb), job);
+	g_signal_connect (job->batch, "paused",
+			  G_CALLBACK (paused_cb), job);
+	g_signal_connect (job->batch, "finished",
+			  G_CALLBACK (finished_cb), job);
+
+	g_hash_table_insert (jobs, GUINT_TO_POINTER (job->id), job);
+	update_idle_timeout ();
+
+	/* Reply first, so the client knows the job before any signal */
+	g_dbus_method_invocation_return_value (invocation,
+					       g_variant_new ("(u)", job->id));
+
+	job->start_id = g_idle_add (start_idle_cb, job);
+}
+
+static void
+handle_cancel (GVariant              *parameters,
+	       GDBusMethodInvocation *invocation)
+{
+	Job   *job;
+	guint  id;
+
+	g_variant_get (parameters, "(u)", &id);
+
+	job = g_hash_table_lookup (jobs, GUINT_TO_POINTER (id));
+	if (job != NULL) {
+		nsc_batch_cancel (job->batch);
+		finish_job (job);
+	}
+
+	g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+handle_pause (GVariant              *parameters,
+	      GDBusMethodInvocation *invocation,
+	      gboolean               pause)
+{
+	Job   *job;
+	guint  id;
+
+	g_variant_get (parameters, "(u)", &id);
+
+	job = g_hash_table_lookup (jobs, GUINT_TO_POINTER (id));
+	if (job != NULL) {
+		if (pause)
+			nsc_batch_pause (job->batch);
+		else
+			nsc_batch_resume (job->batch);
+	}
+
+	g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+method_call_cb (GDBusConnection       *connection,
+		const gchar           *sender,
+		const gchar           *object_path,
+		const gchar           *interface_name,
+		const gchar           *method_name,
+		GVariant              *parameters,
+		GDBusMethodInvocation *invocation,
+		gpointer               user_data)
+{
+	if (g_strcmp0 (method_name, "Submit") == 0)
+		handle_submit (parameters, invocation);
+	else if (g_strcmp0 (method_name, "Cancel") == 0)
+		handle_cancel (parameters, invocation);
+	else if (g_strcmp0 (method_name, "Pause") == 0)
+		handle_pause (parameters, invocation, TRUE);
+	else if (g_strcmp0 (method_name, "Resume") == 0)
+		handle_pause (parameters, invocation, FALSE);
+}
+
+static const GDBusInterfaceVTable interface_vtable = {
+	method_call_cb,
+	NULL,
+	NULL,
+};
+
+static void
+bus_acquired_cb (GDBusConnection *bus,
+		 const gchar     *name,
+		 gpointer         user_data)
+{
+	GError *error = NULL;
+
+	connection = bus;
+
+	if (g_dbus_connection_register_object (connection,
+					       NSC_DBUS_PATH,
+					       introspection->interfaces[0],
+					       &interface_vtable,
+					       NULL, NULL, &error) == 0) {
+		g_warning ("Unable to register the service; %s",
+			   error->message);
+		g_error_free (error);
+		g_main_loop_quit (loop);
+	}
+}
+
+static void
+name_lost_cb (GDBusConnection *bus,
+	      const gchar     *name,
+	      gpointer         user_data)
+{
+	/* Either there is no bus, or someone else is already running */
+	connection = NULL;
+	g_main_loop_quit (loop);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError         *error = NULL;
+	guint           owner_id;
+
+	bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+	g_type_init ();
+
+	context = g_option_context_new (_("- Nautilus Sound Converter service"));
+	g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+	g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+	g_option_context_add_group (context, gst_init_get_option_group ());
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	/* Init gnome-media-profiles, so jobs can look up their profile */
+	gconf = gconf_client_get_default ();
+	gnome_media_profiles_init (gconf);
+
+	/* The same limit as in Nautilus, unless told otherwise */
+	if (max_workers <= 0)
+		max_workers = gconf_client_get_int (gconf, MAX_JOBS, NULL);
+	nsc_scheduler_set_limit (nsc_scheduler_get_default (),
+				 MAX (max_workers, 0));
+	nsc_scheduler_set_throttle (nsc_scheduler_get_default (),
+				    gconf_client_get_bool (gconf, THROTTLE,
+							   NULL));
+
+	introspection = g_dbus_node_info_new_for_xml (NSC_DBUS_INTROSPECTION,
+						      NULL);
+
+	jobs = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+				      NULL, (GDestroyNotify) free_job);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+				   NSC_DBUS_NAME,
+				   G_BUS_NAME_OWNER_FLAGS_NONE,
+				   bus_acquired_cb,
+				   NULL,
+				   name_lost_cb,
+				   NULL, NULL);
+
+	update_idle_timeout ();
+	g_main_loop_run (loop);
+
+	g_bus_unown_name (owner_id);
+
+	g_hash_table_destroy (jobs);
+	g_dbus_node_info_unref (introspection);
+	g_main_loop_unref (loop);
+	g_object_unref (gconf);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,1096 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-split.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gst/gst.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-cue.h"
+#include "nsc-error.h"
+#include "nsc-split.h"
+
+/* Signals */
+enum {
+	PROGRESS,
+	DURATION,
+	COMPLETION,
+	ERROR,
+	LAST_SIGNAL,
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* Element names */
+#define FILE_SOURCE "giosrc"
+#define FILE_SINK   "giosink"
+#define DECODER     "decodebin2"
+
+/* Decoded audio waiting for each encoder */
+#define TRACK_QUEUE_BYTES (1024 * 1024)
+#define DECODE_BUFFERS    4
+
+/*
+ * A track being encoded.  Its pipeline is fed from the one that
+ * decodes the image, and ends when the next track begins.
+ */
+typedef struct _Split Split;
+
+typedef struct {
+	Split      *split;
+	GstElement *pipeline;
+	GstElement *appsrc;
+	GFile      *file;
+
+	/* The samples of the image that belong to it */
+	guint64     start;
+	guint64     end;
+
+	/* Written out, so its pipeline is stopped */
+	gboolean    done;
+} Track;
+
+/*
+ * Splitting a single image.  The streaming thread of the decoding
+ * pipeline cuts the audio and starts the track pipelines, so this
+ * lives until both pipelines are stopped, which may be after the
+ * splitter is gone.
+ */
+struct _Split {
+	NscSplitter    *splitter;
+	GMAudioProfile *profile;
+	NscCueSheet    *sheet;
+	GFile          *directory;
+	GstElement     *pipeline;
+
+	/* Held by the streaming thread while it cuts */
+	GMutex          lock;
+	GPtrArray      *tracks;
+	guint           current;
+	guint64         offset;
+	GstCaps        *caps;
+	gint            rate;
+	guint           frame_bytes;
+	gboolean        released;
+
+	/* The image is decoded, and the tracks only need to finish */
+	gboolean        decoded;
+
+	/* Remove the tracks once stopped, when cancelled */
+	gboolean        remove;
+};
+
+typedef struct {
+	/* The audio profile every track is encoded with */
+	GMAudioProfile *profile;
+
+	/* The image being split */
+	Split          *split;
+
+	/* Held in PAUSED */
+	gboolean        paused;
+
+	/* Misc */
+	int             seconds;
+	guint           tick_id;
+} NscSplitterPrivate;
+
+#define TEARDOWN_THREADS 1
+
+static GThreadPool *teardown_pool = NULL;
+
+/*
+ * GObject methods
+ */
+G_DEFINE_TYPE (NscSplitter, nsc_splitter, G_TYPE_OBJECT);
+
+#define NSC_SPLITTER_GET_PRIVATE(o)                           \
+	((NscSplitterPrivate *)((NSC_SPLITTER(o))->priv))
+
+static void release_split (NscSplitter *splitter,
+			   gboolean     remove_output);
+
+static void
+nsc_splitter_dispose (GObject *object)
+{
+	NscSplitter        *self = (NscSplitter *) object;
+	NscSplitterPrivate *priv = NSC_SPLITTER_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		release_split (self, FALSE);
+
+		if (priv->profile) {
+			g_object_unref (priv->profile);
+			priv->profile = NULL;
+		}
+	}
+
+	G_OBJECT_CLASS (nsc_splitter_parent_class)->dispose (object);
+}
+
+static void
+nsc_splitter_finalize (GObject *object)
+{
+	NscSplitter        *self = (NscSplitter *) object;
+	NscSplitterPrivate *priv = NSC_SPLITTER_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		g_free (priv);
+
+		(NSC_SPLITTER (self))->priv = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_splitter_parent_class)->finalize (object);
+}
+
+static void
+nsc_splitter_class_init (NscSplitterClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose  = nsc_splitter_dispose;
+	object_class->finalize = nsc_splitter_finalize;
+
+	/* Signals */
+	signals[PROGRESS] =
+		g_signal_new ("progress",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscSplitterClass, progress),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__INT,
+			      G_TYPE_NONE, 1, G_TYPE_INT);
+	signals[DURATION] =
+		g_signal_new ("duration",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscSplitterClass, duration),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__INT,
+			      G_TYPE_NONE, 1, G_TYPE_INT);
+	signals[COMPLETION] =
+		g_signal_new ("completion",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscSplitterClass, completion),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+	signals[ERROR] =
+		g_signal_new ("error",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscSplitterClass, error),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE, 1, G_TYPE_POINTER);
+}
+
+static void
+nsc_splitter_init (NscSplitter *self)
+{
+	/* Allocate Private data structure */
+	(NSC_SPLITTER (self))->priv = \
+		(NscSplitterPrivate *) g_malloc0 (sizeof (NscSplitterPrivate));
+}
+
+/*
+ * Private Methods
+ */
+static void
+track_free (Track *track)
+{
+	if (track->pipeline != NULL)
+		gst_object_unref (GST_OBJECT (track->pipeline));
+	g_object_unref (track->file);
+	g_free (track);
+}
+
+static void
+split_free (Split *split)
+{
+	g_ptr_array_free (split->tracks, TRUE);
+	if (split->pipeline != NULL)
+		gst_object_unref (GST_OBJECT (split->pipeline));
+	if (split->caps != NULL)
+		gst_caps_unref (split->caps);
+	g_object_unref (split->directory);
+	g_object_unref (split->profile);
+	nsc_cue_sheet_free (split->sheet);
+	g_mutex_clear (&split->lock);
+	g_free (split);
+}
+
+static void
+teardown_func (gpointer data,
+	       gpointer user_data)
+{
+	Split  *split = data;
+	GError *error = NULL;
+	guint   i;
+
+	/*
+	 * The tracks go first, as the streaming thread may be waiting
+	 * for one of them to take more audio.
+	 */
+	for (i = 0; i < split->tracks->len; i++) {
+		Track *track = g_ptr_array_index (split->tracks, i);
+
+		gst_element_set_state (track->pipeline, GST_STATE_NULL);
+	}
+
+	if (split->pipeline != NULL)
+		gst_element_set_state (split->pipeline, GST_STATE_NULL);
+
+	/* Remove the tracks that were written so far */
+	for (i = 0; split->remove && i < split->tracks->len; i++) {
+		Track *track = g_ptr_array_index (split->tracks, i);
+
+		if (!g_file_delete (track->file, NULL, &error)) {
+			if (!g_error_matches (error, G_IO_ERROR,
+					      G_IO_ERROR_NOT_FOUND))
+				g_warning ("Unable to delete file; %s",
+					   error->message);
+			g_clear_error (&error);
+		}
+	}
+
+	split_free (split);
+}
+
+static void
+disconnect_bus (GstElement *pipeline,
+		gpointer    data)
+{
+	GstBus *bus;
+
+	bus = gst_element_get_bus (pipeline);
+	g_signal_handlers_disconnect_matched (bus, G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, data);
+	gst_bus_remove_signal_watch (bus);
+	gst_object_unref (bus);
+}
+
+/*
+ * Detach the current split from the splitter and hand it over to
+ * the teardown pool, like NscGStreamer does with its pipelines.
+ */
+static void
+release_split (NscSplitter *splitter,
+	       gboolean     remove_output)
+{
+	NscSplitterPrivate *priv;
+	Split              *split;
+	guint               i;
+
+	priv = NSC_SPLITTER_GET_PRIVATE (splitter);
+
+	if (priv->tick_id) {
+		g_source_remove (priv->tick_id);
+		priv->tick_id = 0;
+	}
+
+	split = priv->split;
+	if (split == NULL)
+		return;
+
+	priv->split = NULL;
+	priv->paused = FALSE;
+
+	/* No more tracks are started after this */
+	g_mutex_lock (&split->lock);
+	split->released = TRUE;
+	split->splitter = NULL;
+	split->remove = remove_output;
+	g_mutex_unlock (&split->lock);
+
+	/* Make sure no more messages reach us from these pipelines */
+	disconnect_bus (split->pipeline, splitter);
+	for (i = 0; i < split->tracks->len; i++) {
+		Track *track = g_ptr_array_index (split->tracks, i);
+
+		disconnect_bus (track->pipeline, track);
+	}
+
+	if (teardown_pool == NULL)
+		teardown_pool = g_thread_pool_new (teardown_func, NULL,
+						   TEARDOWN_THREADS,
+						   FALSE, NULL);
+
+	g_thread_pool_push (teardown_pool, split, NULL);
+}
+
+/**
+ * Give up on the image.  The tracks written so far are cut short,
+ * so they are removed, as when cancelled.
+ */
+static void
+fail (NscSplitter *splitter,
+      GError      *error)
+{
+	release_split (splitter, TRUE);
+	g_signal_emit (splitter, signals[ERROR], 0, error);
+}
+
+/**
+ * Emit completion once the image is decoded, and every track
+ * has been written out.
+ */
+static void
+check_done (NscSplitter *splitter)
+{
+	NscSplitterPrivate *priv;
+	Split              *split;
+	gboolean            done;
+	guint               i;
+
+	priv = NSC_SPLITTER_GET_PRIVATE (splitter);
+	split = priv->split;
+
+	g_mutex_lock (&split->lock);
+	done = split->decoded;
+	for (i = 0; done && i < split->tracks->len; i++) {
+		Track *track = g_ptr_array_index (split->tracks, i);
+
+		done = track->done;
+	}
+	g_mutex_unlock (&split->lock);
+
+	if (!done)
+		return;
+
+	release_split (splitter, FALSE);
+	g_signal_emit (splitter, signals[COMPLETION], 0);
+}
+
+static void
+track_eos_cb (GstBus     *bus,
+	      GstMessage *message,
+	      gpointer    user_data)
+{
+	Track *track = user_data;
+
+	gst_element_set_state (track->pipeline, GST_STATE_NULL);
+	track->done = TRUE;
+
+	check_done (track->split->splitter);
+}
+
+static void
+track_error_cb (GstBus     *bus,
+		GstMessage *message,
+		gpointer    user_data)
+{
+	Track  *track = user_data;
+	GError *error = NULL;
+
+	gst_message_parse_error (message, &error, NULL);
+	fail (track->split->splitter, error);
+	g_error_free (error);
+}
+
+static void
+decode_eos_cb (GstBus     *bus,
+	       GstMessage *message,
+	       gpointer    user_data)
+{
+	NscSplitter        *splitter = NSC_SPLITTER (user_data);
+	NscSplitterPrivate *priv;
+	Split              *split;
+	GstElement         *appsrc = NULL;
+	GstFlowReturn       ret;
+
+	priv = NSC_SPLITTER_GET_PRIVATE (splitter);
+	split = priv->split;
+
+	gst_element_set_state (split->pipeline, GST_STATE_NULL);
+
+	if (priv->tick_id) {
+		g_source_remove (priv->tick_id);
+		priv->tick_id = 0;
+	}
+
+	/* The streaming thread is done with the tracks by now */
+	g_mutex_lock (&split->lock);
+	split->decoded = TRUE;
+	if (split->tracks->len == split->sheet->tracks->len) {
+		Track *last = g_ptr_array_index (split->tracks,
+						 split->tracks->len - 1);
+
+		appsrc = gst_object_ref (last->appsrc);
+	}
+	g_mutex_unlock (&split->lock);
+
+	if (appsrc == NULL) {
+		GError *error;
+
+		error = g_error_new (NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+				     _("The image is shorter than its cue sheet"));
+		fail (splitter, error);
+		g_error_free (error);
+		return;
+	}
+
+	/* The last track ends with the image */
+	g_signal_emit_by_name (appsrc, "end-of-stream", &ret);
+	gst_object_unref (appsrc);
+
+	check_done (splitter);
+}
+
+static void
+decode_error_cb (GstBus     *bus,
+		 GstMessage *message,
+		 gpointer    user_data)
+{
+	GError *error = NULL;
+
+	gst_message_parse_error (message, &error, NULL);
+	fail (NSC_SPLITTER (user_data), error);
+	g_error_free (error);
+}
+
+static gboolean
+just_say_yes (GstElement *element,
+	      gpointer    filename,
+	      gpointer    user_data)
+{
+	return TRUE;
+}
+
+/* Callback for when decodebin exposes a source pad */
+static void
+connect_decodebin_cb (GstElement *decodebin,
+		      GstPad     *pad,
+		      gboolean    last,
+		      gpointer    data)
+{
+	GstPad *audiopad;
+
+	/* Only link once */
+	audiopad = gst_element_get_static_pad (data, "sink");
+	if (!GST_PAD_IS_LINKED (audiopad) &&
+	    gst_pad_link (pad, audiopad) != GST_PAD_LINK_OK)
+		g_warning ("Failed to link elements decodebin-split");
+
+	gst_object_unref (audiopad);
+}
+
+/**
+ * "01 - Title.ogg", with anything that can not be in a file name
+ * replaced.
+ */
+static gchar *
+track_basename (GMAudioProfile *profile,
+		NscCueTrack    *cue)
+{
+	gchar *title, *basename;
+
+	if (cue->title != NULL && *cue->title != '\0')
+		title = g_strdup (cue->title);
+	else
+		title = g_strdup_printf (_("Track %02u"), cue->number);
+
+	g_strdelimit (title, "/", '-');
+	basename = g_strdup_printf ("%02u - %s.%s", cue->number,
+				    g_strstrip (title),
+				    gm_audio_profile_get_extension (profile));
+	g_free (title);
+
+	return basename;
+}
+
+/**
+ * Give the track the names from the cue sheet, if the profile
+ * writes tags at all.
+ */
+static void
+set_tags (Split       *split,
+	  NscCueTrack *cue,
+	  GstElement  *encode)
+{
+	GstElement  *setter;
+	GstTagList  *tags;
+	const gchar *performer;
+
+	setter = gst_bin_get_by_interface (GST_BIN (encode),
+					   GST_TYPE_TAG_SETTER);
+	if (setter == NULL)
+		return;
+
+	tags = gst_tag_list_new ();
+	gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE,
+			  GST_TAG_TRACK_NUMBER, cue->number,
+			  GST_TAG_TRACK_COUNT, split->sheet->tracks->len,
+			  NULL);
+
+	performer = cue->performer ? cue->performer : split->sheet->performer;
+	if (cue->title != NULL)
+		gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE,
+				  GST_TAG_TITLE, cue->title, NULL);
+	if (performer != NULL)
+		gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE,
+				  GST_TAG_ARTIST, performer, NULL);
+	if (split->sheet->title != NULL)
+		gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE,
+				  GST_TAG_ALBUM, split->sheet->title, NULL);
+
+	gst_tag_setter_merge_tags (GST_TAG_SETTER (setter), tags,
+				   GST_TAG_MERGE_REPLACE);
+	gst_tag_list_free (tags);
+	gst_object_unref (setter);
+}
+
+/*
+ * The sample the track at @index starts at.  Whatever comes before
+ * the first track belongs to it, and the pregap of every other track
+ * stays with the one before, as it does on the CD.
+ */
+static guint64
+track_start (Split *split,
+	     guint  index)
+{
+	NscCueTrack *cue;
+
+	if (index == 0)
+		return 0;
+
+	cue = g_ptr_array_index (split->sheet->tracks, index);
+
+	return gst_util_uint64_scale_int (cue->start, split->rate,
+					  NSC_CUE_FRAMES_PER_SECOND);
+}
+
+/**
+ * Start encoding the next track.  Called by the streaming thread,
+ * with the lock held.
+ */
+static Track *
+start_track (Split   *split,
+	     GError **error)
+{
+	NscCueTrack *cue;
+	Track       *track;
+	GstElement  *encode, *filesink;
+	GstBus      *bus;
+	gchar       *pipeline;
+	guint        index;
+
+	index = split->tracks->len;
+	cue = g_ptr_array_index (split->sheet->tracks, index);
+
+	track = g_new0 (Track, 1);
+	track->split = split;
+	track->start = track_start (split, index);
+	track->end = index + 1 < split->sheet->tracks->len ?
+		track_start (split, index + 1) : G_MAXUINT64;
+
+	track->file = nsc_splitter_get_track_file (split->profile, split->sheet,
+						   split->directory, index);
+
+	track->pipeline = gst_pipeline_new (NULL);
+	track->appsrc = gst_element_factory_make ("appsrc", NULL);
+	filesink = gst_element_factory_make (FILE_SINK, NULL);
+
+	pipeline = g_strdup_printf ("audioconvert ! audioresample ! %s",
+				    gm_audio_profile_get_pipeline (split->profile));
+	encode = gst_parse_bin_from_description (pipeline, TRUE, NULL);
+	g_free (pipeline);
+
+	if (track->appsrc == NULL || encode == NULL || filesink == NULL) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("Could not create GStreamer encoders for %s"),
+			     gm_audio_profile_get_name (split->profile));
+		if (track->appsrc != NULL)
+			gst_object_unref (GST_OBJECT (track->appsrc));
+		if (encode != NULL)
+			gst_object_unref (GST_OBJECT (encode));
+		if (filesink != NULL)
+			gst_object_unref (GST_OBJECT (filesink));
+		track_free (track);
+		return NULL;
+	}
+
+	/* Push blocks once the encoder is this far behind */
+	g_object_set (G_OBJECT (track->appsrc),
+		      "caps", split->caps,
+		      "format", GST_FORMAT_TIME,
+		      "block", TRUE,
+		      "max-bytes", (guint64) TRACK_QUEUE_BYTES,
+		      NULL);
+
+	g_object_set (G_OBJECT (filesink), "file", track->file, NULL);
+	g_signal_connect (G_OBJECT (filesink), "allow-overwrite",
+			  G_CALLBACK (just_say_yes), NULL);
+
+	gst_bin_add_many (GST_BIN (track->pipeline),
+			  track->appsrc, encode, filesink, NULL);
+	if (!gst_element_link_many (track->appsrc, encode, filesink, NULL)) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("Could not link pipeline"));
+		track_free (track);
+		return NULL;
+	}
+
+	set_tags (split, cue, encode);
+
+	/* The watch is dispatched from the main loop, not from here */
+	bus = gst_element_get_bus (track->pipeline);
+	gst_bus_add_signal_watch (bus);
+	g_signal_connect (G_OBJECT (bus), "message::eos",
+			  G_CALLBACK (track_eos_cb), track);
+	g_signal_connect (G_OBJECT (bus), "message::error",
+			  G_CALLBACK (track_error_cb), track);
+	gst_object_unref (bus);
+
+	g_ptr_array_add (split->tracks, track);
+	gst_element_set_state (track->pipeline, GST_STATE_PLAYING);
+
+	return track;
+}
+
+/**
+ * Find out how long a sample is from the first decoded buffer.
+ */
+static gboolean
+read_format (Split   *split,
+	     GstCaps *caps)
+{
+	GstStructure *structure;
+	gint          channels, width;
+
+	if (caps == NULL)
+		return FALSE;
+
+	structure = gst_caps_get_structure (caps, 0);
+	if (!gst_structure_get_int (structure, "rate", &split->rate) ||
+	    !gst_structure_get_int (structure, "channels", &channels) ||
+	    !gst_structure_get_int (structure, "width", &width) ||
+	    split->rate <= 0 || channels <= 0 || width < 8)
+		return FALSE;
+
+	split->caps = gst_caps_ref (caps);
+	split->frame_bytes = channels * (width / 8);
+
+	return TRUE;
+}
+
+static void
+post_error (Split  *split,
+	    GError *error)
+{
+	gst_element_post_message (split->pipeline,
+				  gst_message_new_error (GST_OBJECT (split->pipeline),
+							 error, NULL));
+}
+
+/**
+ * Cut the decoded audio at the start of every track, and hand
+ * each piece to the encoder of its track.  Runs in the streaming
+ * thread of the decoding pipeline.
+ */
+static void
+new_buffer_cb (GstElement *sink,
+	       gpointer    data)
+{
+	Split     *split = data;
+	GstBuffer *buffer = NULL;
+	GError    *error = NULL;
+	guint64    samples, done = 0;
+
+	g_signal_emit_by_name (sink, "pull-buffer", &buffer);
+	if (buffer == NULL)
+		return;
+
+	g_mutex_lock (&split->lock);
+
+	if (split->frame_bytes == 0 &&
+	    !read_format (split, GST_BUFFER_CAPS (buffer))) {
+		g_set_error (&error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("Could not tell the format of the audio"));
+		split->released = TRUE;
+	}
+
+	samples = GST_BUFFER_SIZE (buffer) / MAX (split->frame_bytes, 1);
+
+	while (done < samples && !split->released) {
+		Track         *track;
+		GstBuffer     *sub;
+		GstElement    *appsrc;
+		GstFlowReturn  ret;
+		guint64        take;
+		gboolean       finished;
+
+		if (split->current < split->tracks->len)
+			track = g_ptr_array_index (split->tracks,
+						   split->current);
+		else
+			track = start_track (split, &error);
+
+		if (track == NULL) {
+			split->released = TRUE;
+			break;
+		}
+
+		take = MIN (samples - done, track->end - split->offset);
+		sub = gst_buffer_create_sub (buffer,
+					     done * split->frame_bytes,
+					     take * split->frame_bytes);
+		gst_buffer_set_caps (sub, split->caps);
+		GST_BUFFER_TIMESTAMP (sub) =
+			gst_util_uint64_scale_int (split->offset - track->start,
+						   GST_SECOND, split->rate);
+		GST_BUFFER_DURATION (sub) =
+			gst_util_uint64_scale_int (take, GST_SECOND,
+						   split->rate);
+
+		split->offset += take;
+		done += take;
+
+		finished = split->offset == track->end;
+		if (finished)
+			split->current++;
+
+		/* Pushing blocks while the encoder catches up */
+		appsrc = gst_object_ref (track->appsrc);
+		g_mutex_unlock (&split->lock);
+
+		g_signal_emit_by_name (appsrc, "push-buffer", sub, &ret);
+		gst_buffer_unref (sub);
+		if (finished)
+			g_signal_emit_by_name (appsrc, "end-of-stream", &ret);
+		gst_object_unref (appsrc);
+
+		g_mutex_lock (&split->lock);
+	}
+
+	g_mutex_unlock (&split->lock);
+	gst_buffer_unref (buffer);
+
+	if (error != NULL) {
+		post_error (split, error);
+		g_error_free (error);
+	}
+}
+
+static Split *
+build_split (GMAudioProfile  *profile,
+	     GFile           *src,
+	     NscCueSheet     *sheet,
+	     GFile           *directory,
+	     GError         **error)
+{
+	Split      *split;
+	GstElement *filesrc, *decode, *convert, *sink;
+	GstCaps    *caps;
+
+	split = g_new0 (Split, 1);
+	g_mutex_init (&split->lock);
+	split->profile = g_object_ref (profile);
+	split->sheet = sheet;
+	split->directory = g_object_ref (directory);
+	split->tracks = g_ptr_array_new_with_free_func ((GDestroyNotify) track_free);
+	split->pipeline = gst_pipeline_new ("split");
+
+	filesrc = gst_element_factory_make (FILE_SOURCE, "file_src");
+	decode = gst_element_factory_make (DECODER, "decode");
+	convert = gst_element_factory_make ("audioconvert", "convert");
+	sink = gst_element_factory_make ("appsink", "split_sink");
+
+	if (filesrc == NULL || decode == NULL ||
+	    convert == NULL || sink == NULL) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("Could not create GStreamer file input"));
+		if (filesrc != NULL)
+			gst_object_unref (GST_OBJECT (filesrc));
+		if (decode != NULL)
+			gst_object_unref (GST_OBJECT (decode));
+		if (convert != NULL)
+			gst_object_unref (GST_OBJECT (convert));
+		if (sink != NULL)
+			gst_object_unref (GST_OBJECT (sink));
+		split_free (split);
+		return NULL;
+	}
+
+	g_object_set (G_OBJECT (filesrc), "file", src, NULL);
+
+	/* Cut as fast as the encoders take it */
+	caps = gst_caps_from_string ("audio/x-raw-int; audio/x-raw-float");
+	g_object_set (G_OBJECT (sink),
+		      "caps", caps,
+		      "emit-signals", TRUE,
+		      "sync", FALSE,
+		      "max-buffers", DECODE_BUFFERS,
+		      NULL);
+	gst_caps_unref (caps);
+
+	gst_bin_add_many (GST_BIN (split->pipeline),
+			  filesrc, decode, convert, sink, NULL);
+
+	if (!gst_element_link (filesrc, decode) ||
+	    !gst_element_link (convert, sink)) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("Could not link pipeline"));
+		split_free (split);
+		return NULL;
+	}
+
+	g_signal_connect (G_OBJECT (decode), "new-decoded-pad",
+			  G_CALLBACK (connect_decodebin_cb), convert);
+	g_signal_connect (G_OBJECT (sink), "new-buffer",
+			  G_CALLBACK (new_buffer_cb), split);
+
+	return split;
+}
+
+static gboolean
+tick_timeout_cb (NscSplitter *splitter)
+{
+	NscSplitterPrivate *priv;
+	gint64              nanos;
+	gint                secs;
+	static GstFormat    format = GST_FORMAT_TIME;
+
+	g_return_val_if_fail (NSC_IS_SPLITTER (splitter), FALSE);
+
+	priv = NSC_SPLITTER_GET_PRIVATE (splitter);
+
+	if (!gst_element_query_position (priv->split->pipeline,
+					 &format,
+					 &nanos))
+		return TRUE;
+
+	secs = nanos / GST_SECOND;
+	if (secs != priv->seconds) {
+		priv->seconds = secs;
+		g_signal_emit (splitter, signals[PROGRESS], 0, secs);
+	}
+
+	return TRUE;
+}
+
+/*
+ * Public Methods
+ */
+NscSplitter *
+nsc_splitter_new (GMAudioProfile *profile)
+{
+	NscSplitter *splitter;
+
+	g_return_val_if_fail (profile != NULL, NULL);
+
+	splitter = g_object_new (NSC_TYPE_SPLITTER, NULL);
+	NSC_SPLITTER_GET_PRIVATE (splitter)->profile = g_object_ref (profile);
+
+	return splitter;
+}
+
+/**
+ * The file track @index of @sheet is written to in @directory when
+ * split with @profile.  This will need to be unreferenced.
+ */
+GFile *
+nsc_splitter_get_track_file (GMAudioProfile *profile,
+			     NscCueSheet    *sheet,
+			     GFile          *directory,
+			     guint           index)
+{
+	GFile *file;
+	gchar *basename;
+
+	g_return_val_if_fail (profile != NULL, NULL);
+	g_return_val_if_fail (sheet != NULL, NULL);
+	g_return_val_if_fail (index < sheet->tracks->len, NULL);
+
+	basename = track_basename (profile,
+				   g_ptr_array_index (sheet->tracks, index));
+	file = g_file_get_child (directory, basename);
+	g_free (basename);
+
+	return file;
+}
+
+/**
+ * Split @src into a file per track of @sheet, in @directory.
+ * The splitter takes ownership of @sheet.
+ */
+void
+nsc_splitter_split_file (NscSplitter  *splitter,
+			 GFile        *src,
+			 NscCueSheet  *sheet,
+			 GFile        *directory,
+			 GError      **error)
+{
+	NscSplitterPrivate   *priv;
+	GstStateChangeReturn  state_ret;
+	GstBus               *bus;
+	Split                *split;
+	gint64                nanos;
+	static GstFormat      format = GST_FORMAT_TIME;
+
+	g_return_if_fail (NSC_IS_SPLITTER (splitter));
+	g_return_if_fail (G_IS_FILE (src));
+	g_return_if_fail (sheet != NULL);
+	g_return_if_fail (G_IS_FILE (directory));
+
+	priv = NSC_SPLITTER_GET_PRIVATE (splitter);
+
+	release_split (splitter, FALSE);
+
+	split = build_split (priv->profile, src, sheet, directory, error);
+	if (split == NULL)
+		return;
+
+	split->splitter = splitter;
+	priv->split = split;
+	priv->seconds = 0;
+
+	bus = gst_element_get_bus (split->pipeline);
+	gst_bus_add_signal_watch (bus);
+	g_signal_connect (G_OBJECT (bus), "message::error",
+			  G_CALLBACK (decode_error_cb), splitter);
+	g_signal_connect (G_OBJECT (bus), "message::eos",
+			  G_CALLBACK (decode_eos_cb), splitter);
+	gst_object_unref (bus);
+
+	state_ret = gst_element_set_state (split->pipeline, GST_STATE_PLAYING);
+	if (state_ret == GST_STATE_CHANGE_ASYNC) {
+		/* Only to catch immediate errors, like in NscGStreamer */
+		state_ret = gst_element_get_state (split->pipeline,
+						   NULL, NULL,
+						   GST_SECOND / 2);
+	}
+
+	if (state_ret == GST_STATE_CHANGE_FAILURE) {
+		GstMessage *msg;
+
+		/* Without running the bus watch, which would report it too */
+		msg = gst_bus_pop_filtered (GST_ELEMENT_BUS (split->pipeline),
+					    GST_MESSAGE_ERROR);
+		if (msg) {
+			gst_message_parse_error (msg, error, NULL);
+			gst_message_unref (msg);
+		} else if (error) {
+			*error = g_error_new (NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+					      "Error starting splitting pipeline");
+		}
+
+		release_split (splitter, FALSE);
+		return;
+	}
+
+	if (gst_element_query_duration (split->pipeline, &format, &nanos))
+		g_signal_emit (splitter, signals[DURATION], 0,
+			       (gint) (nanos / GST_SECOND));
+
+	priv->tick_id = g_timeout_add (250, (GSourceFunc) tick_timeout_cb,
+				       splitter);
+}
+
+/**
+ * Stop splitting, and remove the tracks that were written.  This
+ * returns without waiting for the pipelines to stop.
+ */
+void
+nsc_splitter_cancel (NscSplitter *splitter)
+{
+	g_return_if_fail (NSC_IS_SPLITTER (splitter));
+
+	release_split (splitter, TRUE);
+}
+
+void
+nsc_splitter_pause (NscSplitter *splitter)
+{
+	NscSplitterPrivate *priv;
+	Split              *split;
+	guint               i;
+
+	g_return_if_fail (NSC_IS_SPLITTER (splitter));
+
+	priv = NSC_SPLITTER_GET_PRIVATE (splitter);
+	split = priv->split;
+
+	if (split == NULL || priv->paused)
+		return;
+
+	priv->paused = TRUE;
+	if (!split->decoded)
+		gst_element_set_state (split->pipeline, GST_STATE_PAUSED);
+
+	g_mutex_lock (&split->lock);
+	for (i = 0; i < split->tracks->len; i++) {
+		Track *track = g_ptr_array_index (split->tracks, i);
+
+		if (!track->done)
+			gst_element_set_state (track->pipeline,
+					       GST_STATE_PAUSED);
+	}
+	g_mutex_unlock (&split->lock);
+
+	if (priv->tick_id) {
+		g_source_remove (priv->tick_id);
+		priv->tick_id = 0;
+	}
+}
+
+void
+nsc_splitter_resume (NscSplitter *splitter)
+{
+	NscSplitterPrivate *priv;
+	Split              *split;
+	guint               i;
+
+	g_return_if_fail (NSC_IS_SPLITTER (splitter));
+
+	priv = NSC_SPLITTER_GET_PRIVATE (splitter);
+	split = priv->split;
+
+	if (split == NULL || !priv->paused)
+		return;
+
+	priv->paused = FALSE;
+
+	g_mutex_lock (&split->lock);
+	for (i = 0; i < split->tracks->len; i++) {
+		Track *track = g_ptr_array_index (split->tracks, i);
+
+		if (!track->done)
+			gst_element_set_state (track->pipeline,
+					       GST_STATE_PLAYING);
+	}
+	g_mutex_unlock (&split->lock);
+
+	if (!split->decoded) {
+		gst_element_set_state (split->pipeline, GST_STATE_PLAYING);
+		priv->tick_id = g_timeout_add (250,
+					       (GSourceFunc) tick_timeout_cb,
+					       splitter);
+	}
+}
@@ -0,0 +1,84 @@
+/*
+ *  nsc-split.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_SPLIT_H
+#define NSC_SPLIT_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <profiles/audio-profile.h>
+
+#include "nsc-cue.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Splits a whole-album image into a file per track of its cue
+ * sheet.  The image is decoded once, and the audio is cut at the
+ * exact sample each track starts at, so nothing is lost or doubled
+ * between tracks.  Emits the same signals as NscGStreamer, for the
+ * image as a whole.
+ */
+
+#define NSC_TYPE_SPLITTER            (nsc_splitter_get_type ())
+#define NSC_SPLITTER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NSC_TYPE_SPLITTER, NscSplitter))
+#define NSC_SPLITTER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NSC_TYPE_SPLITTER, NscSplitterClass))
+#define NSC_IS_SPLITTER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NSC_TYPE_SPLITTER))
+#define NSC_IS_SPLITTER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NSC_TYPE_SPLITTER))
+#define NSC_SPLITTER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NSC_TYPE_SPLITTER, NscSplitterClass))
+
+typedef struct {
+	/* Parent object */
+	GObject  object;
+	/* Private data pointer */
+	gpointer priv;
+} NscSplitter;
+
+typedef struct {
+	GObjectClass        parent_class;
+	void (*progress)   (NscSplitter *splitter, const int seconds);
+	void (*duration)   (NscSplitter *splitter, const int seconds);
+	void (*completion) (NscSplitter *splitter);
+	void (*error)      (NscSplitter *splitter, GError *error);
+} NscSplitterClass;
+
+GType        nsc_splitter_get_type   (void);
+NscSplitter *nsc_splitter_new        (GMAudioProfile  *profile);
+void         nsc_splitter_split_file (NscSplitter     *splitter,
+				      GFile           *src,
+				      NscCueSheet     *sheet,
+				      GFile           *directory,
+				      GError         **error);
+void         nsc_splitter_cancel     (NscSplitter     *splitter);
+void         nsc_splitter_pause      (NscSplitter     *splitter);
+void         nsc_splitter_resume     (NscSplitter     *splitter);
+
+GFile       *nsc_splitter_get_track_file (GMAudioProfile *profile,
+					  NscCueSheet    *sheet,
+					  GFile          *directory,
+					  guint           index);
+
+G_END_DECLS
+
+#endif /* NSC_SPLIT_H */
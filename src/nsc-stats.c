@@ -0,0 +1,392 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-stats.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "nsc-stats.h"
+
+struct _NscStats {
+	GPtrArray *files;
+	time_t     started;
+};
+
+static const gchar *stage_names[NSC_STAGE_LAST] = {
+	"decode",
+	"encode",
+	"write",
+};
+
+/*
+ * Private Methods
+ */
+static void
+append_csv_string (GString     *string,
+		   const gchar *value)
+{
+	const gchar *p;
+
+	g_string_append_c (string, '"');
+
+	for (p = value ? value : ""; *p != '\0'; p++) {
+		if (*p == '"')
+			g_string_append_c (string, '"');
+		g_string_append_c (string, *p);
+	}
+
+	g_string_append_c (string, '"');
+}
+
+/* Microseconds to seconds, leaving stages that were not measured empty */
+static void
+append_seconds (GString     *string,
+		gint64       usecs,
+		const gchar *missing)
+{
+	if (usecs < 0)
+		g_string_append (string, missing);
+	else
+		g_string_append_printf (string, "%.6f",
+					(gdouble) usecs / G_USEC_PER_SEC);
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * Append @value as a quoted JSON string.
+ */
+void
+nsc_append_json_string (GString     *string,
+			const gchar *value)
+{
+	const gchar *p;
+
+	g_string_append_c (string, '"');
+
+	for (p = value ? value : ""; *p != '\0'; p++) {
+		switch (*p) {
+		case '"':
+			g_string_append (string, "\\\"");
+			break;
+		case '\\':
+			g_string_append (string, "\\\\");
+			break;
+		case '\n':
+			g_string_append (string, "\\n");
+			break;
+		default:
+			if ((guchar) *p < 0x20)
+				g_string_append_printf (string, "\\u%04x",
+							(guint) *p);
+			else
+				g_string_append_c (string, *p);
+		}
+	}
+
+	g_string_append_c (string, '"');
+}
+
+void
+nsc_file_stats_reset (NscFileStats *file_stats)
+{
+	gint i;
+
+	g_return_if_fail (file_stats != NULL);
+
+	g_free (file_stats->uri);
+	g_free (file_stats->profile);
+
+	memset (file_stats, 0, sizeof (NscFileStats));
+
+	for (i = 0; i < NSC_STAGE_LAST; i++)
+		file_stats->stage_cpu[i] = -1;
+}
+
+NscFileStats *
+nsc_file_stats_copy (const NscFileStats *file_stats)
+{
+	NscFileStats *copy;
+
+	g_return_val_if_fail (file_stats != NULL, NULL);
+
+	copy = g_memdup (file_stats, sizeof (NscFileStats));
+	copy->uri = g_strdup (file_stats->uri);
+	copy->profile = g_strdup (file_stats->profile);
+
+	return copy;
+}
+
+void
+nsc_file_stats_free (NscFileStats *file_stats)
+{
+	if (file_stats == NULL)
+		return;
+
+	g_free (file_stats->uri);
+	g_free (file_stats->profile);
+	g_free (file_stats);
+}
+
+const gchar *
+nsc_stage_get_name (NscStage stage)
+{
+	g_return_val_if_fail (stage < NSC_STAGE_LAST, NULL);
+
+	return stage_names[stage];
+}
+
+NscStats *
+nsc_stats_new (void)
+{
+	NscStats *stats;
+
+	stats = g_new0 (NscStats, 1);
+	stats->files = g_ptr_array_new ();
+	stats->started = time (NULL);
+
+	return stats;
+}
+
+void
+nsc_stats_free (NscStats *stats)
+{
+	if (stats == NULL)
+		return;
+
+	g_ptr_array_foreach (stats->files, (GFunc) nsc_file_stats_free, NULL);
+	g_ptr_array_free (stats->files, TRUE);
+	g_free (stats);
+}
+
+/**
+ * The stats take ownership of @file_stats.
+ */
+void
+nsc_stats_add (NscStats     *stats,
+	       NscFileStats *file_stats)
+{
+	g_return_if_fail (stats != NULL);
+	g_return_if_fail (file_stats != NULL);
+
+	g_ptr_array_add (stats->files, file_stats);
+}
+
+guint
+nsc_stats_get_length (NscStats *stats)
+{
+	g_return_val_if_fail (stats != NULL, 0);
+
+	return stats->files->len;
+}
+
+const NscFileStats *
+nsc_stats_get (NscStats *stats,
+	       guint     index)
+{
+	g_return_val_if_fail (stats != NULL, NULL);
+	g_return_val_if_fail (index < stats->files->len, NULL);
+
+	return g_ptr_array_index (stats->files, index);
+}
+
+gboolean
+nsc_stats_write_csv (NscStats     *stats,
+		     const gchar  *filename,
+		     GError      **error)
+{
+	GString  *csv;
+	gboolean  result;
+	guint     i;
+	gint      stage;
+
+	g_return_val_if_fail (stats != NULL, FALSE);
+
+	csv = g_string_new ("uri,profile,success,duration,realtime_factor,"
+			    "build_time,preroll_time,wall_time,"
+			    "startup_time,query_time,stop_time");
+	for (stage = 0; stage < NSC_STAGE_LAST; stage++)
+		g_string_append_printf (csv, ",%s_cpu", stage_names[stage]);
+	g_string_append (csv, ",bytes_read,bytes_written\n");
+
+	for (i = 0; i < stats->files->len; i++) {
+		NscFileStats *file = g_ptr_array_index (stats->files, i);
+
+		append_csv_string (csv, file->uri);
+		g_string_append_c (csv, ',');
+		append_csv_string (csv, file->profile);
+		g_string_append_printf (csv, ",%d,%.3f,%.3f,",
+					file->success ? 1 : 0,
+					file->duration,
+					file->realtime_factor);
+		append_seconds (csv, file->build_time, "");
+		g_string_append_c (csv, ',');
+		append_seconds (csv, file->preroll_time, "");
+		g_string_append_c (csv, ',');
+		append_seconds (csv, file->wall_time, "");
+		g_string_append_c (csv, ',');
+		append_seconds (csv, file->startup_time, "");
+		g_string_append_c (csv, ',');
+		append_seconds (csv, file->query_time, "");
+		g_string_append_c (csv, ',');
+		append_seconds (csv, file->stop_time, "");
+
+		for (stage = 0; stage < NSC_STAGE_LAST; stage++) {
+			g_string_append_c (csv, ',');
+			append_seconds (csv, file->stage_cpu[stage], "");
+		}
+
+		g_string_append_printf (csv, ",%" G_GUINT64_FORMAT
+					",%" G_GUINT64_FORMAT "\n",
+					file->bytes_read,
+					file->bytes_written);
+	}
+
+	result = g_file_set_contents (filename, csv->str, csv->len, error);
+	g_string_free (csv, TRUE);
+
+	return result;
+}
+
+gboolean
+nsc_stats_write_json (NscStats     *stats,
+		      const gchar  *filename,
+		      GError      **error)
+{
+	GString  *json;
+	gboolean  result;
+	guint     i;
+	gint      stage;
+
+	g_return_val_if_fail (stats != NULL, FALSE);
+
+	json = g_string_new ("{\n  \"host\": ");
+	nsc_append_json_string (json, g_get_host_name ());
+	g_string_append_printf (json, ",\n  \"cpus\": %ld,\n"
+				"  \"started\": %ld,\n  \"files\": [",
+				sysconf (_SC_NPROCESSORS_ONLN),
+				(long) stats->started);
+
+	for (i = 0; i < stats->files->len; i++) {
+		NscFileStats *file = g_ptr_array_index (stats->files, i);
+
+		g_string_append (json, i == 0 ? "\n    {" : ",\n    {");
+		g_string_append (json, "\"uri\": ");
+		nsc_append_json_string (json, file->uri);
+		g_string_append (json, ", \"profile\": ");
+		nsc_append_json_string (json, file->profile);
+		g_string_append_printf (json, ", \"success\": %s, "
+					"\"duration\": %.3f, "
+					"\"realtime_factor\": %.3f",
+					file->success ? "true" : "false",
+					file->duration,
+					file->realtime_factor);
+
+		g_string_append (json, ", \"build_time\": ");
+		append_seconds (json, file->build_time, "null");
+		g_string_append (json, ", \"preroll_time\": ");
+		append_seconds (json, file->preroll_time, "null");
+		g_string_append (json, ", \"wall_time\": ");
+		append_seconds (json, file->wall_time, "null");
+		g_string_append (json, ", \"startup_time\": ");
+		append_seconds (json, file->startup_time, "null");
+		g_string_append (json, ", \"query_time\": ");
+		append_seconds (json, file->query_time, "null");
+		g_string_append (json, ", \"stop_time\": ");
+		append_seconds (json, file->stop_time, "null");
+
+		g_string_append (json, ", \"cpu\": {");
+		for (stage = 0; stage < NSC_STAGE_LAST; stage++) {
+			g_string_append_printf (json, "%s\"%s\": ",
+						stage == 0 ? "" : ", ",
+						stage_names[stage]);
+			append_seconds (json, file->stage_cpu[stage], "null");
+		}
+		g_string_append (json, "}");
+
+		g_string_append_printf (json, ", \"bytes_read\": %"
+					G_GUINT64_FORMAT
+					", \"bytes_written\": %"
+					G_GUINT64_FORMAT "}",
+					file->bytes_read,
+					file->bytes_written);
+	}
+
+	g_string_append (json, "\n  ]\n}\n");
+
+	result = g_file_set_contents (filename, json->str, json->len, error);
+	g_string_free (json, TRUE);
+
+	return result;
+}
+
+/**
+ * Write the report as both CSV and JSON into @directory, named
+ * after the time the batch was started.
+ */
+gboolean
+nsc_stats_export (NscStats     *stats,
+		  const gchar  *directory,
+		  GError      **error)
+{
+	static guint  n_exports = 0;
+	gchar         stamp[32];
+	gchar        *basename, *filename;
+	gboolean      result;
+
+	g_return_val_if_fail (stats != NULL, FALSE);
+	g_return_val_if_fail (directory != NULL, FALSE);
+
+	g_mkdir_with_parents (directory, 0755);
+
+	strftime (stamp, sizeof (stamp), "%Y%m%d-%H%M%S",
+		  localtime (&stats->started));
+	n_exports++;
+
+	basename = g_strdup_printf ("nsc-batch-%s-%d-%u.csv", stamp,
+				    getpid (), n_exports);
+	filename = g_build_filename (directory, basename, NULL);
+	result = nsc_stats_write_csv (stats, filename, error);
+	g_free (filename);
+	g_free (basename);
+
+	if (!result)
+		return FALSE;
+
+	basename = g_strdup_printf ("nsc-batch-%s-%d-%u.json", stamp,
+				    getpid (), n_exports);
+	filename = g_build_filename (directory, basename, NULL);
+	result = nsc_stats_write_json (stats, filename, error);
+	g_free (filename);
+	g_free (basename);
+
+	return result;
+}
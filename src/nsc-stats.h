@@ -0,0 +1,104 @@
+/*
+ *  nsc-stats.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#ifndef NSC_STATS_H
+#define NSC_STATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+	NSC_STAGE_DECODE,
+	NSC_STAGE_ENCODE,
+	NSC_STAGE_WRITE,
+	NSC_STAGE_LAST
+} NscStage;
+
+/*
+ * What it took to convert a single file.  Times are in
+ * microseconds, and a stage time of -1 means it was not measured.
+ */
+typedef struct {
+	gchar    *uri;
+	gchar    *profile;
+	gboolean  success;
+
+	gint64    build_time;
+	gint64    preroll_time;
+	gint64    wall_time;
+
+	/*
+	 * The fixed cost of a file: waiting for the pipeline to start,
+	 * asking for the duration, and stopping it after EOS.
+	 */
+	gint64    startup_time;
+	gint64    query_time;
+	gint64    stop_time;
+	gint64    stage_cpu[NSC_STAGE_LAST];
+
+	/* Only counted when instrumenting, like the stage times */
+	guint64   bytes_read;
+	guint64   bytes_written;
+
+	/* Seconds of audio, and how many of them were done per second */
+	gdouble   duration;
+	gdouble   realtime_factor;
+
+	/* Seconds of audio in the input, more than the above for a range */
+	gdouble   source_duration;
+} NscFileStats;
+
+/* The statistics of every file in a batch */
+typedef struct _NscStats NscStats;
+
+void          nsc_file_stats_reset (NscFileStats       *file_stats);
+NscFileStats *nsc_file_stats_copy  (const NscFileStats *file_stats);
+void          nsc_file_stats_free  (NscFileStats       *file_stats);
+
+const gchar  *nsc_stage_get_name   (NscStage            stage);
+
+NscStats     *nsc_stats_new        (void);
+void          nsc_stats_free       (NscStats           *stats);
+void          nsc_stats_add        (NscStats           *stats,
+				    NscFileStats       *file_stats);
+guint         nsc_stats_get_length (NscStats           *stats);
+const NscFileStats *
+	      nsc_stats_get        (NscStats           *stats,
+				    guint               index);
+gboolean      nsc_stats_write_csv  (NscStats           *stats,
+				    const gchar        *filename,
+				    GError            **error);
+gboolean      nsc_stats_write_json (NscStats           *stats,
+				    const gchar        *filename,
+				    GError            **error);
+gboolean      nsc_stats_export     (NscStats           *stats,
+				    const gchar        *directory,
+				    GError            **error);
+
+void          nsc_append_json_string (GString          *string,
+				      const gchar      *value);
+
+G_END_DECLS
+
+#endif /* NSC_STATS_H */
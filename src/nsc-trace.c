@@ -0,0 +1,286 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-trace.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "nsc-stats.h"
+#include "nsc-trace.h"
+
+struct _NscTrace {
+	GMutex   lock;
+	guint    ref_count;
+
+	/* The events so far, comma separated */
+	GString *events;
+	guint    n_lanes;
+	time_t   started;
+};
+
+/*
+ * Every batch running in the process shares one trace, so a
+ * worker waiting on another shows up in the same timeline.
+ */
+static GMutex        default_lock;
+static NscTrace     *default_trace = NULL;
+
+/*
+ * Private Methods
+ */
+
+/**
+ * Start a new event, with the lock held.
+ */
+static void
+begin_event (NscTrace    *trace,
+	     const gchar *phase,
+	     guint        lane,
+	     const gchar *category,
+	     const gchar *name,
+	     gint64       timestamp)
+{
+	if (trace->events->len > 0)
+		g_string_append (trace->events, ",\n");
+
+	g_string_append_printf (trace->events,
+				"{\"ph\": \"%s\", \"pid\": %d, \"tid\": %u, "
+				"\"ts\": %" G_GINT64_FORMAT ", \"cat\": ",
+				phase, getpid (), lane, timestamp);
+	nsc_append_json_string (trace->events, category);
+	g_string_append (trace->events, ", \"name\": ");
+	nsc_append_json_string (trace->events, name);
+}
+
+static void
+append_detail (NscTrace    *trace,
+	       const gchar *detail)
+{
+	if (detail == NULL)
+		return;
+
+	g_string_append (trace->events, ", \"args\": {\"detail\": ");
+	nsc_append_json_string (trace->events, detail);
+	g_string_append_c (trace->events, '}');
+}
+
+static gboolean
+write_trace (NscTrace     *trace,
+	     const gchar  *directory,
+	     GError      **error)
+{
+	static guint  n_exports = 0;
+	GString      *json;
+	gchar         stamp[32];
+	gchar        *basename, *filename;
+	gboolean      result;
+
+	g_mkdir_with_parents (directory, 0755);
+
+	strftime (stamp, sizeof (stamp), "%Y%m%d-%H%M%S",
+		  localtime (&trace->started));
+	n_exports++;
+
+	basename = g_strdup_printf ("nsc-trace-%s-%d-%u.json", stamp,
+				    getpid (), n_exports);
+	filename = g_build_filename (directory, basename, NULL);
+
+	json = g_string_new ("{\"displayTimeUnit\": \"ms\", "
+			     "\"traceEvents\": [\n");
+	g_string_append_len (json, trace->events->str, trace->events->len);
+	g_string_append (json, "\n]}\n");
+
+	result = g_file_set_contents (filename, json->str, json->len, error);
+
+	g_string_free (json, TRUE);
+	g_free (filename);
+	g_free (basename);
+
+	return result;
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * Get the trace of this process, creating it if there is none.
+ * Every call needs to be matched by nsc_trace_release().
+ */
+NscTrace *
+nsc_trace_acquire (void)
+{
+	NscTrace *trace;
+
+	g_mutex_lock (&default_lock);
+
+	if (default_trace == NULL) {
+		default_trace = g_new0 (NscTrace, 1);
+		g_mutex_init (&default_trace->lock);
+		default_trace->events = g_string_new (NULL);
+		default_trace->started = time (NULL);
+	}
+
+	trace = default_trace;
+	trace->ref_count++;
+
+	g_mutex_unlock (&default_lock);
+
+	return trace;
+}
+
+/**
+ * Once nobody uses the trace any more, it is written into
+ * @directory and freed.
+ */
+gboolean
+nsc_trace_release (NscTrace     *trace,
+		   const gchar  *directory,
+		   GError      **error)
+{
+	gboolean result = TRUE;
+
+	g_return_val_if_fail (trace != NULL, FALSE);
+
+	g_mutex_lock (&default_lock);
+
+	if (--trace->ref_count > 0) {
+		g_mutex_unlock (&default_lock);
+		return TRUE;
+	}
+
+	default_trace = NULL;
+	g_mutex_unlock (&default_lock);
+
+	if (directory != NULL)
+		result = write_trace (trace, directory, error);
+
+	g_string_free (trace->events, TRUE);
+	g_mutex_clear (&trace->lock);
+	g_free (trace);
+
+	return result;
+}
+
+/**
+ * Returns the lane to pass to the other functions.
+ */
+guint
+nsc_trace_add_lane (NscTrace    *trace,
+		    const gchar *name)
+{
+	guint lane;
+
+	g_return_val_if_fail (trace != NULL, 0);
+
+	g_mutex_lock (&trace->lock);
+
+	lane = ++trace->n_lanes;
+	begin_event (trace, "M", lane, "__metadata", "thread_name", 0);
+	g_string_append (trace->events, ", \"args\": {\"name\": ");
+	nsc_append_json_string (trace->events, name);
+	g_string_append (trace->events, "}}");
+
+	g_mutex_unlock (&trace->lock);
+
+	return lane;
+}
+
+void
+nsc_trace_span (NscTrace    *trace,
+		guint        lane,
+		const gchar *category,
+		const gchar *name,
+		gint64       start,
+		gint64       end,
+		const gchar *detail)
+{
+	g_return_if_fail (trace != NULL);
+
+	g_mutex_lock (&trace->lock);
+
+	begin_event (trace, "X", lane, category, name, start);
+	g_string_append_printf (trace->events, ", \"dur\": %" G_GINT64_FORMAT,
+				MAX (end - start, 0));
+	append_detail (trace, detail);
+	g_string_append_c (trace->events, '}');
+
+	g_mutex_unlock (&trace->lock);
+}
+
+void
+nsc_trace_instant (NscTrace    *trace,
+		   guint        lane,
+		   const gchar *category,
+		   const gchar *name,
+		   const gchar *detail)
+{
+	g_return_if_fail (trace != NULL);
+
+	g_mutex_lock (&trace->lock);
+
+	begin_event (trace, "i", lane, category, name,
+		     g_get_monotonic_time ());
+	g_string_append (trace->events, ", \"s\": \"t\"");
+	append_detail (trace, detail);
+	g_string_append_c (trace->events, '}');
+
+	g_mutex_unlock (&trace->lock);
+}
+
+/**
+ * Record the current value of up to two series of a counter,
+ * like the levels of the queues in a pipeline.
+ */
+void
+nsc_trace_counter (NscTrace    *trace,
+		   const gchar *name,
+		   const gchar *series,
+		   gint64       value,
+		   const gchar *series2,
+		   gint64       value2)
+{
+	g_return_if_fail (trace != NULL);
+
+	g_mutex_lock (&trace->lock);
+
+	begin_event (trace, "C", 0, "counter", name,
+		     g_get_monotonic_time ());
+	g_string_append (trace->events, ", \"args\": {");
+	nsc_append_json_string (trace->events, series);
+	g_string_append_printf (trace->events, ": %" G_GINT64_FORMAT, value);
+	if (series2 != NULL) {
+		g_string_append (trace->events, ", ");
+		nsc_append_json_string (trace->events, series2);
+		g_string_append_printf (trace->events,
+					": %" G_GINT64_FORMAT, value2);
+	}
+	g_string_append (trace->events, "}}");
+
+	g_mutex_unlock (&trace->lock);
+}
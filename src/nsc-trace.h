@@ -0,0 +1,68 @@
+/*
+ *  nsc-trace.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_TRACE_H
+#define NSC_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A timeline of what the conversions in this process did, written
+ * in the Chrome trace event format so it can be opened in
+ * chrome://tracing or Perfetto.  Every batch gets a lane of its own,
+ * and times are g_get_monotonic_time () microseconds.  All functions
+ * may be called from any thread.
+ */
+typedef struct _NscTrace NscTrace;
+
+NscTrace *nsc_trace_acquire   (void);
+gboolean  nsc_trace_release   (NscTrace    *trace,
+			       const gchar *directory,
+			       GError     **error);
+guint     nsc_trace_add_lane  (NscTrace    *trace,
+			       const gchar *name);
+void      nsc_trace_span      (NscTrace    *trace,
+			       guint        lane,
+			       const gchar *category,
+			       const gchar *name,
+			       gint64       start,
+			       gint64       end,
+			       const gchar *detail);
+void      nsc_trace_instant   (NscTrace    *trace,
+			       guint        lane,
+			       const gchar *category,
+			       const gchar *name,
+			       const gchar *detail);
+void      nsc_trace_counter   (NscTrace    *trace,
+			       const gchar *name,
+			       const gchar *series,
+			       gint64       value,
+			       const gchar *series2,
+			       gint64       value2);
+
+G_END_DECLS
+
+#endif /* NSC_TRACE_H */
@@ -0,0 +1,395 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-verify.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "nsc-error.h"
+#include "nsc-verify.h"
+
+struct _NscPcmChecksum {
+	GChecksum  *md5;
+	gchar      *digest;
+
+	/* The caps the sample format below was read from */
+	GstCaps    *caps;
+	gboolean    valid;
+
+	/* Bytes per sample in the buffers, and the ones that are hashed */
+	gint        width;
+	gint        packed;
+	gboolean    big_endian;
+
+	/* Samples repacked the way FLAC hashes them */
+	GByteArray *scratch;
+};
+
+struct _NscManifest {
+	GString *lines;
+	time_t   started;
+	guint    n_files;
+	guint    n_matched;
+	guint    n_mismatched;
+};
+
+/* "fLaC", the metadata block header and STREAMINFO */
+#define FLAC_HEADER_SIZE 42
+#define FLAC_MD5_OFFSET  26
+#define FLAC_MD5_SIZE    16
+
+static const gchar *result_names[] = {
+	"none",
+	"unchecked",
+	"match",
+	"mismatch",
+};
+
+/*
+ * Private Methods
+ */
+
+/**
+ * FLAC hashes every sample as the smallest number of little-endian
+ * bytes its bit depth fits in, so 24 bit audio in 32 bit words is
+ * hashed as 3 bytes a sample.  Other formats are hashed as they are.
+ */
+static void
+read_format (NscPcmChecksum *checksum,
+	     GstCaps        *caps)
+{
+	GstStructure *structure;
+	const gchar  *name;
+	gint          width, depth, endianness;
+
+	gst_caps_replace (&checksum->caps, caps);
+	checksum->valid = FALSE;
+
+	if (caps == NULL || gst_caps_get_size (caps) != 1)
+		return;
+
+	structure = gst_caps_get_structure (caps, 0);
+	name = gst_structure_get_name (structure);
+
+	if (!gst_structure_get_int (structure, "width", &width) ||
+	    width <= 0 || width % 8 != 0)
+		return;
+
+	if (!gst_structure_get_int (structure, "endianness", &endianness))
+		endianness = G_BYTE_ORDER;
+
+	if (strcmp (name, "audio/x-raw-int") == 0) {
+		if (!gst_structure_get_int (structure, "depth", &depth))
+			depth = width;
+		checksum->packed = (depth + 7) / 8;
+	} else if (strcmp (name, "audio/x-raw-float") == 0) {
+		checksum->packed = width / 8;
+	} else {
+		return;
+	}
+
+	checksum->width = width / 8;
+	if (checksum->packed <= 0 || checksum->packed > checksum->width)
+		return;
+
+	checksum->big_endian = endianness == G_BIG_ENDIAN;
+	checksum->valid = TRUE;
+}
+
+/*
+ * Public Methods
+ */
+
+const gchar *
+nsc_verify_result_get_name (NscVerifyResult result)
+{
+	g_return_val_if_fail (result <= NSC_VERIFY_MISMATCH, NULL);
+
+	return result_names[result];
+}
+
+NscPcmChecksum *
+nsc_pcm_checksum_new (void)
+{
+	NscPcmChecksum *checksum;
+
+	checksum = g_new0 (NscPcmChecksum, 1);
+	checksum->md5 = g_checksum_new (G_CHECKSUM_MD5);
+	checksum->scratch = g_byte_array_new ();
+	checksum->valid = TRUE;
+
+	return checksum;
+}
+
+void
+nsc_pcm_checksum_free (NscPcmChecksum *checksum)
+{
+	if (checksum == NULL)
+		return;
+
+	g_checksum_free (checksum->md5);
+	g_free (checksum->digest);
+	gst_caps_replace (&checksum->caps, NULL);
+	g_byte_array_free (checksum->scratch, TRUE);
+	g_free (checksum);
+}
+
+/**
+ * Start over for a new file.
+ */
+void
+nsc_pcm_checksum_reset (NscPcmChecksum *checksum)
+{
+	g_return_if_fail (checksum != NULL);
+
+	g_checksum_reset (checksum->md5);
+	g_free (checksum->digest);
+	checksum->digest = NULL;
+	gst_caps_replace (&checksum->caps, NULL);
+	checksum->valid = TRUE;
+}
+
+/**
+ * Called from the streaming thread for every buffer of decoded
+ * audio, so this does no more than hash it, repacking it first when
+ * the samples are wider than FLAC hashes them.
+ */
+void
+nsc_pcm_checksum_update (NscPcmChecksum *checksum,
+			 GstBuffer      *buffer)
+{
+	const guint8 *in;
+	guint8       *out;
+	guint         i, n_samples;
+	gint          byte;
+
+	if (checksum->digest != NULL)
+		return;
+
+	if (GST_BUFFER_CAPS (buffer) != checksum->caps)
+		read_format (checksum, GST_BUFFER_CAPS (buffer));
+
+	if (!checksum->valid)
+		return;
+
+	if (checksum->packed == checksum->width && !checksum->big_endian) {
+		g_checksum_update (checksum->md5, GST_BUFFER_DATA (buffer),
+				   GST_BUFFER_SIZE (buffer));
+		return;
+	}
+
+	n_samples = GST_BUFFER_SIZE (buffer) / checksum->width;
+	g_byte_array_set_size (checksum->scratch,
+			       n_samples * checksum->packed);
+
+	in = GST_BUFFER_DATA (buffer);
+	out = checksum->scratch->data;
+	for (i = 0; i < n_samples; i++, in += checksum->width) {
+		if (checksum->big_endian) {
+			for (byte = 0; byte < checksum->packed; byte++)
+				*out++ = in[checksum->width - 1 - byte];
+		} else {
+			memcpy (out, in, checksum->packed);
+			out += checksum->packed;
+		}
+	}
+
+	g_checksum_update (checksum->md5, checksum->scratch->data,
+			   checksum->scratch->len);
+}
+
+/**
+ * The MD5 of everything hashed since the last reset, or NULL if the
+ * audio was not in a format that can be hashed.  Nothing more can be
+ * added once this is called.
+ */
+const gchar *
+nsc_pcm_checksum_get_string (NscPcmChecksum *checksum)
+{
+	g_return_val_if_fail (checksum != NULL, NULL);
+
+	if (!checksum->valid)
+		return NULL;
+
+	if (checksum->digest == NULL)
+		checksum->digest = g_strdup (g_checksum_get_string (checksum->md5));
+
+	return checksum->digest;
+}
+
+/**
+ * Read the MD5 of the audio that the FLAC encoder stored in the
+ * STREAMINFO block of @file.  Only the header is read.  Returns NULL
+ * without setting @error when the encoder could not store it.
+ */
+gchar *
+nsc_verify_read_flac_md5 (GFile   *file,
+			  GError **error)
+{
+	GFileInputStream *stream;
+	guint8            header[FLAC_HEADER_SIZE];
+	GString          *md5;
+	gsize             n_read;
+	gboolean          result;
+	gint              i;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+	stream = g_file_read (file, NULL, error);
+	if (stream == NULL)
+		return NULL;
+
+	result = g_input_stream_read_all (G_INPUT_STREAM (stream), header,
+					  sizeof (header), &n_read,
+					  NULL, error);
+	g_object_unref (stream);
+
+	if (!result)
+		return NULL;
+
+	/* STREAMINFO always comes first */
+	if (n_read < sizeof (header) || memcmp (header, "fLaC", 4) != 0 ||
+	    (header[4] & 0x7f) != 0) {
+		g_set_error (error, NSC_ERROR, NSC_ERROR_INTERNAL_ERROR,
+			     _("The converted file is not a FLAC file"));
+		return NULL;
+	}
+
+	/* The encoder could not go back to the start to write it */
+	for (i = 0; i < FLAC_MD5_SIZE; i++) {
+		if (header[FLAC_MD5_OFFSET + i] != 0)
+			break;
+	}
+	if (i == FLAC_MD5_SIZE)
+		return NULL;
+
+	md5 = g_string_sized_new (FLAC_MD5_SIZE * 2);
+	for (i = 0; i < FLAC_MD5_SIZE; i++)
+		g_string_append_printf (md5, "%02x",
+					header[FLAC_MD5_OFFSET + i]);
+
+	return g_string_free (md5, FALSE);
+}
+
+NscManifest *
+nsc_manifest_new (void)
+{
+	NscManifest *manifest;
+
+	manifest = g_new0 (NscManifest, 1);
+	manifest->lines = g_string_new (NULL);
+	manifest->started = time (NULL);
+
+	return manifest;
+}
+
+void
+nsc_manifest_free (NscManifest *manifest)
+{
+	if (manifest == NULL)
+		return;
+
+	g_string_free (manifest->lines, TRUE);
+	g_free (manifest);
+}
+
+/**
+ * Add the result of converting @uri, with the MD5 of its decoded
+ * audio, or NULL if there is none.
+ */
+void
+nsc_manifest_add (NscManifest     *manifest,
+		  const gchar     *uri,
+		  NscVerifyResult  result,
+		  const gchar     *pcm_md5)
+{
+	g_return_if_fail (manifest != NULL);
+	g_return_if_fail (uri != NULL);
+
+	if (result == NSC_VERIFY_NONE)
+		return;
+
+	manifest->n_files++;
+	if (result == NSC_VERIFY_MATCH)
+		manifest->n_matched++;
+	else if (result == NSC_VERIFY_MISMATCH)
+		manifest->n_mismatched++;
+
+	g_string_append_printf (manifest->lines, "%s\t%s\t%s\n",
+				result_names[result],
+				pcm_md5 ? pcm_md5 : "-",
+				uri);
+}
+
+/**
+ * Write the manifest into @directory, named after the time the
+ * batch was started.  There is one line for every file, with the
+ * result, the MD5 of the decoded audio and the file it came from.
+ */
+gboolean
+nsc_manifest_export (NscManifest  *manifest,
+		     const gchar  *directory,
+		     GError      **error)
+{
+	static guint  n_exports = 0;
+	GString      *contents;
+	gchar         stamp[32];
+	gchar        *basename, *filename;
+	gboolean      result;
+
+	g_return_val_if_fail (manifest != NULL, FALSE);
+	g_return_val_if_fail (directory != NULL, FALSE);
+
+	g_mkdir_with_parents (directory, 0755);
+
+	strftime (stamp, sizeof (stamp), "%Y%m%d-%H%M%S",
+		  localtime (&manifest->started));
+	n_exports++;
+
+	contents = g_string_new (NULL);
+	g_string_append_printf (contents,
+				"# files: %u, matched: %u, mismatched: %u\n"
+				"# result\tpcm_md5\turi\n",
+				manifest->n_files, manifest->n_matched,
+				manifest->n_mismatched);
+	g_string_append_len (contents, manifest->lines->str,
+			     manifest->lines->len);
+
+	basename = g_strdup_printf ("nsc-verify-%s-%d-%u.txt", stamp,
+				    getpid (), n_exports);
+	filename = g_build_filename (directory, basename, NULL);
+	result = g_file_set_contents (filename, contents->str,
+				      contents->len, error);
+	g_free (filename);
+	g_free (basename);
+	g_string_free (contents, TRUE);
+
+	return result;
+}
@@ -0,0 +1,72 @@
+/*
+ *  nsc-verify.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_VERIFY_H
+#define NSC_VERIFY_H
+
+#include <gio/gio.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+	/* Verification was off, or the file never got to the end */
+	NSC_VERIFY_NONE,
+	/* The decoded audio was checksummed, but there is nothing to compare */
+	NSC_VERIFY_UNCHECKED,
+	NSC_VERIFY_MATCH,
+	NSC_VERIFY_MISMATCH
+} NscVerifyResult;
+
+/* An MD5 of the decoded audio, the same way FLAC computes it */
+typedef struct _NscPcmChecksum NscPcmChecksum;
+
+/* The verification results of every file in a batch */
+typedef struct _NscManifest NscManifest;
+
+const gchar    *nsc_verify_result_get_name (NscVerifyResult  result);
+
+NscPcmChecksum *nsc_pcm_checksum_new       (void);
+void            nsc_pcm_checksum_free      (NscPcmChecksum  *checksum);
+void            nsc_pcm_checksum_reset     (NscPcmChecksum  *checksum);
+void            nsc_pcm_checksum_update    (NscPcmChecksum  *checksum,
+					    GstBuffer       *buffer);
+const gchar    *nsc_pcm_checksum_get_string (NscPcmChecksum *checksum);
+
+gchar          *nsc_verify_read_flac_md5   (GFile           *file,
+					    GError         **error);
+
+NscManifest    *nsc_manifest_new           (void);
+void            nsc_manifest_free          (NscManifest     *manifest);
+void            nsc_manifest_add           (NscManifest     *manifest,
+					    const gchar     *uri,
+					    NscVerifyResult  result,
+					    const gchar     *pcm_md5);
+gboolean        nsc_manifest_export        (NscManifest     *manifest,
+					    const gchar     *directory,
+					    GError         **error);
+
+G_END_DECLS
+
+#endif /* NSC_VERIFY_H */
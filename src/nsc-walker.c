@@ -0,0 +1,495 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-walker.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+#include <config.h>
+
+#include "nsc-walker.h"
+
+/* Signals */
+enum {
+	FILE_FOUND,
+	FINISHED,
+	LAST_SIGNAL,
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* Directories read at the same time */
+#define MAX_RUNNING 4
+
+/* Entries asked for at a time */
+#define N_FILES_PER_REQUEST 64
+
+/*
+ * The content type is guessed from the name, as sniffing every
+ * file of a large collection would read far more than the walk.
+ */
+#define WALK_ATTRIBUTES					\
+	G_FILE_ATTRIBUTE_STANDARD_NAME ","		\
+	G_FILE_ATTRIBUTE_STANDARD_TYPE ","		\
+	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","		\
+	G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+
+typedef struct _NscWalkerPrivate NscWalkerPrivate;
+
+struct _NscWalkerPrivate {
+	/* The directory being walked */
+	GFile         *root;
+
+	/* The files reported, or NULL for any audio file */
+	gchar        **mime_types;
+
+	/* Directories found but not read yet */
+	GQueue        *pending;
+
+	/* Directories being read */
+	guint          n_running;
+
+	guint          n_found;
+	gboolean       running;
+	GCancellable  *cancellable;
+};
+
+/* A directory being read */
+typedef struct {
+	NscWalker       *walker;
+	GFile           *dir;
+	gchar           *path;
+	GFileEnumerator *enumerator;
+} Enumeration;
+
+#define NSC_WALKER_GET_PRIVATE(o)           \
+	((NscWalkerPrivate *)((NSC_WALKER(o))->priv))
+
+G_DEFINE_TYPE (NscWalker, nsc_walker, G_TYPE_OBJECT)
+
+static void run_pending (NscWalker *walker);
+
+static Enumeration *
+enumeration_new (NscWalker   *walker,
+		 GFile       *dir,
+		 const gchar *path)
+{
+	Enumeration *enumeration;
+
+	enumeration = g_new0 (Enumeration, 1);
+	enumeration->walker = walker;
+	enumeration->dir = g_object_ref (dir);
+	enumeration->path = g_strdup (path);
+
+	return enumeration;
+}
+
+static void
+enumeration_free (Enumeration *enumeration)
+{
+	if (enumeration->enumerator != NULL)
+		g_object_unref (enumeration->enumerator);
+	g_object_unref (enumeration->dir);
+	g_free (enumeration->path);
+	g_free (enumeration);
+}
+
+static void
+nsc_walker_dispose (GObject *object)
+{
+	NscWalker        *self = (NscWalker *) object;
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		if (priv->root) {
+			g_object_unref (priv->root);
+			priv->root = NULL;
+		}
+
+		if (priv->cancellable) {
+			g_object_unref (priv->cancellable);
+			priv->cancellable = NULL;
+		}
+	}
+
+	G_OBJECT_CLASS (nsc_walker_parent_class)->dispose (object);
+}
+
+static void
+nsc_walker_finalize (GObject *object)
+{
+	NscWalker        *self = (NscWalker *) object;
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		g_strfreev (priv->mime_types);
+		g_queue_foreach (priv->pending, (GFunc) enumeration_free, NULL);
+		g_queue_free (priv->pending);
+
+		g_free (priv);
+
+		(NSC_WALKER (self))->priv = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_walker_parent_class)->finalize (object);
+}
+
+/*
+ * Private Methods
+ */
+static gboolean
+is_wanted (NscWalker   *walker,
+	   const gchar *content_type)
+{
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (walker);
+	gint              i;
+
+	if (content_type == NULL)
+		return FALSE;
+
+	if (priv->mime_types == NULL)
+		return g_content_type_is_a (content_type, "audio/*");
+
+	for (i = 0; priv->mime_types[i] != NULL; i++)
+		if (g_content_type_is_a (content_type, priv->mime_types[i]))
+			return TRUE;
+
+	return FALSE;
+}
+
+/**
+ * Report the files as they come, and queue the directories
+ * to be read next.
+ */
+static void
+add_info (Enumeration *enumeration,
+	  GFileInfo   *info)
+{
+	NscWalker        *walker = enumeration->walker;
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (walker);
+	const gchar      *name, *content_type;
+	GFile            *child;
+
+	if (g_file_info_get_is_hidden (info))
+		return;
+
+	name = g_file_info_get_name (info);
+
+	switch (g_file_info_get_file_type (info)) {
+	case G_FILE_TYPE_DIRECTORY: {
+		gchar *path;
+
+		child = g_file_get_child (enumeration->dir, name);
+		path = g_build_filename (enumeration->path, name, NULL);
+		g_queue_push_tail (priv->pending,
+				   enumeration_new (walker, child, path));
+		g_free (path);
+		g_object_unref (child);
+		break;
+	}
+	case G_FILE_TYPE_REGULAR:
+		content_type = g_file_info_get_attribute_string (info,
+								 G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+		if (!is_wanted (walker, content_type))
+			break;
+
+		child = g_file_get_child (enumeration->dir, name);
+		priv->n_found++;
+		g_signal_emit (walker, signals[FILE_FOUND], 0,
+			       child, enumeration->path);
+		g_object_unref (child);
+		break;
+	default:
+		/* Links are not followed, so the walk can not loop */
+		break;
+	}
+}
+
+/**
+ * A directory has been read, so start on the next one, or
+ * finish if that was the last.
+ */
+static void
+enumeration_done (Enumeration *enumeration)
+{
+	NscWalker        *walker = enumeration->walker;
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (walker);
+
+	if (enumeration->enumerator != NULL)
+		g_file_enumerator_close_async (enumeration->enumerator,
+					       G_PRIORITY_LOW, NULL,
+					       NULL, NULL);
+	enumeration_free (enumeration);
+
+	priv->n_running--;
+	if (priv->running)
+		run_pending (walker);
+
+	g_object_unref (walker);
+}
+
+static void
+next_files_cb (GObject      *source,
+	       GAsyncResult *res,
+	       gpointer      data)
+{
+	Enumeration      *enumeration = data;
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (enumeration->walker);
+	GList            *infos, *l;
+	GError           *error = NULL;
+
+	infos = g_file_enumerator_next_files_finish (G_FILE_ENUMERATOR (source),
+						     res, &error);
+
+	if (infos == NULL || !priv->running) {
+		if (error != NULL &&
+		    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_warning ("Unable to read %s; %s",
+				   enumeration->path, error->message);
+		}
+		if (error != NULL)
+			g_error_free (error);
+
+		g_list_free_full (infos, g_object_unref);
+		enumeration_done (enumeration);
+		return;
+	}
+
+	for (l = infos; l != NULL; l = l->next)
+		add_info (enumeration, l->data);
+	g_list_free_full (infos, g_object_unref);
+
+	/* The handlers may have cancelled the walk */
+	if (!priv->running) {
+		enumeration_done (enumeration);
+		return;
+	}
+
+	/* Read the directories found here while this one goes on */
+	run_pending (enumeration->walker);
+
+	g_file_enumerator_next_files_async (enumeration->enumerator,
+					    N_FILES_PER_REQUEST,
+					    G_PRIORITY_LOW,
+					    priv->cancellable,
+					    next_files_cb,
+					    enumeration);
+}
+
+static void
+enumerate_cb (GObject      *source,
+	      GAsyncResult *res,
+	      gpointer      data)
+{
+	Enumeration      *enumeration = data;
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (enumeration->walker);
+	GError           *error = NULL;
+
+	enumeration->enumerator =
+		g_file_enumerate_children_finish (G_FILE (source), res, &error);
+
+	if (enumeration->enumerator == NULL) {
+		/* A directory we can not read is skipped */
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("Unable to read %s; %s",
+				   enumeration->path, error->message);
+		g_error_free (error);
+
+		enumeration_done (enumeration);
+		return;
+	}
+
+	if (!priv->running) {
+		enumeration_done (enumeration);
+		return;
+	}
+
+	g_file_enumerator_next_files_async (enumeration->enumerator,
+					    N_FILES_PER_REQUEST,
+					    G_PRIORITY_LOW,
+					    priv->cancellable,
+					    next_files_cb,
+					    enumeration);
+}
+
+/**
+ * Start reading as many of the pending directories as we may.
+ */
+static void
+run_pending (NscWalker *walker)
+{
+	NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (walker);
+	Enumeration      *enumeration;
+
+	while (priv->n_running < MAX_RUNNING &&
+	       !g_queue_is_empty (priv->pending)) {
+		enumeration = g_queue_pop_head (priv->pending);
+
+		priv->n_running++;
+		g_object_ref (walker);
+
+		g_file_enumerate_children_async (enumeration->dir,
+						 WALK_ATTRIBUTES,
+						 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						 G_PRIORITY_LOW,
+						 priv->cancellable,
+						 enumerate_cb,
+						 enumeration);
+	}
+
+	if (priv->n_running == 0 && g_queue_is_empty (priv->pending)) {
+		priv->running = FALSE;
+		g_signal_emit (walker, signals[FINISHED], 0);
+	}
+}
+
+static void
+nsc_walker_class_init (NscWalkerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose  = nsc_walker_dispose;
+	object_class->finalize = nsc_walker_finalize;
+
+	/* Signals */
+	signals[FILE_FOUND] =
+		g_signal_new ("file-found",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscWalkerClass, file_found),
+			      NULL, NULL,
+			      g_cclosure_marshal_generic,
+			      G_TYPE_NONE, 2, G_TYPE_FILE, G_TYPE_STRING);
+	signals[FINISHED] =
+		g_signal_new ("finished",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscWalkerClass, finished),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+static void
+nsc_walker_init (NscWalker *self)
+{
+	/* Allocate Private data structure */
+	(NSC_WALKER (self))->priv = \
+		(NscWalkerPrivate *) g_malloc0 (sizeof (NscWalkerPrivate));
+
+	/* If correctly allocated, initialize parameters */
+	if ((NSC_WALKER (self))->priv != NULL) {
+		NscWalkerPrivate *priv = NSC_WALKER_GET_PRIVATE (self);
+
+		priv->pending = g_queue_new ();
+		priv->cancellable = g_cancellable_new ();
+	}
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * Walk @root, reporting the files of any of @mime_types, or
+ * any audio file when @mime_types is NULL.
+ */
+NscWalker *
+nsc_walker_new (GFile               *root,
+		const gchar * const *mime_types)
+{
+	NscWalker        *walker;
+	NscWalkerPrivate *priv;
+
+	g_return_val_if_fail (G_IS_FILE (root), NULL);
+
+	walker = g_object_new (NSC_TYPE_WALKER, NULL);
+
+	priv = NSC_WALKER_GET_PRIVATE (walker);
+	priv->root = g_object_ref (root);
+	priv->mime_types = g_strdupv ((gchar **) mime_types);
+
+	return walker;
+}
+
+GFile *
+nsc_walker_get_root (NscWalker *walker)
+{
+	g_return_val_if_fail (NSC_IS_WALKER (walker), NULL);
+
+	return NSC_WALKER_GET_PRIVATE (walker)->root;
+}
+
+/**
+ * The number of files reported so far.
+ */
+guint
+nsc_walker_get_n_found (NscWalker *walker)
+{
+	g_return_val_if_fail (NSC_IS_WALKER (walker), 0);
+
+	return NSC_WALKER_GET_PRIVATE (walker)->n_found;
+}
+
+/**
+ * Start the walk.  Every file found is reported with the
+ * directory it is in, relative to the parent of the root, so
+ * the tree can be rebuilt somewhere else.  "finished" is
+ * emitted once every directory has been read.
+ */
+void
+nsc_walker_start (NscWalker *walker)
+{
+	NscWalkerPrivate *priv;
+	gchar            *name;
+
+	g_return_if_fail (NSC_IS_WALKER (walker));
+
+	priv = NSC_WALKER_GET_PRIVATE (walker);
+	g_return_if_fail (!priv->running);
+
+	priv->running = TRUE;
+
+	name = g_file_get_basename (priv->root);
+	g_queue_push_tail (priv->pending,
+			   enumeration_new (walker, priv->root, name));
+	g_free (name);
+
+	run_pending (walker);
+}
+
+/**
+ * Stop the walk.  Nothing is reported after this, not even
+ * "finished".
+ */
+void
+nsc_walker_cancel (NscWalker *walker)
+{
+	NscWalkerPrivate *priv;
+
+	g_return_if_fail (NSC_IS_WALKER (walker));
+
+	priv = NSC_WALKER_GET_PRIVATE (walker);
+	if (!priv->running)
+		return;
+
+	priv->running = FALSE;
+	g_cancellable_cancel (priv->cancellable);
+}
@@ -0,0 +1,74 @@
+/*
+ *  nsc-walker.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_WALKER_H
+#define NSC_WALKER_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Finds the audio files in a directory tree.  Several directories
+ * are read at once, and every file is reported as soon as it is
+ * found, so converting can start long before the walk is done.
+ */
+
+#define NSC_TYPE_WALKER            (nsc_walker_get_type ())
+#define NSC_WALKER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NSC_TYPE_WALKER, NscWalker))
+#define NSC_WALKER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NSC_TYPE_WALKER, NscWalkerClass))
+#define NSC_IS_WALKER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NSC_TYPE_WALKER))
+#define NSC_IS_WALKER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NSC_TYPE_WALKER))
+#define NSC_WALKER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NSC_TYPE_WALKER, NscWalkerClass))
+
+typedef struct _NscWalker      NscWalker;
+typedef struct _NscWalkerClass NscWalkerClass;
+
+struct _NscWalker {
+	/* Parent object */
+	GObject  parent;
+	/* Private data pointer */
+	gpointer priv;
+};
+
+struct _NscWalkerClass {
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (*file_found) (NscWalker *walker, GFile *file, const gchar *path);
+	void (*finished)   (NscWalker *walker);
+};
+
+GType      nsc_walker_get_type    (void);
+NscWalker *nsc_walker_new         (GFile               *root,
+				   const gchar * const *mime_types);
+GFile     *nsc_walker_get_root    (NscWalker           *walker);
+guint      nsc_walker_get_n_found (NscWalker           *walker);
+void       nsc_walker_start       (NscWalker           *walker);
+void       nsc_walker_cancel      (NscWalker           *walker);
+
+G_END_DECLS
+
+#endif /* NSC_WALKER_H */
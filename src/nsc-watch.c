@@ -0,0 +1,401 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-watch.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+/*
+ * Watch mode.  Converts audio files as soon as they are finished in
+ * the watched folders, for recorders that drop their files into a
+ * share all day.  Files that arrive close together are converted in
+ * the same batch, so a burst of files shares a single pipeline.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <gconf/gconf-client.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+#include <gst/gst.h>
+#include <profiles/gnome-media-profiles.h>
+
+#include "nsc-batch.h"
+#include "nsc-gstreamer.h"
+#include "nsc-scheduler.h"
+#include "nsc-watcher.h"
+
+#define GCONF_DIR "/apps/nautilus-sound-converter"
+
+/* Default profile name */
+#define DEFAULT_AUDIO_PROFILE_NAME "cdlossy"
+
+/* Milliseconds without new files before they are converted */
+#define DEFAULT_DEBOUNCE 500
+
+/* A steady stream of files is still converted every few windows */
+#define MAX_DEBOUNCES 4
+
+/* Seconds an idle batch keeps its pipeline for the next file */
+#define LINGER_TIME 30
+
+/* A batch and when each of its files was finished */
+typedef struct {
+	NscBatch *batch;
+	GArray   *ready_times;
+	guint     n_completed;
+	guint     n_failed;
+	gint64    total_latency;
+	gint64    max_latency;
+} Run;
+
+typedef struct {
+	GFile  *file;
+	gint64  ready_time;
+} Pending;
+
+static GMainLoop      *loop = NULL;
+static GConfClient    *gconf = NULL;
+static GMAudioProfile *profile = NULL;
+static gchar          *output_uri = NULL;
+
+/* Files waiting for the window to close */
+static GArray         *pending = NULL;
+static guint           debounce_id = 0;
+
+/* The batch new files are added to, and when it is closed */
+static Run            *current = NULL;
+static guint           linger_id = 0;
+
+/* Options */
+static gchar          *profile_id = NULL;
+static gchar          *output = NULL;
+static gint            debounce = DEFAULT_DEBOUNCE;
+static gchar         **dirs = NULL;
+
+static GOptionEntry entries[] = {
+	{ "profile", 'p', 0, G_OPTION_ARG_STRING, &profile_id,
+	  N_("Audio profile to convert with"), N_("ID") },
+	{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+	  N_("Folder to save the converted files in"), N_("FOLDER") },
+	{ "debounce", 'd', 0, G_OPTION_ARG_INT, &debounce,
+	  N_("Milliseconds to wait for more files before converting"),
+	  N_("MS") },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &dirs,
+	  NULL, N_("FOLDER...") },
+	{ NULL }
+};
+
+/*
+ * Batch callbacks
+ */
+static void
+file_completed_cb (NscBatch *batch, guint index, Run *run)
+{
+	GFile  *file;
+	gint64  latency;
+	gchar  *name;
+
+	latency = g_get_monotonic_time ()
+		- g_array_index (run->ready_times, gint64, index);
+	run->n_completed++;
+	run->total_latency += latency;
+	run->max_latency = MAX (run->max_latency, latency);
+
+	file = nsc_batch_get_file (batch, index);
+	name = g_file_get_parse_name (file);
+	g_print (_("Converted %s, %.0f ms after it was finished\n"),
+		 name, (gdouble) latency / 1000);
+	g_free (name);
+	g_object_unref (file);
+}
+
+static void
+file_failed_cb (NscBatch *batch, guint index, GError *error, Run *run)
+{
+	GFile *file;
+	gchar *name;
+
+	run->n_failed++;
+
+	file = nsc_batch_get_file (batch, index);
+	name = file ? g_file_get_parse_name (file) : g_strdup ("?");
+	g_printerr (_("Could not convert %s: %s\n"), name, error->message);
+	g_free (name);
+	if (file)
+		g_object_unref (file);
+}
+
+static void
+finished_cb (NscBatch *batch, Run *run)
+{
+	if (run->n_completed > 0)
+		g_print (_("Converted %u files, %u failed, "
+			   "%.0f ms after they were finished on average "
+			   "and %.0f ms at most\n"),
+			 run->n_completed, run->n_failed,
+			 (gdouble) run->total_latency / run->n_completed / 1000,
+			 (gdouble) run->max_latency / 1000);
+
+	g_signal_handlers_disconnect_matched (batch, G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, run);
+	g_object_unref (batch);
+	g_array_free (run->ready_times, TRUE);
+	g_free (run);
+}
+
+/**
+ * Settings are read for every batch, like the service does.
+ */
+static Run *
+run_new (void)
+{
+	Run   *run;
+	gchar *dir;
+
+	run = g_new0 (Run, 1);
+	run->ready_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+	run->batch = nsc_batch_new (profile, output_uri);
+
+	nsc_batch_set_retry (run->batch,
+			     gconf_client_get_bool (gconf,
+						    GCONF_DIR "/retry_errors",
+						    NULL));
+	nsc_batch_set_split_cue (run->batch,
+				 gconf_client_get_bool (gconf,
+							GCONF_DIR "/split_cue",
+							NULL));
+
+	dir = gconf_client_get_string (gconf, GCONF_DIR "/report_dir", NULL);
+	if (dir != NULL && *dir != '\0')
+		nsc_batch_set_report_dir (run->batch, dir);
+	g_free (dir);
+
+	dir = gconf_client_get_string (gconf, GCONF_DIR "/verify_dir", NULL);
+	if (dir != NULL && *dir != '\0')
+		nsc_batch_set_verify_dir (run->batch, dir);
+	g_free (dir);
+
+	g_signal_connect (run->batch, "file-completed",
+			  G_CALLBACK (file_completed_cb), run);
+	g_signal_connect (run->batch, "file-failed",
+			  G_CALLBACK (file_failed_cb), run);
+	g_signal_connect (run->batch, "finished",
+			  G_CALLBACK (finished_cb), run);
+
+	/* Keep it waiting for more files until it lingered long enough */
+	nsc_batch_open (run->batch);
+
+	return run;
+}
+
+static gboolean
+linger_timeout_cb (gpointer data)
+{
+	linger_id = 0;
+
+	/* It finishes once it is done with what it has */
+	nsc_batch_close (current->batch);
+	current = NULL;
+
+	return FALSE;
+}
+
+/**
+ * Hand every waiting file to the current batch.
+ */
+static void
+flush_pending (void)
+{
+	gboolean start = FALSE;
+	guint    i;
+
+	if (debounce_id) {
+		g_source_remove (debounce_id);
+		debounce_id = 0;
+	}
+
+	if (pending->len == 0)
+		return;
+
+	if (current == NULL) {
+		current = run_new ();
+		start = TRUE;
+	}
+
+	for (i = 0; i < pending->len; i++) {
+		Pending *p = &g_array_index (pending, Pending, i);
+
+		nsc_batch_add_file (current->batch, p->file);
+		g_array_append_val (current->ready_times, p->ready_time);
+		g_object_unref (p->file);
+	}
+	g_array_set_size (pending, 0);
+
+	if (start)
+		nsc_batch_start (current->batch);
+
+	if (linger_id)
+		g_source_remove (linger_id);
+	linger_id = g_timeout_add_seconds (LINGER_TIME, linger_timeout_cb,
+					   NULL);
+}
+
+static gboolean
+debounce_timeout_cb (gpointer data)
+{
+	debounce_id = 0;
+	flush_pending ();
+
+	return FALSE;
+}
+
+static void
+file_ready_cb (NscWatcher *watcher, GFile *file, gpointer data)
+{
+	Pending  p;
+	gint64   now;
+	guint    i;
+
+	now = g_get_monotonic_time ();
+
+	/* Written to again before it was converted */
+	for (i = 0; i < pending->len; i++) {
+		Pending *other = &g_array_index (pending, Pending, i);
+
+		if (g_file_equal (other->file, file)) {
+			other->ready_time = now;
+			break;
+		}
+	}
+
+	if (i == pending->len) {
+		p.file = g_object_ref (file);
+		p.ready_time = now;
+		g_array_append_val (pending, p);
+	}
+
+	/* Do not keep the first file waiting forever */
+	if (now - g_array_index (pending, Pending, 0).ready_time
+	    >= (gint64) MAX_DEBOUNCES * debounce * 1000) {
+		flush_pending ();
+		return;
+	}
+
+	if (debounce_id)
+		g_source_remove (debounce_id);
+	debounce_id = g_timeout_add (debounce, debounce_timeout_cb, NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	NscWatcher     *watcher;
+	GFile          *output_dir;
+	GError         *error = NULL;
+	gint            i;
+
+	bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+	g_type_init ();
+
+	context = g_option_context_new (_("- Convert audio files as they are added to folders"));
+	g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+	g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+	g_option_context_add_group (context, gst_init_get_option_group ());
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	/* Converting into a watched folder would convert the results again */
+	if (dirs == NULL || output == NULL) {
+		g_printerr (_("Give the folders to watch, and a different folder to save the converted files in with --output\n"));
+		return EXIT_FAILURE;
+	}
+
+	if (debounce <= 0)
+		debounce = DEFAULT_DEBOUNCE;
+
+	gconf = gconf_client_get_default ();
+	gnome_media_profiles_init (gconf);
+
+	/* Recording stations have other work to do */
+	nsc_scheduler_set_throttle (nsc_scheduler_get_default (),
+				    gconf_client_get_bool (gconf,
+							   GCONF_DIR "/throttle",
+							   NULL));
+
+	profile = gm_audio_profile_lookup (profile_id ? profile_id
+					   : DEFAULT_AUDIO_PROFILE_NAME);
+	if (profile == NULL || !nsc_gstreamer_supports_profile (profile)) {
+		g_printerr (_("The audio profile '%s' is not available\n"),
+			    profile_id ? profile_id
+				       : DEFAULT_AUDIO_PROFILE_NAME);
+		return EXIT_FAILURE;
+	}
+
+	output_dir = g_file_new_for_commandline_arg (output);
+	output_uri = g_file_get_uri (output_dir);
+
+	watcher = nsc_watcher_new (NULL);
+	g_signal_connect (watcher, "file-ready",
+			  G_CALLBACK (file_ready_cb), NULL);
+
+	for (i = 0; dirs[i] != NULL; i++) {
+		GFile *dir;
+
+		dir = g_file_new_for_commandline_arg (dirs[i]);
+
+		if (g_file_equal (dir, output_dir)) {
+			g_printerr (_("The converted files can not be saved in a watched folder\n"));
+			return EXIT_FAILURE;
+		}
+
+		if (!nsc_watcher_add_dir (watcher, dir, &error)) {
+			g_printerr ("%s\n", error->message);
+			return EXIT_FAILURE;
+		}
+		g_object_unref (dir);
+	}
+	g_object_unref (output_dir);
+
+	pending = g_array_new (FALSE, FALSE, sizeof (Pending));
+
+	loop = g_main_loop_new (NULL, FALSE);
+	g_main_loop_run (loop);
+
+	g_object_unref (watcher);
+	g_array_free (pending, TRUE);
+	g_main_loop_unref (loop);
+	g_object_unref (gconf);
+
+	return EXIT_SUCCESS;
+}
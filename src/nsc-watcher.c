@@ -0,0 +1,354 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  nsc-watcher.c
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <glib/gi18n.h>
+
+#include "nsc-watcher.h"
+
+/* Signals */
+enum {
+	FILE_READY,
+	LAST_SIGNAL,
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* Closed after writing, or moved in from somewhere else */
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR)
+
+/* Room for a good number of events per read */
+#define EVENT_BUFFER_SIZE 4096
+
+typedef struct _NscWatcherPrivate NscWatcherPrivate;
+
+struct _NscWatcherPrivate {
+	/* The files reported, or NULL for any audio file */
+	gchar      **mime_types;
+
+	/* The inotify instance, and its source in the main loop */
+	gint         fd;
+	GIOChannel  *channel;
+	guint        watch_id;
+
+	/* Watched directories by watch descriptor */
+	GHashTable  *dirs;
+};
+
+#define NSC_WATCHER_GET_PRIVATE(o)           \
+	((NscWatcherPrivate *)((NSC_WATCHER(o))->priv))
+
+G_DEFINE_TYPE (NscWatcher, nsc_watcher, G_TYPE_OBJECT)
+
+static void
+nsc_watcher_dispose (GObject *object)
+{
+	NscWatcher        *self = (NscWatcher *) object;
+	NscWatcherPrivate *priv = NSC_WATCHER_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		if (priv->watch_id) {
+			g_source_remove (priv->watch_id);
+			priv->watch_id = 0;
+		}
+
+		if (priv->channel) {
+			g_io_channel_unref (priv->channel);
+			priv->channel = NULL;
+		}
+
+		/* Closing it drops every watch */
+		if (priv->fd >= 0) {
+			close (priv->fd);
+			priv->fd = -1;
+		}
+
+		g_hash_table_remove_all (priv->dirs);
+	}
+
+	G_OBJECT_CLASS (nsc_watcher_parent_class)->dispose (object);
+}
+
+static void
+nsc_watcher_finalize (GObject *object)
+{
+	NscWatcher        *self = (NscWatcher *) object;
+	NscWatcherPrivate *priv = NSC_WATCHER_GET_PRIVATE (self);
+
+	if (priv != NULL) {
+		g_strfreev (priv->mime_types);
+		g_hash_table_destroy (priv->dirs);
+
+		g_free (priv);
+
+		(NSC_WATCHER (self))->priv = NULL;
+	}
+
+	G_OBJECT_CLASS (nsc_watcher_parent_class)->finalize (object);
+}
+
+/*
+ * Private Methods
+ */
+
+/**
+ * The content type is guessed from the name, so nothing is read
+ * from a file that is not going to be converted.
+ */
+static gboolean
+is_wanted (NscWatcher  *watcher,
+	   const gchar *name)
+{
+	NscWatcherPrivate *priv = NSC_WATCHER_GET_PRIVATE (watcher);
+	gchar             *content_type;
+	gboolean           wanted = FALSE;
+	gint               i;
+
+	/* Hidden files are usually still being copied */
+	if (name[0] == '.')
+		return FALSE;
+
+	content_type = g_content_type_guess (name, NULL, 0, NULL);
+
+	if (priv->mime_types == NULL) {
+		wanted = g_content_type_is_a (content_type, "audio/*");
+	} else {
+		for (i = 0; !wanted && priv->mime_types[i] != NULL; i++)
+			wanted = g_content_type_is_a (content_type,
+						      priv->mime_types[i]);
+	}
+
+	g_free (content_type);
+
+	return wanted;
+}
+
+static void
+handle_event (NscWatcher                 *watcher,
+	      const struct inotify_event *event)
+{
+	NscWatcherPrivate *priv = NSC_WATCHER_GET_PRIVATE (watcher);
+	GFile             *dir, *file;
+
+	if (event->mask & IN_Q_OVERFLOW) {
+		g_warning ("Too many files at once, some were missed");
+		return;
+	}
+
+	dir = g_hash_table_lookup (priv->dirs, GINT_TO_POINTER (event->wd));
+	if (dir == NULL)
+		return;
+
+	/* The directory itself went away */
+	if (event->mask & IN_IGNORED) {
+		g_hash_table_remove (priv->dirs, GINT_TO_POINTER (event->wd));
+		return;
+	}
+
+	if (event->len == 0 || (event->mask & IN_ISDIR) ||
+	    !is_wanted (watcher, event->name))
+		return;
+
+	file = g_file_get_child (dir, event->name);
+	g_signal_emit (watcher, signals[FILE_READY], 0, file);
+	g_object_unref (file);
+}
+
+/**
+ * Read every event that is waiting, and go back to sleep.
+ */
+static gboolean
+inotify_cb (GIOChannel   *channel,
+	    GIOCondition  condition,
+	    gpointer      data)
+{
+	NscWatcher        *watcher = NSC_WATCHER (data);
+	NscWatcherPrivate *priv = NSC_WATCHER_GET_PRIVATE (watcher);
+	gchar              buffer[EVENT_BUFFER_SIZE]
+		__attribute__ ((aligned (__alignof__ (struct inotify_event))));
+	const gchar       *p;
+	gssize             len;
+
+	for (;;) {
+		len = read (priv->fd, buffer, sizeof (buffer));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+
+		for (p = buffer; p < buffer + len;) {
+			const struct inotify_event *event;
+
+			event = (const struct inotify_event *) p;
+			handle_event (watcher, event);
+			p += sizeof (struct inotify_event) + event->len;
+		}
+	}
+
+	if (len < 0 && errno != EAGAIN) {
+		g_warning ("Unable to watch for new files; %s",
+			   g_strerror (errno));
+		priv->watch_id = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+ensure_inotify (NscWatcher  *watcher,
+		GError     **error)
+{
+	NscWatcherPrivate *priv = NSC_WATCHER_GET_PRIVATE (watcher);
+	gint               errsv;
+
+	if (priv->fd >= 0)
+		return TRUE;
+
+	priv->fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+	if (priv->fd < 0) {
+		errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     _("Could not watch for new files: %s"),
+			     g_strerror (errsv));
+		return FALSE;
+	}
+
+	priv->channel = g_io_channel_unix_new (priv->fd);
+	priv->watch_id = g_io_add_watch (priv->channel, G_IO_IN,
+					 inotify_cb, watcher);
+
+	return TRUE;
+}
+
+static void
+nsc_watcher_class_init (NscWatcherClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose  = nsc_watcher_dispose;
+	object_class->finalize = nsc_watcher_finalize;
+
+	/* Signals */
+	signals[FILE_READY] =
+		g_signal_new ("file-ready",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (NscWatcherClass, file_ready),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, G_TYPE_FILE);
+}
+
+static void
+nsc_watcher_init (NscWatcher *self)
+{
+	/* Allocate Private data structure */
+	(NSC_WATCHER (self))->priv = \
+		(NscWatcherPrivate *) g_malloc0 (sizeof (NscWatcherPrivate));
+
+	/* If correctly allocated, initialize parameters */
+	if ((NSC_WATCHER (self))->priv != NULL) {
+		NscWatcherPrivate *priv = NSC_WATCHER_GET_PRIVATE (self);
+
+		priv->fd = -1;
+		priv->dirs = g_hash_table_new_full (g_direct_hash,
+						    g_direct_equal,
+						    NULL, g_object_unref);
+	}
+}
+
+/*
+ * Public Methods
+ */
+
+/**
+ * Watch for files of any of @mime_types, or any audio file when
+ * @mime_types is NULL.
+ */
+NscWatcher *
+nsc_watcher_new (const gchar * const *mime_types)
+{
+	NscWatcher *watcher;
+
+	watcher = g_object_new (NSC_TYPE_WATCHER, NULL);
+	NSC_WATCHER_GET_PRIVATE (watcher)->mime_types =
+		g_strdupv ((gchar **) mime_types);
+
+	return watcher;
+}
+
+/**
+ * Report the files finished in @dir from now on.  Only @dir itself
+ * is watched, not the directories in it.
+ */
+gboolean
+nsc_watcher_add_dir (NscWatcher  *watcher,
+		     GFile       *dir,
+		     GError     **error)
+{
+	NscWatcherPrivate *priv;
+	gchar             *path;
+	gint               wd, errsv;
+
+	g_return_val_if_fail (NSC_IS_WATCHER (watcher), FALSE);
+	g_return_val_if_fail (G_IS_FILE (dir), FALSE);
+
+	priv = NSC_WATCHER_GET_PRIVATE (watcher);
+
+	path = g_file_get_path (dir);
+	if (path == NULL) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			     _("Only local folders can be watched"));
+		return FALSE;
+	}
+
+	if (!ensure_inotify (watcher, error)) {
+		g_free (path);
+		return FALSE;
+	}
+
+	wd = inotify_add_watch (priv->fd, path, WATCH_EVENTS);
+	if (wd < 0) {
+		errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     _("Could not watch %s: %s"), path,
+			     g_strerror (errsv));
+		g_free (path);
+		return FALSE;
+	}
+	g_free (path);
+
+	g_hash_table_replace (priv->dirs, GINT_TO_POINTER (wd),
+			      g_object_ref (dir));
+
+	return TRUE;
+}
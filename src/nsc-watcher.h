@@ -0,0 +1,72 @@
+/*
+ *  nsc-watcher.h
+ *
+ *  Copyright (C) 2008-2010 Brian Pepple
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *  Author: Brian Pepple <bpepple@fedoraproject.org>
+ *
+ */
+
+
+#ifndef NSC_WATCHER_H
+#define NSC_WATCHER_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Reports audio files as they are finished in a set of directories.
+ * A file is finished when whoever wrote it closes it, or when it is
+ * renamed into the directory, so half-written files are never seen.
+ * Nothing runs between events.
+ */
+
+#define NSC_TYPE_WATCHER            (nsc_watcher_get_type ())
+#define NSC_WATCHER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NSC_TYPE_WATCHER, NscWatcher))
+#define NSC_WATCHER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NSC_TYPE_WATCHER, NscWatcherClass))
+#define NSC_IS_WATCHER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NSC_TYPE_WATCHER))
+#define NSC_IS_WATCHER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NSC_TYPE_WATCHER))
+#define NSC_WATCHER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NSC_TYPE_WATCHER, NscWatcherClass))
+
+typedef struct _NscWatcher      NscWatcher;
+typedef struct _NscWatcherClass NscWatcherClass;
+
+struct _NscWatcher {
+	/* Parent object */
+	GObject  parent;
+	/* Private data pointer */
+	gpointer priv;
+};
+
+struct _NscWatcherClass {
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (*file_ready) (NscWatcher *watcher, GFile *file);
+};
+
+GType       nsc_watcher_get_type (void);
+NscWatcher *nsc_watcher_new      (const gchar * const *mime_types);
+gboolean    nsc_watcher_add_dir  (NscWatcher          *watcher,
+				  GFile               *dir,
+				  GError             **error);
+
+G_END_DECLS
+
+#endif /* NSC_WATCHER_H */
@@ -26,6 +26,59 @@
 
 #include "nsc-xml.h"
 
+/* Where the .ui files are in the compiled in resources */
+#define RESOURCE_PATH "/org/gnome/NautilusSoundConverter"
+
+/*
+ * A parsed copy of each file that was used before, so the
+ * next dialog does not have to wait for the parser.
+ */
+static GHashTable *spares = NULL;
+
+static GtkBuilder *
+load_file (const gchar  *filename,
+	   GError      **error)
+{
+	GtkBuilder *ui;
+	gchar      *path;
+
+	/* Create the gtkbuilder */
+	ui = gtk_builder_new ();
+	gtk_builder_set_translation_domain (ui, GETTEXT_PACKAGE);
+	path = g_build_path ("/", RESOURCE_PATH, filename, NULL);
+
+	/* Load the xml file */
+	if (gtk_builder_add_from_resource (ui, path, error) == 0) {
+		g_object_unref (ui);
+		ui = NULL;
+	}
+	g_free (path);
+
+	return ui;
+}
+
+static gboolean
+prefetch_idle_cb (gpointer data)
+{
+	const gchar *filename = data;
+	GtkBuilder  *ui;
+	GError      *err = NULL;
+
+	if (g_hash_table_lookup (spares, filename) != NULL)
+		return FALSE;
+
+	ui = load_file (filename, &err);
+	if (ui == NULL) {
+		g_warning ("XML file error: %s", err->message);
+		g_error_free (err);
+		return FALSE;
+	}
+
+	g_hash_table_insert (spares, g_strdup (filename), ui);
+
+	return FALSE;
+}
+
 static GtkBuilder *
 xml_get_file (const gchar *filename,
               const gchar *first_widget,
@@ -34,22 +87,28 @@ xml_get_file (const gchar *filename,
 	GObject    **pointer;
 	GtkBuilder  *ui = NULL;
 	const char  *name;
-	gchar       *path;
+	gpointer     key;
 	GError      *err = NULL;
+	gint64       start;
 
-	/* Create the gtkbuilder */
-	ui = gtk_builder_new ();
-	gtk_builder_set_translation_domain (ui, GETTEXT_PACKAGE);
-	path = g_build_filename (DATADIR, PACKAGE, filename, NULL);
+	start = g_get_monotonic_time ();
 
-	/* Load the xml file */
-	if (gtk_builder_add_from_file (ui, path, &err) == 0) {
-		g_warning ("XML file error: %s", err->message);
-		g_error_free (err);
-		g_free (path);
-		return NULL;
+	/* Take the spare if there is one, and parse the next one later */
+	if (spares != NULL &&
+	    g_hash_table_lookup_extended (spares, filename,
+					  &key, (gpointer *) &ui)) {
+		g_hash_table_steal (spares, filename);
+		g_free (key);
+	} else {
+		ui = load_file (filename, &err);
+		if (ui == NULL) {
+			g_warning ("XML file error: %s", err->message);
+			g_error_free (err);
+			return NULL;
+		}
 	}
-	g_free (path);
+
+	nsc_xml_prefetch (filename);
 
 	/* Grab the widgets */
 	for (name = first_widget; name; name = va_arg (args, char *)) {
@@ -63,6 +122,10 @@ xml_get_file (const gchar *filename,
 			continue;
 		}
 	}
+
+	g_debug ("Loaded %s in %.2f ms", filename,
+		 (g_get_monotonic_time () - start) / 1000.0);
+
 	return ui;
 }
 
@@ -88,3 +151,21 @@ nsc_xml_get_file (const gchar *filename,
 
 	return TRUE;
 }
+
+/**
+ * Parse @filename when the main loop is idle, so the next
+ * nsc_xml_get_file() for it can return right away.
+ */
+void
+nsc_xml_prefetch (const gchar *filename)
+{
+	if (spares == NULL)
+		spares = g_hash_table_new_full (g_str_hash, g_str_equal,
+						g_free, g_object_unref);
+
+	if (g_hash_table_lookup (spares, filename) != NULL)
+		return;
+
+	g_idle_add_full (G_PRIORITY_LOW, prefetch_idle_cb,
+			 g_strdup (filename), g_free);
+}
@@ -27,6 +27,7 @@
 gboolean    nsc_xml_get_file (const gchar *filename,
 			      const gchar *first_widget,
 			      ...);
+void        nsc_xml_prefetch (const gchar *filename);
 
 #endif /*  __NSC_XML_H__ */
 